@@ -4,11 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <vector>
+
 #include "llvm/IR/Module.h"
 
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/Model/Binary.h"
 #include "revng/Pipes/StringMap.h"
+#include "revng/Support/MetaAddress.h"
 
 #include "revng-c/Backend/DecompilePipe.h"
 
@@ -16,7 +20,17 @@ namespace detail {
 using Container = revng::pipes::DecompileStringMap;
 }
 
+/// The isolated functions in \a M that decompile() restructures and emits, in
+/// module order: the ones whose entry is in \a Targets, or all of them if
+/// \a Targets is empty. Declarations are never selected.
+std::vector<llvm::Function *>
+selectFunctionsToDecompile(llvm::Module &M,
+                           const std::set<MetaAddress> &Targets);
+
+/// Decompile the isolated functions in \a M whose entry is in \a Targets, or
+/// all of them if \a Targets is empty.
 void decompile(FunctionMetadataCache &Cache,
                llvm::Module &M,
                const model::Binary &Model,
+               const std::set<MetaAddress> &Targets,
                detail::Container &DecompiledFunctions);
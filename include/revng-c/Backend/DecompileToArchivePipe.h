@@ -0,0 +1,60 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/FileContainer.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/StringMap.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+inline constexpr char
+  DecompiledArchiveMIMEType[] = "application/x.c+ptml+index";
+inline constexpr char DecompiledArchiveSuffix[] = ".c.ptml.index";
+inline constexpr char DecompiledArchiveName[] = "decompiled-archive";
+using DecompiledArchiveContainer = FileContainer<&kinds::DecompiledArchive,
+                                                 DecompiledArchiveName,
+                                                 DecompiledArchiveMIMEType,
+                                                 DecompiledArchiveSuffix>;
+
+/// Pack the decompiled functions into an indexed archive (see
+/// DecompiledFunctionArchive), so that clients can fetch a single function
+/// without loading all the others.
+class DecompileToArchive {
+public:
+  static constexpr auto Name = "decompile-to-archive";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    return { ContractGroup({ Contract(Decompiled,
+                                      0,
+                                      DecompiledArchive,
+                                      1,
+                                      InputPreservation::Preserve) }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           const DecompileStringMap &DecompiledFunctionsContainer,
+           DecompiledArchiveContainer &OutArchive);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
+} // end namespace revng::pipes
@@ -13,7 +13,6 @@
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Contract.h"
 #include "revng/Pipes/Kinds.h"
-#include "revng/Pipes/StringBufferContainer.h"
 #include "revng/Pipes/StringMap.h"
 
 #include "revng-c/Backend/DecompilePipe.h"
@@ -24,10 +23,10 @@ namespace revng::pipes {
 inline constexpr char DecompiledMIMEType[] = "text/x.c+ptml";
 inline constexpr char DecompiledSuffix[] = ".c";
 inline constexpr char DecompiledName[] = "decompiled-c-code";
-using DecompiledFileContainer = StringBufferContainer<&kinds::DecompiledToC,
-                                                      DecompiledName,
-                                                      DecompiledMIMEType,
-                                                      DecompiledSuffix>;
+using DecompiledFileContainer = FileContainer<&kinds::DecompiledToC,
+                                             DecompiledName,
+                                             DecompiledMIMEType,
+                                             DecompiledSuffix>;
 
 class DecompileToSingleFile {
 public:
@@ -0,0 +1,115 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+
+/// Indexed binary archive of decompiled functions.
+///
+/// The archive is laid out as follows (all integers are little endian):
+///
+/// * a Header;
+/// * `Header.EntryCount` IndexEntry, sorted by MetaAddress;
+/// * the string table, holding the serialized MetaAddress of each entry;
+/// * the body of each function, compressed with zlib if the Compressed flag
+///   is set.
+///
+/// Since the index is made of fixed-size entries sorted by MetaAddress, a
+/// single function can be looked up with a binary search and decompressed
+/// without touching the rest of the archive.
+namespace decompiled_archive {
+
+inline constexpr char Magic[8] = { 'R', 'V', 'N', 'G', 'C', 'D', 'F', 'A' };
+inline constexpr uint32_t Version = 1;
+
+enum Flags : uint32_t {
+  None = 0,
+  Compressed = 1 << 0,
+};
+
+using ulittle32_t = llvm::support::ulittle32_t;
+using ulittle64_t = llvm::support::ulittle64_t;
+
+struct Header {
+  char Magic[8];
+  ulittle32_t Version;
+  ulittle32_t Flags;
+  ulittle64_t EntryCount;
+  ulittle64_t Reserved;
+};
+static_assert(sizeof(Header) == 32);
+
+struct IndexEntry {
+  /// Offset and size of the serialized MetaAddress in the string table
+  ulittle32_t KeyOffset;
+  ulittle32_t KeySize;
+  /// Offset and size of the (possibly compressed) body
+  ulittle64_t BodyOffset;
+  ulittle64_t BodySize;
+  /// Size of the body once decompressed
+  ulittle64_t RawSize;
+};
+static_assert(sizeof(IndexEntry) == 32);
+
+} // namespace decompiled_archive
+
+/// Serialize \a Functions as an indexed archive.
+/// If \a Compress is set and zlib is available, bodies are compressed.
+void writeDecompiledFunctionArchive(llvm::raw_ostream &OS,
+                                    const revng::pipes::DecompileStringMap
+                                      &Functions,
+                                    bool Compress);
+
+/// Read-only view over an archive produced by writeDecompiledFunctionArchive.
+///
+/// The archive is memory-mapped when opened from a file: only the pages of the
+/// index and of the functions actually looked up are read.
+///
+/// Archives are not trusted: malformed ones are reported as llvm::Errors, both
+/// when they are opened and when a corrupt body is looked up.
+class DecompiledFunctionArchive {
+private:
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  const decompiled_archive::Header *TheHeader = nullptr;
+  const decompiled_archive::IndexEntry *Index = nullptr;
+
+private:
+  explicit DecompiledFunctionArchive(std::unique_ptr<llvm::MemoryBuffer>
+                                       Buffer);
+
+public:
+  static llvm::Expected<DecompiledFunctionArchive>
+  create(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+  static llvm::Expected<DecompiledFunctionArchive> open(llvm::StringRef Path);
+
+public:
+  uint64_t size() const;
+
+  MetaAddress getKey(uint64_t Index) const;
+
+  /// Find the C code of the function at \a Entry, decompressing only that
+  /// function. O(log n) in the number of functions in the archive.
+  /// Returns std::nullopt if the archive has no such function, and an error if
+  /// its body is corrupt.
+  llvm::Expected<std::optional<std::string>>
+  lookup(const MetaAddress &Entry) const;
+
+private:
+  llvm::Expected<std::string>
+  getBody(const decompiled_archive::IndexEntry &Entry) const;
+};
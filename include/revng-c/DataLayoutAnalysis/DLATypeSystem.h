@@ -4,9 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <compare>
 #include <cstddef>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
@@ -14,10 +16,15 @@
 #include <set>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/EpochTracker.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/IntEqClasses.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Allocator.h"
@@ -116,9 +123,19 @@ public:
 protected:
   const LinkKind Kind;
   OffsetExpression OE;
+  size_t Hash;
+  // The ID assigned to the tag when it is interned in a LayoutTypeSystem.
+  // Interned tags are unique, so two interned tags are equal if and only if
+  // they have the same ID. 0 is never assigned, so it marks the tags that have
+  // not been interned yet.
+  uint32_t ID = 0;
+
+  friend class LayoutTypeSystem;
+
+  static size_t computeHash(LinkKind K, const OffsetExpression &O);
 
   explicit TypeLinkTag(LinkKind K, OffsetExpression &&O) :
-    Kind(K), OE(std::move(O)) {}
+    Kind(K), OE(std::move(O)), Hash(computeHash(Kind, OE)) {}
 
   // TODO: potentially we are interested in marking TypeLinkTags with some info
   // that allows us to track which step on the type system has created them.
@@ -149,7 +166,26 @@ public:
     return TypeLinkTag(LK_Pointer, OffsetExpression{});
   }
 
-  std::strong_ordering operator<=>(const TypeLinkTag &Other) const = default;
+  size_t getHash() const { return Hash; }
+
+  uint32_t getID() const {
+    revng_assert(ID != 0);
+    return ID;
+  }
+
+  bool operator==(const TypeLinkTag &Other) const {
+    return Hash == Other.Hash and Kind == Other.Kind and OE == Other.OE;
+  }
+
+  /// Orders the tags by kind and then by offset expression. Comparing the IDs
+  /// is cheaper, when the order only needs to be consistent.
+  std::strong_ordering operator<=>(const TypeLinkTag &Other) const {
+    if (this == &Other)
+      return std::strong_ordering::equal;
+    if (auto Cmp = Kind <=> Other.Kind; Cmp != 0)
+      return Cmp;
+    return OE <=> Other.OE;
+  }
 
   friend void
   writeToLog(Logger<true> &L, const dla::TypeLinkTag &T, int /* Ignore */);
@@ -172,10 +208,16 @@ struct LayoutTypeSystemNode {
   struct NeighborLinkComparison {
     using is_transparent = std::true_type;
 
+    /// Links are ordered by the ID of the neighbor, and then by tag. A
+    /// missing tag comes before all the others.
+    ///
+    /// Tags are interned, so equal tags are detected comparing pointers, and
+    /// the tags themselves are only compared for parallel links to the same
+    /// neighbor, to keep them ordered by offset.
     struct Helper {
     private:
       uint64_t ID;
-      const TypeLinkTag *const TagPointer;
+      const TypeLinkTag *TagPointer;
 
     public:
       Helper() : ID(0), TagPointer(nullptr) {}
@@ -185,11 +227,14 @@ struct LayoutTypeSystemNode {
       Helper(const Helper &) = default;
 
       bool operator<(const Helper &Other) const {
-        if (auto Cmp = ID <=> Other.ID; Cmp != 0)
-          return Cmp < 0;
+        if (ID != Other.ID)
+          return ID < Other.ID;
+
+        if (TagPointer == Other.TagPointer)
+          return false;
 
         if (nullptr == TagPointer or nullptr == Other.TagPointer)
-          return TagPointer < Other.TagPointer;
+          return nullptr == TagPointer;
 
         return *TagPointer < *Other.TagPointer;
       }
@@ -200,7 +245,245 @@ struct LayoutTypeSystemNode {
     }
   };
 
-  using NeighborsSet = std::set<Link, NeighborLinkComparison>;
+  /// The set of the neighbors of a node, sorted as a
+  /// std::set<Link, NeighborLinkComparison> would be, but stored in a
+  /// contiguous vector to be cheap to allocate and fast to iterate.
+  ///
+  /// Erasing a Link only marks it as erased, so that erasing never invalidates
+  /// the iterators to the other Links. Inserting a Link instead compacts away
+  /// the erased ones, and invalidates all the iterators to the set.
+  class NeighborsSet : public llvm::DebugEpochBase {
+  private:
+    using Key = NeighborLinkComparison::Helper;
+
+    struct Entry {
+      Link Value;
+      // The ID of Value.first, so that looking up a Link does not need to
+      // access the neighbors, some of which might have been destroyed if the
+      // Link has been erased.
+      uint64_t ID;
+      bool Erased;
+
+      Key getKey() const { return Key({ ID, Value.second }); }
+    };
+
+    std::vector<Entry> Entries;
+    size_t NumErased = 0;
+
+  public:
+    using value_type = Link;
+    using size_type = size_t;
+
+    class iterator : public llvm::DebugEpochBase::HandleBase {
+    private:
+      friend class NeighborsSet;
+
+      const Entry *Current = nullptr;
+      const Entry *End = nullptr;
+
+      iterator(const Entry *Current,
+               const Entry *End,
+               const llvm::DebugEpochBase *Epoch) :
+        llvm::DebugEpochBase::HandleBase(Epoch), Current(Current), End(End) {
+        skipErased();
+      }
+
+      void skipErased() {
+        while (Current != End and Current->Erased)
+          ++Current;
+      }
+
+    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Link;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Link *;
+      using reference = const Link &;
+
+      iterator() = default;
+
+      reference operator*() const {
+        revng_assert(isHandleInSync(), "NeighborsSet iterator invalidated");
+        return Current->Value;
+      }
+      pointer operator->() const { return &operator*(); }
+
+      iterator &operator++() {
+        revng_assert(isHandleInSync(), "NeighborsSet iterator invalidated");
+        ++Current;
+        skipErased();
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator Old = *this;
+        ++*this;
+        return Old;
+      }
+
+      iterator &operator--() {
+        revng_assert(isHandleInSync(), "NeighborsSet iterator invalidated");
+        do
+          --Current;
+        while (Current->Erased);
+        return *this;
+      }
+      iterator operator--(int) {
+        iterator Old = *this;
+        --*this;
+        return Old;
+      }
+
+      bool operator==(const iterator &Other) const {
+        return Current == Other.Current;
+      }
+    };
+
+    using const_iterator = iterator;
+
+  private:
+    iterator makeIterator(std::vector<Entry>::const_iterator It) const {
+      const Entry *Begin = Entries.data();
+      return iterator(Begin + (It - Entries.begin()),
+                      Begin + Entries.size(),
+                      this);
+    }
+
+    // The first entry, erased or not, whose key is not less than K
+    std::vector<Entry>::iterator lowerBoundEntry(const Key &K) {
+      return std::lower_bound(Entries.begin(),
+                              Entries.end(),
+                              K,
+                              [](const Entry &E, const Key &K) {
+                                return E.getKey() < K;
+                              });
+    }
+
+    std::vector<Entry>::const_iterator lowerBoundEntry(const Key &K) const {
+      return const_cast<NeighborsSet *>(this)->lowerBoundEntry(K);
+    }
+
+    std::vector<Entry>::const_iterator upperBoundEntry(const Key &K) const {
+      return std::upper_bound(Entries.begin(),
+                              Entries.end(),
+                              K,
+                              [](const Key &K, const Entry &E) {
+                                return K < E.getKey();
+                              });
+    }
+
+    void compact() {
+      if (not NumErased)
+        return;
+      llvm::erase_if(Entries, [](const Entry &E) { return E.Erased; });
+      NumErased = 0;
+    }
+
+    static bool sameKey(const Entry &LHS, const Entry &RHS) {
+      return not(LHS.getKey() < RHS.getKey())
+             and not(RHS.getKey() < LHS.getKey());
+    }
+
+  public:
+    iterator begin() const { return makeIterator(Entries.begin()); }
+    iterator end() const { return makeIterator(Entries.end()); }
+
+    size_t size() const { return Entries.size() - NumErased; }
+    bool empty() const { return size() == 0; }
+
+    iterator lower_bound(const Key &K) const {
+      return makeIterator(lowerBoundEntry(K));
+    }
+
+    iterator upper_bound(const Key &K) const {
+      return makeIterator(upperBoundEntry(K));
+    }
+
+    iterator find(const Link &L) const {
+      Key K(L);
+      auto It = lowerBoundEntry(K);
+      if (It == Entries.end() or It->Erased or K < It->getKey())
+        return end();
+      return makeIterator(It);
+    }
+
+    bool contains(const Link &L) const { return find(L) != end(); }
+
+    std::pair<iterator, bool> insert(const Link &L) {
+      Key K(L);
+      auto It = lowerBoundEntry(K);
+      bool Found = It != Entries.end() and not(K < It->getKey());
+      if (Found and not It->Erased)
+        return { makeIterator(It), false };
+
+      incrementEpoch();
+      if (Found) {
+        // Revive the erased entry, nothing needs to be moved
+        It->Value = L;
+        It->Erased = false;
+        --NumErased;
+      } else {
+        if (NumErased) {
+          compact();
+          It = lowerBoundEntry(K);
+        }
+        It = Entries.insert(It, Entry{ L, L.first->ID, false });
+      }
+      return { makeIterator(It), true };
+    }
+
+    /// Inserts all the Links in the range that are not in the set yet. This
+    /// is linear in the size of the set if the range is sorted.
+    template<typename IteratorT>
+    void insert(IteratorT First, IteratorT Last) {
+      incrementEpoch();
+      compact();
+      auto OldSize = static_cast<std::ptrdiff_t>(Entries.size());
+      for (const Link &L : llvm::make_range(First, Last))
+        Entries.push_back(Entry{ L, L.first->ID, false });
+
+      const auto Less = [](const Entry &LHS, const Entry &RHS) {
+        return LHS.getKey() < RHS.getKey();
+      };
+      auto Middle = Entries.begin() + OldSize;
+      if (not std::is_sorted(Middle, Entries.end(), Less))
+        std::stable_sort(Middle, Entries.end(), Less);
+      std::inplace_merge(Entries.begin(), Middle, Entries.end(), Less);
+      // The merge is stable, so for duplicated Links this keeps the one that
+      // was in the set before
+      Entries.erase(std::unique(Entries.begin(), Entries.end(), sameKey),
+                    Entries.end());
+    }
+
+    iterator erase(iterator It) {
+      revng_assert(It != end());
+      auto &E = Entries[It.Current - Entries.data()];
+      revng_assert(not E.Erased);
+      E.Erased = true;
+      ++NumErased;
+      return ++It;
+    }
+
+    iterator erase(iterator First, iterator Last) {
+      while (First != Last)
+        First = erase(First);
+      return Last;
+    }
+
+    size_t erase(const Link &L) {
+      auto It = find(L);
+      if (It == end())
+        return 0;
+      erase(It);
+      return 1;
+    }
+
+    void clear() {
+      incrementEpoch();
+      Entries.clear();
+      NumErased = 0;
+    }
+  };
+
   using NeighborIterator = NeighborsSet::iterator;
   NeighborsSet Successors{};
   NeighborsSet Predecessors{};
@@ -285,13 +568,71 @@ public:
   using NodeUniquePtr = std::unique_ptr<LayoutTypeSystemNode>;
   using NeighborIterator = LayoutTypeSystemNode::NeighborIterator;
 
+  /// Iterates over the nodes in order of ID, skipping the removed ones.
+  ///
+  /// Creating nodes does not invalidate the iterators, and the nodes created
+  /// during an iteration are visited by it too.
+  class LayoutIterator {
+  private:
+    friend class LayoutTypeSystem;
+
+    const std::vector<LayoutTypeSystemNode *> *Nodes = nullptr;
+    size_t Index = 0;
+
+    LayoutIterator(const std::vector<LayoutTypeSystemNode *> *Nodes,
+                   size_t Index) :
+      Nodes(Nodes), Index(Index) {
+      skipRemoved();
+    }
+
+    bool isEnd() const { return Index >= Nodes->size(); }
+
+    void skipRemoved() {
+      while (not isEnd() and (*Nodes)[Index] == nullptr)
+        ++Index;
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = LayoutTypeSystemNode *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = LayoutTypeSystemNode *const *;
+    using reference = LayoutTypeSystemNode *;
+
+    LayoutIterator() = default;
+
+    LayoutTypeSystemNode *operator*() const { return (*Nodes)[Index]; }
+
+    LayoutIterator &operator++() {
+      ++Index;
+      skipRemoved();
+      return *this;
+    }
+    LayoutIterator operator++(int) {
+      LayoutIterator Old = *this;
+      ++*this;
+      return Old;
+    }
+
+    bool operator==(const LayoutIterator &Other) const {
+      // The end iterator keeps being the end when new nodes are created
+      if (isEnd() or Other.isEnd())
+        return isEnd() and Other.isEnd();
+      return Index == Other.Index;
+    }
+  };
+
   LayoutTypeSystem() : DebugPrinter(new TSDebugPrinter) {}
 
   ~LayoutTypeSystem() {
     for (auto *Layout : Layouts) {
+      if (not Layout)
+        continue;
       Layout->~LayoutTypeSystemNode();
       NodeAllocator.Deallocate(Layout);
     }
+    for (const TypeLinkTag *Tag : LinkTags)
+      Tag->~TypeLinkTag();
     Layouts.clear();
   }
 
@@ -308,13 +649,15 @@ protected:
   addLink(LayoutTypeSystemNode *Src, LayoutTypeSystemNode *Tgt, TagT &&Tag) {
     if (Src == nullptr or Tgt == nullptr or Src == Tgt)
       return std::make_pair(nullptr, false);
-    revng_assert(Layouts.contains(Src));
-    revng_assert(Layouts.contains(Tgt));
-    auto It = LinkTags.insert(std::forward<TagT>(Tag)).first;
-    revng_assert(It != LinkTags.end());
-    const TypeLinkTag *T = &*It;
+    revng_assert(hasLayout(Src));
+    revng_assert(hasLayout(Tgt));
+    const TypeLinkTag *T = internTag(std::forward<TagT>(Tag));
     bool New = Src->Successors.insert(std::make_pair(Tgt, T)).second;
     New |= Tgt->Predecessors.insert(std::make_pair(Src, T)).second;
+    if (New) {
+      markChanged(Src);
+      markChanged(Tgt);
+    }
     return std::make_pair(T, New);
   }
 
@@ -360,12 +703,77 @@ public:
     dumpDotOnFile(FName.c_str(), ShowCollapsed);
   }
 
-  auto getNumLayouts() const { return Layouts.size(); }
+  auto getNumLayouts() const { return NumLayouts; }
+
+  /// The node with ID \a ID, or nullptr if it has been removed
+  LayoutTypeSystemNode *getNodeByID(uint64_t ID) const {
+    return ID < Layouts.size() ? Layouts[ID] : nullptr;
+  }
+
+  /// The number of nodes that have been merged into other nodes so far
+  uint64_t getNumMergedNodes() const { return NumMergedNodes; }
+
+  /// The number of nodes that have been removed so far, without merging them
+  uint64_t getNumRemovedNodes() const { return NumRemovedNodes; }
+
+  /// The bytes allocated so far for nodes and link tags. Nodes are allocated
+  /// in a bump allocator, so removing them does not decrease this number.
+  size_t getAllocatedBytes() const {
+    return NodeAllocator.getBytesAllocated()
+           + TagAllocator.getBytesAllocated();
+  }
 
   auto getLayoutsRange() const {
-    return llvm::make_range(Layouts.begin(), Layouts.end());
+    return llvm::make_range(LayoutIterator(&Layouts, 0),
+                            LayoutIterator(&Layouts, Layouts.size()));
+  }
+
+  /// Counts the edges, walking the successors of all the nodes
+  size_t getNumEdges() const {
+    size_t Result = 0;
+    for (const LayoutTypeSystemNode *N : getLayoutsRange())
+      Result += N->Successors.size();
+    return Result;
+  }
+
+public:
+  /// A position in the log of the nodes that changed
+  using ChangeCheckpoint = size_t;
+
+  /// Returns a checkpoint, to later get the nodes that changed after it.
+  /// Changes are only tracked after the first checkpoint has been taken.
+  ChangeCheckpoint getChangeCheckpoint() {
+    TrackChanges = true;
+    LatestCheckpoint = ChangeLog.size();
+    return LatestCheckpoint;
   }
 
+  /// Records that \a N has changed: it has been created, its size has
+  /// changed, or some of its edges have been added, moved or removed.
+  ///
+  /// The methods of LayoutTypeSystem that change the nodes record their changes
+  /// on their own, this has to be called only after changing a node directly.
+  void markChanged(const LayoutTypeSystemNode *N) {
+    if (not TrackChanges)
+      return;
+
+    if (LastChange.size() <= N->ID)
+      LastChange.resize(Layouts.size(), 0);
+
+    // A node logged after the latest checkpoint is seen from all the
+    // checkpoints, so there's no need to log it again
+    if (LastChange[N->ID] > LatestCheckpoint)
+      return;
+
+    ChangeLog.push_back(N->ID);
+    LastChange[N->ID] = ChangeLog.size();
+  }
+
+  /// The nodes that changed after \a Checkpoint, and that have not been
+  /// removed since, in order of ID
+  llvm::SmallVector<LayoutTypeSystemNode *, 0>
+  getChangedSince(ChangeCheckpoint Checkpoint) const;
+
 public:
   void mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *> ToMerge);
 
@@ -391,11 +799,62 @@ private:
 
   // Holds all the LayoutTypeSystemNode
   llvm::BumpPtrAllocator NodeAllocator = {};
-  std::set<LayoutTypeSystemNode *> Layouts = {};
+  // The node with ID I is Layouts[I], or nullptr if it has been removed
+  std::vector<LayoutTypeSystemNode *> Layouts = {};
+  size_t NumLayouts = 0;
+  uint64_t NumMergedNodes = 0;
+  uint64_t NumRemovedNodes = 0;
+
+  // The IDs of the nodes that changed, in order of change
+  std::vector<uint64_t> ChangeLog = {};
+  // For each node ID, the position in ChangeLog after its latest entry, or 0
+  // if it was never logged
+  std::vector<size_t> LastChange = {};
+  ChangeCheckpoint LatestCheckpoint = 0;
+  bool TrackChanges = false;
+
+  bool hasLayout(const LayoutTypeSystemNode *N) const {
+    return N->ID < Layouts.size() and Layouts[N->ID] == N;
+  }
+
+  void eraseLayout(LayoutTypeSystemNode *N) {
+    revng_assert(hasLayout(N));
+    Layouts[N->ID] = nullptr;
+    --NumLayouts;
+    N->~LayoutTypeSystemNode();
+    NodeAllocator.Deallocate(N);
+  }
+
+  struct InternedTagInfo {
+    static const TypeLinkTag *getEmptyKey() {
+      return llvm::DenseMapInfo<const TypeLinkTag *>::getEmptyKey();
+    }
+
+    static const TypeLinkTag *getTombstoneKey() {
+      return llvm::DenseMapInfo<const TypeLinkTag *>::getTombstoneKey();
+    }
+
+    static unsigned getHashValue(const TypeLinkTag *Tag) {
+      return Tag->getHash();
+    }
+
+    static bool isEqual(const TypeLinkTag *LHS, const TypeLinkTag *RHS) {
+      if (LHS == RHS)
+        return true;
+      if (LHS == getEmptyKey() or LHS == getTombstoneKey()
+          or RHS == getEmptyKey() or RHS == getTombstoneKey())
+        return false;
+      return *LHS == *RHS;
+    }
+  };
 
   // Holds the link tags, so that they can be deduplicated and referred to using
   // TypeLinkTag * in the links inside LayoutTypeSystemNode
-  std::set<TypeLinkTag> LinkTags = {};
+  llvm::BumpPtrAllocator TagAllocator = {};
+  llvm::DenseSet<const TypeLinkTag *, InternedTagInfo> LinkTags = {};
+
+  // Returns the interned tag equal to Tag, interning it if it's new
+  const TypeLinkTag *internTag(TypeLinkTag &&Tag);
 
 public:
   // Checks that is valid, and returns true if it is, false otherwise
@@ -571,7 +1030,7 @@ struct llvm::GraphTraits<const dla::LayoutTypeSystem *>
   : public llvm::GraphTraits<const dla::LayoutTypeSystemNode *> {
 
 public:
-  using nodes_iterator = std::set<dla::LayoutTypeSystemNode *>::iterator;
+  using nodes_iterator = dla::LayoutTypeSystem::LayoutIterator;
 
   static NodeRef getEntryNode(const dla::LayoutTypeSystem *) { return nullptr; }
 
@@ -593,7 +1052,7 @@ struct llvm::GraphTraits<dla::LayoutTypeSystem *>
   : public llvm::GraphTraits<dla::LayoutTypeSystemNode *> {
 
 public:
-  using nodes_iterator = std::set<dla::LayoutTypeSystemNode *>::iterator;
+  using nodes_iterator = dla::LayoutTypeSystem::LayoutIterator;
 
   static NodeRef getEntryNode(const dla::LayoutTypeSystem *) { return nullptr; }
 
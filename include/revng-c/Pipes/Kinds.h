@@ -65,4 +65,10 @@ inline pipeline::SingleElementKind DecompiledToC("decompiled-to-c",
                                                  fat(ranks::Function),
                                                  { &ModelHeader });
 
+inline pipeline::SingleElementKind DecompiledArchive("decompiled-archive",
+                                                     Binary,
+                                                     ranks::Binary,
+                                                     fat(ranks::Function),
+                                                     { &ModelHeader });
+
 } // namespace revng::kinds
@@ -10,6 +10,7 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
 
 #include "revng-c/RestructureCFG/BasicBlockNodeBB.h"
@@ -35,7 +36,9 @@ public:
     NK_List,
     NK_Switch,
     NK_SwitchBreak,
-    NK_Set
+    NK_Set,
+    NK_Label,
+    NK_Goto
   };
 
   enum class DispatcherKind {
@@ -75,7 +78,7 @@ public:
     Name(CFGNode->getNameStr()),
     Successor(Successor) {}
 
-  inline ASTNode *Clone() const;
+  inline ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const;
 
   ASTNode &operator=(ASTNode &&) = delete;
   ASTNode &operator=(const ASTNode &) = delete;
@@ -83,7 +86,9 @@ public:
   ASTNode() = delete;
 
 public:
-  static void deleteASTNode(ASTNode *A);
+  /// Run the destructor of \a A, without releasing its memory, which belongs
+  /// to the arena of an `ASTTree`
+  static void destroyASTNode(ASTNode *A);
 
 protected:
   ASTNode(const ASTNode &) = default;
@@ -157,7 +162,9 @@ public:
 
   void dumpEdge(llvm::raw_fd_ostream &ASTFile);
 
-  ASTNode *Clone() const { return new CodeNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) CodeNode(*this);
+  }
 };
 
 class IfNode : public ASTNode {
@@ -268,12 +275,12 @@ public:
 
   void updateASTNodesPointers(ASTNodeMap &SubstitutionMap);
 
-  ASTNode *Clone() const { return new IfNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) IfNode(*this);
+  }
 
   ExprNode *getCondExpr() const { return ConditionExpression; }
 
-  ExprNode **getCondExprAddress() { return &ConditionExpression; }
-
   void replaceCondExpr(ExprNode *NewExpr) { ConditionExpression = NewExpr; }
 
   void updateCondExprPtr(ExprNodeMap &Map);
@@ -325,7 +332,9 @@ public:
 
   void updateASTNodesPointers(ASTNodeMap &SubstitutionMap);
 
-  ASTNode *Clone() const { return new ScsNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) ScsNode(*this);
+  }
 
   bool isWhileTrue() const { return LoopType == Type::WhileTrue; }
 
@@ -369,8 +378,9 @@ private:
   SequenceNode(const std::string &Name) : ASTNode(NK_List, Name) {}
 
 public:
-  static SequenceNode *createEmpty(const std::string &Name) {
-    return new SequenceNode(Name);
+  static SequenceNode *createEmpty(llvm::BumpPtrAllocator &Allocator,
+                                   const std::string &Name) {
+    return new (Allocator) SequenceNode(Name);
   }
 
 protected:
@@ -415,8 +425,8 @@ public:
 
   void updateASTNodesPointers(ASTNodeMap &SubstitutionMap);
 
-  ASTNode *Clone() const {
-    return reinterpret_cast<ASTNode *>(new SequenceNode(*this));
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) SequenceNode(*this);
   }
 };
 
@@ -442,7 +452,9 @@ protected:
 public:
   static bool classof(const ASTNode *N) { return N->getKind() == NK_Continue; }
 
-  ASTNode *Clone() const { return new ContinueNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) ContinueNode(*this);
+  }
 
   void dump(llvm::raw_fd_ostream &ASTFile);
 
@@ -477,7 +489,9 @@ protected:
   }
 
 public:
-  ASTNode *Clone() const { return new BreakNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) BreakNode(*this);
+  }
 
   void dump(llvm::raw_fd_ostream &ASTFile);
 
@@ -535,7 +549,9 @@ public:
 
   void dumpEdge(llvm::raw_fd_ostream &ASTFile);
 
-  ASTNode *Clone() const { return new SetNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) SetNode(*this);
+  }
 
   unsigned getStateVariableValue() const { return StateVariableValue; }
 
@@ -599,7 +615,9 @@ public:
 
   void dumpEdge(llvm::raw_fd_ostream &ASTFile);
 
-  ASTNode *Clone() const { return new SwitchNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) SwitchNode(*this);
+  }
 
   case_container &cases() { return LabelCaseVec; }
 
@@ -701,7 +719,9 @@ public:
     return N->getKind() == NK_SwitchBreak;
   }
 
-  ASTNode *Clone() const { return new SwitchBreakNode(*this); }
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) SwitchBreakNode(*this);
+  }
 
   void dump(llvm::raw_fd_ostream &ASTFile);
 
@@ -717,26 +737,97 @@ public:
   }
 };
 
-inline ASTNode *ASTNode::Clone() const {
+// Target of `GotoNode`s. Labels and gotos are only emitted for regions whose
+// combing has been interrupted because it exceeded the duplication budget.
+class LabelNode : public ASTNode {
+  friend class ASTNode;
+
+public:
+  LabelNode(const std::string &Name) : ASTNode(NK_Label, Name) {}
+
+protected:
+  LabelNode(const LabelNode &) = default;
+  LabelNode(LabelNode &&) = delete;
+  ~LabelNode() = default;
+
+  // Each label marks a distinct point in the code, so two labels are never
+  // interchangeable.
+  bool nodeIsEqual(const ASTNode *Node) const { return this == Node; }
+
+public:
+  static bool classof(const ASTNode *N) { return N->getKind() == NK_Label; }
+
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) LabelNode(*this);
+  }
+
+  void dump(llvm::raw_fd_ostream &ASTFile);
+
+  void dumpEdge(llvm::raw_fd_ostream &ASTFile);
+};
+
+class GotoNode : public ASTNode {
+  friend class ASTNode;
+
+private:
+  LabelNode *Target = nullptr;
+
+public:
+  GotoNode(LabelNode *Target) : ASTNode(NK_Goto, "goto"), Target(Target) {}
+
+protected:
+  GotoNode(const GotoNode &) = default;
+  GotoNode(GotoNode &&) = delete;
+  ~GotoNode() = default;
+
+  bool nodeIsEqual(const ASTNode *Node) const {
+    auto *OtherGoto = llvm::dyn_cast_or_null<GotoNode>(Node);
+    return OtherGoto != nullptr and OtherGoto->getTarget() == Target;
+  }
+
+public:
+  static bool classof(const ASTNode *N) { return N->getKind() == NK_Goto; }
+
+  ASTNode *Clone(llvm::BumpPtrAllocator &Allocator) const {
+    return new (Allocator) GotoNode(*this);
+  }
+
+  void dump(llvm::raw_fd_ostream &ASTFile);
+
+  void dumpEdge(llvm::raw_fd_ostream &ASTFile);
+
+  void updateASTNodesPointers(ASTNodeMap &SubstitutionMap);
+
+  LabelNode *getTarget() const {
+    revng_assert(Target != nullptr);
+    return Target;
+  }
+};
+
+inline ASTNode *ASTNode::Clone(llvm::BumpPtrAllocator &Allocator) const {
   switch (getKind()) {
   case NK_Code:
-    return llvm::cast<CodeNode>(this)->Clone();
+    return llvm::cast<CodeNode>(this)->Clone(Allocator);
   case NK_Break:
-    return llvm::cast<BreakNode>(this)->Clone();
+    return llvm::cast<BreakNode>(this)->Clone(Allocator);
   case NK_Continue:
-    return llvm::cast<ContinueNode>(this)->Clone();
+    return llvm::cast<ContinueNode>(this)->Clone(Allocator);
   case NK_If:
-    return llvm::cast<IfNode>(this)->Clone();
+    return llvm::cast<IfNode>(this)->Clone(Allocator);
   case NK_Scs:
-    return llvm::cast<ScsNode>(this)->Clone();
+    return llvm::cast<ScsNode>(this)->Clone(Allocator);
   case NK_List:
-    return llvm::cast<SequenceNode>(this)->Clone();
+    return llvm::cast<SequenceNode>(this)->Clone(Allocator);
   case NK_Switch:
-    return llvm::cast<SwitchNode>(this)->Clone();
+    return llvm::cast<SwitchNode>(this)->Clone(Allocator);
   case NK_SwitchBreak:
-    return llvm::cast<SwitchBreakNode>(this)->Clone();
+    return llvm::cast<SwitchBreakNode>(this)->Clone(Allocator);
   case NK_Set:
-    return llvm::cast<SetNode>(this)->Clone();
+    return llvm::cast<SetNode>(this)->Clone(Allocator);
+  case NK_Label:
+    return llvm::cast<LabelNode>(this)->Clone(Allocator);
+  case NK_Goto:
+    return llvm::cast<GotoNode>(this)->Clone(Allocator);
   }
   return nullptr;
 }
@@ -772,9 +863,15 @@ inline void ASTNode::updateASTNodesPointers(ASTNodeMap &SubstitutionMap) {
     SwitchBreak->updateASTNodesPointers(SubstitutionMap);
   } break;
 
+  case ASTNode::NK_Goto: {
+    auto *Goto = llvm::cast<GotoNode>(this);
+    Goto->updateASTNodesPointers(SubstitutionMap);
+  } break;
+
   case ASTNode::NK_Code:
   case ASTNode::NK_Break:
-  case ASTNode::NK_Set: {
+  case ASTNode::NK_Set:
+  case ASTNode::NK_Label: {
     // They only have a successor
   } break;
 
@@ -810,6 +907,10 @@ inline bool ASTNode::isEqual(const ASTNode *Node) const {
     return llvm::cast<SwitchBreakNode>(this)->nodeIsEqual(Node);
   case NK_Set:
     return llvm::cast<SetNode>(this)->nodeIsEqual(Node);
+  case NK_Label:
+    return llvm::cast<LabelNode>(this)->nodeIsEqual(Node);
+  case NK_Goto:
+    return llvm::cast<GotoNode>(this)->nodeIsEqual(Node);
   default:
     revng_abort();
   }
@@ -6,11 +6,16 @@
 
 class ASTNode;
 class ASTTree;
+class IfNode;
 
 extern bool needsLoopVar(const ASTNode *N);
 
 extern void flipEmptyThen(ASTTree &AST, ASTNode *RootNode);
 
+/// Moves the `else` branch of \a If to the `then` branch, negating its
+/// condition, if the `then` branch is empty. Returns whether it did.
+extern bool flipIfEmptyThen(ASTTree &AST, IfNode *If);
+
 extern ASTNode *collapseSequences(ASTTree &AST, ASTNode *RootNode);
 
 extern ASTNode *simplifyAtomicSequence(ASTTree &AST, ASTNode *RootNode);
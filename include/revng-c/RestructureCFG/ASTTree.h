@@ -5,8 +5,12 @@
 //
 
 #include <cstdlib>
+#include <tuple>
 #include <type_traits>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Allocator.h"
+
 #include "revng-c/RestructureCFG/ASTNode.h"
 
 // Forward declarations.
@@ -17,12 +21,18 @@ class BasicBlockNode;
 
 class SequenceNode;
 
+/// The GHAST of a function.
+///
+/// All the `ASTNode`s and `ExprNode`s of the tree are allocated in an arena
+/// owned by the tree, and their memory is released all at once when the tree is
+/// destroyed.
 class ASTTree {
 
 public:
-  using ast_deleter_t = decltype(&ASTNode::deleteASTNode);
+  /// Removing a node only runs its destructor: its memory belongs to the arena
+  using ast_deleter_t = decltype(&ASTNode::destroyASTNode);
   using ast_destructor = std::integral_constant<ast_deleter_t,
-                                                &ASTNode::deleteASTNode>;
+                                                &ASTNode::destroyASTNode>;
   using ast_unique_ptr = std::unique_ptr<ASTNode, ast_destructor>;
   using getPointerT = ASTNode *(*) (ast_unique_ptr &);
 
@@ -37,15 +47,16 @@ public:
   using links_iterator = llvm::mapped_iterator<internal_iterator, getPointerT>;
   using links_range = llvm::iterator_range<links_iterator>;
 
-  using expr_deleter_t = decltype(&ExprNode::deleteExprNode);
-  using expr_destructor = std::integral_constant<expr_deleter_t,
-                                                 &ExprNode::deleteExprNode>;
-  using expr_unique_ptr = std::unique_ptr<ExprNode, expr_destructor>;
-
-  using links_container_expr = std::vector<expr_unique_ptr>;
+  using links_container_expr = std::vector<ExprNode *>;
   using links_iterator_expr = typename links_container_expr::iterator;
   using links_range_expr = llvm::iterator_range<links_iterator_expr>;
 
+  /// Identifies an `ExprNode` by its kind, its fields and the addresses of its
+  /// children. Since the children are interned too, two conditions have the
+  /// same key if and only if they are structurally equal.
+  using ExprKey = std::
+    tuple<unsigned, unsigned, const void *, const void *, size_t>;
+
   using ASTNodeMap = ASTNode::ASTNodeMap;
   using BasicBlockNodeBB = ASTNode::BasicBlockNodeBB;
   using BBNodeMap = ASTNode::BBNodeMap;
@@ -61,26 +72,41 @@ public:
   links_iterator_expr endExpr() { return CondExprList.end(); }
 
 private:
+  // The arena must be declared before the nodes, so that the nodes are
+  // destroyed before their memory is released
+  llvm::BumpPtrAllocator Allocator = {};
   links_container ASTNodeList = {};
-  std::map<BasicBlockNodeBB *, ASTNode *> BBASTMap = {};
-  std::map<ASTNode *, BasicBlockNodeBB *> ASTBBMap = {};
+
+  // The `BasicBlockNode`s come from different `RegionCFG`s, which number them
+  // independently, so they are not indexed by ID
+  llvm::DenseMap<BasicBlockNodeBB *, ASTNode *> BBASTMap = {};
+
+  // The `BasicBlockNode` of each `ASTNode`, indexed by the ID of the `ASTNode`
+  std::vector<BasicBlockNodeBB *> ASTBBMap = {};
+
   ASTNode *RootNode = nullptr;
   unsigned IDCounter = 0;
   links_container_expr CondExprList = {};
+  llvm::DenseMap<ExprKey, ExprNode *> InternedCondExprs = {};
 
 public:
   ASTTree() = default;
 
-  // Default movable
+  // Movable, but not move assignable, since the nodes of the tree that is
+  // overwritten would outlive their arena
   ASTTree(ASTTree &&) = default;
-  ASTTree &operator=(ASTTree &&) = default;
+  ASTTree &operator=(ASTTree &&) = delete;
 
   // Non copyable
   ASTTree(const ASTTree &) = delete;
   ASTTree &operator=(const ASTTree &) = delete;
 
 private:
-  ASTNode *addASTNodeImpl(ast_unique_ptr &&ASTObject);
+  ASTNode *addASTNodeImpl(ASTNode *ASTObject);
+
+  void setCFGNode(ASTNode *ASTObject, BasicBlockNodeBB *Node);
+
+  ExprNode *internCondExpr(ExprNode *Expr);
 
 public:
   SequenceNode *addSequenceNode();
@@ -97,9 +123,17 @@ public:
 
   links_container::size_type size() const;
 
-  void addASTNode(BasicBlockNodeBB *Node, ast_unique_ptr &&ASTObject);
+  /// Create a node of type \a NodeT in the arena of this tree and add it to the
+  /// tree
+  template<typename NodeT, typename... ArgsT>
+  NodeT *addASTNode(ArgsT &&...Args) {
+    auto *ASTObject = new (Allocator) NodeT(std::forward<ArgsT>(Args)...);
+    return llvm::cast<NodeT>(addASTNodeImpl(ASTObject));
+  }
 
-  ASTNode *addASTNode(ast_unique_ptr &&ASTObject);
+  /// Record that \a ASTObject, which belongs to this tree, is the node
+  /// generated for \a Node
+  void mapASTNode(BasicBlockNodeBB *Node, ASTNode *ASTObject);
 
   void removeASTNode(ASTNode *Node);
 
@@ -126,5 +160,14 @@ public:
                                     const std::string &FolderName,
                                     const std::string &FileName) const;
 
-  ExprNode *addCondExpr(expr_unique_ptr &&Expr);
+  /// Return the condition of type \a ExprT of this AST that is built from
+  /// \a Args, creating it in the arena of this tree unless a structurally
+  /// equal condition already exists.
+  ///
+  /// The children of the condition must have been obtained from this method,
+  /// so that structurally equal conditions are always the same `ExprNode`.
+  template<typename ExprT, typename... ArgsT>
+  ExprNode *addCondExpr(ArgsT &&...Args) {
+    return internCondExpr(new (Allocator) ExprT(std::forward<ArgsT>(Args)...));
+  }
 };
@@ -11,6 +11,10 @@ class Function;
 } // end namespace llvm
 
 class ASTTree;
+struct RestructureMetrics;
 
-extern void
-beautifyAST(const model::Binary &Model, llvm::Function &F, ASTTree &CombedAST);
+/// Beautify \a CombedAST, recording metrics in \a Metrics, if not null
+extern void beautifyAST(const model::Binary &Model,
+                        llvm::Function &F,
+                        ASTTree &CombedAST,
+                        RestructureMetrics *Metrics = nullptr);
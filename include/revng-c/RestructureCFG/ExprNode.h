@@ -18,6 +18,14 @@ class BasicBlock;
 class Value;
 } // namespace llvm
 
+/// Boolean condition of an `IfNode`.
+///
+/// `ExprNode`s are allocated and interned by an `ASTTree` (see
+/// `ASTTree::addCondExpr`): a condition can be shared by many `IfNode`s and by
+/// many other conditions, therefore it is never modified after its creation.
+/// To change a condition, build a new one and replace it in the `IfNode`.
+/// `ExprNode`s are trivially destructible, since the arena of the `ASTTree`
+/// releases them without running their destructors.
 class ExprNode {
 public:
   enum NodeKind {
@@ -38,8 +46,6 @@ public:
   ExprNode(const ExprNode &) = default;
   ExprNode(ExprNode &&) = default;
 
-  static void deleteExprNode(ExprNode *E);
-
 protected:
   ExprNode(NodeKind K) : Kind(K) {}
   ~ExprNode() = default;
@@ -91,24 +97,6 @@ public:
   ComparisonKind getComparison() const { return Comparison; }
 
   size_t getConstant() const { return Constant; }
-
-  void flipComparison() {
-    if (Comparison == Comparison_Equal) {
-      Comparison = Comparison_NotEqual;
-    } else if (Comparison == Comparison_NotEqual) {
-      Comparison = Comparison_Equal;
-    } else if (Comparison == Comparison_NotPresent) {
-      Comparison = Comparison_Equal;
-      Constant = 0;
-    } else {
-      revng_abort();
-    }
-  }
-
-  void setNotPresentKind() {
-    revng_assert(Comparison != Comparison_NotPresent);
-    Comparison = Comparison_NotPresent;
-  }
 };
 
 class ValueCompareNode : public CompareNode {
@@ -206,10 +194,6 @@ protected:
 
 public:
   ExprNode *getNegatedNode() const { return Child; }
-
-  ExprNode **getNegatedNodeAddress() { return &Child; }
-
-  void setNegatedNode(ExprNode *NewNegatedNode) { Child = NewNegatedNode; }
 };
 
 class BinaryNode : public ExprNode {
@@ -241,15 +225,6 @@ public:
   std::pair<const ExprNode *, const ExprNode *> getInternalNodes() const {
     return std::make_pair(LeftChild, RightChild);
   }
-
-  std::pair<ExprNode **, ExprNode **> getInternalNodesAddress() {
-    return std::make_pair(&LeftChild, &RightChild);
-  }
-
-  void setInternalNodes(std::pair<ExprNode *, ExprNode *> NewInternalNodes) {
-    LeftChild = NewInternalNodes.first;
-    RightChild = NewInternalNodes.second;
-  }
 };
 
 class AndNode : public BinaryNode {
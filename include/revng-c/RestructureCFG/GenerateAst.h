@@ -66,8 +66,12 @@ public:
 
 // Helper function that visit an AST tree and creates the sequence nodes
 inline ASTNode *createSequence(ASTTree &Tree, ASTNode *RootNode) {
-  SequenceNode *RootSequenceNode = Tree.addSequenceNode();
-  RootSequenceNode->addNode(RootNode);
+  // The AST of regions emitted with gotos is built directly as a sequence.
+  auto *RootSequenceNode = llvm::dyn_cast<SequenceNode>(RootNode);
+  if (RootSequenceNode == nullptr) {
+    RootSequenceNode = Tree.addSequenceNode();
+    RootSequenceNode->addNode(RootNode);
+  }
 
   for (ASTNode *Node : RootSequenceNode->nodes()) {
 
@@ -101,7 +105,9 @@ inline ASTNode *createSequence(ASTTree &Tree, ASTNode *RootNode) {
     case ASTNode::NK_Continue:
     case ASTNode::NK_Break:
     case ASTNode::NK_SwitchBreak:
-    case ASTNode::NK_Set: {
+    case ASTNode::NK_Set:
+    case ASTNode::NK_Label:
+    case ASTNode::NK_Goto: {
       // Do nothing for these nodes
     } break;
 
@@ -165,6 +171,8 @@ inline void simplifyDummies(ASTTree &AST, ASTNode *RootNode) {
   case ASTNode::NK_Break:
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Set:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
 
@@ -444,6 +452,32 @@ createSwitchTile(RegionCFG<NodeT> &Graph,
   return Tile;
 }
 
+inline void
+generateGotoAst(RegionCFG<llvm::BasicBlock *> &Region,
+                ASTTree &AST,
+                std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree>
+                  &CollapsedMap);
+
+inline void
+generateAst(RegionCFG<llvm::BasicBlock *> &Region,
+            ASTTree &AST,
+            std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> &CollapsedMap);
+
+/// Returns the AST of a collapsed region, generating it if needed. Entries that
+/// are already in \p CollapsedMap are only looked up, so that ASTs generated
+/// in advance can be read concurrently.
+inline ASTTree &
+getCollapsedAST(RegionCFG<llvm::BasicBlock *> *BodyGraph,
+                std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree>
+                  &CollapsedMap) {
+  auto It = CollapsedMap.find(BodyGraph);
+  if (It == CollapsedMap.end()) {
+    It = CollapsedMap.insert({ BodyGraph, ASTTree() }).first;
+    generateAst(*BodyGraph, It->second, CollapsedMap);
+  }
+  return It->second;
+}
+
 inline void
 generateAst(RegionCFG<llvm::BasicBlock *> &Region,
             ASTTree &AST,
@@ -472,6 +506,13 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
   // where we can compute it is here.
   Region.computeUntangleWeight();
 
+  // If the combing exceeded the duplication budget, the region is not
+  // structured, and we emit it using `goto`s.
+  if (Region.needsGotos()) {
+    generateGotoAst(Region, AST, CollapsedMap);
+    return;
+  }
+
   // TODO: factorize out the AST generation phase.
   llvm::DominatorTreeBase<BasicBlockNode<NodeT>, false> ASTDT;
   ASTDT.recalculate(Region);
@@ -504,7 +545,7 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
       Successors.push_back(Successor);
 
     // Handle collapsded node.
-    ASTTree::ast_unique_ptr ASTObject;
+    ASTNode *ASTObject = nullptr;
     if (Node->isCollapsed()) {
 
       revng_assert(Children.size() <= 1);
@@ -513,18 +554,15 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
       revng_log(CombLogger,
                 "Inspecting collapsed node: " << Node->getNameStr());
 
-      // Call recursively the generation of the AST for the collapsed node.
-      const auto &[It, New] = CollapsedMap.insert({ BodyGraph, ASTTree() });
-      ASTTree &CollapsedAST = It->second;
-      if (New)
-        generateAst(*BodyGraph, CollapsedAST, CollapsedMap);
-
-      ASTNode *Body = AST.copyASTNodesFrom(CollapsedAST);
+      // Call recursively the generation of the AST for the collapsed node,
+      // unless it has already been generated.
+      ASTNode *Body = AST.copyASTNodesFrom(getCollapsedAST(BodyGraph,
+                                                           CollapsedMap));
 
       switch (Successors.size()) {
 
       case 0: {
-        ASTObject.reset(new ScsNode(Node, Body));
+        ASTObject = AST.addASTNode<ScsNode>(Node, Body);
       } break;
 
       case 1: {
@@ -534,7 +572,7 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           ASTChild = findASTNode(AST, TileToNodeMap, Succ);
           createTile(Region, ASTDT, TileToNodeMap, Node, Succ, true);
         }
-        ASTObject.reset(new ScsNode(Node, Body, ASTChild));
+        ASTObject = AST.addASTNode<ScsNode>(Node, Body, ASTChild);
       } break;
 
       default:
@@ -699,13 +737,13 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
         PostDomAST = findASTNode(AST, TileToNodeMap, PostDomBB);
       }
 
-      ASTObject.reset(new SwitchNode(Node,
-                                     SwitchCondition,
-                                     std::move(LabeledCases),
-                                     PostDomAST));
+      ASTObject = AST.addASTNode<SwitchNode>(Node,
+                                             SwitchCondition,
+                                             std::move(LabeledCases),
+                                             PostDomAST);
       for (ASTNode *Break : SwitchBreakVector) {
         SwitchBreakNode *SwitchBreakCast = llvm::cast<SwitchBreakNode>(Break);
-        SwitchNode *Switch = llvm::cast<SwitchNode>(ASTObject.get());
+        SwitchNode *Switch = llvm::cast<SwitchNode>(ASTObject);
         SwitchBreakCast->setParentSwitch(Switch);
       }
     } else {
@@ -782,14 +820,15 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
                      false);
 
           // Build the `IfNode`.
-          using UniqueExpr = ASTTree::expr_unique_ptr;
-          using ExprDestruct = ASTTree::expr_destructor;
           auto *OriginalNode = Node->getOriginalNode();
-          UniqueExpr CondExpr(new AtomicNode(OriginalNode), ExprDestruct());
-          ExprNode *Condition = AST.addCondExpr(std::move(CondExpr));
+          ExprNode *Condition = AST.addCondExpr<AtomicNode>(OriginalNode);
 
           // Insert the postdominator if the current tile actually has it.
-          ASTObject.reset(new IfNode(Node, Condition, Then, Else, nullptr));
+          ASTObject = AST.addASTNode<IfNode>(Node,
+                                             Condition,
+                                             Then,
+                                             Else,
+                                             nullptr);
         } break;
         case 2: {
 
@@ -854,18 +893,19 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           }
 
           // Build the `IfNode`.
-          using UniqueExpr = ASTTree::expr_unique_ptr;
-          using ExprDestruct = ASTTree::expr_destructor;
           auto *OriginalNode = Node->getOriginalNode();
-          UniqueExpr CondExpr(new AtomicNode(OriginalNode), ExprDestruct());
-          ExprNode *Condition = AST.addCondExpr(std::move(CondExpr));
+          ExprNode *Condition = AST.addCondExpr<AtomicNode>(OriginalNode);
 
           // Insert the postdominator if the current tile actually has it.
           ASTNode *PostDom = nullptr;
           if (PostDomBB)
             PostDom = findASTNode(AST, TileToNodeMap, PostDomBB);
 
-          ASTObject.reset(new IfNode(Node, Condition, Then, Else, PostDom));
+          ASTObject = AST.addASTNode<IfNode>(Node,
+                                             Condition,
+                                             Then,
+                                             Else,
+                                             PostDom);
 
           if (PostDomBB) {
             createTile(Region, ASTDT, TileToNodeMap, Node, PostDomBB, true);
@@ -906,12 +946,13 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           }
 
           // Build the `IfNode`.
-          using UniqueExpr = ASTTree::expr_unique_ptr;
-          using ExprDestruct = ASTTree::expr_destructor;
           auto *OriginalNode = Node->getOriginalNode();
-          UniqueExpr CondExpr(new AtomicNode(OriginalNode), ExprDestruct());
-          ExprNode *Condition = AST.addCondExpr(std::move(CondExpr));
-          ASTObject.reset(new IfNode(Node, Condition, Then, Else, PostDom));
+          ExprNode *Condition = AST.addCondExpr<AtomicNode>(OriginalNode);
+          ASTObject = AST.addASTNode<IfNode>(Node,
+                                             Condition,
+                                             Then,
+                                             Else,
+                                             PostDom);
 
           if (PostDomBB) {
             createTile(Region, ASTDT, TileToNodeMap, Node, PostDomBB, true);
@@ -939,9 +980,9 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           // Therefore, the successor will not be a successor on the AST.
           revng_assert(not Node->isBreak() and not Node->isContinue());
           if (Node->isSet()) {
-            ASTObject.reset(new SetNode(Node));
+            ASTObject = AST.addASTNode<SetNode>(Node);
           } else {
-            ASTObject.reset(new CodeNode(Node, nullptr));
+            ASTObject = AST.addASTNode<CodeNode>(Node, nullptr);
           }
         } break;
 
@@ -954,9 +995,9 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           revng_assert(Successors[0] == Children[0]);
           auto *Succ = findASTNode(AST, TileToNodeMap, Children[0]);
           if (Node->isSet()) {
-            ASTObject.reset(new SetNode(Node, Succ));
+            ASTObject = AST.addASTNode<SetNode>(Node, Succ);
           } else {
-            ASTObject.reset(new CodeNode(Node, Succ));
+            ASTObject = AST.addASTNode<CodeNode>(Node, Succ);
           }
           createTile(Region, ASTDT, TileToNodeMap, Node, Children[0], true);
         } break;
@@ -973,13 +1014,13 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
 
       case 0: {
         if (Node->isBreak())
-          ASTObject.reset(new BreakNode(Node));
+          ASTObject = AST.addASTNode<BreakNode>(Node);
         else if (Node->isContinue())
-          ASTObject.reset(new ContinueNode(Node));
+          ASTObject = AST.addASTNode<ContinueNode>(Node);
         else if (Node->isSet())
-          ASTObject.reset(new SetNode(Node));
+          ASTObject = AST.addASTNode<SetNode>(Node);
         else if (Node->isEmpty() or Node->isCode())
-          ASTObject.reset(new CodeNode(Node, nullptr));
+          ASTObject = AST.addASTNode<CodeNode>(Node, nullptr);
         else
           revng_abort();
       } break;
@@ -992,7 +1033,7 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
       } break;
       }
     }
-    AST.addASTNode(Node, std::move(ASTObject));
+    AST.mapASTNode(Node, ASTObject);
   }
 
   // Set in the ASTTree object the root node.
@@ -1002,6 +1043,133 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
   AST.setRoot(RootNode);
 }
 
+/// Generates the AST of a region whose combing has been interrupted. The nodes
+/// of the region are emitted in reverse post order in a single sequence, and
+/// each edge that does not lead to the next node of the sequence becomes a
+/// `goto` to a label placed right before its target.
+inline void
+generateGotoAst(RegionCFG<llvm::BasicBlock *> &Region,
+                ASTTree &AST,
+                std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree>
+                  &CollapsedMap) {
+  using NodeT = llvm::BasicBlock *;
+  using BasicBlockNodeT = typename RegionCFG<NodeT>::BasicBlockNodeT;
+
+  revng_log(CombLogger,
+            "Emitting region " << Region.getRegionName() << " with gotos");
+
+  llvm::ReversePostOrderTraversal<BasicBlockNodeT *> RPOT(&Region
+                                                             .getEntryNode());
+  std::vector<BasicBlockNodeT *> Order(RPOT.begin(), RPOT.end());
+
+  // Labels are created lazily, only for the nodes targeted by a `goto`
+  std::map<BasicBlockNodeT *, LabelNode *> Labels;
+  auto CreateGoto = [&AST, &Labels](BasicBlockNodeT *Target) {
+    LabelNode *&Label = Labels[Target];
+    if (Label == nullptr) {
+      Label = AST.addASTNode<LabelNode>(Target->getNameStr());
+    }
+    ASTNode *Goto = AST.addASTNode<GotoNode>(Label);
+    return Goto;
+  };
+
+  // For each node, the statements emitted for it
+  std::vector<llvm::SmallVector<ASTNode *, 2>> Statements(Order.size());
+
+  for (const auto &Group : llvm::enumerate(Order)) {
+    BasicBlockNodeT *Node = Group.value();
+    auto &NodeStatements = Statements[Group.index()];
+    BasicBlockNodeT *Next = nullptr;
+    if (Group.index() + 1 < Order.size())
+      Next = Order[Group.index() + 1];
+
+    llvm::SmallVector<BasicBlockNodeT *, 2> Successors;
+    for (BasicBlockNodeT *Successor : Node->successors())
+      Successors.push_back(Successor);
+
+    // Edges that do not lead to `Next` are emitted as a `goto`
+    auto CreateJump = [&CreateGoto, Next](BasicBlockNodeT *Target) {
+      return Target == Next ? nullptr : CreateGoto(Target);
+    };
+
+    ASTNode *ASTObject = nullptr;
+    if (Node->isCollapsed()) {
+      revng_assert(Successors.size() <= 1);
+      RegionCFG<NodeT> *BodyGraph = Node->getCollapsedCFG();
+      revng_assert(BodyGraph != nullptr);
+
+      ASTNode *Body = AST.copyASTNodesFrom(getCollapsedAST(BodyGraph,
+                                                           CollapsedMap));
+      ASTObject = AST.addASTNode<ScsNode>(Node, Body);
+    } else if (Node->isDispatcher() or isASwitch(Node)) {
+      revng_assert(Node->isCode() or Node->isDispatcher());
+
+      llvm::Value *SwitchCondition = nullptr;
+      if (not Node->isDispatcher()) {
+        NodeT OriginalNode = Node->getOriginalNode();
+        llvm::Instruction *Terminator = OriginalNode->getTerminator();
+        llvm::SwitchInst *Switch = llvm::cast<llvm::SwitchInst>(Terminator);
+        SwitchCondition = Switch->getCondition();
+      }
+
+      // Each case jumps to its target, so that the `switch` never needs to
+      // fall through to the next statement
+      SwitchNode::case_container LabeledCases;
+      for (const auto &[SwitchSucc, EdgeInfos] : Node->labeled_successors())
+        LabeledCases.push_back({ EdgeInfos.Labels, CreateGoto(SwitchSucc) });
+
+      ASTObject = AST.addASTNode<SwitchNode>(Node,
+                                             SwitchCondition,
+                                             std::move(LabeledCases),
+                                             nullptr);
+      Successors.clear();
+    } else if (Successors.size() == 2) {
+      revng_assert(not Node->isBreak() and not Node->isContinue()
+                   and not Node->isSet());
+      ASTNode *Then = CreateJump(Successors[0]);
+      ASTNode *Else = CreateJump(Successors[1]);
+      revng_assert(Then != nullptr or Else != nullptr);
+
+      auto *OriginalNode = Node->getOriginalNode();
+      ExprNode *Condition = AST.addCondExpr<AtomicNode>(OriginalNode);
+      ASTObject = AST.addASTNode<IfNode>(Node, Condition, Then, Else, nullptr);
+      Successors.clear();
+    } else {
+      revng_assert(Successors.size() <= 1);
+      if (Node->isBreak())
+        ASTObject = AST.addASTNode<BreakNode>(Node);
+      else if (Node->isContinue())
+        ASTObject = AST.addASTNode<ContinueNode>(Node);
+      else if (Node->isSet())
+        ASTObject = AST.addASTNode<SetNode>(Node);
+      else if (Node->isEmpty() or Node->isCode())
+        ASTObject = AST.addASTNode<CodeNode>(Node, nullptr);
+      else
+        revng_abort();
+    }
+
+    AST.mapASTNode(Node, ASTObject);
+    NodeStatements.push_back(AST.findASTNode(Node));
+
+    // A single successor which is not the next node needs an explicit jump
+    if (Successors.size() == 1)
+      if (ASTNode *Jump = CreateJump(Successors[0]))
+        NodeStatements.push_back(Jump);
+  }
+
+  // Lay out the statements, placing the labels right before their target
+  SequenceNode *Sequence = AST.addSequenceNode();
+  for (const auto &Group : llvm::enumerate(Order)) {
+    auto LabelIt = Labels.find(Group.value());
+    if (LabelIt != Labels.end())
+      Sequence->addNode(LabelIt->second);
+    for (ASTNode *Statement : Statements[Group.index()])
+      Sequence->addNode(Statement);
+  }
+
+  AST.setRoot(Sequence);
+}
+
 inline void normalize(ASTTree &AST, const llvm::Function &F) {
 
   // AST dumper helper
@@ -25,7 +25,6 @@ public:
   using BasicBlockNodeT = typename BasicBlockNode<NodeT>::BasicBlockNodeT;
   using BasicBlockNodeTSet = std::set<BasicBlockNodeT *>;
   using BasicBlockNodeTVect = std::vector<BasicBlockNodeT *>;
-  using BasicBlockNodeTUPVect = std::vector<std::unique_ptr<BasicBlockNodeT>>;
   using EdgeDescriptor = typename BasicBlockNode<NodeT>::EdgeDescriptor;
 
   using links_container = std::set<BasicBlockNodeT *>;
@@ -53,7 +52,12 @@ public:
 
   int getIndex() const { return Index; }
 
-  void replaceNodes(BasicBlockNodeTUPVect &NewNodes);
+  template<typename RangeT>
+  void replaceNodes(RangeT &&NewNodes) {
+    Nodes.clear();
+    for (BasicBlockNodeT *Node : NewNodes)
+      Nodes.insert(Node);
+  }
 
   void updateNodes(const BasicBlockNodeTSet &Removal,
                    BasicBlockNodeT *Collapsed,
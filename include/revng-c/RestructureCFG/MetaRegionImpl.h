@@ -14,13 +14,6 @@
 #include "revng-c/RestructureCFG/BasicBlockNodeBB.h"
 #include "revng-c/RestructureCFG/MetaRegion.h"
 
-template<class NodeT>
-void MetaRegion<NodeT>::replaceNodes(BasicBlockNodeTUPVect &N) {
-  Nodes.erase(Nodes.begin(), Nodes.end());
-  for (std::unique_ptr<BasicBlockNodeT> &Node : N)
-    Nodes.insert(Node.get());
-}
-
 template<class NodeT>
 void MetaRegion<NodeT>::updateNodes(const BasicBlockNodeTSet &ToRemove,
                                     BasicBlockNodeT *Collapsed,
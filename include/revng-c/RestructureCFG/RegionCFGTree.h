@@ -4,13 +4,19 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <cstdlib>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/iterator_range.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
 
@@ -42,44 +48,194 @@ inline bool isASwitch(BasicBlockNode<llvm::BasicBlock *> *Node) {
   return false;
 }
 
-/// The RegionCFG, a container for BasicBlockNodes
-template<class NodeT = llvm::BasicBlock *>
-class RegionCFG {
+/// Slab-allocated storage for the BasicBlockNodes of a RegionCFG, indexed by
+/// node ID.
+//
+//  Removing a node from the RegionCFG only drops it from the index: the node
+//  stays valid until `reclaimRemoved` is called, which destroys all the removed
+//  nodes and recycles their memory for the nodes created afterwards.
+//  This is necessary since the CFG restructuring algorithm uses maps and sets
+//  (e.g. Backedges) that are indexed using BasicBlockNodeT *: if the address of
+//  a removed node was reused for a new one while such a set is still alive, we
+//  would get false-positive hits in it. Hence, removed nodes must only be
+//  reclaimed when nothing refers to them anymore.
+//  IDs are never reused, so tables indexed by node ID are not affected.
+template<class BBNodeT>
+class BasicBlockNodeStorage {
+public:
+  using links_container = std::vector<BBNodeT *>;
 
-  using BBNodeT = BasicBlockNode<NodeT>;
-  using BBNodeTUniquePtr = typename std::unique_ptr<BBNodeT>;
-  using getPointerT = BBNodeT *(*) (BBNodeTUniquePtr &);
-  using getConstPointerT = const BBNodeT *(*) (const BBNodeTUniquePtr &);
+private:
+  llvm::BumpPtrAllocator Allocator;
+
+  /// The nodes in the RegionCFG indexed by ID, nullptr for removed nodes
+  links_container Nodes;
+
+  /// Nodes that have been removed, but not destroyed yet
+  std::vector<BBNodeT *> Removed;
 
-  static BBNodeT *getPointer(BBNodeTUniquePtr &Original) {
-    return Original.get();
+  /// Memory of the destroyed nodes, reused before allocating new memory
+  std::vector<void *> FreeSlots;
+
+  size_t NumAlive = 0;
+
+public:
+  using internal_iterator = typename links_container::iterator;
+  using internal_const_iterator = typename links_container::const_iterator;
+
+  static bool isAlive(BBNodeT *Node) { return Node != nullptr; }
+  using IsAliveT = bool (*)(BBNodeT *);
+
+  using iterator = llvm::filter_iterator<internal_iterator, IsAliveT>;
+  using const_iterator = llvm::filter_iterator<internal_const_iterator,
+                                               IsAliveT>;
+
+public:
+  BasicBlockNodeStorage() = default;
+  BasicBlockNodeStorage(const BasicBlockNodeStorage &) = delete;
+  BasicBlockNodeStorage &operator=(const BasicBlockNodeStorage &) = delete;
+
+  BasicBlockNodeStorage(BasicBlockNodeStorage &&Other) :
+    Allocator(std::move(Other.Allocator)),
+    Nodes(std::exchange(Other.Nodes, {})),
+    Removed(std::exchange(Other.Removed, {})),
+    FreeSlots(std::exchange(Other.FreeSlots, {})),
+    NumAlive(std::exchange(Other.NumAlive, 0)) {}
+
+  BasicBlockNodeStorage &operator=(BasicBlockNodeStorage &&Other) {
+    if (this != &Other) {
+      destroyAll();
+      Allocator = std::move(Other.Allocator);
+      Nodes = std::exchange(Other.Nodes, {});
+      Removed = std::exchange(Other.Removed, {});
+      FreeSlots = std::exchange(Other.FreeSlots, {});
+      NumAlive = std::exchange(Other.NumAlive, 0);
+    }
+    return *this;
   }
 
-  static_assert(std::is_same_v<decltype(&getPointer), getPointerT>);
+  ~BasicBlockNodeStorage() { destroyAll(); }
+
+public:
+  template<typename... ArgsT>
+  BBNodeT *create(ArgsT &&...Args) {
+    void *Memory = nullptr;
+    if (FreeSlots.empty()) {
+      Memory = Allocator.Allocate<BBNodeT>();
+    } else {
+      Memory = FreeSlots.back();
+      FreeSlots.pop_back();
+    }
+    BBNodeT *Node = new (Memory) BBNodeT(std::forward<ArgsT>(Args)...);
 
-  static const BBNodeT *getConstPointer(const BBNodeTUniquePtr &Original) {
-    return Original.get();
+    unsigned ID = Node->getID();
+    if (ID >= Nodes.size())
+      Nodes.resize(ID + 1, nullptr);
+    revng_assert(Nodes[ID] == nullptr);
+    Nodes[ID] = Node;
+    ++NumAlive;
+
+    return Node;
   }
 
-  static_assert(std::is_same_v<decltype(&getConstPointer), getConstPointerT>);
+  void remove(BBNodeT *Node) {
+    unsigned ID = Node->getID();
+    revng_assert(ID < Nodes.size() and Nodes[ID] == Node);
+    Nodes[ID] = nullptr;
+    Removed.push_back(Node);
+    --NumAlive;
+  }
+
+  /// Destroy the removed nodes, so that their memory can be reused
+  void reclaimRemoved() {
+    for (BBNodeT *Node : Removed) {
+      Node->~BBNodeT();
+      FreeSlots.push_back(Node);
+    }
+    Removed.clear();
+  }
+
+  /// Get the node with the given ID, or nullptr if it has been removed
+  BBNodeT *lookup(unsigned ID) const {
+    return ID < Nodes.size() ? Nodes[ID] : nullptr;
+  }
+
+  size_t size() const { return NumAlive; }
+  bool empty() const { return NumAlive == 0; }
+  void reserve(size_t Size) { Nodes.reserve(Size); }
+
+  /// Number of removed nodes that have not been reclaimed yet
+  size_t removedSize() const { return Removed.size(); }
+
+  iterator begin() {
+    return llvm::make_filter_range(Nodes, &isAlive).begin();
+  }
+  iterator end() { return llvm::make_filter_range(Nodes, &isAlive).end(); }
+
+  const_iterator begin() const {
+    return llvm::make_filter_range(Nodes, &isAlive).begin();
+  }
+  const_iterator end() const {
+    return llvm::make_filter_range(Nodes, &isAlive).end();
+  }
+
+private:
+  /// Destroy all the nodes, the memory is released with the allocator
+  void destroyAll() {
+    for (BBNodeT *Node : Nodes)
+      if (Node != nullptr)
+        Node->~BBNodeT();
+    reclaimRemoved();
+    Nodes.clear();
+    FreeSlots.clear();
+    NumAlive = 0;
+  }
+};
+
+/// Dense side table associating a value to each BasicBlockNode of a single
+/// RegionCFG, indexed by node ID. Like `std::map::operator[]`, looking up a
+/// node that has no value yet yields a default constructed one.
+/// Like for `std::vector`, adding a node with a new ID may invalidate the
+/// references to the values.
+template<class NodeT, typename ValueT>
+class BBNodeIDMap {
+private:
+  std::vector<ValueT> Values;
+
+public:
+  ValueT &operator[](const BasicBlockNode<NodeT> *Node) {
+    unsigned ID = Node->getID();
+    if (ID >= Values.size())
+      Values.resize(ID + 1);
+    return Values[ID];
+  }
+
+  /// Get the value of \a Node, or a default constructed one if it has none
+  ValueT lookup(const BasicBlockNode<NodeT> *Node) const {
+    unsigned ID = Node->getID();
+    return ID < Values.size() ? Values[ID] : ValueT();
+  }
+};
+
+/// The RegionCFG, a container for BasicBlockNodes
+template<class NodeT = llvm::BasicBlock *>
+class RegionCFG {
+
+  using BBNodeT = BasicBlockNode<NodeT>;
+  using StorageT = BasicBlockNodeStorage<BBNodeT>;
 
 public:
   using BasicBlockNodeT = typename BBNodeT::BasicBlockNodeT;
   using BasicBlockNodeType = typename BasicBlockNodeT::Type;
   using BasicBlockNodeTSet = std::set<BasicBlockNodeT *>;
   using BasicBlockNodeTVect = std::vector<BasicBlockNodeT *>;
-  using BasicBlockNodeTUPVect = std::vector<std::unique_ptr<BasicBlockNodeT>>;
   using BBNodeMap = typename BBNodeT::BBNodeMap;
   using RegionCFGT = typename BBNodeT::RegionCFGT;
 
   using EdgeDescriptor = typename BBNodeT::EdgeDescriptor;
 
-  using links_container = std::vector<BBNodeTUniquePtr>;
-  using internal_iterator = typename links_container::iterator;
-  using internal_const_iterator = typename links_container::const_iterator;
-  using links_iterator = llvm::mapped_iterator<internal_iterator, getPointerT>;
-  using links_const_iterator = llvm::mapped_iterator<internal_const_iterator,
-                                                     getConstPointerT>;
+  using links_iterator = typename StorageT::iterator;
+  using links_const_iterator = typename StorageT::const_iterator;
   using links_range = llvm::iterator_range<links_iterator>;
   using links_const_range = llvm::iterator_range<links_const_iterator>;
 
@@ -98,34 +254,7 @@ public:
 
 private:
   /// Storage for basic block nodes, associated to their original counterpart
-  links_container BlockNodes;
-
-  /// Quarantine for dead nodes.
-  //  When nodes are removed from RegionCFG, they are not really freed, but they
-  //  are held here until the RegionCFG itself goes out of scope.
-  //  This is unfortunately necessary now, since the CFG restructuring algorithm
-  //  uses maps and sets (e.g. Backedges.) that are indexed using a
-  //  BasicBlockNodeT *.
-  //  If we don't hold the removed nodes in quarantine, the system allocator can
-  //  reuse the blocks, allocating new nodes at the same address, and causing
-  //  false-positive hits in some of the mentioned maps. This was the most
-  //  straightforward solution for now.
-  //
-  //  Other solutions we have considered:
-  //    - use a special monotonic allocator for BasicBlockNodes
-  //      - this should work, but in principle it gives the same results as the
-  //        current solution, with more boilerplate. Also, at the moment
-  //        std::unique_ptr is not allocator aware, so we would need to change
-  //        BlockNodes to not use them, and this would require even more
-  //        boilerplate.
-  //    - change the API for RegionCFG::removeNode, to take as arguments the
-  //      reference to the data structure and maps that must be updated, so that
-  //      when we remove the node from RegionCFG we also clear it from the maps.
-  //      However, this is very invasive, it requires changing the public facing
-  //      API, it requirese coupling the RegionCFG API with internal details,
-  //      and in the future it would need to be updated for every new map that
-  //      must be updated on removal of a node.
-  links_container DeadNodesQuarantine;
+  StorageT BlockNodes;
 
   /// Pointer to the entry basic block of this function
   BasicBlockNodeT *EntryNode;
@@ -133,6 +262,7 @@ private:
   std::string FunctionName;
   std::string RegionName;
   bool ToInflate = true;
+  bool NeedsGotos = false;
   size_t UntangleWeight = WeightNotComputed;
   llvm::DominatorTreeBase<BasicBlockNodeT, false> DT;
   FPostDomTree IFPDT;
@@ -238,31 +368,29 @@ public:
 
   std::string getRegionName() const;
 
-  links_iterator begin() {
-    return llvm::map_iterator(BlockNodes.begin(), getPointer);
-  }
+  links_iterator begin() { return BlockNodes.begin(); }
 
-  links_const_iterator begin() const {
-    return llvm::map_iterator(BlockNodes.begin(), getConstPointer);
-  }
+  links_const_iterator begin() const { return BlockNodes.begin(); }
 
-  links_iterator end() {
-    return llvm::map_iterator(BlockNodes.end(), getPointer);
-  }
+  links_iterator end() { return BlockNodes.end(); }
 
-  links_const_iterator end() const {
-    return llvm::map_iterator(BlockNodes.end(), getConstPointer);
-  }
+  links_const_iterator end() const { return BlockNodes.end(); }
 
   size_t size() const { return BlockNodes.size(); }
   void setSize(size_t Size) { BlockNodes.reserve(Size); }
 
+  /// Get the node with the given ID, or nullptr if it has been removed
+  BBNodeT *getNodeByID(unsigned ID) const { return BlockNodes.lookup(ID); }
+
+  /// Upper bound on the IDs of the nodes of this RegionCFG, useful to size
+  /// tables indexed by node ID
+  unsigned getIDBound() const { return IDCounter; }
+
   BBNodeT *addNode(NodeT Node, llvm::StringRef Name);
   BBNodeT *addNode(NodeT Node) { return addNode(Node, Node->getName()); }
 
   BBNodeT *createCollapsedNode(RegionCFG *Collapsed) {
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(this, Collapsed));
-    return BlockNodes.back().get();
+    return BlockNodes.create(this, Collapsed);
   }
 
   BBNodeT *addArtificialNode(llvm::StringRef Name = "dummy",
@@ -270,8 +398,7 @@ public:
     revng_assert(T == BasicBlockNodeType::Empty
                  or T == BasicBlockNodeType::Break
                  or T == BasicBlockNodeType::Continue);
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(this, Name, T));
-    return BlockNodes.back().get();
+    return BlockNodes.create(this, Name, T);
   }
 
   BBNodeT *addContinue() {
@@ -283,9 +410,7 @@ public:
   }
 
   BBNodeT *addDispatcher(llvm::StringRef Name, BasicBlockNodeT::Type T) {
-    using BBNodeT = BasicBlockNodeT;
-    auto D = std::make_unique<BBNodeT>(this, Name, T);
-    return BlockNodes.emplace_back(std::move(D)).get();
+    return BlockNodes.create(this, Name, T);
   }
 
   BBNodeT *addEntryDispatcher() {
@@ -301,13 +426,10 @@ public:
   BBNodeT *addSetStateNode(unsigned StateVariableValue,
                            llvm::StringRef TargetName,
                            BasicBlockNodeT::Type T) {
-    using BBNodeT = BasicBlockNodeT;
     std::string IdStr = std::to_string(StateVariableValue);
     std::string Name = "set idx " + IdStr + " (desired target) "
                        + TargetName.str();
-    auto Tmp = std::make_unique<BBNodeT>(this, Name, T, StateVariableValue);
-    BlockNodes.emplace_back(std::move(Tmp));
-    return BlockNodes.back().get();
+    return BlockNodes.create(this, Name, T, StateVariableValue);
   }
 
   BBNodeT *addEntrySetStateNode(unsigned StateVariableValue,
@@ -324,15 +446,22 @@ public:
 
   BBNodeT *addTile() {
     using Type = typename BasicBlockNodeT::Type;
-    auto Tmp = std::make_unique<BBNodeT>(this, "tile", Type::Tile);
-    BlockNodes.emplace_back(std::move(Tmp));
-    return BlockNodes.back().get();
+    return BlockNodes.create(this, "tile", Type::Tile);
   }
 
   BBNodeT *cloneNode(BasicBlockNodeT &OriginalNode);
 
+  /// Remove \a Node from the graph. The node can still be used until the next
+  /// call to `reclaimRemovedNodes`.
   void removeNode(BasicBlockNodeT *Node);
 
+  /// Destroy the removed nodes, and reuse their memory for new nodes. After
+  /// this, pointers to removed nodes must not be used, not even as keys.
+  void reclaimRemovedNodes() { BlockNodes.reclaimRemoved(); }
+
+  /// Number of removed nodes that have not been reclaimed yet
+  size_t getRemovedNodesCount() const { return BlockNodes.removedSize(); }
+
   void insertBulkNodes(BasicBlockNodeTSet &Nodes,
                        BasicBlockNodeT *Head,
                        BBNodeMap &SubstitutionMap,
@@ -343,7 +472,6 @@ public:
 
   BBNodeT &front() const { return *EntryNode; }
 
-  std::vector<BBNodeTUniquePtr> &getNodes() { return BlockNodes; }
 
 public:
   /// Dump a GraphViz representing this function on any stream
@@ -371,6 +499,19 @@ public:
 
   BBNodeT *cloneUntilExit(BBNodeT *Node, BBNodeT *Sink);
 
+  /// Update `DT` and `IFPDT` after the edge `{Conditional, Untangled}` has
+  /// been redirected to `Clone`, the root of a freshly cloned subgraph, and
+  /// marked as inlined. Nodes left without predecessors are removed from the
+  /// region, and from the trees.
+  void untangleUpdate(BBNodeT *Conditional,
+                      BBNodeT *Untangled,
+                      BBNodeT *Clone,
+                      bool WasInlined);
+
+  /// Cross-check `DT` and `IFPDT` against trees recomputed from scratch.
+  /// Enabled by the `verify` logger.
+  void verifyDominatorTrees();
+
   /// Apply the untangle preprocessing pass.
   void untangle();
 
@@ -387,6 +528,10 @@ public:
 
   void weave();
 
+  /// Returns true if the combing of this region has been interrupted because
+  /// it exceeded the duplication budget, and the region needs `goto`s.
+  bool needsGotos() const { return NeedsGotos; }
+
   void markUnreachableAsInlined();
 
   void computeUntangleWeight() {
@@ -444,7 +589,14 @@ struct GraphTraits<Inverse<RegionCFG<NodeT> *>>
 
 } // namespace llvm
 
-extern unsigned DuplicationCounter;
+// Counters are atomic, since independent regions may be restructured
+// concurrently.
+extern std::atomic<unsigned> DuplicationCounter;
+extern std::atomic<unsigned> DuplicatedWeightCounter;
+
+/// Maximum weight that combing may duplicate, as a percentage of the weight of
+/// the region being combed. Zero means no limit.
+extern llvm::cl::opt<unsigned> DuplicationBudget;
 
-extern unsigned UntangleTentativeCounter;
-extern unsigned UntanglePerformedCounter;
+extern std::atomic<unsigned> UntangleTentativeCounter;
+extern std::atomic<unsigned> UntanglePerformedCounter;
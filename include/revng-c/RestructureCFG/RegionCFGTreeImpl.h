@@ -91,9 +91,7 @@ inline std::string RegionCFG<NodeT>::getRegionName() const {
 template<class NodeT>
 inline BasicBlockNode<NodeT> *
 RegionCFG<NodeT>::addNode(NodeT Node, llvm::StringRef Name) {
-  using BBNodeT = BasicBlockNodeT;
-  BlockNodes.emplace_back(std::make_unique<BBNodeT>(this, Node, Name));
-  BasicBlockNodeT *Result = BlockNodes.back().get();
+  BasicBlockNodeT *Result = BlockNodes.create(this, Node, Name);
   revng_log(CombLogger,
             "Building " << Name << " at address: " << Result << "\n");
   return Result;
@@ -102,9 +100,7 @@ RegionCFG<NodeT>::addNode(NodeT Node, llvm::StringRef Name) {
 template<class NodeT>
 inline BasicBlockNode<NodeT> *
 RegionCFG<NodeT>::cloneNode(BasicBlockNodeT &OriginalNode) {
-  using BBNodeT = BasicBlockNodeT;
-  BlockNodes.emplace_back(std::make_unique<BBNodeT>(OriginalNode, this));
-  BasicBlockNodeT *New = BlockNodes.back().get();
+  BasicBlockNodeT *New = BlockNodes.create(OriginalNode, this);
   New->setName(OriginalNode.getName().str() + " cloned");
   New->setWeaved(OriginalNode.isWeaved());
   return New;
@@ -121,13 +117,7 @@ inline void RegionCFG<NodeT>::removeNode(BasicBlockNodeT *Node) {
   for (BasicBlockNodeT *Successor : Node->successors())
     Successor->removePredecessor(Node);
 
-  for (auto It = BlockNodes.begin(); It != BlockNodes.end(); It++) {
-    if ((*It).get() == Node) {
-      DeadNodesQuarantine.push_back(std::move(*It));
-      BlockNodes.erase(It);
-      break;
-    }
-  }
+  BlockNodes.remove(Node);
 }
 
 template<class NodeT>
@@ -151,8 +141,7 @@ inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
   revng_assert(BlockNodes.empty());
 
   for (BasicBlockNodeT *Node : Nodes) {
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(*Node, this));
-    BasicBlockNodeT *New = BlockNodes.back().get();
+    BasicBlockNodeT *New = BlockNodes.create(*Node, this);
     SubMap[Node] = New;
 
     // The copy constructor used above does not bring along the successors and
@@ -203,7 +192,7 @@ inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
   EntryNode = SubMap[Head];
   revng_assert(EntryNode != nullptr);
   // Fix the hack above
-  for (BBNodeTUniquePtr &Node : BlockNodes)
+  for (BasicBlockNodeT *Node : nodes())
     Node->updatePointers(SubMap);
 
   // Connect all the `ContinueBackedges` to `continue` nodes
@@ -246,8 +235,8 @@ template<typename StreamT>
 inline void RegionCFG<NodeT>::dumpDot(StreamT &S) const {
   S << "digraph CFGFunction {\n";
 
-  for (const std::unique_ptr<BasicBlockNode<NodeT>> &BB : BlockNodes) {
-    streamNode(S, BB.get());
+  for (const BasicBlockNode<NodeT> *BB : nodes()) {
+    streamNode(S, BB);
     unsigned Counter = 0;
     for (const auto &[Successor, EdgeInfo] : BB->labeled_successors()) {
       unsigned PredID = BB->getID();
@@ -374,7 +363,7 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
                                  BasicBlockNode<NodeT> *Sink) {
 
   // Clone the postdominator node.
-  BBNodeMap CloneMap;
+  BBNodeIDMap<NodeT, BasicBlockNodeT *> CloneMap;
   BasicBlockNode<NodeT> *Clone = cloneNode(*Node);
 
   // Insert the postdominator clone in the map.
@@ -383,8 +372,8 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
   BasicBlockNodeTVect WorkList;
   WorkList.push_back(Node);
 
-  // Set of nodes which have been already processed.
-  BasicBlockNodeTSet AlreadyProcessed;
+  // Nodes which have been already processed.
+  BBNodeIDMap<NodeT, bool> AlreadyProcessed;
 
   while (!WorkList.empty()) {
     BasicBlockNode<NodeT> *CurrentNode = WorkList.back();
@@ -393,25 +382,21 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
     // Ensure that we are not processing the sink node.
     revng_assert(CurrentNode != Sink);
 
-    auto [_, Inserted] = AlreadyProcessed.insert(CurrentNode);
-    if (!Inserted)
+    if (AlreadyProcessed[CurrentNode])
       continue;
+    AlreadyProcessed[CurrentNode] = true;
 
     // Get the clone of the `CurrentNode`.
-    BasicBlockNode<NodeT> *CurrentClone = CloneMap.at(CurrentNode);
+    BasicBlockNode<NodeT> *CurrentClone = CloneMap.lookup(CurrentNode);
+    revng_assert(CurrentClone != nullptr);
 
     for (const auto &[Succ, Labels] : CurrentNode->labeled_successors()) {
       // If the successor is not the sink, create and edge that directly
       // connects it.
       if (Succ != Sink) {
-        BasicBlockNode<NodeT> *SuccessorClone = nullptr;
-
-        // The clone of the successor node already exists.
-        auto CloneIt = CloneMap.find(Succ);
-        if (CloneIt != CloneMap.end()) {
-          SuccessorClone = CloneIt->second;
-        } else {
-          // The clone of the successor does not exist, create it in place.
+        // If the clone of the successor does not exist, create it in place.
+        BasicBlockNode<NodeT> *SuccessorClone = CloneMap.lookup(Succ);
+        if (SuccessorClone == nullptr) {
           SuccessorClone = cloneNode(*Succ);
           CloneMap[Succ] = SuccessorClone;
         }
@@ -429,6 +414,129 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
   return Clone;
 }
 
+template<class NodeT>
+inline void RegionCFG<NodeT>::untangleUpdate(BasicBlockNode<NodeT> *Conditional,
+                                             BasicBlockNode<NodeT> *Untangled,
+                                             BasicBlockNode<NodeT> *Clone,
+                                             bool WasInlined) {
+  // The graph has already been changed, so all the updates are applied to the
+  // trees in a single batch.
+  using DomUpdate = typename llvm::DominatorTreeBase<BasicBlockNodeT,
+                                                     false>::UpdateType;
+  const auto Insert = llvm::DominatorTree::Insert;
+  const auto Delete = llvm::DominatorTree::Delete;
+
+  // The cloned subgraph is reachable only through the new edge, which is
+  // enough for the dominator tree to discover all of it at once.
+  std::vector<DomUpdate> Updates;
+  Updates.push_back({ Insert, Conditional, Clone });
+  Updates.push_back({ Delete, Conditional, Untangled });
+  DT.applyUpdates(Updates);
+
+  // The new edge is inlined, so the cloned subgraph is disconnected from the
+  // rest of the region in the filtered view, and all of its edges are new for
+  // the postdominator tree. Its exits become new roots.
+  std::vector<DomUpdate> PostDomUpdates;
+  BBNodeIDMap<NodeT, bool> InFilteredView;
+  BasicBlockNodeTVect Clones;
+  for (BasicBlockNode<NodeT> *Node : llvm::post_order(Clone)) {
+    Clones.push_back(Node);
+    for (const auto &[Succ, Labels] : Node->labeled_successors()) {
+      if (Labels.Inlined)
+        continue;
+
+      PostDomUpdates.push_back({ Insert, Node, Succ });
+      InFilteredView[Node] = true;
+      InFilteredView[Succ] = true;
+    }
+  }
+
+  // A clone with no edges at all in the filtered view is an isolated exit.
+  // It can only become a root of the postdominator tree when the tree is
+  // computed from scratch.
+  const auto IsIsolated = [&InFilteredView](BasicBlockNode<NodeT> *Node) {
+    return not InFilteredView.lookup(Node);
+  };
+  bool RecalculatePostDom = llvm::any_of(Clones, IsIsolated);
+
+  if (not RecalculatePostDom) {
+    if (not WasInlined)
+      PostDomUpdates.push_back({ Delete, Conditional, Untangled });
+    IFPDT.applyUpdates(PostDomUpdates);
+  }
+
+  // Remove nodes that have no predecessors (nodes that are the result of
+  // node cloning and that remains dandling around). Only the node we have
+  // untangled, and transitively its successors, can end up in this state.
+  BasicBlockNode<NodeT> *Entry = &getEntryNode();
+  BBNodeIDMap<NodeT, bool> Removed;
+  BasicBlockNodeTVect WorkList = { Untangled };
+  while (not WorkList.empty()) {
+    BasicBlockNode<NodeT> *Node = WorkList.back();
+    WorkList.pop_back();
+
+    if (Node == Entry or Node->predecessor_size() != 0)
+      continue;
+
+    if (Removed[Node])
+      continue;
+    Removed[Node] = true;
+
+    for (BasicBlockNode<NodeT> *Succ : Node->successors())
+      WorkList.push_back(Succ);
+
+    // `Node` is not reachable anymore, so the edge deletion has already
+    // dropped it from `DT`. In the postdominator tree it is a leaf, since it
+    // has no predecessors.
+    if (DT[Node] != nullptr)
+      DT.eraseNode(Node);
+    if (not RecalculatePostDom and IFPDT[Node] != nullptr)
+      IFPDT.eraseNode(Node);
+
+    removeNode(Node);
+  }
+
+  if (RecalculatePostDom)
+    IFPDT.recalculate(*this);
+
+  verifyDominatorTrees();
+}
+
+template<class NodeT>
+inline void RegionCFG<NodeT>::verifyDominatorTrees() {
+  if (not VerifyLog.isEnabled())
+    return;
+
+  const auto HaveSameIDoms = [this](const auto &Tree, const auto &Reference) {
+    for (BasicBlockNode<NodeT> *Node : nodes()) {
+      auto *TreeNode = Tree[Node];
+      auto *ReferenceNode = Reference[Node];
+      if ((TreeNode == nullptr) != (ReferenceNode == nullptr))
+        return false;
+
+      if (ReferenceNode == nullptr)
+        continue;
+
+      auto *IDom = TreeNode->getIDom();
+      auto *ReferenceIDom = ReferenceNode->getIDom();
+      if ((IDom == nullptr) != (ReferenceIDom == nullptr))
+        return false;
+
+      if (IDom != nullptr and IDom->getBlock() != ReferenceIDom->getBlock())
+        return false;
+    }
+    return true;
+  };
+
+  llvm::DominatorTreeBase<BasicBlockNodeT, false> ReferenceDT;
+  ReferenceDT.recalculate(*this);
+  revng_assert(HaveSameIDoms(DT, ReferenceDT));
+
+  FPostDomTree ReferenceIFPDT;
+  ReferenceIFPDT.recalculate(*this);
+  revng_assert(HaveSameIDoms(IFPDT, ReferenceIFPDT));
+}
+
 template<class NodeT>
 inline void RegionCFG<NodeT>::untangle() {
   // TODO: Here we handle only conditional nodes with two successors. We should
@@ -455,7 +563,7 @@ inline void RegionCFG<NodeT>::untangle() {
   // case of a code node the weight will be equal to the number of instruction
   // in the original basic block; in case of a collapsed node the weight will be
   // the sum of the weights of all the nodes contained in the collapsed graph.
-  std::map<BasicBlockNode<NodeT> *, size_t> WeightMap;
+  BBNodeIDMap<NodeT, size_t> WeightMap;
   for (BasicBlockNode<NodeT> *Node : Graph.nodes()) {
     WeightMap[Node] = Node->getWeight();
   }
@@ -464,29 +572,25 @@ inline void RegionCFG<NodeT>::untangle() {
   // Reverse Post-Order.
   BasicBlockNodeTVect ConditionalNodes;
   {
-    BasicBlockNodeTSet ConditionalNodesSet;
-    for (auto *Node : Graph)
-      if (Node->successor_size() == 2)
-        ConditionalNodesSet.insert(Node);
-
     llvm::ReversePostOrderTraversal<BasicBlockNode<NodeT> *> RPOT(EntryNode);
 
     for (BasicBlockNode<NodeT> *RPOTBB : RPOT) {
-      if (ConditionalNodesSet.contains(RPOTBB)) {
+      if (RPOTBB->successor_size() == 2) {
         ConditionalNodes.push_back(RPOTBB);
       }
     }
   }
 
+  // Compute the dominator and postdominator trees once. Each untangle keeps
+  // them up to date incrementally.
+  DT.recalculate(Graph);
+  IFPDT.recalculate(Graph);
+
   while (not ConditionalNodes.empty()) {
 
     BasicBlockNode<NodeT> *Conditional = ConditionalNodes.back();
     ConditionalNodes.pop_back();
 
-    // Update the information of the dominator and postdominator trees.
-    DT.recalculate(Graph);
-    IFPDT.recalculate(Graph);
-
     // Update the postdominator
     BasicBlockNodeT *PostDominator = IFPDT[Conditional]->getIDom()->getBlock();
 
@@ -634,6 +738,8 @@ inline void RegionCFG<NodeT>::untangle() {
       // We fully inline all the nodes belonging to the branch we are untangling
       // till the exit node.
       BasicBlockNode<NodeT> *UntangledChild = cloneUntilExit(ToUntangle, Sink);
+      const auto &[_, Labels] = Conditional->getSuccessorEdge(ToUntangle);
+      bool WasInlined = Labels.Inlined;
 
       // Move the edge coming out of the conditional node to the new clone of
       // the node.
@@ -644,21 +750,9 @@ inline void RegionCFG<NodeT>::untangle() {
       // dominator and postdominator trees.
       markEdgeInlined(EdgeDescriptor(Conditional, UntangledChild));
 
-      // Remove nodes that have no predecessors (nodes that are the result of
-      // node cloning and that remains dandling around).
-      // While doing this, update InlineEdges.
-      bool Removed = true;
-      while (Removed) {
-        Removed = false;
-        BasicBlockNode<NodeT> *Entry = &getEntryNode();
-        for (auto It = begin(); It != end(); ++It) {
-          if ((Entry != *It and (*It)->predecessor_size() == 0)) {
-            removeNode(*It);
-            Removed = true;
-            break;
-          }
-        }
-      }
+      // Drop the dandling nodes and bring the dominator and postdominator
+      // trees in sync with the new graph.
+      untangleUpdate(Conditional, ToUntangle, UntangledChild, WasInlined);
     }
   }
 
@@ -671,6 +765,9 @@ inline void RegionCFG<NodeT>::untangle() {
   // Remove the sink node.
   purgeVirtualSink(Sink);
 
+  // Nothing refers to the nodes dropped by the untangle anymore.
+  reclaimRemovedNodes();
+
   if (CombLogger.isEnabled()) {
     Graph.dumpCFGOnFile(FunctionName,
                         "untangle",
@@ -749,12 +846,13 @@ inline void RegionCFG<NodeT>::inflate() {
   // that will be used to detect the point where combing needs to stop
   // duplicating node. This is the immediate post dominator for most nodes, but
   // we have a special case for the case nodes of switches.
-  BBNodeMap ConditionalToCombEnd;
+  // The node is nullptr if the combing goes on until the end of the region.
+  BBNodeIDMap<NodeT, BasicBlockNodeT *> ConditionalToCombEnd;
 
-  // Collect all the conditional nodes in the graph.
-  // This is the working list of conditional nodes on which we will operate and
-  // will contain only the filtered conditionals.
-  BasicBlockNodeTSet ConditionalNodesSet;
+  // Mark all the conditional nodes in the graph.
+  // These are the conditional nodes on which we will operate, and contain only
+  // the filtered conditionals.
+  BBNodeIDMap<NodeT, bool> IsConditional;
 
   std::vector<BasicBlockNode<NodeT> *> Switches;
 
@@ -773,10 +871,10 @@ inline void RegionCFG<NodeT>::inflate() {
                                        .OutValue;
 
       // Add the conditional node to the set of nodes processed by the inflate.
-      ConditionalNodesSet.insert(Node);
+      revng_assert(not IsConditional[Node]);
+      IsConditional[Node] = true;
       BasicBlockNode<NodeT> *PostDom = IFPDT[Node]->getIDom()->getBlock();
-      bool New = ConditionalToCombEnd.insert({ Node, PostDom }).second;
-      revng_assert(New);
+      ConditionalToCombEnd[Node] = PostDom;
 
       // If the exit nodes reachable from the Then and from the Else are not
       // disjoint, then the conditional node is not eligible for having its
@@ -850,27 +948,31 @@ inline void RegionCFG<NodeT>::inflate() {
       moveEdgeTarget(EdgeDescriptor(Switch, Case), DummyCase);
       addPlainEdge(EdgeDescriptor(DummyCase, Case));
 
-      ConditionalNodesSet.insert(DummyCase);
+      IsConditional[DummyCase] = true;
       BasicBlockNode<NodeT> *PostDom = IFPDT[Switch]->getIDom()->getBlock();
       // Combing of switch cases continues until the post dominator of the
       // switch, not until the post dominator of the case.
-      bool New = ConditionalToCombEnd.insert({ DummyCase, PostDom }).second;
-      revng_assert(New);
+      ConditionalToCombEnd[DummyCase] = PostDom;
     }
   }
 
   if (CombLogger.isEnabled()) {
     revng_log(CombLogger, "Conditional nodes present in the graph are:");
-    for (BasicBlockNode<NodeT> *Node : ConditionalNodesSet)
-      revng_log(CombLogger, Node->getNameStr());
+    for (BasicBlockNode<NodeT> *Node : Graph.nodes())
+      if (IsConditional.lookup(Node))
+        revng_log(CombLogger, Node->getNameStr());
   }
 
   // Equivalence-class like set to keep track of all the cloned nodes created
-  // starting from an original node.
-  std::map<BasicBlockNode<NodeT> *, SmallPtrSet<NodeT>> NodesEquivalenceClass;
+  // starting from an original node. A comb end of nullptr has no equivalent.
+  BBNodeIDMap<NodeT, SmallPtrSet<NodeT>> NodesEquivalenceClass;
+  const SmallPtrSet<NodeT> NoEquivalents;
+  const auto GetEquivalenceClass = [&](BasicBlockNode<NodeT> *Node) {
+    return Node != nullptr ? &NodesEquivalenceClass[Node] : &NoEquivalents;
+  };
 
   // Map to keep track of the cloning relationship.
-  BBNodeMap CloneToOriginalMap;
+  BBNodeIDMap<NodeT, BasicBlockNodeT *> CloneToOriginalMap;
 
   // Initialize a list containing the reverse post order of the nodes of the
   // graph.
@@ -884,14 +986,24 @@ inline void RegionCFG<NodeT>::inflate() {
     RevPostOrderList.push_back(RPOTBB);
     NodesEquivalenceClass[RPOTBB].insert(RPOTBB);
     CloneToOriginalMap[RPOTBB] = RPOTBB;
-    if (ConditionalNodesSet.contains(RPOTBB))
+    if (IsConditional.lookup(RPOTBB))
       ConditionalNodes.push_back(RPOTBB);
   }
-  NodesEquivalenceClass[nullptr] = {};
 
   // CFGDumper used to incrementally print the combing evolution
   CFGDumper Dumper(Graph, FunctionName, RegionName, "inflate");
 
+  // Maximum weight that combing is allowed to duplicate, expressed as a
+  // percentage of the weight of the region. Zero means that there is no limit.
+  size_t MaxDuplicatedWeight = 0;
+  if (DuplicationBudget != 0) {
+    size_t RegionWeight = 0;
+    for (BasicBlockNode<NodeT> *Node : Graph.nodes())
+      RegionWeight += Node->getWeight();
+    MaxDuplicatedWeight = RegionWeight * DuplicationBudget / 100;
+  }
+  size_t DuplicatedWeight = 0;
+
   // Iterate on ConditionalNodes from the back. Given that they are inserted
   // into ConditionalNodes in RPOT, this iteration is in post-order.
   while (not ConditionalNodes.empty()) {
@@ -901,10 +1013,9 @@ inline void RegionCFG<NodeT>::inflate() {
     ConditionalNodes.pop_back();
 
     // Retrieve a reference to the set of postdominators.
-    auto CombEndIt = ConditionalToCombEnd.find(Conditional);
-    revng_assert(CombEndIt != ConditionalToCombEnd.end());
-    auto CombEndSetIt = NodesEquivalenceClass.find(CombEndIt->second);
-    revng_assert(CombEndSetIt != NodesEquivalenceClass.end());
+    revng_assert(IsConditional.lookup(Conditional));
+    BasicBlockNodeT *&CombEnd = ConditionalToCombEnd[Conditional];
+    const SmallPtrSet<NodeT> *CombEndSet = GetEquivalenceClass(CombEnd);
 
     if (CombLogger.isEnabled()) {
       revng_log(CombLogger,
@@ -951,7 +1062,7 @@ inline void RegionCFG<NodeT>::inflate() {
 
       // Comb end flag, which is useful to understand if the dummies we will
       // insert will need to substitute the current postdominator.
-      bool IsCombEnd = CombEndSetIt->second.contains(Candidate);
+      bool IsCombEnd = CombEndSet->contains(Candidate);
 
       if (not IsCombEnd) {
         for (auto &[Successor, EdgeLabel] : Candidate->labeled_successors()) {
@@ -1012,12 +1123,13 @@ inline void RegionCFG<NodeT>::inflate() {
 
         revng_log(CombLogger,
                   "Update conditional post-dominator. Old: "
-                    << CombEndIt->second->getNameStr()
+                    << CombEnd->getNameStr()
                     << " New: " << Dummy->getNameStr());
 
         // The dummy is now the node that ends the combing for Conditional.
-        CombEndIt->second = Dummy;
-        CombEndSetIt = NodesEquivalenceClass.insert({ Dummy, { Dummy } }).first;
+        CombEnd = Dummy;
+        NodesEquivalenceClass[Dummy].insert(Dummy);
+        CombEndSet = GetEquivalenceClass(Dummy);
 
         // Mark the dummy to explore.
         WorkList.insert(Dummy);
@@ -1035,8 +1147,22 @@ inline void RegionCFG<NodeT>::inflate() {
 
       } else {
 
+        // If duplicating the candidate exceeds the duplication budget, stop
+        // combing. The region will be emitted using `goto`s.
+        if (DuplicationBudget != 0) {
+          DuplicatedWeight += Candidate->getWeight();
+          if (DuplicatedWeight > MaxDuplicatedWeight) {
+            revng_log(CombLogger,
+                      "Duplication budget exceeded while duplicating "
+                        << Candidate->getNameStr());
+            NeedsGotos = true;
+            break;
+          }
+        }
+
         // Duplicate node.
         DuplicationCounter++;
+        DuplicatedWeightCounter += Candidate->getWeight();
         revng_log(CombLogger, "Duplicating node " << Candidate->getNameStr());
 
         BasicBlockNode<NodeT> *Duplicated = Graph.cloneNode(*Candidate);
@@ -1071,7 +1197,8 @@ inline void RegionCFG<NodeT>::inflate() {
                      + std::to_string(Iteration));
         }
 
-        BasicBlockNode<NodeT> *OriginalNode = CloneToOriginalMap.at(Candidate);
+        BasicBlockNode<NodeT> *OriginalNode = CloneToOriginalMap[Candidate];
+        revng_assert(OriginalNode != nullptr);
 
         bool AreDummies = Candidate->isEmpty();
         revng_assert(AreDummies == Duplicated->isEmpty());
@@ -1089,14 +1216,14 @@ inline void RegionCFG<NodeT>::inflate() {
           revng_assert(CandidateSuccSize == 0 or CInl == false);
           revng_assert(DuplicatedSuccSize == 0 or DInl == false);
 
-          // Notice: after this call Duplicated is invalid if the call returns
-          // true, meaning that dereferencing it is bad. You can still use it as
-          // a key or value into maps though.
+          // Notice: after this call Duplicated has been removed from the graph
+          // if the call returns true. It stays valid until the end of the
+          // inflate, when the removed nodes are reclaimed.
           if (not purgeIfTrivialDummy(Duplicated)) {
             // Add the cloned node in the equivalence class of the original
             // node.
             CloneToOriginalMap[Duplicated] = OriginalNode;
-            NodesEquivalenceClass.at(OriginalNode).insert(Duplicated);
+            NodesEquivalenceClass[OriginalNode].insert(Duplicated);
 
             // If it wasn't purged, insert the cloned node in the reverse post
             // order list. Here the order is not strictly relevant, because
@@ -1111,13 +1238,13 @@ inline void RegionCFG<NodeT>::inflate() {
           // node, this process may make it trivial. In that case we want to
           // remove it.
 
-          // Notice: after this call Candidate is invalid if the call returns
-          // true, meaning that dereferencing it is bad. You can still use it as
-          // a key or value into maps though.
+          // Notice: after this call Candidate has been removed from the graph
+          // if the call returns true. It stays valid until the end of the
+          // inflate, when the removed nodes are reclaimed.
           if (purgeIfTrivialDummy(Candidate)) {
             revng_log(CombLogger, "Candidate is now trivial");
-            CloneToOriginalMap.erase(Candidate);
-            NodesEquivalenceClass.at(OriginalNode).erase(Candidate);
+            CloneToOriginalMap[Candidate] = nullptr;
+            NodesEquivalenceClass[OriginalNode].erase(Candidate);
             Visited.erase(Candidate);
             // Erase Candidate from the post order list, but update ListIt so
             // that after the removal it points to the element that was
@@ -1134,7 +1261,7 @@ inline void RegionCFG<NodeT>::inflate() {
 
           // Add the cloned node in the equivalence class of the original node.
           CloneToOriginalMap[Duplicated] = OriginalNode;
-          NodesEquivalenceClass.at(OriginalNode).insert(Duplicated);
+          NodesEquivalenceClass[OriginalNode].insert(Duplicated);
 
           // Insert the cloned node in the reverse post order list, right before
           // the Candidate. This is not important right now, because we don't
@@ -1159,6 +1286,10 @@ inline void RegionCFG<NodeT>::inflate() {
     revng_log(CombLogger,
               "Finished looking at conditional: " << Conditional->getNameStr());
     Dumper.log("-conditional-" + Conditional->getNameStr() + "-final-state");
+
+    // Combing has been interrupted, what is left is emitted with `goto`s.
+    if (NeedsGotos)
+      break;
   }
 
   if (CombLogger.isEnabled()) {
@@ -1171,6 +1302,9 @@ inline void RegionCFG<NodeT>::inflate() {
   // Purge extra dummy nodes introduced.
   purgeTrivialDummies();
 
+  // The maps of the combing are gone, the removed nodes can be reclaimed.
+  reclaimRemovedNodes();
+
   if (CombLogger.isEnabled()) {
     Graph.dumpCFGOnFile(FunctionName,
                         "inflate",
@@ -1361,13 +1495,21 @@ inline void RegionCFG<NodeT>::weave() {
           edge_label_t Labels;
           bool WeavingDefault = false;
 
+          // The updates to the IFPDT are applied in a single batch, once the
+          // graph has been changed.
+          using DomUpdate = typename llvm::DominatorTreeBase<BasicBlockNodeT,
+                                                             true>::UpdateType;
+          const auto Insert = llvm::DominatorTree::Insert;
+          const auto Delete = llvm::DominatorTree::Delete;
+          std::vector<DomUpdate> Updates;
+
           // Iterate over all the case nodes that we found, moving all the
-          // necessary edges and updating the IFPDT.
+          // necessary edges. Inlined edges are not in the filtered view of the
+          // IFPDT, so they don't need updates.
           // Also, collect all the case labels of the cases we're weaving.
           for (BasicBlockNodeT *Case : PostDominatedCases) {
 
             auto LabeledEdge = extractLabeledEdge(EdgeDescriptor(Switch, Case));
-            IFPDT.deleteEdge(Switch, Case);
 
             auto &EdgeInfo = LabeledEdge.second;
             // If we find an edge without case labels, that's the default.
@@ -1384,7 +1526,10 @@ inline void RegionCFG<NodeT>::weave() {
               Labels.insert(EdgeInfo.Labels.begin(), EdgeInfo.Labels.end());
 
             addEdge(EdgeDescriptor(NewSwitch, Case), EdgeInfo);
-            IFPDT.insertEdge(NewSwitch, Case);
+            if (not EdgeInfo.Inlined) {
+              Updates.push_back({ Delete, Switch, Case });
+              Updates.push_back({ Insert, NewSwitch, Case });
+            }
 
             CaseSet.erase(Case);
           }
@@ -1398,13 +1543,15 @@ inline void RegionCFG<NodeT>::weave() {
           EdgeInfo EI = { Labels, false };
 
           addEdge(EdgeDescriptor(Switch, NewSwitch), EI);
-          IFPDT.insertEdge(Switch, NewSwitch);
+          Updates.push_back({ Insert, Switch, NewSwitch });
+          IFPDT.applyUpdates(Updates);
         }
       }
     }
   }
 
   DT.recalculate(Graph);
+  verifyDominatorTrees();
 
   if (CombLogger.isEnabled()) {
     Graph.dumpCFGOnFile(FunctionName,
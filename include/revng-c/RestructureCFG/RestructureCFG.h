@@ -4,11 +4,54 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <string>
+
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 
 class ASTTree;
 
+/// Metrics about the restructuring and the beautification of a function
+struct RestructureMetrics {
+  /// Number of SCSs collapsed into a region
+  uint64_t MetaRegions = 0;
+  uint64_t EntryDispatchers = 0;
+  uint64_t ExitDispatchers = 0;
+
+  /// Nodes duplicated by the comb, and their total weight
+  uint64_t DuplicatedNodes = 0;
+  uint64_t DuplicatedWeight = 0;
+
+  /// Number of untangle opportunities considered and actually performed
+  uint64_t UntangleTentative = 0;
+  uint64_t UntanglePerformed = 0;
+
+  /// Number of regions that exceeded the duplication budget and have been
+  /// emitted with `goto`s
+  uint64_t GotoRegions = 0;
+
+  /// Number of nodes of the RegionCFG of the function before the
+  /// restructuring, and of all the RegionCFGs (the root one and the collapsed
+  /// ones) after it
+  uint64_t InitialNodes = 0;
+  uint64_t FinalNodes = 0;
+
+  /// Weight of the CFG before the restructuring and of the resulting GHAST
+  uint64_t InitialWeight = 0;
+  uint64_t FinalWeight = 0;
+
+  /// Short-circuit simplifications performed by the beautification
+  uint64_t ShortCircuits = 0;
+  uint64_t TrivialShortCircuits = 0;
+
+  /// Wall time of each phase of the restructuring, in seconds
+  double MetaRegionsSeconds = 0;
+  double CollapseSeconds = 0;
+  double GenerateASTSeconds = 0;
+  double NormalizeSeconds = 0;
+};
+
 class RestructureCFG : public llvm::FunctionPass {
 
 public:
@@ -22,4 +65,18 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 };
 
-bool restructureCFG(llvm::Function &F, ASTTree &AST);
+/// Restructure \a F into \a AST, recording metrics in \a Metrics, if not null
+bool restructureCFG(llvm::Function &F,
+                    ASTTree &AST,
+                    RestructureMetrics *Metrics = nullptr);
+
+/// Describes the tree of the metaregions identified by restructureCFG in \a F,
+/// before any of them is collapsed. Each metaregion is printed between braces,
+/// as the sorted names of the basic blocks it contains, followed by the
+/// metaregions nested in it.
+std::string describeMetaRegionTree(llvm::Function &F);
+
+/// Describes the value of the options that affect the AST produced by
+/// restructureCFG, so that ASTs generated with different options can be told
+/// apart. The number of threads is not among them: it doesn't affect the AST.
+std::string describeRestructureOptions();
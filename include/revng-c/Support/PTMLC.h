@@ -7,6 +7,7 @@
 #include <type_traits>
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Value.h"
 
@@ -66,6 +67,7 @@ public:
     Default,
     Break,
     Continue,
+    Goto,
     If,
     Else,
     Return,
@@ -122,6 +124,8 @@ private:
       return "break";
     case Keyword::Continue:
       return "continue";
+    case Keyword::Goto:
+      return "goto";
     case Keyword::If:
       return "if";
     case Keyword::Else:
@@ -141,21 +145,21 @@ private:
     }
   }
 
-  llvm::StringRef toString(Operator OperatorOp) const {
+  // The spelling of the operators is resolved at compile time for each of the
+  // two output modes, so that the plain C emission does not need to check the
+  // mode for every single operator.
+  template<bool TagLess>
+  static llvm::StringRef toString(Operator OperatorOp) {
     switch (OperatorOp) {
     case Operator::PointerDereference: {
       return "*";
     }
     case Operator::AddressOf: {
-      if (!isGenerateTagLessPTML())
-        return "&amp;";
-      return "&";
+      return TagLess ? "&" : "&amp;";
     }
 
     case Operator::Arrow: {
-      if (!isGenerateTagLessPTML())
-        return "-&gt;";
-      return "->";
+      return TagLess ? "->" : "-&gt;";
     }
 
     case Operator::Dot: {
@@ -178,21 +182,15 @@ private:
     }
 
     case Operator::RShift: {
-      if (!isGenerateTagLessPTML())
-        return "&gt;&gt;";
-      return ">>";
+      return TagLess ? ">>" : "&gt;&gt;";
     }
 
     case Operator::LShift: {
-      if (!isGenerateTagLessPTML())
-        return "&lt;&lt;";
-      return "<<";
+      return TagLess ? "<<" : "&lt;&lt;";
     }
 
     case Operator::And: {
-      if (!isGenerateTagLessPTML())
-        return "&amp;";
-      return "&";
+      return TagLess ? "&" : "&amp;";
     }
 
     case Operator::Or: {
@@ -208,30 +206,20 @@ private:
       return "!=";
     }
     case Operator::CmpGt: {
-      if (!isGenerateTagLessPTML())
-        return "&gt;";
-      return ">";
+      return TagLess ? ">" : "&gt;";
     }
     case Operator::CmpGte: {
-      if (!isGenerateTagLessPTML())
-        return "&gt;=";
-      return ">=";
+      return TagLess ? ">=" : "&gt;=";
     }
     case Operator::CmpLt: {
-      if (!isGenerateTagLessPTML())
-        return "&lt;";
-      return "<";
+      return TagLess ? "<" : "&lt;";
     }
 
     case Operator::CmpLte: {
-      if (!isGenerateTagLessPTML())
-        return "&lt;=";
-      return "<=";
+      return TagLess ? "<=" : "&lt;=";
     }
     case Operator::BoolAnd: {
-      if (!isGenerateTagLessPTML())
-        return "&amp;&amp;";
-      return "&&";
+      return TagLess ? "&&" : "&amp;&amp;";
     }
     case Operator::BoolOr: {
       return "||";
@@ -254,6 +242,12 @@ private:
     }
   }
 
+  llvm::StringRef toString(Operator OperatorOp) const {
+    if (isGenerateTagLessPTML())
+      return toString<true>(OperatorOp);
+    return toString<false>(OperatorOp);
+  }
+
   llvm::StringRef toString(Directive TheDirective) const {
     switch (TheDirective) {
     case Directive::Include:
@@ -291,6 +285,15 @@ private:
     return Result;
   }
 
+  llvm::SmallString<12>
+  numberHelper(const llvm::APInt &I, unsigned int Radix, bool Signed) const {
+    llvm::SmallString<12> Result;
+    I.toString(Result, Radix, Signed);
+    if (I.getBitWidth() == 64 and I.isNegative())
+      Result += 'U';
+    return Result;
+  }
+
   Tag keywordTagHelper(const llvm::StringRef Str) const {
     return ptml::PTMLBuilder::getTag(ptml::tags::Span, Str)
       .addAttribute(ptml::attributes::Token, ptml::c::tokens::Keyword);
@@ -331,12 +334,7 @@ public:
   Tag getNumber(const llvm::APInt &I,
                 unsigned int Radix = 10,
                 bool Signed = false) const {
-    llvm::SmallString<12> Result;
-    I.toString(Result, Radix, Signed);
-    if (I.getBitWidth() == 64 and I.isNegative())
-      Result += 'U';
-
-    return getConstantTag(Result);
+    return getConstantTag(numberHelper(I, Radix, Signed));
   }
 
   template<class T>
@@ -344,6 +342,33 @@ public:
     return getConstantTag(std::to_string(I));
   }
 
+  // Serialized variants of the getters above. When emitting plain C they
+  // directly return the text of the token, without building a Tag.
+  std::string getOperatorString(Operator OperatorOp) const {
+    if (isGenerateTagLessPTML())
+      return toString<true>(OperatorOp).str();
+    return getOperator(OperatorOp).serialize();
+  }
+
+  std::string getConstantString(const llvm::StringRef Str) const {
+    if (isGenerateTagLessPTML())
+      return Str.str();
+    return getConstantTag(Str).serialize();
+  }
+
+  std::string getNullString() const { return getConstantString("NULL"); }
+
+  std::string getNumberString(const llvm::APInt &I,
+                              unsigned int Radix = 10,
+                              bool Signed = false) const {
+    return getConstantString(numberHelper(I, Radix, Signed));
+  }
+
+  template<class T>
+  std::string getNumberString(const T &I) const {
+    return getConstantString(std::to_string(I));
+  }
+
   // String literal.
   Tag getStringLiteral(const llvm::StringRef Str) const {
     return ptml::PTMLBuilder::tokenTag(Str, ptml::c::tokens::StringLiteral);
@@ -4,11 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <unordered_map>
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/Type.h"
+#include "revng/Support/MetaAddress.h"
 
 #include "revng-c/Pipes/Ranks.h"
 #include "revng-c/Support/PTMLC.h"
@@ -40,6 +42,12 @@ private:
 public:
   TypeInlineHelper(const model::Binary &Model);
 
+  // Get the TypeInlineHelper for `Model`, sharing it with all the other users
+  // of the same version of the model. The analysis is only recomputed when the
+  // types (or the stack frames) it depends upon change.
+  static std::shared_ptr<const TypeInlineHelper>
+  get(const model::Binary &Model);
+
 public:
   const GraphInfo &getTypeGraph() const;
   const std::set<const model::Type *> &getTypesToInline() const;
@@ -51,6 +59,12 @@ public:
   std::unordered_map<const model::Function *, std::set<const model::Type *>>
   findStackTypesPerFunction(const model::Binary &Model) const;
 
+  // Collect stack frame types only for the model::Functions whose entry is in
+  // `Functions`.
+  std::unordered_map<const model::Function *, std::set<const model::Type *>>
+  findStackTypesPerFunction(const model::Binary &Model,
+                            const std::set<MetaAddress> &Functions) const;
+
   // Collect all stack frame types, since we want to dump them inline in the
   // function body.
   std::set<const model::Type *>
@@ -76,6 +90,10 @@ private:
 
   // Helper function used for finding all nested (into `RootType`) inlinable
   // types.
+  std::set<const model::Type *>
+  getStackTypesToInline(const model::Binary &Model,
+                        const model::Function &Function) const;
+
   std::set<const model::Type *>
   getNestedTypesToInline(const model::Type *RootType,
                          const UpcastablePointer<model::Type> &NestedTy) const;
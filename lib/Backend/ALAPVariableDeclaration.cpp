@@ -7,16 +7,18 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <list>
-#include <type_traits>
-
-#include "llvm/ADT/PostOrderIterator.h"
-#include "llvm/ADT/SmallSet.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/Support/GenericDomTreeConstruction.h"
 
-#include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/RecursiveCoroutine.h"
 
 #include "revng-c/RestructureCFG/ASTNode.h"
@@ -26,7 +28,8 @@
 
 #include "ALAPVariableDeclaration.h"
 
-using BBGHASTNodeMap = std::multimap<const llvm::BasicBlock *, const ASTNode *>;
+using BBGHASTNodeMap = llvm::DenseMap<const llvm::BasicBlock *,
+                                      llvm::SmallVector<const ASTNode *, 2>>;
 
 static RecursiveCoroutine<void>
 collectExprBB(ExprNode *Expr, const ASTNode *Node, BBGHASTNodeMap &ResultMap) {
@@ -38,7 +41,7 @@ collectExprBB(ExprNode *Expr, const ASTNode *Node, BBGHASTNodeMap &ResultMap) {
   case ExprNode::NodeKind::NK_Atomic: {
     auto *Atomic = llvm::cast<AtomicNode>(Expr);
     llvm::BasicBlock *BB = Atomic->getConditionalBasicBlock();
-    ResultMap.insert(std::make_pair(BB, Node));
+    ResultMap[BB].push_back(Node);
   } break;
   case ExprNode::NodeKind::NK_Not: {
     auto *Not = llvm::cast<NotNode>(Expr);
@@ -100,7 +103,7 @@ private:
 
       // Add the original `BB` in the `ResultMap`
       llvm::BasicBlock *BB = If->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, If));
+      BBToASTNode[BB].push_back(If);
 
       ExprNode *IfExpr = If->getCondExpr();
       collectExprBB(IfExpr, If, BBToASTNode);
@@ -117,7 +120,7 @@ private:
 
       // Add the original `BB` in the `ResultMap`
       llvm::BasicBlock *BB = Switch->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, Switch));
+      BBToASTNode[BB].push_back(Switch);
 
       for (auto &LabelCasePair : Switch->cases_const_range()) {
         ASTNode *Case = LabelCasePair.second;
@@ -129,7 +132,7 @@ private:
       // Add the original `BB` in the `ResultMap`
       auto *Code = llvm::cast<CodeNode>(Node);
       llvm::BasicBlock *BB = Code->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, Code));
+      BBToASTNode[BB].push_back(Code);
     } break;
     case ASTNode::NK_Continue: {
       auto *Continue = llvm::cast<ContinueNode>(Node);
@@ -145,7 +148,9 @@ private:
     } break;
     case ASTNode::NK_Set:
     case ASTNode::NK_SwitchBreak:
-    case ASTNode::NK_Break: {
+    case ASTNode::NK_Break:
+    case ASTNode::NK_Label:
+    case ASTNode::NK_Goto: {
 
       // These nodes should not have an associated `BasicBlock`
       revng_assert(Node->getOriginalBB() == nullptr);
@@ -167,119 +172,164 @@ public:
   }
 };
 
-struct ASTForwardNode {
-  ASTForwardNode(const ASTNode *Node) : Node(Node) {}
-  const ASTNode *Node;
-  const ASTNode *getASTNode() { return Node; }
-};
+// Dense representation of the scope reachability graph of a GHAST.
+//
+// In this graph each `ASTNode` has as children the `ASTNode`s nested in it,
+// with the exception of the elements of a `SequenceNode`: only the first one is
+// a child of the `SequenceNode`, while each of the others is a child of its
+// immediate predecessor. The graph is a tree, and the nodes are
+// numbered in preorder, so that the subtree of each node spans a contiguous
+// range of indexes. Dominance over this tree, which is what we need for the
+// variable declaration scope, boils down to the lowest common ancestor.
+class ScopeTree {
+public:
+  static constexpr unsigned NoParent = std::numeric_limits<unsigned>::max();
 
-using Node = ForwardNode<ASTForwardNode>;
-using ScopeReachabilityGenericGraphTy = GenericGraph<Node>;
-using ASTToNodeMapType = std::map<const ASTNode *, Node *>;
+private:
+  std::vector<const ASTNode *> Nodes;
+  std::vector<unsigned> Parents;
+  // Index past the last node of the subtree of each node.
+  std::vector<unsigned> SubtreeEnds;
+  llvm::DenseMap<const ASTNode *, unsigned> ASTToIndex;
 
-// In this struct we compact both the underlying `GenericGraph` that we use to
-// materialize the graph, and the mapping between the original `ASTNode` and the
-// corresponding `Node` in the `GenericGraph`
-struct ScopeReachabilityGraphTy {
-  ScopeReachabilityGenericGraphTy Graph;
-  ASTToNodeMapType ASTToNodeMap;
-};
+public:
+  ScopeTree(const ASTTree &GHAST) { buildNode(GHAST.getRoot(), NoParent); }
 
-static RecursiveCoroutine<Node *>
-buildNode(ScopeReachabilityGraphTy &ScopeReachabilityGraph,
-          const ASTNode *ASTN) {
-  // Create a new node in the `GenericGraph`
-  Node *GNode = ScopeReachabilityGraph.Graph.addNode(ASTN);
-  ScopeReachabilityGraph.ASTToNodeMap[ASTN] = GNode;
+public:
+  unsigned size() const { return Nodes.size(); }
 
-  switch (ASTN->getKind()) {
-  case ASTNode::NK_List: {
-    auto *Seq = llvm::cast<SequenceNode>(ASTN);
+  const ASTNode *getASTNode(unsigned Index) const { return Nodes[Index]; }
 
-    Node *PreviousGChild = GNode;
-    for (ASTNode *Child : Seq->nodes()) {
-      Node *GChild = rc_recur buildNode(ScopeReachabilityGraph, Child);
+  unsigned getParent(unsigned Index) const { return Parents[Index]; }
 
-      // Create the sibling-to-sibling edge
-      if (PreviousGChild)
-        PreviousGChild->addSuccessor(GChild);
+  unsigned getSubtreeEnd(unsigned Index) const { return SubtreeEnds[Index]; }
 
-      // Prepare for the next iteration
-      PreviousGChild = GChild;
-    }
-  } break;
-  case ASTNode::NK_Scs: {
-    auto *Scs = llvm::cast<ScsNode>(ASTN);
+  unsigned getIndex(const ASTNode *Node) const {
+    auto It = ASTToIndex.find(Node);
+    revng_assert(It != ASTToIndex.end());
+    return It->second;
+  }
 
-    if (Scs->hasBody()) {
-      Node *Body = rc_recur buildNode(ScopeReachabilityGraph, Scs->getBody());
-      GNode->addSuccessor(Body);
-    }
-  } break;
-  case ASTNode::NK_If: {
-    auto *If = llvm::cast<IfNode>(ASTN);
+private:
+  unsigned addNode(const ASTNode *ASTN, unsigned Parent) {
+    unsigned Index = Nodes.size();
+    Nodes.push_back(ASTN);
+    Parents.push_back(Parent);
+    SubtreeEnds.push_back(Index + 1);
+    bool New = ASTToIndex.try_emplace(ASTN, Index).second;
+    revng_assert(New);
+    return Index;
+  }
 
-    if (If->hasThen()) {
-      Node *Then = rc_recur buildNode(ScopeReachabilityGraph, If->getThen());
-      GNode->addSuccessor(Then);
-    }
-    if (If->hasElse()) {
-      Node *Else = rc_recur buildNode(ScopeReachabilityGraph, If->getElse());
-      GNode->addSuccessor(Else);
-    }
-  } break;
-  case ASTNode::NK_Switch: {
-    auto *Switch = llvm::cast<SwitchNode>(ASTN);
+  RecursiveCoroutine<void> buildNode(const ASTNode *ASTN, unsigned Parent) {
+    unsigned Index = addNode(ASTN, Parent);
+
+    switch (ASTN->getKind()) {
+    case ASTNode::NK_List: {
+      auto *Seq = llvm::cast<SequenceNode>(ASTN);
+
+      // Each child is nested in its preceding sibling
+      llvm::SmallVector<unsigned, 8> Children;
+      unsigned PreviousChild = Index;
+      for (ASTNode *Child : Seq->nodes()) {
+        unsigned ChildIndex = Nodes.size();
+        rc_recur buildNode(Child, PreviousChild);
+        Children.push_back(ChildIndex);
+        PreviousChild = ChildIndex;
+      }
+
+      // Hence, the subtree of each child extends up to the end of the sequence
+      for (unsigned ChildIndex : Children)
+        SubtreeEnds[ChildIndex] = Nodes.size();
+    } break;
+    case ASTNode::NK_Scs: {
+      auto *Scs = llvm::cast<ScsNode>(ASTN);
+
+      if (Scs->hasBody())
+        rc_recur buildNode(Scs->getBody(), Index);
+    } break;
+    case ASTNode::NK_If: {
+      auto *If = llvm::cast<IfNode>(ASTN);
+
+      if (If->hasThen())
+        rc_recur buildNode(If->getThen(), Index);
+      if (If->hasElse())
+        rc_recur buildNode(If->getElse(), Index);
+    } break;
+    case ASTNode::NK_Switch: {
+      auto *Switch = llvm::cast<SwitchNode>(ASTN);
 
-    for (auto &LabelCasePair : Switch->cases_const_range()) {
-      Node *Case = rc_recur buildNode(ScopeReachabilityGraph,
-                                      LabelCasePair.second);
-      GNode->addSuccessor(Case);
+      for (auto &LabelCasePair : Switch->cases_const_range())
+        rc_recur buildNode(LabelCasePair.second, Index);
+    } break;
+    case ASTNode::NK_Code:
+    case ASTNode::NK_Continue:
+    case ASTNode::NK_Set:
+    case ASTNode::NK_SwitchBreak:
+    case ASTNode::NK_Break:
+    case ASTNode::NK_Label:
+    case ASTNode::NK_Goto:
+      break;
+    default:
+      revng_unreachable();
     }
-  } break;
-  case ASTNode::NK_Code:
-  case ASTNode::NK_Continue:
-  case ASTNode::NK_Set:
-  case ASTNode::NK_SwitchBreak:
-  case ASTNode::NK_Break:
-    break;
-  default:
-    revng_unreachable();
-  }
 
-  rc_return GNode;
-}
+    // All the nodes created so far belong to the subtree of `ASTN`
+    SubtreeEnds[Index] = Nodes.size();
+
+    rc_return;
+  }
+};
 
 /// This helper function can be used to collect all the transitive `User`s
 /// starting from an `llvm::Instruction` and stopping at either: a `CallInst`,
 /// an `Assign` or a terminator
-static RecursiveCoroutine<void>
-collectTransitiveUsers(const llvm::Instruction *I,
-                       llvm::SmallSet<const llvm::Instruction *, 4> &Users) {
+using InstructionSet = llvm::SmallPtrSetImpl<const llvm::Instruction *>;
+
+static void collectTransitiveUsers(const llvm::Instruction *I,
+                                   InstructionSet &Users) {
+  llvm::SmallVector<const llvm::Instruction *, 8> Worklist = { I };
 
-  // This dataflow visit will stop at certain collection points
-  if (isAssignment(I) or isCallToIsolatedFunction(I) or I->isTerminator()) {
+  while (not Worklist.empty()) {
+    const llvm::Instruction *Current = Worklist.pop_back_val();
+
+    // This dataflow visit will stop at certain collection points
     // We stop at `@Assign` `TaggedCall`.
     // We stop at calls to isolated functions.
     // We stop at `Terminator` instructions.
-    rc_return;
+    if (isAssignment(Current) or isCallToIsolatedFunction(Current)
+        or Current->isTerminator())
+      continue;
+
+    // In all the other cases, we continue exploring the dataflow
+    for (const llvm::User *U : Current->users()) {
+      const auto *UserInstruction = llvm::cast<llvm::Instruction>(U);
+      if (bool New = Users.insert(UserInstruction).second; New)
+        Worklist.push_back(UserInstruction);
+    }
   }
+}
+
+// The range of preorder indexes in the `ScopeTree` spanned by the `ASTNode`s
+// using a variable. The lowest common ancestor of all the users is the lowest
+// common ancestor of the first and of the last of them.
+struct UsageRange {
+  unsigned First = std::numeric_limits<unsigned>::max();
+  unsigned Last = 0;
 
-  // In all the other cases, we continue exploring the dataflow
-  for (const llvm::User *U : I->users()) {
-    const llvm::Instruction *UserInstruction = llvm::cast<llvm::Instruction>(U);
-    if (bool New = Users.insert(UserInstruction).second; New)
-      rc_recur collectTransitiveUsers(UserInstruction, Users);
+  void add(unsigned Index) {
+    First = std::min(First, Index);
+    Last = std::max(Last, Index);
   }
 
-  rc_return;
-}
+  bool empty() const { return First > Last; }
+};
 
-static llvm::SmallSet<const ASTNode *, 4>
-collectUsageASTNodes(const llvm::Instruction *Variable,
-                     const BBGHASTNodeMap &BBToASTNode) {
+static UsageRange collectUsageRange(const llvm::Instruction *Variable,
+                                    const BBGHASTNodeMap &BBToASTNode,
+                                    const ScopeTree &Tree) {
   // Collect the immediate `User`s of the `Variable`
-  llvm::SmallSet<const llvm::Instruction *, 4> UsageInstructions;
+  llvm::SmallPtrSet<const llvm::Instruction *, 8> UsageInstructions;
   for (const llvm::User *VariableUser : Variable->users()) {
     const llvm::Instruction
       *UserInst = llvm::cast<llvm::Instruction>(VariableUser);
@@ -294,131 +344,132 @@ collectUsageASTNodes(const llvm::Instruction *Variable,
   }
 
   // Collect the transitive `User`s of the already collected `User`s
-  llvm::SmallSet<const llvm::Instruction *, 4> AdditionalUsers;
+  llvm::SmallPtrSet<const llvm::Instruction *, 8> AdditionalUsers;
   for (const llvm::Instruction *UserInst : UsageInstructions) {
     collectTransitiveUsers(UserInst, AdditionalUsers);
   }
-
-  // Merge the obtained results from the transitive `User`s collection
   UsageInstructions.insert(AdditionalUsers.begin(), AdditionalUsers.end());
 
-  // We collect all the AST nodes that are users of the pending variable
-  // we are analyzing
-  llvm::SmallSet<const ASTNode *, 4> UsageASTNodes;
+  // We now collect all the AST nodes that are users of the pending variable
+  // we are analyzing. Only the first and the last in preorder matter.
+  UsageRange Result;
   for (const llvm::Instruction *UserInst : UsageInstructions) {
     const llvm::BasicBlock *UserBB = UserInst->getParent();
 
     // We retrieve all the `GHASTNode`s which encompass the `BasicBlock`
     // above
-    auto Range = BBToASTNode.equal_range(UserBB);
-    for (auto RangeIt = Range.first; RangeIt != Range.second; ++RangeIt) {
-      UsageASTNodes.insert(RangeIt->second);
-    }
+    auto It = BBToASTNode.find(UserBB);
+    if (It == BBToASTNode.end())
+      continue;
+
+    for (const ASTNode *UsageASTNode : It->second)
+      Result.add(Tree.getIndex(UsageASTNode));
   }
 
   // Ensure that we find usages for each `Variable` that we need to assign
-  revng_assert(not UsageASTNodes.empty());
+  revng_assert(not Result.empty());
 
-  return UsageASTNodes;
+  return Result;
 }
 
-static ScopeReachabilityGraphTy
-makeGHASTReachabilityGraph(const ASTTree &GHAST) {
-  ScopeReachabilityGraphTy ScopeReachabilityGraph;
-  const ASTNode *RootNode = GHAST.getRoot();
-  Node *RootGNode = buildNode(ScopeReachabilityGraph, RootNode);
-  ScopeReachabilityGraph.Graph.setEntryNode(RootGNode);
+/// Compute the lowest common ancestor in \p Tree of each pair of nodes in
+/// \p Queries, all at once, using Tarjan's offline algorithm.
+static std::vector<unsigned>
+computeLowestCommonAncestors(const ScopeTree &Tree,
+                             llvm::ArrayRef<UsageRange> Queries) {
+  std::vector<unsigned> Result(Queries.size(), ScopeTree::NoParent);
+
+  // Register each query on both its endpoints: it will be answered when the
+  // visit of the latest of the two is completed.
+  std::vector<llvm::SmallVector<unsigned, 1>> QueriesAt(Tree.size());
+  for (const auto &Entry : llvm::enumerate(Queries)) {
+    unsigned QueryIndex = Entry.index();
+    const UsageRange &Query = Entry.value();
+    if (Query.First == Query.Last) {
+      Result[QueryIndex] = Query.First;
+    } else {
+      QueriesAt[Query.First].push_back(QueryIndex);
+      QueriesAt[Query.Last].push_back(QueryIndex);
+    }
+  }
 
-  return ScopeReachabilityGraph;
-}
+  // Disjoint sets of nodes: each completed node is merged into the set of its
+  // parent, so the representative of the set of a completed node is always its
+  // closest ancestor whose visit is still in progress, which is exactly what
+  // Tarjan's algorithm needs.
+  std::vector<unsigned> Representative(Tree.size());
+  for (unsigned Index = 0; Index < Tree.size(); ++Index)
+    Representative[Index] = Index;
+
+  const auto FindRepresentative = [&Representative](unsigned Index) {
+    // Path halving
+    while (Representative[Index] != Index) {
+      Representative[Index] = Representative[Representative[Index]];
+      Index = Representative[Index];
+    }
+    return Index;
+  };
 
-static std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
-computeVariableUsages(const ASTTree &GHAST,
-                      PendingVariableListType &PendingVariables) {
+  llvm::BitVector Completed(Tree.size());
+  const auto Complete = [&](unsigned Index) {
+    Completed.set(Index);
 
-  // Compute a `BasicBlock * -> GHASTNode *` multimap representing which
-  // `GHASTNode`s covers the usage of a certain `BasicBlock`
-  BBToASTNodeMapping Mapping(GHAST);
-  const BBGHASTNodeMap &BBToASTNode = Mapping.compute();
+    for (unsigned QueryIndex : QueriesAt[Index]) {
+      const UsageRange &Query = Queries[QueryIndex];
+      unsigned Other = Query.First == Index ? Query.Last : Query.First;
+      if (Completed.test(Other))
+        Result[QueryIndex] = FindRepresentative(Other);
+    }
 
-  std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
-    VariableUsages;
-  for (auto *Variable : PendingVariables) {
-    VariableUsages[Variable] = collectUsageASTNodes(Variable, BBToASTNode);
+    // All the children of `Index` have been merged into it already, and the
+    // parent is still in progress: it is the representative of its own set.
+    if (unsigned Parent = Tree.getParent(Index); Parent != ScopeTree::NoParent)
+      Representative[Index] = Parent;
+  };
+
+  // Visiting the nodes in preorder, a node is completed as soon as we step out
+  // of its subtree.
+  llvm::SmallVector<unsigned, 16> InProgress;
+  for (unsigned Index = 0; Index < Tree.size(); ++Index) {
+    while (not InProgress.empty()
+           and Tree.getSubtreeEnd(InProgress.back()) <= Index)
+      Complete(InProgress.pop_back_val());
+    InProgress.push_back(Index);
   }
+  while (not InProgress.empty())
+    Complete(InProgress.pop_back_val());
 
-  return VariableUsages;
+  return Result;
 }
 
 ASTVarDeclMap computeVarDeclMap(const ASTTree &GHAST,
-                                PendingVariableListType &PendingVariables) {
-
-  // 1: build a `GenericGraph` over the GHAST, representing the visibility
-  // graph between `ASTNode`s. In this `GenericGraph`, no `SequenceNode` is
-  // present, but instead each sibling in a `SequenceNode` has, as child, its
-  // immediate successor. This type of view is useful for our analysis.
-  ScopeReachabilityGraphTy
-    ScopeReachabilityGraph = makeGHASTReachabilityGraph(GHAST);
-
-  // 2: we instantiate the dominator tree over the `ScopeReachabilityGraph`. We
-  // will make use of dominance queries as an alternative to performing
-  // reachability queries over the same graph. Indeed, we postulate that they
-  // are equivalent given the AST like structure of `ScopeReachabilityGraph`,
-  // and the fact that the direct successor of each `ASTNode` is a child of it
-  // in this representation.
-  llvm::DominatorTreeBase<Node, false> DT;
-  DT.recalculate(ScopeReachabilityGraph.Graph);
-
-  // 3: pre-compute, for each variable, all the `ASTNode`s that contain an use
-  // of the variable
-  auto VariableUsages = computeVariableUsages(GHAST, PendingVariables);
-
-  // 4: perform the `Variable` assignment operation.
-  // We want to iterate over the nodes of the newly created `GenericGraph`in
-  // post order.
-  ASTVarDeclMap Result;
-  for (auto *TheNode : llvm::post_order(&ScopeReachabilityGraph.Graph)) {
+                                const PendingVariableListType &PendingVars) {
 
-    // At each iteration, iterate over the list of variables that are still to
-    // assign
-    for (const llvm::CallInst *&Pending : PendingVariables) {
+  // 1: build a dense tree over the GHAST, representing the visibility between
+  // `ASTNode`s.
+  ScopeTree Tree(GHAST);
 
-      // We use a `nullptr` in `PendingVariables` as a tombstone to mark the
-      // fact that the variable has already been assigned
-      if (not Pending) {
-        continue;
-      }
+  // 2: compute a `BasicBlock * -> GHASTNode *` map representing which
+  // `GHASTNode`s covers the usage of a certain `BasicBlock`
+  BBToASTNodeMapping Mapping(GHAST);
+  const BBGHASTNodeMap &BBToASTNode = Mapping.compute();
 
-      const llvm::SmallSet<const ASTNode *, 4> &UsageASTNodes = VariableUsages
-                                                                  .at(Pending);
-
-      // If, from the current node, we dominate all the `ASTNode`s in
-      // `UsageASTNodes`, we can mark the variable to be emitted in the current
-      // `ASTNode`
-      const auto TheNodeDominatesASTUse = [&](const ASTNode *UsageASTNode) {
-        Node *UsageGraphNode = ScopeReachabilityGraph.ASTToNodeMap
-                                 .at(UsageASTNode);
-        return DT.dominates(TheNode, UsageGraphNode);
-      };
-      bool AllUsesDominated = llvm::all_of(UsageASTNodes,
-                                           TheNodeDominatesASTUse);
-
-      // If we the current TheNode dominates all the uses of the `Variable`,
-      // we mark the current node as the place where to emit the variable
-      // declaration
-      if (AllUsesDominated) {
-        Result[TheNode->getASTNode()].insert(Pending);
-        Pending = nullptr;
-      }
-    }
-  }
+  // 3: pre-compute, for each variable, the range of `ASTNode`s that contain an
+  // use of the variable
+  llvm::SmallVector<UsageRange> Usages;
+  Usages.reserve(PendingVars.size());
+  for (const llvm::CallInst *Variable : PendingVars)
+    Usages.push_back(collectUsageRange(Variable, BBToASTNode, Tree));
 
-  // At the end of the processing, we should have assigned all the pending
-  // variables
-  const auto IsNullPtr = [](const llvm::CallInst *Variable) {
-    return not Variable;
-  };
-  revng_assert(llvm::all_of(PendingVariables, IsNullPtr));
+  // 4: the declaration of each variable goes in the innermost `ASTNode` that
+  // dominates all of its uses, i.e., their lowest common ancestor.
+  std::vector<unsigned> Scopes = computeLowestCommonAncestors(Tree, Usages);
+
+  ASTVarDeclMap Result;
+  for (const auto &[Variable, Scope] : llvm::zip(PendingVars, Scopes)) {
+    revng_assert(Scope != ScopeTree::NoParent);
+    Result[Tree.getASTNode(Scope)].insert(Variable);
+  }
 
   return Result;
 }
@@ -22,4 +22,4 @@ using PendingVariableListType = llvm::SmallVector<const llvm::CallInst *>;
 
 extern ASTVarDeclMap
 computeVarDeclMap(const ASTTree &GHAST,
-                  PendingVariableListType &PendingVariables);
+                  const PendingVariableListType &PendingVariables);
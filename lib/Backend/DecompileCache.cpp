@@ -0,0 +1,232 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/IRHelpers.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/YAMLTraits.h"
+
+#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/Support/FunctionTags.h"
+
+#include "DecompileCache.h"
+
+static Logger<> Log{ "decompile-cache" };
+
+/// Bump this every time the emitted C code changes for the same input, so that
+/// entries produced by older versions are not reused.
+static constexpr const char *CacheFormatVersion = "decompile-cache-v2";
+
+static std::string hashString(llvm::StringRef Data) {
+  llvm::MD5 Hasher;
+  Hasher.update(Data);
+  llvm::MD5::MD5Result Result;
+  Hasher.final(Result);
+  return Result.digest().str().str();
+}
+
+template<typename T>
+static std::string hashSerialized(const T &Element) {
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream OS(Buffer);
+    serialize(OS, Element);
+  }
+  return hashString(Buffer);
+}
+
+static void printAttachedMetadata(llvm::raw_ostream &OS,
+                                  const llvm::Module *M,
+                                  llvm::ArrayRef<std::pair<unsigned,
+                                                           llvm::MDNode *>>
+                                    Attachments) {
+  for (const auto &[Kind, MD] : Attachments) {
+    OS << Kind << ": ";
+    MD->printTree(OS, M);
+    OS << "\n";
+  }
+}
+
+DecompileCache::DecompileCache(llvm::StringRef Directory,
+                               const model::Binary &Model,
+                               llvm::StringRef Options) :
+  Directory(Directory.str()), Model(Model) {
+
+  if (std::error_code Error = llvm::sys::fs::create_directories(Directory))
+    revng_abort(Error.message().c_str());
+
+  for (const UpcastablePointer<model::Type> &T : Model.Types())
+    TypeHashes[T.get()] = hashSerialized(T);
+
+  llvm::MD5 Hasher;
+  Hasher.update(CacheFormatVersion);
+  Hasher.update(Options);
+  Hasher.update(hashSerialized(Model.Segments()));
+  Hasher.update(hashSerialized(Model.ImportedDynamicFunctions()));
+  llvm::MD5::MD5Result Result;
+  Hasher.final(Result);
+  GlobalHash = Result.digest().str().str();
+}
+
+std::string
+DecompileCache::computeKey(FunctionMetadataCache &Cache,
+                           const llvm::Function &F,
+                           const InlineableTypesMap &StackTypes) const {
+  const model::Function *ModelFunction = llvmToModelFunction(Model, F);
+  revng_assert(ModelFunction);
+
+  llvm::MD5 Hasher;
+  Hasher.update(GlobalHash);
+
+  // The IR of the function. Metadata is printed as references, so the content
+  // of the attached metadata (e.g. debug locations) has to be added on top.
+  {
+    std::string IR;
+    llvm::raw_string_ostream OS(IR);
+    F.print(OS);
+
+    const llvm::Module *M = F.getParent();
+    llvm::SmallVector<std::pair<unsigned, llvm::MDNode *>, 4> Attachments;
+    F.getAllMetadata(Attachments);
+    printAttachedMetadata(OS, M, Attachments);
+    for (const llvm::Instruction &I : llvm::instructions(F)) {
+      Attachments.clear();
+      I.getAllMetadata(Attachments);
+      printAttachedMetadata(OS, M, Attachments);
+    }
+
+    OS.flush();
+    Hasher.update(IR);
+  }
+
+  Hasher.update(hashSerialized(*ModelFunction));
+
+  // Callees are referred to by name and their attributes (e.g. NoReturn)
+  // affect the emitted code.
+  for (const llvm::Instruction &I : llvm::instructions(F)) {
+    auto *Call = getCallToIsolatedFunction(&I);
+    if (not Call)
+      continue;
+
+    if (const llvm::Function *Callee = Call->getCalledFunction())
+      if (const auto *CalleeModel = llvmToModelFunction(Model, *Callee))
+        Hasher.update(hashSerialized(*CalleeModel));
+  }
+
+  // Collect all the types reachable from the types of the values of F. These
+  // include the prototype of F, its stack frame type and the prototypes of all
+  // its callees.
+  llvm::SmallPtrSet<const model::Type *, 16> Visited;
+  std::vector<const model::Type *> Worklist;
+  const auto Enqueue = [&Visited, &Worklist](const model::QualifiedType &QT) {
+    if (QT.UnqualifiedType().empty())
+      return;
+    const model::Type *T = QT.UnqualifiedType().getConst();
+    if (Visited.insert(T).second)
+      Worklist.push_back(T);
+  };
+
+  for (const auto &[Value, Type] :
+       initModelTypes(Cache, F, ModelFunction, Model, /*PointersOnly=*/false))
+    Enqueue(Type);
+
+  std::vector<llvm::StringRef> ReachableTypeHashes;
+  while (not Worklist.empty()) {
+    const model::Type *T = Worklist.back();
+    Worklist.pop_back();
+    ReachableTypeHashes.push_back(TypeHashes.at(T));
+    for (const model::QualifiedType &QT : T->edges())
+      Enqueue(QT);
+  }
+
+  // Make the key independent of the order in which types have been visited
+  llvm::sort(ReachableTypeHashes);
+  for (llvm::StringRef Hash : ReachableTypeHashes)
+    Hasher.update(Hash);
+
+  // Whether the stack frame type is emitted inline depends on how many times
+  // it is referenced in the whole model.
+  Hasher.update("inline-stack-types:");
+  if (auto It = StackTypes.find(ModelFunction); It != StackTypes.end()) {
+    std::vector<llvm::StringRef> InlinedTypeHashes;
+    for (const model::Type *T : It->second)
+      InlinedTypeHashes.push_back(TypeHashes.at(T));
+    llvm::sort(InlinedTypeHashes);
+    for (llvm::StringRef Hash : InlinedTypeHashes)
+      Hasher.update(Hash);
+  }
+
+  llvm::MD5::MD5Result Result;
+  Hasher.final(Result);
+  return Result.digest().str().str();
+}
+
+std::string DecompileCache::getEntryPath(llvm::StringRef Key) const {
+  llvm::SmallString<128> Path(Directory);
+  llvm::sys::path::append(Path, Key + ".c.ptml");
+  return Path.str().str();
+}
+
+std::optional<std::string> DecompileCache::lookup(llvm::StringRef Key) const {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(getEntryPath(Key));
+  if (not MaybeBuffer) {
+    revng_log(Log, "Miss: " << Key);
+    return std::nullopt;
+  }
+
+  revng_log(Log, "Hit: " << Key);
+  return (*MaybeBuffer)->getBuffer().str();
+}
+
+void DecompileCache::store(llvm::StringRef Key, llvm::StringRef CCode) const {
+  std::string Path = getEntryPath(Key);
+
+  // Write to a temporary file and then move it in place, so that concurrent
+  // runs sharing the same cache never observe partially written entries.
+  // Failing to store an entry is not an error, it will just be recomputed.
+  int FD;
+  llvm::SmallString<128> TemporaryPath;
+  if (std::error_code Error = llvm::sys::fs::createUniqueFile(Path
+                                                                + "-%%%%%%.tmp",
+                                                              FD,
+                                                              TemporaryPath)) {
+    revng_log(Log, "Cannot create " << Path << ": " << Error.message());
+    return;
+  }
+
+  {
+    llvm::raw_fd_ostream OS(FD, /* shouldClose */ true);
+    OS << CCode;
+    OS.close();
+    if (OS.has_error()) {
+      revng_log(Log, "Cannot write " << TemporaryPath << ": "
+                                     << OS.error().message());
+      OS.clear_error();
+      llvm::sys::fs::remove(TemporaryPath);
+      return;
+    }
+  }
+
+  if (std::error_code Error = llvm::sys::fs::rename(TemporaryPath, Path)) {
+    revng_log(Log, "Cannot create " << Path << ": " << Error.message());
+    llvm::sys::fs::remove(TemporaryPath);
+  }
+}
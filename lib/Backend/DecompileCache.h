@@ -0,0 +1,67 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+
+namespace llvm {
+class Function;
+} // end namespace llvm
+
+using InlineableTypesMap = std::unordered_map<const model::Function *,
+                                              std::set<const model::Type *>>;
+
+/// Persistent on-disk cache of the C code emitted for isolated functions.
+///
+/// Entries are content-addressed: the key of a function is a hash of its LLVM
+/// IR and of all the parts of the model that can affect the C code emitted for
+/// it, namely the model::Function itself, the model::Function of its callees,
+/// all the types reachable from the types of its values (which include its
+/// prototype, its stack frame type and the prototypes of its callees), the
+/// segments, the dynamic functions and the options that affect the emitted
+/// code. Stale entries are never removed, they simply stop being looked up.
+class DecompileCache {
+private:
+  std::string Directory;
+  const model::Binary &Model;
+
+  /// Hash of the serialized form of each type in the model
+  std::unordered_map<const model::Type *, std::string> TypeHashes;
+
+  /// Hash of the parts of the model and of the options that every function
+  /// depends upon
+  std::string GlobalHash;
+
+public:
+  /// \a Options describes all the settings, other than the IR and the model,
+  /// that affect the C code emitted for a function.
+  DecompileCache(llvm::StringRef Directory,
+                 const model::Binary &Model,
+                 llvm::StringRef Options);
+
+public:
+  /// Compute the key identifying the C code of \a F.
+  ///
+  /// \note this has to be called before \a F is restructured, since
+  ///       restructuring and beautification alter its IR.
+  std::string computeKey(FunctionMetadataCache &Cache,
+                         const llvm::Function &F,
+                         const InlineableTypesMap &StackTypes) const;
+
+  std::optional<std::string> lookup(llvm::StringRef Key) const;
+
+  void store(llvm::StringRef Key, llvm::StringRef CCode) const;
+
+private:
+  std::string getEntryPath(llvm::StringRef Key) const;
+};
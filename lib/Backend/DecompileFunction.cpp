@@ -2,8 +2,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
+#include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -24,8 +29,11 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -47,6 +55,7 @@
 #include "revng/PTML/IndentedOstream.h"
 #include "revng/Pipeline/Location.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/YAMLTraits.h"
@@ -71,6 +80,8 @@
 #include "revng-c/TypeNames/ModelTypeNames.h"
 
 #include "ALAPVariableDeclaration.h"
+#include "DecompileCache.h"
+#include "DecompileStatistics.h"
 
 using llvm::cast;
 using llvm::dyn_cast;
@@ -98,14 +109,44 @@ using tokenDefinition::types::StringToken;
 
 using TokenMapT = std::map<const llvm::Value *, std::string>;
 using ModelTypesMap = std::map<const llvm::Value *, const model::QualifiedType>;
-using InlineableTypesMap = std::unordered_map<const model::Function *,
-                                              std::set<const model::Type *>>;
 
 static constexpr const char *StackFrameVarName = "_stack";
 
 static Logger<> Log{ "c-backend" };
 static Logger<> VisitLog{ "c-backend-visit-order" };
 
+static llvm::cl::opt<unsigned>
+  DecompileThreads("decompile-threads",
+                   llvm::cl::desc("Number of threads used to emit the C code "
+                                  "of isolated functions (0 means one per "
+                                  "hardware thread)"),
+                   llvm::cl::cat(MainCategory),
+                   llvm::cl::init(1));
+
+static llvm::cl::opt<std::string>
+  DecompileCacheDir("decompile-cache-dir",
+                    llvm::cl::desc("Directory where the C code of each "
+                                   "function is cached across runs"),
+                    llvm::cl::value_desc("directory"),
+                    llvm::cl::cat(MainCategory));
+
+static llvm::cl::opt<std::string>
+  StatisticsOutputPath("decompile-statistics-output",
+                       llvm::cl::desc("Path of a CSV file where to write "
+                                      "per-function decompilation statistics"),
+                       llvm::cl::value_desc("filename"),
+                       llvm::cl::cat(MainCategory));
+
+/// Whether the C code is emitted without PTML tags
+static constexpr bool GeneratePlainC = false;
+
+/// Describes all the settings, other than the IR and the model, that affect the
+/// C code emitted for a function. The number of threads does not.
+static std::string describeOutputOptions() {
+  return describeRestructureOptions()
+         + " ptml-tags=" + (GeneratePlainC ? "no" : "yes");
+}
+
 static bool isStackFrameDecl(const llvm::Value *I) {
   auto *Call = dyn_cast_or_null<llvm::CallInst>(I);
   if (not Call)
@@ -142,7 +183,7 @@ static bool isCConstant(const llvm::Value *V) {
 }
 
 static std::string addAlwaysParentheses(llvm::StringRef Expr) {
-  return std::string("(") + Expr.str() + ")";
+  return (llvm::Twine("(") + Expr + ")").str();
 }
 
 static std::string get128BitIntegerHexConstant(llvm::APInt Value,
@@ -192,7 +233,7 @@ static std::string get128BitIntegerHexConstant(llvm::APInt Value,
                      /*radix=*/16,
                      /*signed=*/false,
                      /*formatAsCLiteral=*/true);
-    CompositeConstant += B.getConstantTag(LowBitsString).serialize();
+    CompositeConstant += B.getConstantString(LowBitsString);
   }
   return addAlwaysParentheses(CompositeConstant);
 }
@@ -287,11 +328,18 @@ private:
   VarNameGenerator NameGenerator;
 
   /// Keep track of the names associated with function arguments, and local
-  /// variables. In the past it also kept track of intermediate expressions, but
-  /// with the new design all the tokens corresponding to instructions that
-  /// don't represent local variables are recomputed every time.
+  /// variables.
   TokenMapT TokenMap;
 
+  /// Memoized tokens of the expressions (i.e. constants and instructions that
+  /// are not statements) that have already been built.
+  ///
+  /// The token of an expression only depends on the names in TokenMap, so the
+  /// cache is flushed every time one of those names is overridden.
+  /// Statements are never cached, since they are emitted exactly where they
+  /// appear and their side effects must not be folded.
+  mutable llvm::DenseMap<const llvm::Value *, std::string> ExpressionTokens;
+
 private:
   /// Name of the local variable used to break out from loops
   std::string LoopStateVar;
@@ -337,7 +385,8 @@ public:
       IsOperatorPrecedenceResolutionPassEnabled = true;
   }
 
-  void emitFunction(bool NeedsLocalStateVar, InlineableTypesMap &StackTypes);
+  void emitFunction(bool NeedsLocalStateVar,
+                    const InlineableTypesMap &StackTypes);
 
 private:
   /// Visit a GHAST node and all its children recursively, emitting BBs
@@ -393,6 +442,10 @@ private:
 private:
   std::string addParentheses(llvm::StringRef Expr) const;
 
+  /// Append \a Expr to \a Result, wrapping it in parentheses if needed,
+  /// without building intermediate strings.
+  void appendParentheses(std::string &Result, llvm::StringRef Expr) const;
+
   std::string buildDerefExpr(llvm::StringRef Expr) const;
 
   std::string buildAddressExpr(llvm::StringRef Expr) const;
@@ -419,7 +472,10 @@ private:
                  or isCallStackArgumentDecl(I));
     std::string VarName = NameGenerator.nextVarName();
     // This may override the entry for I, if I belongs to a "duplicated"
-    // BasicBlock that is reachable from many paths on the GHAST.
+    // BasicBlock that is reachable from many paths on the GHAST. In that case
+    // the expressions built so far might refer to the old name.
+    if (TokenMap.contains(I))
+      ExpressionTokens.clear();
     TokenMap[I] = getVariableLocationReference(VarName, ModelFunction, B);
     return getVariableLocationDefinition(VarName, ModelFunction, B);
   }
@@ -439,14 +495,31 @@ std::string CCodeGenerator::addParentheses(llvm::StringRef Expr) const {
   return addAlwaysParentheses(Expr);
 }
 
+void CCodeGenerator::appendParentheses(std::string &Result,
+                                       llvm::StringRef Expr) const {
+  if (IsOperatorPrecedenceResolutionPassEnabled) {
+    Result.append(Expr.data(), Expr.size());
+    return;
+  }
+
+  Result.reserve(Result.size() + Expr.size() + 2);
+  Result += '(';
+  Result.append(Expr.data(), Expr.size());
+  Result += ')';
+}
+
 std::string CCodeGenerator::buildDerefExpr(llvm::StringRef Expr) const {
   using PTMLOperator = ptml::PTMLCBuilder::Operator;
-  return B.getOperator(PTMLOperator::PointerDereference) + addParentheses(Expr);
+  std::string Result = B.getOperatorString(PTMLOperator::PointerDereference);
+  appendParentheses(Result, Expr);
+  return Result;
 }
 
 std::string CCodeGenerator::buildAddressExpr(llvm::StringRef Expr) const {
-  return B.getOperator(ptml::PTMLCBuilder::Operator::AddressOf)
-         + addParentheses(Expr);
+  using PTMLOperator = ptml::PTMLCBuilder::Operator;
+  std::string Result = B.getOperatorString(PTMLOperator::AddressOf);
+  appendParentheses(Result, Expr);
+  return Result;
 }
 
 std::string
@@ -460,8 +533,10 @@ CCodeGenerator::buildCastExpr(StringRef ExprToCast,
   revng_assert(SrcType.skipTypedefs() == DestType.skipTypedefs()
                or (SrcType.isScalar() and DestType.isScalar()));
 
-  return addAlwaysParentheses(getTypeName(DestType, B)) + " "
-         + addParentheses(ExprToCast);
+  std::string Result = addAlwaysParentheses(getTypeName(DestType, B));
+  Result += ' ';
+  appendParentheses(Result, ExprToCast);
+  return Result;
 }
 
 static std::string getUndefToken(model::QualifiedType UndefType,
@@ -481,26 +556,26 @@ static std::string getFormattedIntegerToken(const llvm::CallInst *Call,
   if (isCallToTagged(Call, FunctionTags::HexInteger)) {
     const auto Operand = Call->getArgOperand(0);
     const auto *Value = cast<llvm::ConstantInt>(Operand);
-    return B.getConstantTag(hexLiteral(Value, B, Model)).serialize();
+    return B.getConstantString(hexLiteral(Value, B, Model));
   }
 
   if (isCallToTagged(Call, FunctionTags::CharInteger)) {
     const auto Operand = Call->getArgOperand(0);
     const auto *Value = cast<llvm::ConstantInt>(Operand);
-    return B.getConstantTag(charLiteral(Value)).serialize();
+    return B.getConstantString(charLiteral(Value));
   }
 
   if (isCallToTagged(Call, FunctionTags::BoolInteger)) {
     const auto Operand = Call->getArgOperand(0);
     const auto *Value = cast<llvm::ConstantInt>(Operand);
-    return B.getConstantTag(boolLiteral(Value)).serialize();
+    return B.getConstantString(boolLiteral(Value));
   }
 
   if (isCallToTagged(Call, FunctionTags::NullPtr)) {
     const auto Operand = Call->getArgOperand(0);
     const auto *Value = cast<llvm::ConstantInt>(Operand);
     revng_assert(Value->isZero());
-    return B.getNullTag().serialize();
+    return B.getNullString();
   }
   std::string Error = "Cannot get token for custom opcode: "
                       + dumpToString(Call);
@@ -516,12 +591,12 @@ CCodeGenerator::getConstantToken(const llvm::Value *C) const {
     rc_return getUndefToken(TypeMap.at(Undef), B);
 
   if (auto *Null = dyn_cast<llvm::ConstantPointerNull>(C))
-    rc_return B.getNullTag().serialize();
+    rc_return B.getNullString();
 
   if (auto *Const = dyn_cast<llvm::ConstantInt>(C)) {
     llvm::APInt Value = Const->getValue();
     if (Value.isIntN(64))
-      rc_return B.getNumber(Value).serialize();
+      rc_return B.getNumberString(Value);
     else
       rc_return get128BitIntegerHexConstant(Value, B, Model);
   }
@@ -666,7 +741,7 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
       // index.
       std::string IndexExpr;
       if (auto *Const = dyn_cast<llvm::ConstantInt>(ThirdArgument)) {
-        IndexExpr = B.getNumber(Const->getValue()).serialize();
+        IndexExpr = B.getNumberString(Const->getValue());
       } else {
         IndexExpr = rc_recur getToken(ThirdArgument);
       }
@@ -710,8 +785,8 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
 
   std::string CurExpr = addParentheses(BaseString);
   using PTMLOperator = ptml::PTMLCBuilder::Operator;
-  Tag Deref = UseArrow ? B.getOperator(PTMLOperator::Arrow) :
-                         B.getOperator(PTMLOperator::Dot);
+  std::string Deref = UseArrow ? B.getOperatorString(PTMLOperator::Arrow) :
+                                B.getOperatorString(PTMLOperator::Dot);
 
   // Traverse the model to decide whether to emit "." or "[]"
   for (; CurArg != Call->arg_end(); ++CurArg) {
@@ -729,7 +804,7 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
 
       std::string IndexExpr;
       if (auto *Const = dyn_cast<llvm::ConstantInt>(CurArg->get())) {
-        IndexExpr = B.getNumber(Const->getValue()).serialize();
+        IndexExpr = B.getNumberString(Const->getValue());
       } else {
         IndexExpr = rc_recur getToken(CurArg->get());
       }
@@ -742,7 +817,7 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
       auto *FieldIdxConst = cast<llvm::ConstantInt>(CurArg->get());
       uint64_t FieldIdx = FieldIdxConst->getValue().getLimitedValue();
 
-      CurExpr += Deref.serialize();
+      CurExpr += Deref;
 
       // Find the field name
       const auto *UnqualType = CurType.UnqualifiedType().getConst();
@@ -765,7 +840,7 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
 
     // Regardless if the base type was a pointer or not, we are now
     // navigating only references
-    Deref = B.getOperator(PTMLOperator::Dot);
+    Deref = B.getOperatorString(PTMLOperator::Dot);
   }
 
   rc_return CurExpr;
@@ -778,7 +853,7 @@ CCodeGenerator::getCustomOpcodeToken(const llvm::CallInst *Call) const {
     const llvm::Value *StoredVal = Call->getArgOperand(0);
     const llvm::Value *PointerVal = Call->getArgOperand(1);
     rc_return rc_recur getToken(PointerVal) + " "
-      + B.getOperator(ptml::PTMLCBuilder::Operator::Assign) + " "
+      + B.getOperatorString(ptml::PTMLCBuilder::Operator::Assign) + " "
       + rc_recur getToken(StoredVal);
   }
 
@@ -897,22 +972,22 @@ CCodeGenerator::getCustomOpcodeToken(const llvm::CallInst *Call) const {
   if (isCallToTagged(Call, FunctionTags::UnaryMinus)) {
     auto Operand = Call->getArgOperand(0);
     std::string ToNegate = rc_recur getToken(Operand);
-    rc_return B.getOperator(PTMLOperator::UnaryMinus) + ToNegate;
+    rc_return B.getOperatorString(PTMLOperator::UnaryMinus) + ToNegate;
   }
 
   if (isCallToTagged(Call, FunctionTags::BinaryNot)) {
     auto Operand = Call->getArgOperand(0);
     std::string ToNegate = rc_recur getToken(Operand);
     rc_return(Operand->getType()->isIntegerTy(1) ?
-                B.getOperator(PTMLOperator::BoolNot) :
-                B.getOperator(PTMLOperator::BinaryNot))
+                B.getOperatorString(PTMLOperator::BoolNot) :
+                B.getOperatorString(PTMLOperator::BinaryNot))
       + ToNegate;
   }
 
   if (isCallToTagged(Call, FunctionTags::BooleanNot)) {
     auto Operand = Call->getArgOperand(0);
     std::string ToNegate = rc_recur getToken(Operand);
-    rc_return B.getOperator(PTMLOperator::BoolNot) + ToNegate;
+    rc_return B.getOperatorString(PTMLOperator::BoolNot) + ToNegate;
   }
 
   if (isCallToTagged(Call, FunctionTags::StringLiteral)) {
@@ -1023,37 +1098,37 @@ static std::string addDebugInfo(const llvm::Instruction *I,
 /// Return the string that represents the given binary operator in C
 static const std::string getBinOpString(const llvm::BinaryOperator *BinOp,
                                         const ptml::PTMLCBuilder &B) {
-  const Tag Op = [&BinOp, &B]() {
+  const std::string Op = [&BinOp, &B]() {
     bool IsBool = BinOp->getType()->isIntegerTy(1);
 
     using PTMLOperator = ptml::PTMLCBuilder::Operator;
 
     switch (BinOp->getOpcode()) {
     case Instruction::Add:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Add);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Add);
     case Instruction::Sub:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Sub);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Sub);
     case Instruction::Mul:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Mul);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Mul);
     case Instruction::SDiv:
     case Instruction::UDiv:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Div);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Div);
     case Instruction::SRem:
     case Instruction::URem:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Modulo);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Modulo);
     case Instruction::LShr:
     case Instruction::AShr:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::RShift);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::RShift);
     case Instruction::Shl:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::LShift);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::LShift);
     case Instruction::And:
-      return IsBool ? B.getOperator(PTMLOperator::BoolAnd) :
-                      B.getOperator(ptml::PTMLCBuilder::Operator::And);
+      return IsBool ? B.getOperatorString(PTMLOperator::BoolAnd) :
+                      B.getOperatorString(ptml::PTMLCBuilder::Operator::And);
     case Instruction::Or:
-      return IsBool ? B.getOperator(PTMLOperator::BoolOr) :
-                      B.getOperator(ptml::PTMLCBuilder::Operator::Or);
+      return IsBool ? B.getOperatorString(PTMLOperator::BoolOr) :
+                      B.getOperatorString(ptml::PTMLCBuilder::Operator::Or);
     case Instruction::Xor:
-      return B.getOperator(ptml::PTMLCBuilder::Operator::Xor);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::Xor);
     default:
       revng_abort("Unknown const Binary operation");
     }
@@ -1065,24 +1140,24 @@ static const std::string getBinOpString(const llvm::BinaryOperator *BinOp,
 static const std::string getCmpOpString(const llvm::CmpInst::Predicate &Pred,
                                         const ptml::PTMLCBuilder &B) {
   using llvm::CmpInst;
-  const Tag Op = [&Pred, &B]() {
+  const std::string Op = [&Pred, &B]() {
     switch (Pred) {
     case CmpInst::ICMP_EQ: ///< equal
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpEq);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpEq);
     case CmpInst::ICMP_NE: ///< not equal
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpNeq);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpNeq);
     case CmpInst::ICMP_UGT: ///< unsigned greater than
     case CmpInst::ICMP_SGT: ///< signed greater than
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpGt);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpGt);
     case CmpInst::ICMP_UGE: ///< unsigned greater or equal
     case CmpInst::ICMP_SGE: ///< signed greater or equal
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpGte);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpGte);
     case CmpInst::ICMP_ULT: ///< unsigned less than
     case CmpInst::ICMP_SLT: ///< signed less than
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpLt);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpLt);
     case CmpInst::ICMP_ULE: ///< unsigned less or equal
     case CmpInst::ICMP_SLE: ///< signed less or equal
-      return B.getOperator(ptml::PTMLCBuilder::Operator::CmpLte);
+      return B.getOperatorString(ptml::PTMLCBuilder::Operator::CmpLte);
     default:
       revng_abort("Unknown comparison operator");
     }
@@ -1347,6 +1422,44 @@ CCodeGenerator::getInstructionToken(const llvm::Instruction *I) const {
   rc_return "";
 }
 
+static bool isStatement(const llvm::Instruction *I) {
+  // Return are statements
+  if (isa<llvm::ReturnInst>(I))
+    return true;
+
+  // Instructions that are not calls are never statement.
+  auto *Call = dyn_cast<llvm::CallInst>(I);
+  if (not Call)
+    return false;
+
+  // Calls to Assign and LocalVariable are statemements.
+  // Stack frame declarations and call stack arguments declarations are
+  // statements.
+  if (isAssignment(Call))
+    return true;
+
+  // Calls to isolated functions or helpers that return struct types on LLVM IR
+  // need a statement.
+  // This is necessary as a result of the fact that there is no direct mapping
+  // between struct types on LLVM IR and on the model, so whenever a function
+  // returns a struct in LLVM IR we cannot generally create a call to
+  // LocalVariable nor to Copy/Assign (because we'd need to tag them with model
+  // Type and we can't do that.), so we have to deal with it here on the fly.
+  // We do it by marking these as statements, and emitting an assignment in C
+  if (isArtificialAggregateLocalVarDecl(Call)
+      or isHelperAggregateLocalVarDecl(Call))
+    return true;
+
+  // Calls to isolated functions and helpers that return void are statements.
+  // If they don't return void, they are not statements. They are expressions
+  // that will be assigned to some local variables in some other assign
+  // statements.
+  if (isCallToIsolatedFunction(Call) or isCallToNonIsolated(Call))
+    return Call->getType()->isVoidTy();
+
+  return false;
+}
+
 RecursiveCoroutine<std::string>
 CCodeGenerator::getToken(const llvm::Value *V) const {
   revng_log(Log, "getToken(): " << dumpToString(V));
@@ -1368,11 +1481,24 @@ CCodeGenerator::getToken(const llvm::Value *V) const {
                and not isArtificialAggregateLocalVarDecl(V)
                and not isHelperAggregateLocalVarDecl(V));
 
-  if (isCConstant(V))
-    rc_return rc_recur getConstantToken(V);
+  if (auto CacheIt = ExpressionTokens.find(V);
+      CacheIt != ExpressionTokens.end()) {
+    revng_log(Log, "Cached!");
+    rc_return CacheIt->second;
+  }
 
-  if (auto *I = dyn_cast<llvm::Instruction>(V))
-    rc_return rc_recur getInstructionToken(I);
+  if (isCConstant(V)) {
+    std::string Token = rc_recur getConstantToken(V);
+    ExpressionTokens[V] = Token;
+    rc_return Token;
+  }
+
+  if (auto *I = dyn_cast<llvm::Instruction>(V)) {
+    std::string Token = rc_recur getInstructionToken(I);
+    if (not isStatement(I))
+      ExpressionTokens[V] = Token;
+    rc_return Token;
+  }
 
   std::string Error = "Cannot get token for llvm::Value: ";
   Error += dumpToString(V).c_str();
@@ -1401,44 +1527,6 @@ CCodeGenerator::getCallToken(const llvm::CallInst *Call,
   rc_return Expression;
 }
 
-static bool isStatement(const llvm::Instruction *I) {
-  // Return are statements
-  if (isa<llvm::ReturnInst>(I))
-    return true;
-
-  // Instructions that are not calls are never statement.
-  auto *Call = dyn_cast<llvm::CallInst>(I);
-  if (not Call)
-    return false;
-
-  // Calls to Assign and LocalVariable are statemements.
-  // Stack frame declarations and call stack arguments declarations are
-  // statements.
-  if (isAssignment(Call))
-    return true;
-
-  // Calls to isolated functions or helpers that return struct types on LLVM IR
-  // need a statement.
-  // This is necessary as a result of the fact that there is no direct mapping
-  // between struct types on LLVM IR and on the model, so whenever a function
-  // returns a struct in LLVM IR we cannot generally create a call to
-  // LocalVariable nor to Copy/Assign (because we'd need to tag them with model
-  // Type and we can't do that.), so we have to deal with it here on the fly.
-  // We do it by marking these as statements, and emitting an assignment in C
-  if (isArtificialAggregateLocalVarDecl(Call)
-      or isHelperAggregateLocalVarDecl(Call))
-    return true;
-
-  // Calls to isolated functions and helpers that return void are statements.
-  // If they don't return void, they are not statements. They are expressions
-  // that will be assigned to some local variables in some other assign
-  // statements.
-  if (isCallToIsolatedFunction(Call) or isCallToNonIsolated(Call))
-    return Call->getType()->isVoidTy();
-
-  return false;
-}
-
 void CCodeGenerator::emitBasicBlock(const llvm::BasicBlock *BB,
                                     bool EmitReturn) {
   LoggerIndent Indent{ VisitLog };
@@ -1576,11 +1664,11 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
       using Operator = ptml::PTMLCBuilder::Operator;
       switch (Comparison) {
       case CompareNode::ComparisonKind::Comparison_Equal: {
-        auto CmpString = B.getOperator(Operator::CmpEq);
+        auto CmpString = B.getOperatorString(Operator::CmpEq);
         CompareNodeString += " " + CmpString;
       } break;
       case CompareNode::ComparisonKind::Comparison_NotEqual: {
-        auto CmpString = B.getOperator(Operator::CmpNeq);
+        auto CmpString = B.getOperatorString(Operator::CmpNeq);
         CompareNodeString += " " + CmpString;
       } break;
       default: {
@@ -1646,7 +1734,7 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
 
     const NotNode *N = cast<NotNode>(E);
     ExprNode *Negated = N->getNegatedNode();
-    rc_return B.getOperator(ptml::PTMLCBuilder::Operator::BoolNot)
+    rc_return B.getOperatorString(ptml::PTMLCBuilder::Operator::BoolNot)
       + addAlwaysParentheses(rc_recur buildGHASTCondition(Negated, EmitBB));
   } break;
 
@@ -1660,10 +1748,10 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
     std::string Child1Token = rc_recur buildGHASTCondition(Child1, EmitBB);
     std::string Child2Token = rc_recur buildGHASTCondition(Child2, EmitBB);
     using PTMLOperator = ptml::PTMLCBuilder::Operator;
-    const Tag &OpToken = E->getKind() == NodeKind::NK_And ?
-                           B.getOperator(PTMLOperator::BoolAnd) :
-                           B.getOperator(PTMLOperator::BoolOr);
-    rc_return addAlwaysParentheses(Child1Token) + " " + OpToken.serialize()
+    std::string OpToken = E->getKind() == NodeKind::NK_And ?
+                            B.getOperatorString(PTMLOperator::BoolAnd) :
+                            B.getOperatorString(PTMLOperator::BoolOr);
+    rc_return addAlwaysParentheses(Child1Token) + " " + OpToken
       + " " + addAlwaysParentheses(Child2Token);
   } break;
 
@@ -1679,6 +1767,10 @@ static std::string makeWhile(const ptml::PTMLCBuilder &B,
          + CondExpr + ")";
 }
 
+static std::string getLabelName(const LabelNode *Label) {
+  return "_label_" + std::to_string(Label->getID());
+}
+
 RecursiveCoroutine<void> CCodeGenerator::emitGHASTNode(const ASTNode *N) {
   if (N == nullptr)
     rc_return;
@@ -1933,10 +2025,13 @@ RecursiveCoroutine<void> CCodeGenerator::emitGHASTNode(const ASTNode *N) {
           if (SwitchVar) {
             llvm::Type *SwitchVarT = SwitchVar->getType();
             auto *IntType = cast<llvm::IntegerType>(SwitchVarT);
-            auto *CaseConst = llvm::ConstantInt::get(IntType, CaseVal);
+            // Build the APInt directly instead of going through
+            // llvm::ConstantInt::get, which would mutate the LLVMContext and
+            // is not safe when emitting multiple functions concurrently.
+            llvm::APInt CaseValue(IntType->getBitWidth(), CaseVal);
             // TODO: assigned the signedness based on the signedness of the
             // condition
-            Out << B.getNumber(CaseConst->getValue());
+            Out << B.getNumber(CaseValue);
           } else {
             Out << B.getNumber(CaseVal);
           }
@@ -2004,6 +2099,22 @@ RecursiveCoroutine<void> CCodeGenerator::emitGHASTNode(const ASTNode *N) {
         << B.getOperator(ptml::PTMLCBuilder::Operator::Assign) << " "
         << StateValue << ";\n";
   } break;
+
+  case ASTNode::NodeKind::NK_Label: {
+    revng_log(VisitLog, "(NK_Label)");
+
+    // Labels are followed by an empty statement, since in C they cannot
+    // directly precede a declaration or the end of a scope.
+    Out << getLabelName(cast<LabelNode>(N)) << ":;\n";
+  } break;
+
+  case ASTNode::NodeKind::NK_Goto: {
+    revng_log(VisitLog, "(NK_Goto)");
+
+    const GotoNode *Goto = cast<GotoNode>(N);
+    Out << B.getKeyword(ptml::PTMLCBuilder::Keyword::Goto) << " "
+        << getLabelName(Goto->getTarget()) << ";\n";
+  } break;
   }
 
   rc_return;
@@ -2036,7 +2147,7 @@ static std::string getModelArgIdentifier(const model::Type *ModelFunctionType,
 }
 
 void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
-                                  InlineableTypesMap &StackTypes) {
+                                  const InlineableTypesMap &StackTypes) {
   revng_log(Log, "========= Emitting Function " << LLVMFunction.getName());
   revng_log(VisitLog, "========= Function " << LLVMFunction.getName());
   LoggerIndent Indent{ VisitLog };
@@ -2131,11 +2242,11 @@ static std::string decompileFunction(FunctionMetadataCache &Cache,
                                      const Binary &Model,
                                      const ASTVarDeclMap &VarToDeclare,
                                      bool NeedsLocalStateVar,
-                                     InlineableTypesMap &StackTypes) {
+                                     const InlineableTypesMap &StackTypes) {
   std::string Result;
 
   llvm::raw_string_ostream Out(Result);
-  ptml::PTMLCBuilder B;
+  ptml::PTMLCBuilder B(GeneratePlainC);
 
   CCodeGenerator
     Backend(Cache, Model, LLVMFunc, CombedAST, VarToDeclare, Out, B);
@@ -2178,67 +2289,327 @@ static ASTVarDeclMap computeVariableDeclarationScope(const llvm::Function &F,
   return computeVarDeclMap(GHAST, PendingVariables);
 }
 
-using Container = revng::pipes::DecompileStringMap;
-void decompile(FunctionMetadataCache &Cache,
-               llvm::Module &Module,
-               const model::Binary &Model,
-               Container &DecompiledFunctions) {
-  TypeInlineHelper TheTypeInlineHelper(Model);
+/// Build the GHAST of \a F and beautify it, recording statistics about each
+/// step in \a Stats, if not null.
+static void buildGHAST(const model::Binary &Model,
+                       llvm::Function &F,
+                       ASTTree &GHAST,
+                       llvm::Task &T,
+                       FunctionStatistics *Stats) {
+  RestructureMetrics *Metrics = Stats ? &Stats->Restructuring : nullptr;
+  // GHASTs are always built one at a time, so the memory usage of the process
+  // is the one of this function
+  T.advance("restructureCFG");
+  measureStage(Stats ? &Stats->RestructureCFG : nullptr,
+               /* MeasureMemory */ true,
+               [&]() { restructureCFG(F, GHAST, Metrics); });
+  // TODO: beautification should be optional, but at the moment it's not
+  // truly so (if disabled, things crash). We should strive to make it
+  // optional for real.
+  T.advance("beautifyAST");
+  measureStage(Stats ? &Stats->BeautifyAST : nullptr,
+               /* MeasureMemory */ true,
+               [&]() { beautifyAST(Model, F, GHAST, Metrics); });
+  if (Stats)
+    Stats->GHASTNodes = GHAST.size();
+
+  if (Log.isEnabled()) {
+    GHAST.dumpASTOnFile(F.getName().str(),
+                        "ast-backend",
+                        "AST-during-c-codegen.dot");
+  }
+}
 
-  // Get all Stack types and all the inlinable types reachable from it,
-  // since we want to emit forward declarations for all of them.
-  auto StackTypes = TheTypeInlineHelper.findStackTypesPerFunction(Model);
+/// Generate the C code for \a F, starting from its beautified GHAST.
+///
+/// This only reads the IR of \a F, the GHAST and the model, so it can be run
+/// concurrently on different functions as long as each invocation gets its own
+/// \a Cache.
+static std::string emitCCode(FunctionMetadataCache &Cache,
+                             const llvm::Function &F,
+                             const ASTTree &GHAST,
+                             const model::Binary &Model,
+                             const InlineableTypesMap &StackTypes) {
+  auto VariablesToDeclare = computeVariableDeclarationScope(F, GHAST);
+  auto NeedsLoopStateVar = hasLoopDispatchers(GHAST);
+  return decompileFunction(Cache,
+                           F,
+                           GHAST,
+                           Model,
+                           VariablesToDeclare,
+                           NeedsLoopStateVar,
+                           StackTypes);
+}
 
-  auto
-    T = llvm::make_task_on_set(llvm::make_address_range(FunctionTags::Isolated
-                                                          .functions(&Module)),
-                               "decompile");
+static MetaAddress getEntry(const llvm::Function &F) {
+  return getMetaAddressMetadata(&F, "revng.function.entry");
+}
 
+std::vector<llvm::Function *>
+selectFunctionsToDecompile(llvm::Module &Module,
+                           const std::set<MetaAddress> &Targets) {
+  std::vector<llvm::Function *> Functions;
   for (llvm::Function &F : FunctionTags::Isolated.functions(&Module)) {
-    T.advance(&F,
-              llvm::Twine("decompile Function: ") + llvm::Twine(F.getName()));
-
     if (F.empty())
       continue;
 
+    if (not Targets.empty() and not Targets.contains(getEntry(F)))
+      continue;
+
+    Functions.push_back(&F);
+  }
+
+  return Functions;
+}
+
+/// Statistics for \a F, if they have been requested
+static std::optional<FunctionStatistics>
+initStatistics(const DecompileStatisticsReport *Report,
+               const llvm::Function &F) {
+  if (not Report)
+    return std::nullopt;
+
+  FunctionStatistics Result;
+  Result.Entry = getEntry(F);
+  Result.Name = F.getName().str();
+  Result.BasicBlocks = F.size();
+  Result.Instructions = F.getInstructionCount();
+  return Result;
+}
+
+using Container = revng::pipes::DecompileStringMap;
+
+static void decompileSerially(FunctionMetadataCache &Cache,
+                              const std::vector<llvm::Function *> &Functions,
+                              const model::Binary &Model,
+                              const InlineableTypesMap &StackTypes,
+                              const DecompileCache *DiskCache,
+                              DecompileStatisticsReport *Report,
+                              Container &DecompiledFunctions) {
+  auto T = llvm::make_task_on_set(Functions, "decompile");
+
+  for (llvm::Function *F : Functions) {
+    T.advance(F,
+              llvm::Twine("decompile Function: ") + llvm::Twine(F->getName()));
+
+    auto Stats = initStatistics(Report, *F);
+
+    std::string CacheKey;
+    if (DiskCache) {
+      CacheKey = DiskCache->computeKey(Cache, *F, StackTypes);
+      if (auto CCode = DiskCache->lookup(CacheKey)) {
+        if (Stats) {
+          Stats->Cached = true;
+          Stats->EmittedBytes = CCode->size();
+          Report->add(std::move(*Stats));
+        }
+        DecompiledFunctions.insert_or_assign(getEntry(*F), std::move(*CCode));
+        continue;
+      }
+    }
+
     llvm::Task T2(3,
                   llvm::Twine("decompile Function: ")
-                    + llvm::Twine(F.getName()));
+                    + llvm::Twine(F->getName()));
 
     // TODO: this will eventually become a GHASTContainer for revng pipeline
     ASTTree GHAST;
 
     // Generate the GHAST and beautify it.
-    {
-      T2.advance("restructureCFG");
-      restructureCFG(F, GHAST);
-      // TODO: beautification should be optional, but at the moment it's not
-      // truly so (if disabled, things crash). We should strive to make it
-      // optional for real.
-      T2.advance("beautifyAST");
-      beautifyAST(Model, F, GHAST);
-    }
+    buildGHAST(Model, *F, GHAST, T2, Stats ? &*Stats : nullptr);
 
+    // Generated C code for F
     T2.advance("decompileFunction");
-    if (Log.isEnabled()) {
-      GHAST.dumpASTOnFile(F.getName().str(),
-                          "ast-backend",
-                          "AST-during-c-codegen.dot");
+    std::string CCode;
+    measureStage(Stats ? &Stats->EmitCCode : nullptr,
+                 /* MeasureMemory */ true,
+                 [&]() {
+                   CCode = emitCCode(Cache, *F, GHAST, Model, StackTypes);
+                 });
+    if (DiskCache)
+      DiskCache->store(CacheKey, CCode);
+
+    if (Stats) {
+      Stats->EmittedBytes = CCode.size();
+      Report->add(std::move(*Stats));
     }
 
-    // Generated C code for F
-    auto VariablesToDeclare = computeVariableDeclarationScope(F, GHAST);
-    auto NeedsLoopStateVar = hasLoopDispatchers(GHAST);
-    std::string CCode = decompileFunction(Cache,
-                                          F,
-                                          GHAST,
-                                          Model,
-                                          VariablesToDeclare,
-                                          NeedsLoopStateVar,
-                                          StackTypes);
-
     // Push the C code into
-    MetaAddress Key = getMetaAddressMetadata(&F, "revng.function.entry");
-    DecompiledFunctions.insert_or_assign(Key, std::move(CCode));
+    DecompiledFunctions.insert_or_assign(getEntry(*F), std::move(CCode));
   }
 }
+
+/// Decompile functions using \a NumThreads worker threads.
+///
+/// Restructuring and beautification mutate the IR and rely on global state, so
+/// they still run on the calling thread. The GHASTs of a batch of functions are
+/// then handed to a thread pool, which emits their C code concurrently. Results
+/// are inserted into \a DecompiledFunctions from the calling thread, in the
+/// same order as the serial version, so the output is identical.
+static void decompileInParallel(unsigned NumThreads,
+                                FunctionMetadataCache &Cache,
+                                const std::vector<llvm::Function *> &Functions,
+                                const model::Binary &Model,
+                                const InlineableTypesMap &StackTypes,
+                                const DecompileCache *DiskCache,
+                                DecompileStatisticsReport *Report,
+                                Container &DecompiledFunctions) {
+  struct PendingFunction {
+    const llvm::Function *F = nullptr;
+    std::unique_ptr<ASTTree> GHAST;
+    std::string CacheKey;
+    std::optional<FunctionStatistics> Stats;
+    std::string CCode;
+  };
+
+  // Bound the number of GHASTs alive at the same time, while still giving
+  // each worker more than one function per batch to balance the load.
+  const size_t BatchSize = NumThreads * 8;
+  std::vector<PendingFunction> Batch;
+  Batch.reserve(BatchSize);
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(NumThreads));
+
+  const auto EmitBatch = [&]() {
+    llvm::Task T(1, "decompileFunction");
+    T.advance(llvm::Twine("emit ") + llvm::Twine(Batch.size())
+              + llvm::Twine(" functions"));
+
+    for (PendingFunction &Pending : Batch) {
+      Pool.async([&Pending, &Model, &StackTypes]() {
+        // FunctionMetadataCache is not thread-safe. Its entries are indexed by
+        // the function being decompiled, so a per-function cache is as
+        // effective as a shared one.
+        FunctionMetadataCache Cache;
+        // The other workers are emitting other functions in the meantime, so
+        // the memory usage of the process says nothing about this one
+        auto *Stage = Pending.Stats ? &Pending.Stats->EmitCCode : nullptr;
+        measureStage(Stage, /* MeasureMemory */ false, [&]() {
+          Pending.CCode = emitCCode(Cache,
+                                    *Pending.F,
+                                    *Pending.GHAST,
+                                    Model,
+                                    StackTypes);
+        });
+      });
+    }
+    Pool.wait();
+
+    for (PendingFunction &Pending : Batch) {
+      if (DiskCache)
+        DiskCache->store(Pending.CacheKey, Pending.CCode);
+      if (Pending.Stats) {
+        Pending.Stats->EmittedBytes = Pending.CCode.size();
+        Report->add(std::move(*Pending.Stats));
+      }
+      DecompiledFunctions.insert_or_assign(getEntry(*Pending.F),
+                                           std::move(Pending.CCode));
+    }
+    Batch.clear();
+  };
+
+  auto T = llvm::make_task_on_set(Functions, "decompile");
+
+  for (llvm::Function *F : Functions) {
+    T.advance(F,
+              llvm::Twine("decompile Function: ") + llvm::Twine(F->getName()));
+
+    auto Stats = initStatistics(Report, *F);
+
+    std::string CacheKey;
+    if (DiskCache) {
+      CacheKey = DiskCache->computeKey(Cache, *F, StackTypes);
+      if (auto CCode = DiskCache->lookup(CacheKey)) {
+        if (Stats) {
+          Stats->Cached = true;
+          Stats->EmittedBytes = CCode->size();
+          Report->add(std::move(*Stats));
+        }
+        DecompiledFunctions.insert_or_assign(getEntry(*F), std::move(*CCode));
+        continue;
+      }
+    }
+
+    llvm::Task T2(2,
+                  llvm::Twine("decompile Function: ")
+                    + llvm::Twine(F->getName()));
+
+    auto GHAST = std::make_unique<ASTTree>();
+    buildGHAST(Model, *F, *GHAST, T2, Stats ? &*Stats : nullptr);
+    Batch.push_back({ F,
+                      std::move(GHAST),
+                      std::move(CacheKey),
+                      std::move(Stats),
+                      {} });
+
+    if (Batch.size() >= BatchSize)
+      EmitBatch();
+  }
+
+  if (not Batch.empty())
+    EmitBatch();
+}
+
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &Module,
+               const model::Binary &Model,
+               const std::set<MetaAddress> &Targets,
+               Container &DecompiledFunctions) {
+  // Select the functions to decompile before doing anything else, so that the
+  // cost of decompiling a few functions does not depend on the size of the
+  // binary.
+  std::vector<llvm::Function *> Functions = selectFunctionsToDecompile(Module,
+                                                                       Targets);
+  if (Functions.empty())
+    return;
+
+  // The type inlining analysis only depends on the model, share it with the
+  // other pipes working on the same version of it.
+  auto TheTypeInlineHelper = TypeInlineHelper::get(Model);
+
+  // Get all Stack types and all the inlinable types reachable from it,
+  // since we want to emit forward declarations for all of them.
+  InlineableTypesMap StackTypes;
+  if (Targets.empty())
+    StackTypes = TheTypeInlineHelper->findStackTypesPerFunction(Model);
+  else
+    StackTypes = TheTypeInlineHelper->findStackTypesPerFunction(Model, Targets);
+
+  // Loggers are not thread-safe: if any of them is enabled stick to the serial
+  // version to keep the logs readable.
+  unsigned NumThreads = llvm::hardware_concurrency(DecompileThreads)
+                          .compute_thread_count();
+  if (Log.isEnabled() or VisitLog.isEnabled())
+    NumThreads = 1;
+
+  std::optional<DecompileCache> DiskCache;
+  if (not DecompileCacheDir.empty())
+    DiskCache.emplace(DecompileCacheDir, Model, describeOutputOptions());
+  const DecompileCache *DiskCachePtr = DiskCache ? &*DiskCache : nullptr;
+
+  std::optional<DecompileStatisticsReport> Report;
+  if (not StatisticsOutputPath.empty())
+    Report.emplace();
+  DecompileStatisticsReport *ReportPtr = Report ? &*Report : nullptr;
+
+  if (NumThreads <= 1)
+    decompileSerially(Cache,
+                      Functions,
+                      Model,
+                      StackTypes,
+                      DiskCachePtr,
+                      ReportPtr,
+                      DecompiledFunctions);
+  else
+    decompileInParallel(NumThreads,
+                        Cache,
+                        Functions,
+                        Model,
+                        StackTypes,
+                        DiskCachePtr,
+                        ReportPtr,
+                        DecompiledFunctions);
+
+  if (Report)
+    Report->write(StatisticsOutputPath);
+}
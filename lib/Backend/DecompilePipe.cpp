@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipes/Kinds.h"
@@ -21,10 +23,22 @@ void Decompile::run(const pipeline::ExecutionContext &Ctx,
                     pipeline::LLVMContainer &IRContainer,
                     DecompileStringMap &DecompiledFunctions) {
 
+  // The pipeline only hands us the functions required to produce the
+  // requested targets: restrict the decompilation to them.
+  std::set<MetaAddress> Targets;
+  for (const pipeline::Target &Target : IRContainer.enumerate())
+    if (&Target.getKind() == &kinds::StackAccessesSegregated)
+      Targets.insert(DecompileStringMap::keyFromString(Target
+                                                         .getPathComponents()
+                                                         .front()));
+
+  if (Targets.empty())
+    return;
+
   llvm::Module &Module = IRContainer.getModule();
   const model::Binary &Model = *getModelFromContext(Ctx);
   FunctionMetadataCache Cache;
-  decompile(Cache, Module, Model, DecompiledFunctions);
+  decompile(Cache, Module, Model, Targets, DecompiledFunctions);
 }
 
 void Decompile::print(const pipeline::Context &Ctx,
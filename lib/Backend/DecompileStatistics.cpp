@@ -0,0 +1,84 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "DecompileStatistics.h"
+
+static void writeStage(llvm::raw_ostream &Out, const StageStatistics &Stage) {
+  Out << "," << llvm::format("%.6f", Stage.Seconds);
+  if (Stage.Memory)
+    Out << "," << Stage.Memory->HeapDelta << "," << Stage.Memory->HeapAfter
+        << "," << Stage.Memory->PeakGrowth;
+  else
+    Out << ",,,";
+}
+
+/// Writes \a Field as a CSV field, quoted and with the quotes in it doubled
+static void writeQuoted(llvm::raw_ostream &Out, llvm::StringRef Field) {
+  Out << '"';
+  for (char C : Field) {
+    if (C == '"')
+      Out << '"';
+    Out << C;
+  }
+  Out << '"';
+}
+
+static void writeRestructuring(llvm::raw_ostream &Out,
+                               const RestructureMetrics &Metrics) {
+  Out << "," << Metrics.MetaRegions << "," << Metrics.EntryDispatchers << ","
+      << Metrics.ExitDispatchers << "," << Metrics.DuplicatedNodes << ","
+      << Metrics.DuplicatedWeight << "," << Metrics.UntangleTentative << ","
+      << Metrics.UntanglePerformed << "," << Metrics.GotoRegions << ","
+      << Metrics.InitialNodes << "," << Metrics.FinalNodes << ","
+      << Metrics.InitialWeight << "," << Metrics.FinalWeight << ","
+      << Metrics.ShortCircuits << "," << Metrics.TrivialShortCircuits;
+  for (double Seconds : { Metrics.MetaRegionsSeconds,
+                          Metrics.CollapseSeconds,
+                          Metrics.GenerateASTSeconds,
+                          Metrics.NormalizeSeconds })
+    Out << "," << llvm::format("%.6f", Seconds);
+}
+
+void DecompileStatisticsReport::write(llvm::StringRef Path) const {
+  std::error_code Error;
+  llvm::raw_fd_ostream Out(Path, Error, llvm::sys::fs::OF_Text);
+  if (Error)
+    revng_abort(Error.message().c_str());
+
+  Out << "entry,name,basic_blocks,instructions,ghast_nodes,emitted_bytes,"
+         "cached";
+  for (llvm::StringRef Stage : { "restructure_cfg", "beautify_ast", "emit" })
+    Out << "," << Stage << "_seconds," << Stage << "_heap_delta," << Stage
+        << "_heap_after," << Stage << "_peak_rss_growth";
+  Out << ",metaregions,entry_dispatchers,exit_dispatchers,duplicated_nodes,"
+         "duplicated_weight,untangle_tentative,untangle_performed,"
+         "goto_regions,initial_regioncfg_nodes,final_regioncfg_nodes,"
+         "initial_weight,final_weight,short_circuits,"
+         "trivial_short_circuits,metaregions_seconds,collapse_seconds,"
+         "generate_ast_seconds,normalize_seconds";
+  Out << "\n";
+
+  for (const FunctionStatistics &Function : Functions) {
+    Out << Function.Entry.toString() << ",";
+    writeQuoted(Out, Function.Name);
+    Out << "," << Function.BasicBlocks << "," << Function.Instructions << ","
+        << Function.GHASTNodes << "," << Function.EmittedBytes << ","
+        << (Function.Cached ? "1" : "0");
+    writeStage(Out, Function.RestructureCFG);
+    writeStage(Out, Function.BeautifyAST);
+    writeStage(Out, Function.EmitCCode);
+    writeRestructuring(Out, Function.Restructuring);
+    Out << "\n";
+  }
+
+  Out.flush();
+  if (Out.has_error())
+    revng_abort(Out.error().message().c_str());
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Process.h"
+
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/RestructureCFG/RestructureCFG.h"
+
+/// Wall time and memory usage of a single stage of the decompilation of a
+/// function.
+struct StageStatistics {
+  /// Process-wide memory usage, sampled before and after the stage
+  struct MemoryStatistics {
+    /// Change of the heap usage. It does not account for memory that is freed
+    /// before the stage ends.
+    int64_t HeapDelta = 0;
+    uint64_t HeapAfter = 0;
+
+    /// Growth of the peak resident set size of the process, which accounts
+    /// for the memory freed before the stage ends, but only if it sets a new
+    /// peak
+    uint64_t PeakGrowth = 0;
+  };
+
+  double Seconds = 0;
+
+  /// Only set if no other function was being decompiled during the stage,
+  /// since the memory usage is sampled process-wide
+  std::optional<MemoryStatistics> Memory;
+};
+
+/// Returns the peak resident set size of the process, in bytes
+inline uint64_t getPeakResidentSetSize() {
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) != 0)
+    return 0;
+  // On Linux ru_maxrss is in kilobytes
+  return static_cast<uint64_t>(Usage.ru_maxrss) * 1024;
+}
+
+/// Run \a Callable and record its statistics in \a Stage, if not null. The
+/// memory usage is recorded only if \a MeasureMemory.
+template<typename CallableT>
+void measureStage(StageStatistics *Stage,
+                  bool MeasureMemory,
+                  CallableT &&Callable) {
+  if (Stage == nullptr) {
+    Callable();
+    return;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  uint64_t HeapBefore = 0;
+  uint64_t PeakBefore = 0;
+  if (MeasureMemory) {
+    HeapBefore = llvm::sys::Process::GetMallocUsage();
+    PeakBefore = getPeakResidentSetSize();
+  }
+  auto Start = Clock::now();
+
+  Callable();
+
+  std::chrono::duration<double> Elapsed = Clock::now() - Start;
+  Stage->Seconds = Elapsed.count();
+  if (MeasureMemory) {
+    uint64_t HeapAfter = llvm::sys::Process::GetMallocUsage();
+    Stage->Memory = StageStatistics::MemoryStatistics{
+      .HeapDelta = static_cast<int64_t>(HeapAfter)
+                   - static_cast<int64_t>(HeapBefore),
+      .HeapAfter = HeapAfter,
+      .PeakGrowth = getPeakResidentSetSize() - PeakBefore
+    };
+  }
+}
+
+/// Statistics about the decompilation of a single function
+struct FunctionStatistics {
+  MetaAddress Entry;
+  std::string Name;
+  uint64_t BasicBlocks = 0;
+  uint64_t Instructions = 0;
+  uint64_t GHASTNodes = 0;
+  uint64_t EmittedBytes = 0;
+  bool Cached = false;
+
+  StageStatistics RestructureCFG;
+  StageStatistics BeautifyAST;
+  StageStatistics EmitCCode;
+
+  RestructureMetrics Restructuring;
+};
+
+/// Collects FunctionStatistics and writes them out as a CSV file, one row per
+/// function. This is the consolidated report of a run: it also includes the
+/// metrics of the restructuring.
+class DecompileStatisticsReport {
+private:
+  std::vector<FunctionStatistics> Functions;
+
+public:
+  void add(FunctionStatistics &&Statistics) {
+    Functions.push_back(std::move(Statistics));
+  }
+
+  void write(llvm::StringRef Path) const;
+};
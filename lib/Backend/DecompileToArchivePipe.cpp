@@ -0,0 +1,47 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/RegisterContainerFactory.h"
+#include "revng/Pipes/FileContainer.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Backend/DecompileToArchivePipe.h"
+#include "revng-c/Backend/DecompiledFunctionArchive.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+static pipeline::RegisterDefaultConstructibleContainer<
+  DecompiledArchiveContainer>
+  Reg;
+
+void DecompileToArchive::run(const pipeline::ExecutionContext &Ctx,
+                             const DecompileStringMap &DecompiledFunctions,
+                             DecompiledArchiveContainer &OutArchive) {
+  std::error_code EC;
+  llvm::raw_fd_ostream Out(OutArchive.getOrCreatePath(), EC);
+  if (EC)
+    revng_abort(EC.message().c_str());
+
+  writeDecompiledFunctionArchive(Out,
+                                 DecompiledFunctions,
+                                 /* Compress */ true);
+
+  Out.flush();
+  EC = Out.error();
+  if (EC)
+    revng_abort(EC.message().c_str());
+}
+
+void DecompileToArchive::print(const pipeline::Context &Ctx,
+                               llvm::raw_ostream &OS,
+                               llvm::ArrayRef<std::string> Names) const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
+} // end namespace revng::pipes
+
+static pipeline::RegisterPipe<revng::pipes::DecompileToArchive> Y;
@@ -17,6 +17,8 @@ void printSingleCFile(llvm::raw_ostream &Out,
   Out << B.getIncludeQuote("types-and-globals.h")
       << B.getIncludeQuote("helpers.h") << "\n";
 
+  // Function bodies are written straight from the map to Out, without
+  // building any intermediate string.
   if (Targets.empty()) {
     // If Targets is empty print all the Functions' bodies
     for (const auto &[MetaAddress, CFunction] : Functions)
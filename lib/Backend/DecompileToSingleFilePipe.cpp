@@ -6,6 +6,7 @@
 #include "revng/Pipeline/RegisterContainerFactory.h"
 #include "revng/Pipes/FileContainer.h"
 #include "revng/Pipes/Kinds.h"
+#include "revng/Support/Assert.h"
 
 #include "revng-c/Backend/DecompileToSingleFile.h"
 #include "revng-c/Backend/DecompileToSingleFilePipe.h"
@@ -23,14 +24,24 @@ void DecompileToSingleFile::run(const pipeline::ExecutionContext &Ctx,
                                 const Container &DecompiledFunctions,
                                 DecompiledFileContainer &OutCFile) {
 
-  auto Out = OutCFile.asStream();
+  // Stream the C file straight to disk: the decompiled functions can be
+  // hundreds of MBs, and building the whole file in memory on top of
+  // DecompiledFunctions would double the peak memory usage.
+  std::error_code EC;
+  llvm::raw_fd_ostream Out(OutCFile.getOrCreatePath(), EC);
+  if (EC)
+    revng_abort(EC.message().c_str());
 
   ptml::PTMLCBuilder B;
 
   // Make a single C file with an empty set of targets, which means all the
   // functions in DecompiledFunctions
   printSingleCFile(Out, B, DecompiledFunctions, {} /* Targets */);
+
   Out.flush();
+  EC = Out.error();
+  if (EC)
+    revng_abort(EC.message().c_str());
 }
 
 void DecompileToSingleFile::print(const pipeline::Context &Ctx,
@@ -0,0 +1,218 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Compression.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Backend/DecompiledFunctionArchive.h"
+
+using namespace decompiled_archive;
+
+template<typename T>
+static void writeStruct(llvm::raw_ostream &OS, const T &Value) {
+  OS.write(reinterpret_cast<const char *>(&Value), sizeof(T));
+}
+
+void writeDecompiledFunctionArchive(llvm::raw_ostream &OS,
+                                    const revng::pipes::DecompileStringMap
+                                      &Functions,
+                                    bool Compress) {
+  namespace zlib = llvm::compression::zlib;
+  Compress = Compress and zlib::isAvailable();
+
+  // Compressed sizes are needed to emit the index, so compress everything
+  // upfront. Functions are iterated in MetaAddress order, which is the order
+  // the index has to be sorted by.
+  std::string StringTable;
+  std::vector<llvm::SmallVector<uint8_t, 0>> CompressedBodies;
+  std::vector<IndexEntry> Index;
+  for (const auto &[Entry, CCode] : Functions) {
+    IndexEntry NewEntry;
+    std::string Key = Entry.toString();
+    NewEntry.KeyOffset = StringTable.size();
+    NewEntry.KeySize = Key.size();
+    StringTable += Key;
+
+    NewEntry.RawSize = CCode.size();
+    if (Compress) {
+      zlib::compress(llvm::arrayRefFromStringRef(CCode),
+                     CompressedBodies.emplace_back());
+      NewEntry.BodySize = CompressedBodies.back().size();
+    } else {
+      NewEntry.BodySize = CCode.size();
+    }
+    Index.push_back(NewEntry);
+  }
+
+  // Now that all the sizes are known, lay out the bodies
+  uint64_t Offset = sizeof(Header) + Index.size() * sizeof(IndexEntry)
+                    + StringTable.size();
+  for (IndexEntry &Entry : Index) {
+    Entry.KeyOffset += sizeof(Header) + Index.size() * sizeof(IndexEntry);
+    Entry.BodyOffset = Offset;
+    Offset += Entry.BodySize;
+  }
+
+  Header TheHeader;
+  std::memcpy(TheHeader.Magic, Magic, sizeof(Magic));
+  TheHeader.Version = Version;
+  TheHeader.Flags = Compress ? Flags::Compressed : Flags::None;
+  TheHeader.EntryCount = Index.size();
+  TheHeader.Reserved = 0;
+
+  writeStruct(OS, TheHeader);
+  for (const IndexEntry &Entry : Index)
+    writeStruct(OS, Entry);
+  OS << StringTable;
+
+  if (Compress) {
+    for (const auto &Body : CompressedBodies)
+      OS << llvm::toStringRef(Body);
+  } else {
+    for (const auto &[Entry, CCode] : Functions)
+      OS << CCode;
+  }
+}
+
+using MemoryBufferPtr = std::unique_ptr<llvm::MemoryBuffer>;
+
+/// zlib cannot compress more than this, so a larger ratio between the size
+/// of a body and its compressed size means the archive is corrupt
+static constexpr uint64_t MaxCompressionRatio = 1032;
+
+DecompiledFunctionArchive::DecompiledFunctionArchive(MemoryBufferPtr Buffer) :
+  Buffer(std::move(Buffer)) {
+  const char *Start = this->Buffer->getBufferStart();
+  TheHeader = reinterpret_cast<const Header *>(Start);
+  Index = reinterpret_cast<const IndexEntry *>(Start + sizeof(Header));
+}
+
+static llvm::Error createError(const llvm::Twine &Message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Invalid decompiled function archive: "
+                                   + Message.str());
+}
+
+llvm::Expected<DecompiledFunctionArchive>
+DecompiledFunctionArchive::create(MemoryBufferPtr Buffer) {
+  llvm::StringRef Data = Buffer->getBuffer();
+  if (Data.size() < sizeof(Header))
+    return createError("truncated header");
+
+  const auto *TheHeader = reinterpret_cast<const Header *>(Data.data());
+  if (std::memcmp(TheHeader->Magic, Magic, sizeof(Magic)) != 0)
+    return createError("bad magic");
+
+  if (TheHeader->Version != Version)
+    return createError("unsupported version "
+                       + llvm::Twine(uint32_t(TheHeader->Version)));
+
+  if ((TheHeader->Flags & Flags::Compressed)
+      and not llvm::compression::zlib::isAvailable())
+    return createError("compressed, but zlib is not available");
+
+  uint64_t EntryCount = TheHeader->EntryCount;
+  uint64_t IndexEnd = sizeof(Header) + EntryCount * sizeof(IndexEntry);
+  if (EntryCount > Data.size() / sizeof(IndexEntry) or IndexEnd > Data.size())
+    return createError("truncated index");
+
+  // Make sure every lookup will stay within the buffer, and that it will not
+  // allocate more memory than the body can possibly decompress to
+  bool IsCompressed = TheHeader->Flags & Flags::Compressed;
+  const auto *Index = reinterpret_cast<const IndexEntry *>(Data.data()
+                                                           + sizeof(Header));
+  for (uint64_t I = 0; I < EntryCount; ++I) {
+    const IndexEntry &Entry = Index[I];
+    if (Entry.KeyOffset + uint64_t(Entry.KeySize) > Data.size()
+        or Entry.BodyOffset > Data.size()
+        or Entry.BodySize > Data.size() - Entry.BodyOffset)
+      return createError("entry " + llvm::Twine(I) + " is out of bounds");
+
+    uint64_t MaxRawSize = Entry.BodySize * MaxCompressionRatio;
+    bool ValidRawSize = IsCompressed ? Entry.RawSize <= MaxRawSize :
+                                       Entry.RawSize == Entry.BodySize;
+    if (not ValidRawSize)
+      return createError("entry " + llvm::Twine(I)
+                         + " has an invalid uncompressed size");
+  }
+
+  return DecompiledFunctionArchive(std::move(Buffer));
+}
+
+llvm::Expected<DecompiledFunctionArchive>
+DecompiledFunctionArchive::open(llvm::StringRef Path) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path,
+                                                 /* IsText */ false,
+                                                 /* RequiresNullTerminator */
+                                                 false);
+  if (not MaybeBuffer)
+    return llvm::errorCodeToError(MaybeBuffer.getError());
+
+  return create(std::move(*MaybeBuffer));
+}
+
+uint64_t DecompiledFunctionArchive::size() const {
+  return TheHeader->EntryCount;
+}
+
+MetaAddress DecompiledFunctionArchive::getKey(uint64_t I) const {
+  revng_assert(I < size());
+  const IndexEntry &Entry = Index[I];
+  llvm::StringRef Key(Buffer->getBufferStart() + Entry.KeyOffset,
+                      Entry.KeySize);
+  return MetaAddress::fromString(Key);
+}
+
+llvm::Expected<std::string>
+DecompiledFunctionArchive::getBody(const IndexEntry &Entry) const {
+  llvm::StringRef Body(Buffer->getBufferStart() + Entry.BodyOffset,
+                       Entry.BodySize);
+  if (not(TheHeader->Flags & Flags::Compressed))
+    return Body.str();
+
+  namespace zlib = llvm::compression::zlib;
+  llvm::SmallVector<uint8_t, 0> Decompressed;
+  auto Input = llvm::arrayRefFromStringRef(Body);
+  if (llvm::Error Error = zlib::decompress(Input, Decompressed, Entry.RawSize))
+    return createError("cannot decompress body: "
+                       + llvm::toString(std::move(Error)));
+
+  if (Decompressed.size() != Entry.RawSize)
+    return createError("body decompresses to "
+                       + llvm::Twine(Decompressed.size()) + " bytes instead of "
+                       + llvm::Twine(Entry.RawSize));
+
+  return llvm::toStringRef(Decompressed).str();
+}
+
+llvm::Expected<std::optional<std::string>>
+DecompiledFunctionArchive::lookup(const MetaAddress &Entry) const {
+  // The index is sorted by MetaAddress: binary search it
+  uint64_t Low = 0;
+  uint64_t High = size();
+  while (Low < High) {
+    uint64_t Middle = Low + (High - Low) / 2;
+    MetaAddress Key = getKey(Middle);
+    if (Key == Entry) {
+      auto MaybeBody = getBody(Index[Middle]);
+      if (not MaybeBody)
+        return MaybeBody.takeError();
+      return std::optional<std::string>(std::move(*MaybeBody));
+    }
+
+    if (Key < Entry)
+      Low = Middle + 1;
+    else
+      High = Middle;
+  }
+
+  return std::nullopt;
+}
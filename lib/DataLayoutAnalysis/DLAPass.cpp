@@ -54,56 +54,7 @@ bool DLAPass::runOnModule(llvm::Module &M) {
   // Middle-end Steps: manipulate nodes and edges of the DLATypeSystem graph
   T.advance("DLA Middleend");
   dla::StepManager SM;
-  size_t PtrSize = getPointerSize(Model.Architecture());
-
-  //
-  // Graph normalization phase
-  //
-  revng_check(SM.addStep<dla::RemoveInvalidPointers>(PtrSize));
-  revng_check(SM.addStep<dla::CollapseEqualitySCC>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::DecomposeStridedEdges>());
-
-  //
-  // Graph optimization phase
-  //
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::MergePointeesOfPointerUnion>(PtrSize));
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run before
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // produce better results
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ArrangeAccessesHierarchically>());
-  revng_check(SM.addStep<dla::CompactCompatibleArrays>());
-  revng_check(SM.addStep<dla::PushDownPointers>());
-  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
-  // so we want to run MergePointerNodes again afterwards.
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run again after
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // improve the results even further.
-  revng_check(SM.addStep<dla::ResolveLeafUnions>());
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ComputeNonInterferingComponents>());
+  dla::scheduleMiddleEndSteps(SM, getPointerSize(Model.Architecture()));
   SM.run(TS);
 
   // Compress the equivalence classes obtained after graph manipulation
@@ -3,9 +3,12 @@
 //
 
 #include <algorithm>
+#include <limits>
+#include <optional>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
@@ -51,6 +54,16 @@ void OffsetExpression::print(llvm::raw_ostream &OS) const {
   }
 }
 
+size_t TypeLinkTag::computeHash(LinkKind K, const OffsetExpression &O) {
+  hash_code Result = hash_combine(K,
+                                  O.Offset,
+                                  hash_combine_range(O.Strides.begin(),
+                                                     O.Strides.end()));
+  for (const std::optional<uint64_t> &TripCount : O.TripCounts)
+    Result = hash_combine(Result, TripCount.has_value(), TripCount.value_or(0));
+  return Result;
+}
+
 void LayoutTypePtr::print(raw_ostream &Out) const {
   Out << '{';
   Out << "0x";
@@ -212,8 +225,39 @@ LayoutTypeSystemNode *LayoutTypeSystem::createArtificialLayoutType() {
   revng_assert(New);
   ++NID;
   EqClasses.growBy1();
-  bool Success = Layouts.insert(New).second;
-  revng_assert(Success);
+  revng_assert(Layouts.size() == New->ID);
+  Layouts.push_back(New);
+  ++NumLayouts;
+  markChanged(New);
+  return New;
+}
+
+SmallVector<LayoutTypeSystemNode *, 0>
+LayoutTypeSystem::getChangedSince(ChangeCheckpoint Checkpoint) const {
+  revng_assert(TrackChanges and Checkpoint <= ChangeLog.size());
+  SmallVector<uint64_t, 0> IDs(std::next(ChangeLog.begin(), Checkpoint),
+                               ChangeLog.end());
+  llvm::sort(IDs);
+  IDs.erase(std::unique(IDs.begin(), IDs.end()), IDs.end());
+
+  SmallVector<LayoutTypeSystemNode *, 0> Result;
+  for (uint64_t ID : IDs)
+    if (Layouts[ID])
+      Result.push_back(Layouts[ID]);
+  return Result;
+}
+
+const TypeLinkTag *LayoutTypeSystem::internTag(TypeLinkTag &&Tag) {
+  revng_assert(Tag.ID == 0);
+  auto It = LinkTags.find(&Tag);
+  if (It != LinkTags.end())
+    return *It;
+
+  revng_assert(LinkTags.size() < std::numeric_limits<uint32_t>::max());
+  auto *New = new (TagAllocator.Allocate<TypeLinkTag>())
+    TypeLinkTag(std::move(Tag));
+  New->ID = LinkTags.size() + 1;
+  LinkTags.insert(New);
   return New;
 }
 
@@ -233,37 +277,27 @@ static void fixPredSucc(LayoutTypeSystemNode *From,
   uint64_t FromID = From->ID;
   using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
 
+  // Replaces all the links to From in Neighbors with links to Into. Inserting
+  // invalidates the iterators, so all the links are erased first.
+  const auto ReplaceFrom = [FromID, Into](auto &Neighbors) {
+    auto It = Neighbors.lower_bound(IDBasedKey{ FromID, nullptr });
+    auto End = Neighbors.upper_bound(IDBasedKey{ FromID + 1, nullptr });
+    SmallVector<const TypeLinkTag *, 4> Tags;
+    for (; It != End; It = Neighbors.erase(It))
+      Tags.push_back(It->second);
+    for (const TypeLinkTag *Tag : Tags)
+      Neighbors.insert({ Into, Tag });
+  };
+
   // All the predecessors of all the successors of From are updated so that they
   // point to Into
-  for (auto &[Successor, Tag] : From->Successors) {
-    auto It = Successor->Predecessors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Successor->Predecessors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Successor->Predecessors.extract(It);
-      revng_assert(Extracted);
-      Successor->Predecessors.insert({ Into, Extracted.value().second });
-      It = Next;
-    }
-  }
+  for (auto &[Successor, Tag] : From->Successors)
+    ReplaceFrom(Successor->Predecessors);
 
   // All the successors of all the predecessors of From are updated so that they
   // point to Into
-  for (auto &[Predecessor, Tag] : From->Predecessors) {
-    auto It = Predecessor->Successors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Predecessor->Successors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Predecessor->Successors.extract(It);
-      revng_assert(Extracted);
-      Predecessor->Successors.insert({ Into, Extracted.value().second });
-      It = Next;
-    }
-  }
+  for (auto &[Predecessor, Tag] : From->Predecessors)
+    ReplaceFrom(Predecessor->Successors);
 
   // Merge all the predecessors and successors.
   {
@@ -322,13 +356,16 @@ void LayoutTypeSystem::mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *>
 
     EqClasses.join(IntoID, From->ID);
 
+    markChanged(Into);
+    for (const auto &[Neighbor, Tag] : From->Successors)
+      markChanged(Neighbor);
+    for (const auto &[Neighbor, Tag] : From->Predecessors)
+      markChanged(Neighbor);
+
     fixPredSucc(From, Into);
 
-    // Remove From from Layouts
-    bool Erased = Layouts.erase(From);
-    revng_assert(Erased);
-    From->~LayoutTypeSystemNode();
-    NodeAllocator.Deallocate(From);
+    eraseLayout(From);
+    ++NumMergedNodes;
   }
 }
 
@@ -341,6 +378,7 @@ void LayoutTypeSystem::removeNode(LayoutTypeSystemNode *ToRemove) {
   using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
 
   for (auto &[Neighbor, Tag] : ToRemove->Successors) {
+    markChanged(Neighbor);
     auto &PredOfSucc = Neighbor->Predecessors;
     auto It = PredOfSucc.lower_bound(IDBasedKey{ TheID, nullptr });
     auto End = PredOfSucc.upper_bound(IDBasedKey{ TheID + 1, nullptr });
@@ -348,16 +386,15 @@ void LayoutTypeSystem::removeNode(LayoutTypeSystemNode *ToRemove) {
   }
 
   for (auto &[Neighbor, Tag] : ToRemove->Predecessors) {
+    markChanged(Neighbor);
     auto &SuccOfPred = Neighbor->Successors;
     auto It = SuccOfPred.lower_bound(IDBasedKey{ TheID, nullptr });
     auto End = SuccOfPred.upper_bound(IDBasedKey{ TheID + 1, nullptr });
     SuccOfPred.erase(It, End);
   }
 
-  bool Erased = Layouts.erase(ToRemove);
-  revng_assert(Erased);
-  ToRemove->~LayoutTypeSystemNode();
-  NodeAllocator.Deallocate(ToRemove);
+  eraseLayout(ToRemove);
+  ++NumRemovedNodes;
 }
 
 using NeighborIterator = LayoutTypeSystem::NeighborIterator;
@@ -368,15 +405,14 @@ static void moveEdgeTargetWithoutSumming(LayoutTypeSystemNode *OldTgt,
 
   // First, move the successor from OldTgt to NewTgt
   LayoutTypeSystemNode *Src = InverseEdgeIt->first;
-  auto SuccHandle = Src->Successors.extract({ OldTgt, InverseEdgeIt->second });
-  revng_assert(not SuccHandle.empty());
-  SuccHandle.value().first = NewTgt;
-  Src->Successors.insert(std::move(SuccHandle));
+  const TypeLinkTag *Tag = InverseEdgeIt->second;
+  bool Erased = Src->Successors.erase({ OldTgt, Tag });
+  revng_assert(Erased);
+  Src->Successors.insert({ NewTgt, Tag });
 
   // Then, move the predecessor edge from OldTgt to NewTgt
-  auto PredHandle = OldTgt->Predecessors.extract(InverseEdgeIt);
-  revng_assert(not PredHandle.empty());
-  NewTgt->Predecessors.insert(std::move(PredHandle));
+  OldTgt->Predecessors.erase(InverseEdgeIt);
+  NewTgt->Predecessors.insert({ Src, Tag });
 }
 
 static void moveEdgeSourceWithoutSumming(LayoutTypeSystemNode *OldSrc,
@@ -384,15 +420,14 @@ static void moveEdgeSourceWithoutSumming(LayoutTypeSystemNode *OldSrc,
                                          NeighborIterator EdgeIt) {
   // First, move the predecessor edge from OldSrc to NewSrc.
   LayoutTypeSystemNode *Tgt = EdgeIt->first;
-  auto PredHandle = Tgt->Predecessors.extract({ OldSrc, EdgeIt->second });
-  revng_assert(not PredHandle.empty());
-  PredHandle.value().first = NewSrc;
-  Tgt->Predecessors.insert(std::move(PredHandle));
+  const TypeLinkTag *Tag = EdgeIt->second;
+  bool Erased = Tgt->Predecessors.erase({ OldSrc, Tag });
+  revng_assert(Erased);
+  Tgt->Predecessors.insert({ NewSrc, Tag });
 
   // Then, move the successor edge from OldSrc to NewSrc
-  auto SuccHandle = OldSrc->Successors.extract(EdgeIt);
-  revng_assert(not SuccHandle.empty());
-  NewSrc->Successors.insert(std::move(SuccHandle));
+  OldSrc->Successors.erase(EdgeIt);
+  NewSrc->Successors.insert({ Tgt, Tag });
 }
 
 void LayoutTypeSystem::moveEdgeTarget(LayoutTypeSystemNode *OldTgt,
@@ -403,21 +438,24 @@ void LayoutTypeSystem::moveEdgeTarget(LayoutTypeSystemNode *OldTgt,
   if (not OldTgt or not NewTgt)
     return;
 
+  markChanged(InverseEdgeIt->first);
+  markChanged(OldTgt);
+  markChanged(NewTgt);
+
   if (not OffsetToSum)
     return moveEdgeTargetWithoutSumming(OldTgt, NewTgt, InverseEdgeIt);
 
   LayoutTypeSystemNode *Src = InverseEdgeIt->first;
+  const TypeLinkTag *EdgeTag = InverseEdgeIt->second;
 
   // Erase info in Src that represent the fact that OldTgt was a successor.
-  bool Erased = Src->Successors.erase({ OldTgt, InverseEdgeIt->second });
+  bool Erased = Src->Successors.erase({ OldTgt, EdgeTag });
   revng_assert(Erased);
 
-  // Extract the predecessor edge to be moved from OldTgt to NewTgt
-  auto OldPredHandle = OldTgt->Predecessors.extract(InverseEdgeIt);
-  revng_assert(not OldPredHandle.empty());
+  // Erase the predecessor edge to be moved from OldTgt to NewTgt
+  OldTgt->Predecessors.erase(InverseEdgeIt);
 
   // Add new instance links with adjusted offsets from Src to NewTgt.
-  const TypeLinkTag *EdgeTag = OldPredHandle.value().second;
   switch (EdgeTag->getKind()) {
 
   case TypeLinkTag::LK_Instance: {
@@ -441,21 +479,24 @@ void LayoutTypeSystem::moveEdgeSource(LayoutTypeSystemNode *OldSrc,
   if (not OldSrc or not NewSrc)
     return;
 
+  markChanged(EdgeIt->first);
+  markChanged(OldSrc);
+  markChanged(NewSrc);
+
   if (not OffsetToSum)
     return moveEdgeSourceWithoutSumming(OldSrc, NewSrc, EdgeIt);
 
   LayoutTypeSystemNode *Tgt = EdgeIt->first;
+  const TypeLinkTag *EdgeTag = EdgeIt->second;
 
   // Erase info in Tgt that represent the fact that OldSrc was a predecessor.
-  bool Erased = Tgt->Predecessors.erase({ OldSrc, EdgeIt->second });
+  bool Erased = Tgt->Predecessors.erase({ OldSrc, EdgeTag });
   revng_assert(Erased);
 
-  // Extract the successor edge to be moved from OldSrc to NewSrc
-  auto OldSuccHandle = OldSrc->Successors.extract(EdgeIt);
-  revng_assert(not OldSuccHandle.empty());
+  // Erase the successor edge to be moved from OldSrc to NewSrc
+  OldSrc->Successors.erase(EdgeIt);
 
   // Add new instance links with adjusted offsets from NewSrc to Tgt.
-  const TypeLinkTag *EdgeTag = OldSuccHandle.value().second;
   switch (EdgeTag->getKind()) {
 
   case TypeLinkTag::LK_Instance: {
@@ -474,6 +515,8 @@ void LayoutTypeSystem::moveEdgeSource(LayoutTypeSystemNode *OldSrc,
 NeighborIterator LayoutTypeSystem::eraseEdge(LayoutTypeSystemNode *Src,
                                              NeighborIterator EdgeIt) {
   LayoutTypeSystemNode *Tgt = EdgeIt->first;
+  markChanged(Src);
+  markChanged(Tgt);
 
   // Erase the inverse edge from Tgt to Src
   bool Erased = Tgt->Predecessors.erase({ Src, EdgeIt->second });
@@ -493,7 +536,7 @@ void LayoutTypeSystem::dropOutgoingEdges(LayoutTypeSystemNode *N) {
 static Logger<> VerifyDLALog("dla-verify-strict");
 
 bool LayoutTypeSystem::verifyConsistency() const {
-  for (LayoutTypeSystemNode *NodePtr : Layouts) {
+  for (LayoutTypeSystemNode *NodePtr : getLayoutsRange()) {
     if (not NodePtr) {
       if (VerifyDLALog.isEnabled())
         revng_check(false);
@@ -698,6 +698,12 @@ bool Builder::createIntraproceduralTypes(llvm::Module &M,
   bool Changed = false;
   InstanceLinkAdder ILA(Model, *Cache);
 
+  // Functions are processed one at a time, in module order. Processing them in
+  // parallel would need a ScalarEvolution for each function at the same time,
+  // but the legacy pass manager only hands out one at a time, and both
+  // ScalarEvolution and getAsInstruction create constants in the LLVMContext,
+  // which is not thread safe. Nodes for callee formals and prototypes are also
+  // shared among functions.
   for (Function &F : M.functions()) {
     auto FTags = FunctionTags::TagsSet::from(&F);
     if (F.isIntrinsic() or not FTags.contains(FunctionTags::Isolated))
@@ -801,8 +807,11 @@ bool Builder::createIntraproceduralTypes(llvm::Module &M,
           using PointerGraph = EdgeFilteredGraph<LayoutTypeSystemNode *,
                                                  isPointerEdge>;
           using InversePointerGraph = llvm::Inverse<PointerGraph>;
-          for (LayoutTypeSystemNode *PointerToPointee :
-               llvm::children<InversePointerGraph>(PointeeNode)) {
+          // Adding links invalidates the iterators on the neighbors of the
+          // nodes involved, so the pointers to PointeeNode are collected first.
+          SmallVector<LayoutTypeSystemNode *, 8>
+            PointersToPointee(llvm::children<InversePointerGraph>(PointeeNode));
+          for (LayoutTypeSystemNode *PointerToPointee : PointersToPointee) {
             revng_assert(AccessSize == getPointerSize(Model.Architecture()));
             revng_assert(AccessSize == PointerToPointee->Size);
             if (PointerToPointee != AccessNode)
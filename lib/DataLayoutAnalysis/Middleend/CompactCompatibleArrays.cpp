@@ -5,6 +5,7 @@
 #include <compare>
 #include <functional>
 #include <optional>
+#include <utility>
 
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -25,6 +26,7 @@ getTripCount(uint64_t StartOffset, uint64_t EndOffset, uint64_t Stride) {
 namespace dla {
 
 using NeighborIterator = LayoutTypeSystem::NeighborIterator;
+using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
 
 // Helper ordering for NeighborIterators. We need it here because we need to use
 // such iterators and keys in associative containers, and we want neighbors with
@@ -481,6 +483,13 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
           // properly to continue the outer iteration.
           ChildEdgeNext = Compact(ChildEdgeIt);
 
+          // Adding the edge to New invalidates the iterators on the children
+          // of Parent, so we have to look up ChildEdgeNext again afterwards.
+          std::optional<IDBasedKey> NextKey;
+          if (ChildEdgeNext != ChildEdgeEnd)
+            NextKey = IDBasedKey{ ChildEdgeNext->first->ID,
+                                  ChildEdgeNext->second };
+
           OffsetExpression NewStridedOffset{ Current.StartOffset };
           NewStridedOffset.Strides.push_back(Current.Stride);
           NewStridedOffset.TripCounts
@@ -488,6 +497,12 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
                                     Current.EndOffset,
                                     Current.Stride));
           TS.addInstanceLink(Parent, New, std::move(NewStridedOffset));
+
+          ChildEdgeEnd = GT::child_edge_end(Parent);
+          if (NextKey)
+            ChildEdgeNext = Parent->Successors.lower_bound(*NextKey);
+          else
+            ChildEdgeNext = ChildEdgeEnd;
         } else {
           revng_assert(CompactedWithCurrent.size() == 1);
           revng_assert(CompactedWithCurrent.front() == ChildEdgeIt);
@@ -2,6 +2,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <set>
+
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 
@@ -103,6 +106,7 @@ bool CollapseSingleChild::collapseSingle(LayoutTypeSystem &TS,
 
       TS.mergeNodes({ /*Into=*/Node, /*From=*/Child });
       Node->Size = ChildSize;
+      TS.markChanged(Node);
 
       Changed = true;
       Merged = true;
@@ -128,4 +132,52 @@ bool CollapseSingleChild::runOnTypeSystem(LayoutTypeSystem &TS) {
   return Changed;
 }
 
+bool CollapseSingleChild::runOnChangedNodes(LayoutTypeSystem &TS,
+                                            ArrayRef<LTSN *> Nodes) {
+  bool Changed = false;
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  // Whether a node can be collapsed only depends on the node and on its only
+  // child, so the nodes that did not change since the previous run, and whose
+  // children did not change, are skipped.
+  // The others are visited in order of ID like in a full run, together with
+  // the nodes that a full run would visit after changing them. Visiting a node
+  // can merge the nodes with a higher ID, so they are tracked by ID.
+  std::set<uint64_t> ToVisit;
+  const auto Enqueue = [&ToVisit](const LTSN *N, uint64_t MinID) {
+    if (N->ID >= MinID)
+      ToVisit.insert(N->ID);
+    for (const auto &Link : N->Predecessors)
+      if (isInstanceEdge(Link) and Link.first->ID >= MinID)
+        ToVisit.insert(Link.first->ID);
+  };
+
+  for (const LTSN *Node : Nodes)
+    Enqueue(Node, 0);
+
+  while (not ToVisit.empty()) {
+    uint64_t ID = *ToVisit.begin();
+    ToVisit.erase(ToVisit.begin());
+
+    LTSN *Node = TS.getNodeByID(ID);
+    if (Node == nullptr)
+      continue;
+
+    revng_log(Log, "Analyzing Node: " << ID);
+    auto Checkpoint = TS.getChangeCheckpoint();
+    if (not collapseSingle(TS, Node))
+      continue;
+
+    Changed = true;
+    for (const LTSN *ChangedNode : TS.getChangedSince(Checkpoint))
+      Enqueue(ChangedNode, ID + 1);
+  }
+
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  return Changed;
+}
+
 } // end namespace dla
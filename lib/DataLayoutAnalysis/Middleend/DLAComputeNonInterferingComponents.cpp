@@ -7,6 +7,7 @@
 #include <numeric>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -201,6 +202,11 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
         return C.NumChildren > 1ULL;
       };
 
+      // Adding links to N invalidates the iterators on its Successors, which
+      // are still needed by the following Components, so the links from N to
+      // the New nodes are only added after all the Components are processed.
+      llvm::SmallVector<std::pair<LTSN *, uint64_t>, 8> ComponentNodes;
+
       // For each Component with more than one element we have to create a new
       // node in the type system, and push the edges from N to the elements of
       // the component down to the newly created node.
@@ -226,11 +232,14 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
         for (auto &OrderedChild : OrderedChildRange)
           TS.moveEdgeSource(N, New, OrderedChild.ChildIt, -C.StartByte);
 
-        // Add a link between N and the New node representing the component.
-        // The component is at offset C.StartByte inside N.
-        TS.addInstanceLink(N, New, OffsetExpression(C.StartByte));
+        ComponentNodes.push_back({ New, C.StartByte });
       }
 
+      // Add a link between N and each New node representing a component.
+      // The component is at offset StartByte inside N.
+      for (const auto &[New, StartByte] : ComponentNodes)
+        TS.addInstanceLink(N, New, OffsetExpression(StartByte));
+
       N->InterferingInfo = AllChildrenAreNonInterfering;
     }
   }
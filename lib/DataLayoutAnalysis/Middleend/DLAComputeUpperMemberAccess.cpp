@@ -31,6 +31,27 @@ using NonPointerFilterT = EdgeFilteredGraph<GraphNodeT, isNotPointerEdge>;
 using ConstNonPointerFilterT = EdgeFilteredGraph<const LTSN *,
                                                  isNotPointerEdge>;
 
+/// Returns the size that \a N needs to contain all its non-pointer children
+static uint64_t computeUpperMember(const LTSN *N) {
+  revng_log(Log, "N->ID: " << N->ID);
+  revng_assert(not isLeaf(N) or N->Size);
+  uint64_t FinalSize = N->Size;
+
+  // Look at all the instance-of edges and inheritance edges all together.
+  revng_log(Log, "N's children");
+  LoggerIndent Indent{ Log };
+  for (auto &[Child, EdgeTag] : children_edges<ConstNonPointerFilterT>(N)) {
+    revng_log(Log, "Child->ID: " << Child->ID);
+    revng_log(Log,
+              "EdgeTag->Kind: "
+                << dla::TypeLinkTag::toString(EdgeTag->getKind()));
+    FinalSize = std::max(FinalSize, getFieldUpperMember(Child, EdgeTag));
+  }
+
+  revng_assert(FinalSize);
+  return FinalSize;
+}
+
 bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
@@ -53,30 +74,52 @@ bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) {
     LoggerIndent MoreIndent{ Log };
 
     for (LTSN *N : post_order_ext(NonPointerFilterT(Root), Visited)) {
-      revng_log(Log, "N->ID: " << N->ID);
-      revng_assert(not isLeaf(N) or N->Size);
-      uint64_t FinalSize = N->Size;
-
-      // Look at all the instance-of edges and inheritance edges all together.
-      revng_log(Log, "N's children");
-      LoggerIndent MoreMoreIndent{ Log };
-      for (auto &[Child, EdgeTag] : children_edges<ConstNonPointerFilterT>(N)) {
-        revng_log(Log, "Child->ID: " << Child->ID);
-        revng_log(Log,
-                  "EdgeTag->Kind: "
-                    << dla::TypeLinkTag::toString(EdgeTag->getKind()));
-        FinalSize = std::max(FinalSize, getFieldUpperMember(Child, EdgeTag));
-      }
-
-      if (FinalSize != N->Size)
+      uint64_t FinalSize = computeUpperMember(N);
+      if (FinalSize != N->Size) {
+        N->Size = FinalSize;
+        TS.markChanged(N);
         Changed = true;
-
-      N->Size = FinalSize;
-      revng_assert(FinalSize);
+      }
     }
   }
 
   return Changed;
 }
 
+bool ComputeUpperMemberAccesses::runOnChangedNodes(LayoutTypeSystem &TS,
+                                                   ArrayRef<LTSN *> Changed) {
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+  bool Result = false;
+
+  // After the previous run each node was already large enough to contain its
+  // children. Other steps can shrink a node (e.g. RemoveInvalidStrideEdges),
+  // but then they mark it as changed. computeUpperMember never shrinks a node
+  // either, not even in a full run, so a node needs to be recomputed only if it
+  // has changed, or if one of its children has changed.
+  SmallVector<LTSN *, 0> Worklist;
+  const auto PushParents = [&Worklist](LTSN *N) {
+    for (LTSN *Parent : children<Inverse<NonPointerFilterT>>(N))
+      Worklist.push_back(Parent);
+  };
+  for (LTSN *N : Changed) {
+    Worklist.push_back(N);
+    PushParents(N);
+  }
+
+  while (not Worklist.empty()) {
+    LTSN *N = Worklist.pop_back_val();
+    uint64_t FinalSize = computeUpperMember(N);
+    if (FinalSize == N->Size)
+      continue;
+
+    N->Size = FinalSize;
+    TS.markChanged(N);
+    Result = true;
+    PushParents(N);
+  }
+
+  return Result;
+}
+
 } // end namespace dla
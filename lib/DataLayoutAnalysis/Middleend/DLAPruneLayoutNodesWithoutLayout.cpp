@@ -77,4 +77,44 @@ bool PruneLayoutNodesWithoutLayout::runOnTypeSystem(LayoutTypeSystem &TS) {
   return Changed;
 }
 
+bool PruneLayoutNodesWithoutLayout::runOnChangedNodes(LayoutTypeSystem &TS,
+                                                      ArrayRef<LTSN *> Nodes) {
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  // After the previous run each node without size had at least one child.
+  // A node can lose its size or its last child only if it has changed, and
+  // removing it can leave its parents without children.
+  std::set<LTSN *> ToRemove;
+  SmallVector<LTSN *, 0> Worklist(Nodes.begin(), Nodes.end());
+  while (not Worklist.empty()) {
+    LTSN *N = Worklist.pop_back_val();
+    if (N->Size > 0 or ToRemove.contains(N))
+      continue;
+
+    using GT = GraphTraits<NonPointerFilterT>;
+    if (std::any_of(GT::child_begin(N),
+                    GT::child_end(N),
+                    [&ToRemove](LTSN *Child) {
+                      return !ToRemove.contains(Child);
+                    }))
+      continue;
+
+    revng_log(Log, "#### Queuing for removal: " << N->ID);
+    ToRemove.insert(N);
+    for (LTSN *Parent : children<Inverse<NonPointerFilterT>>(N))
+      Worklist.push_back(Parent);
+  }
+
+  for (LTSN *N : ToRemove) {
+    revng_log(Log, "# Removing: " << N->ID);
+    TS.removeNode(N);
+  }
+
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG() and TS.verifyLeafs());
+
+  return not ToRemove.empty();
+}
+
 } // end namespace dla
@@ -2,7 +2,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <string>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
@@ -70,6 +78,7 @@ static std::string getStepNameFromID(const void *ID) {
 
 static Logger<> DLAStepManagerLog("dla-step-manager");
 static Logger<> DLADumpDot("dla-step-dump-dot");
+static Logger<> DLAStepStatisticsLog("dla-step-statistics");
 
 [[nodiscard]] bool StepManager::addStep(std::unique_ptr<Step> S) {
   const void *StepID = S->getStepID();
@@ -117,6 +126,57 @@ static Logger<> DLADumpDot("dla-step-dump-dot");
   return true;
 }
 
+bool StepManager::runStep(Step &S, LayoutTypeSystem &TS, bool &Incremental) {
+  Incremental = false;
+  if (not RunIncrementally or not S.isIncremental())
+    return S.runOnTypeSystem(TS);
+
+  // The changes applied by S are included in its next run, since Steps that
+  // make a single pass on TS can find more to do on the nodes they changed
+  auto Before = TS.getChangeCheckpoint();
+  bool Changed = false;
+  auto It = Checkpoints.find(S.getStepID());
+  if (It != Checkpoints.end()) {
+    Incremental = true;
+    Changed = S.runOnChangedNodes(TS, TS.getChangedSince(It->second));
+  } else {
+    Changed = S.runOnTypeSystem(TS);
+  }
+
+  Checkpoints[S.getStepID()] = Before;
+  return Changed;
+}
+
+/// Runs \a S with \a RunStep, and records what it did in \a Stats
+static void runAndMeasure(Step &S,
+                          LayoutTypeSystem &TS,
+                          StepStatistics &Stats,
+                          llvm::function_ref<bool()> RunStep) {
+  using Clock = std::chrono::steady_clock;
+
+  Stats.Name = getStepNameFromID(S.getStepID());
+  Stats.NodesBefore = TS.getNumLayouts();
+  Stats.EdgesBefore = TS.getNumEdges();
+  uint64_t MergedBefore = TS.getNumMergedNodes();
+  uint64_t RemovedBefore = TS.getNumRemovedNodes();
+  size_t AllocatedBefore = TS.getAllocatedBytes();
+  uint64_t HeapBefore = llvm::sys::Process::GetMallocUsage();
+  auto Start = Clock::now();
+
+  Stats.Changed = RunStep();
+
+  std::chrono::duration<double> Elapsed = Clock::now() - Start;
+  Stats.Seconds = Elapsed.count();
+  Stats.HeapDelta = static_cast<int64_t>(llvm::sys::Process::GetMallocUsage())
+                    - static_cast<int64_t>(HeapBefore);
+  Stats.AllocatedBytesDelta = static_cast<int64_t>(TS.getAllocatedBytes())
+                              - static_cast<int64_t>(AllocatedBefore);
+  Stats.MergedNodes = TS.getNumMergedNodes() - MergedBefore;
+  Stats.RemovedNodes = TS.getNumRemovedNodes() - RemovedBefore;
+  Stats.NodesAfter = TS.getNumLayouts();
+  Stats.EdgesAfter = TS.getNumEdges();
+}
+
 void StepManager::run(LayoutTypeSystem &TS) {
   if (not hasValidSchedule())
     revng_abort("Cannot run a on LayoutTypeSystem: invalid schedule");
@@ -124,10 +184,31 @@ void StepManager::run(LayoutTypeSystem &TS) {
   if (DLADumpDot.isEnabled())
     TS.dumpDotOnFile("type-system-0.dot", true);
 
+  bool Measure = CollectStatistics or DLAStepStatisticsLog.isEnabled();
+  Statistics.clear();
+  Checkpoints.clear();
+
   llvm::Task T{ Schedule.size(), "StepManager::run" };
   for (auto &S : Schedule) {
     T.advance(getStepNameFromID(S->getStepID()));
-    S->runOnTypeSystem(TS);
+    if (Measure) {
+      StepStatistics &Stats = Statistics.emplace_back();
+      runAndMeasure(*S, TS, Stats, [&]() {
+        return runStep(*S, TS, Stats.Incremental);
+      });
+      revng_log(DLAStepStatisticsLog,
+                Stats.Name << (Stats.Incremental ? " (incremental)" : "")
+                           << (Stats.Changed ? "" : " (unchanged)") << ": "
+                           << llvm::format("%.6f", Stats.Seconds) << "s, "
+                           << Stats.NodesBefore << " -> " << Stats.NodesAfter
+                           << " nodes, " << Stats.EdgesBefore << " -> "
+                           << Stats.EdgesAfter << " edges, "
+                           << Stats.MergedNodes << " merged, "
+                           << Stats.RemovedNodes << " removed");
+    } else {
+      bool Incremental;
+      runStep(*S, TS, Incremental);
+    }
     ++x;
     if (DLADumpDot.isEnabled()) {
       revng_log(DLADumpDot,
@@ -137,6 +218,86 @@ void StepManager::run(LayoutTypeSystem &TS) {
       TS.dumpDotOnFile(DotName.c_str(), true);
     }
   }
+
+  if (DLAStepStatisticsLog.isEnabled())
+    writeStatistics("DLA-step-statistics.csv");
+}
+
+void StepManager::writeStatistics(llvm::StringRef Path) const {
+  std::error_code Error;
+  llvm::raw_fd_ostream Out(Path, Error, llvm::sys::fs::OF_Text);
+  if (Error)
+    revng_abort(Error.message().c_str());
+
+  Out << "index,step,changed,incremental,seconds,nodes_before,nodes_after,"
+         "edges_before,edges_after,merged_nodes,removed_nodes,"
+         "allocated_bytes_delta,heap_delta\n";
+
+  for (size_t Index = 0; Index < Statistics.size(); ++Index) {
+    const StepStatistics &Stats = Statistics[Index];
+    Out << Index << "," << Stats.Name << "," << (Stats.Changed ? "1" : "0")
+        << "," << (Stats.Incremental ? "1" : "0") << ","
+        << llvm::format("%.6f", Stats.Seconds) << ","
+        << Stats.NodesBefore << "," << Stats.NodesAfter << ","
+        << Stats.EdgesBefore << "," << Stats.EdgesAfter << ","
+        << Stats.MergedNodes << "," << Stats.RemovedNodes << ","
+        << Stats.AllocatedBytesDelta << "," << Stats.HeapDelta << "\n";
+  }
+
+  Out.flush();
+  if (Out.has_error())
+    revng_abort(Out.error().message().c_str());
+}
+
+void scheduleMiddleEndSteps(StepManager &SM, size_t PointerSize) {
+  //
+  // Graph normalization phase
+  //
+  revng_check(SM.addStep<RemoveInvalidPointers>(PointerSize));
+  revng_check(SM.addStep<CollapseEqualitySCC>());
+  revng_check(SM.addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(SM.addStep<SimplifyInstanceAtOffset0>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<RemoveInvalidStrideEdges>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<DecomposeStridedEdges>());
+
+  //
+  // Graph optimization phase
+  //
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<MergePointeesOfPointerUnion>(PointerSize));
+  revng_check(SM.addStep<MergePointerNodes>());
+  revng_check(SM.addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(SM.addStep<SimplifyInstanceAtOffset0>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<RemoveInvalidStrideEdges>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+
+  revng_check(SM.addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run before
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // produce better results
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<ArrangeAccessesHierarchically>());
+  revng_check(SM.addStep<CompactCompatibleArrays>());
+  revng_check(SM.addStep<PushDownPointers>());
+  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
+  // so we want to run MergePointerNodes again afterwards.
+  revng_check(SM.addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run again after
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // improve the results even further.
+  revng_check(SM.addStep<ResolveLeafUnions>());
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<ComputeNonInterferingComponents>());
 }
 
 } // end namespace dla
@@ -5,12 +5,17 @@
 //
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 
 #include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
 
@@ -50,6 +55,17 @@ public:
   /// Runs the Step on TS, returns true if it has applied changes to TS.
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) = 0;
 
+  /// Returns true if the Step can be re-run with runOnChangedNodes
+  virtual bool isIncremental() const { return false; }
+
+  /// Runs the Step on TS, knowing that it has already run on TS and that
+  /// only the nodes in Changed have changed since the start of that run.
+  /// Returns true if it has applied changes to TS.
+  virtual bool runOnChangedNodes(LayoutTypeSystem &TS,
+                                 llvm::ArrayRef<LayoutTypeSystemNode *>) {
+    return runOnTypeSystem(TS);
+  }
+
   IDSetConstRef getDependencies() const { return Dependencies; }
   IDSetConstRef getInvalidated() const { return Invalidated; }
 
@@ -124,6 +140,12 @@ public:
   virtual ~PruneLayoutNodesWithoutLayout() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isIncremental() const override { return true; }
+
+  virtual bool
+  runOnChangedNodes(LayoutTypeSystem &TS,
+                    llvm::ArrayRef<LayoutTypeSystemNode *> Changed) override;
 };
 
 /// dla::Step that merge pointer nodes pointing to the same layout
@@ -138,6 +160,12 @@ public:
   virtual ~MergePointerNodes() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isIncremental() const override { return true; }
+
+  virtual bool
+  runOnChangedNodes(LayoutTypeSystem &TS,
+                    llvm::ArrayRef<LayoutTypeSystemNode *> Changed) override;
 };
 
 /// dla::Step that takes all strided edges and decompose in edges with only one
@@ -178,6 +206,12 @@ public:
   virtual ~ComputeUpperMemberAccesses() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isIncremental() const override { return true; }
+
+  virtual bool
+  runOnChangedNodes(LayoutTypeSystem &TS,
+                    llvm::ArrayRef<LayoutTypeSystemNode *> Changed) override;
 };
 
 /// dla::Step that removes invalid stride edges
@@ -242,6 +276,12 @@ public:
   virtual ~CollapseSingleChild() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isIncremental() const override { return true; }
+
+  virtual bool
+  runOnChangedNodes(LayoutTypeSystem &TS,
+                    llvm::ArrayRef<LayoutTypeSystemNode *> Changed) override;
 };
 
 /// dla::Step that decompose the LayoutTypeSystem into components, each of which
@@ -363,6 +403,12 @@ public:
   virtual ~DeduplicateFields() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isIncremental() const override { return true; }
+
+  virtual bool
+  runOnChangedNodes(LayoutTypeSystem &TS,
+                    llvm::ArrayRef<LayoutTypeSystemNode *> Changed) override;
 };
 
 inline DecomposeStridedEdges::DecomposeStridedEdges() :
@@ -391,6 +437,25 @@ bool intersect(const RangeT &R1, const RangeT &R2) {
   return intersect(R1.begin(), R1.end(), R2.begin(), R2.end());
 }
 
+/// What a single Step did to the LayoutTypeSystem it ran on
+struct StepStatistics {
+  std::string Name;
+  bool Changed = false;
+  // True if the Step only looked at the nodes changed since its previous run
+  bool Incremental = false;
+  double Seconds = 0;
+  size_t NodesBefore = 0;
+  size_t NodesAfter = 0;
+  size_t EdgesBefore = 0;
+  size_t EdgesAfter = 0;
+  uint64_t MergedNodes = 0;
+  uint64_t RemovedNodes = 0;
+  // Bytes allocated by the LayoutTypeSystem for its nodes and link tags
+  int64_t AllocatedBytesDelta = 0;
+  // Process-wide heap usage, which includes the neighbors of the nodes
+  int64_t HeapDelta = 0;
+};
+
 class StepManager {
 
 public:
@@ -408,6 +473,20 @@ public:
   using sched_const_iterator = decltype(Schedule)::const_iterator;
   using sched_const_range = llvm::iterator_range<sched_const_iterator>;
 
+private:
+  bool CollectStatistics = false;
+  bool RunIncrementally = true;
+  std::vector<StepStatistics> Statistics;
+
+  // For each incremental Step that already ran, the checkpoint taken right
+  // before its latest run
+  llvm::SmallDenseMap<const void *, LayoutTypeSystem::ChangeCheckpoint, 4>
+    Checkpoints;
+
+  /// Runs \a S on \a TS, incrementally if S has already run on it.
+  /// Returns true if S has applied changes to TS.
+  bool runStep(Step &S, LayoutTypeSystem &TS, bool &Incremental);
+
 public:
   StepManager() : Schedule(), InsertedSteps(), InvalidatedSteps() {}
 
@@ -419,7 +498,9 @@ public:
     return addStep(std::make_unique<StepT>(std::forward<ArgsT &&>(Args)...));
   }
 
-  /// Runs the added steps
+  /// Runs the added steps.
+  /// Incremental steps that are scheduled more than once only look at the
+  /// nodes that have changed since their previous run.
   void run(LayoutTypeSystem &TS);
 
   /// Drops all the scheduled steps
@@ -427,8 +508,25 @@ public:
     Schedule.clear();
     InsertedSteps.clear();
     InvalidatedSteps.clear();
+    Statistics.clear();
+    Checkpoints.clear();
   }
 
+  /// Makes run() collect StepStatistics for each Step it runs. They are also
+  /// collected when the dla-step-statistics Logger is enabled.
+  void enableStatistics() { CollectStatistics = true; }
+
+  /// Makes run() always run the Steps on the whole LayoutTypeSystem, even if
+  /// they already ran on it. Incremental runs are expected to give the same
+  /// results, this is meant to check that.
+  void disableIncrementalRuns() { RunIncrementally = false; }
+
+  /// The statistics of each Step of the last run, in schedule order
+  llvm::ArrayRef<StepStatistics> getStatistics() const { return Statistics; }
+
+  /// Writes the statistics of the last run as a CSV file, one row per Step
+  void writeStatistics(llvm::StringRef Path) const;
+
   bool hasValidSchedule() const {
     return not intersect(InsertedSteps, InvalidatedSteps);
   }
@@ -444,4 +542,8 @@ public:
   }
 };
 
+/// Adds to \a SM all the Steps of the DLA middle-end, in the order in which
+/// the DLAPass runs them
+void scheduleMiddleEndSteps(StepManager &SM, size_t PointerSize);
+
 } // end namespace dla
@@ -2,11 +2,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+#include <utility>
+
 #include "DLAStep.h"
 #include "FieldSizeComputation.h"
 
 namespace dla {
 
+using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
+
 bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
@@ -27,7 +32,7 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
       if (not isInstanceEdge(Edge))
         continue;
 
-      const auto &[Child, Tag] = Edge;
+      const auto [Child, Tag] = Edge;
       const auto &OffsetExpr = Tag->getOffsetExpr();
       auto NLayers = OffsetExpr.Strides.size();
       if (NLayers < 2)
@@ -35,6 +40,15 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
 
       Changed = true;
 
+      // Adding the new edges invalidates the iterators on the children of
+      // Parent, so we have to look up EdgeNext again afterwards.
+      std::optional<IDBasedKey> NextKey;
+      if (EdgeNext != EdgeEnd)
+        NextKey = IDBasedKey{ EdgeNext->first->ID, EdgeNext->second };
+
+      // Remove the old strided edge
+      TS.eraseEdge(Parent, EdgeIt);
+
       // Setup the chain of nodes across which we will build the new chain of
       // single-layered strided edges.
       llvm::SmallVector<LayoutTypeSystemNode *> NodeChain;
@@ -77,12 +91,17 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
         LayoutTypeSystemNode *Succ = NodeChain[Idx];
         // Link them
         const auto [Tag, New] = TS.addInstanceLink(Pred, Succ, std::move(OE));
-        if (Pred != Parent)
+        if (Pred != Parent) {
           Pred->Size = getFieldSize(Succ, Tag);
+          TS.markChanged(Pred);
+        }
       }
 
-      // Remove the old strided edge
-      TS.eraseEdge(Parent, EdgeIt);
+      EdgeEnd = DLAGraph::child_edge_end(Parent);
+      if (NextKey)
+        EdgeNext = Parent->Successors.lower_bound(*NextKey);
+      else
+        EdgeNext = EdgeEnd;
     }
   }
 
@@ -7,11 +7,13 @@
 #include <cstdint>
 #include <iterator>
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetOperations.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Debug.h"
 
 #include "revng/Support/Assert.h"
@@ -66,58 +68,11 @@ static order cmpNodes(const LTSN *A, const LTSN *B) {
   return order::equal;
 }
 
-/// Strong ordering for edges: order by kind, then by offset expression
+/// Strong ordering for edges. Tags are interned, so equal tags are the same
+/// tag, and they can be ordered by ID.
 static order cmpEdgeTags(const Tag *A, const Tag *B) {
-  if (A == B)
-    return order::equal;
   revng_assert(A != nullptr and B != nullptr);
-
-  auto KindA = A->getKind();
-  auto KindB = B->getKind();
-
-  // If at least one is a pointer, only look at the kind
-  if (KindA == TypeLinkTag::LK_Pointer or KindB == TypeLinkTag::LK_Pointer)
-    return KindA <=> KindB;
-
-  OffsetExpression OffA = A->getOffsetExpr();
-  OffsetExpression OffB = B->getOffsetExpr();
-
-  const auto KindCmp = KindA <=> KindB;
-  if (KindCmp != order::equal)
-    return KindCmp;
-
-  const auto OffsetCmp = OffA.Offset <=> OffB.Offset;
-  if (OffsetCmp != order::equal)
-    return OffsetCmp;
-
-  const auto StrideSizeCmp = OffA.Strides.size() <=> OffB.Strides.size();
-  if (StrideSizeCmp != order::equal)
-    return StrideSizeCmp;
-  for (const auto &[StrA, StrB] : llvm::zip(OffA.Strides, OffB.Strides)) {
-    const auto StrideCmp = StrA <=> StrB;
-    if (StrideCmp != order::equal)
-      return StrideCmp;
-  }
-
-  const auto TCSizeCmp = OffA.TripCounts.size() <=> OffB.TripCounts.size();
-  if (TCSizeCmp != order::equal)
-    return TCSizeCmp;
-  for (const auto &[TCA, TCB] : llvm::zip(OffA.TripCounts, OffB.TripCounts)) {
-    if (not TCA and not TCB)
-      continue;
-    if (TCA and not TCB)
-      return order::less;
-    if (not TCA and TCB)
-      return order::greater;
-
-    if (TCA and TCB) {
-      const auto TCCmp = *TCA <=> *TCB;
-      if (TCCmp != order::equal)
-        return TCCmp;
-    }
-  }
-
-  return order::equal;
+  return A->getID() <=> B->getID();
 }
 
 /// Strong ordering for links: compare edge tags and destination node
@@ -331,19 +286,63 @@ mergeIfTopologicallyEq(LayoutTypeSystem &TS,
   return { true, Preserved, ErasedNodes };
 }
 
-static auto getSuccEdgesToChild(LTSN *Parent, LTSN *Child) {
+/// Returns a copy of the edges from \a Parent to \a Child, since merging nodes
+/// invalidates the Successors of \a Parent
+static SmallVector<Link> getSuccEdgesToChild(LTSN *Parent, LTSN *Child) {
   auto &Succ = Parent->Successors;
   using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
-  return llvm::iterator_range(Succ.lower_bound(IDBasedKey{ Child->ID,
-                                                           nullptr }),
-                              Succ.upper_bound(IDBasedKey{ Child->ID + 1,
-                                                           nullptr }));
+  return SmallVector<Link>(Succ.lower_bound(IDBasedKey{ Child->ID, nullptr }),
+                           Succ.upper_bound(IDBasedKey{ Child->ID + 1,
+                                                        nullptr }));
 }
 
-bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
+/// The nodes that have a changed node among their instance descendants,
+/// including themselves.
+///
+/// Subtrees are compared by looking only at the nodes reached through instance
+/// edges, and at the IDs of the targets of pointer edges. If none of them has
+/// changed, comparing the fields of a node again gives the same result.
+class ChangedSubtrees {
+private:
+  LayoutTypeSystem &TS;
+  LayoutTypeSystem::ChangeCheckpoint Checkpoint;
+  llvm::DenseSet<uint64_t> Changed;
+
+public:
+  ChangedSubtrees(LayoutTypeSystem &TS, ArrayRef<LTSN *> ChangedNodes) :
+    TS(TS), Checkpoint(TS.getChangeCheckpoint()) {
+    addWithAncestors(ChangedNodes);
+  }
+
+  /// Returns true if the subtree of \a N has changed, also considering the
+  /// changes applied to TS since the last call
+  bool contains(const LTSN *N) {
+    auto ChangedNodes = TS.getChangedSince(Checkpoint);
+    if (not ChangedNodes.empty()) {
+      Checkpoint = TS.getChangeCheckpoint();
+      addWithAncestors(ChangedNodes);
+    }
+    return Changed.contains(N->ID);
+  }
+
+private:
+  void addWithAncestors(ArrayRef<LTSN *> ChangedNodes) {
+    SmallVector<LTSN *, 0> Worklist(ChangedNodes.begin(), ChangedNodes.end());
+    while (not Worklist.empty()) {
+      LTSN *N = Worklist.pop_back_val();
+      if (not Changed.insert(N->ID).second)
+        continue;
+
+      for (LTSN *Parent : children<Inverse<NonPointerFilterT>>(N))
+        Worklist.push_back(Parent);
+    }
+  }
+};
+
+/// Deduplicates the fields of the nodes with many fields. If \a Subtrees is
+/// not nullptr, the nodes whose subtree has not changed are skipped.
+static bool deduplicateFields(LayoutTypeSystem &TS, ChangedSubtrees *Subtrees) {
   bool TypeSystemChanged = false;
-  if (VerifyLog.isEnabled())
-    revng_assert(TS.verifyDAG());
 
   llvm::SmallPtrSet<LTSN *, 16> VisitedNodes;
 
@@ -372,6 +371,13 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
     // cached because children can be merged during traversal, which would
     // invalidate iterators in llvm::post_order if we use it vanilla.
     for (LTSN *NodeWithFields : PostOrderFromRoot) {
+      if (Subtrees != nullptr and not Subtrees->contains(NodeWithFields)) {
+        revng_log(Log,
+                  "****** Skip unchanged NodeWithFields with ID: "
+                    << NodeWithFields->ID);
+        continue;
+      }
+
       revng_log(Log,
                 "****** Try to dedup children of NodeWithFields with ID: "
                   << NodeWithFields->ID);
@@ -401,13 +407,13 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
         // edge, so consider them all when comparing CurChild with the
         // AnalyzedNotMerged.
         bool FieldsMerged = false;
-        auto CurChildEdges = getSuccEdgesToChild(NodeWithFields, CurChild);
+        SmallVector<Link> CurChildEdges = getSuccEdgesToChild(NodeWithFields,
+                                                              CurChild);
         revng_log(Log,
-                  "There are "
-                    << std::distance(CurChildEdges.begin(), CurChildEdges.end())
-                    << " edges from " << NodeWithFields->ID << " to "
-                    << CurChild->ID);
-        for (auto &CurLink : CurChildEdges) {
+                  "There are " << CurChildEdges.size() << " edges from "
+                               << NodeWithFields->ID << " to "
+                               << CurChild->ID);
+        for (const Link &CurLink : CurChildEdges) {
 
           LoggerIndent MoreIndent{ Log };
           revng_log(Log, "Edge: " << *CurLink.second);
@@ -426,13 +432,13 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
                       "Try to merge: " << CurLink.first->ID << " with "
                                        << NotMergedNode->ID);
 
-            auto NotMergedEdges = getSuccEdgesToChild(NodeWithFields,
-                                                      NotMergedNode);
+            SmallVector<Link>
+              NotMergedEdges = getSuccEdgesToChild(NodeWithFields,
+                                                   NotMergedNode);
             revng_log(Log,
-                      "There are " << std::distance(NotMergedEdges.begin(),
-                                                    NotMergedEdges.end())
-                                   << " edges from " << NodeWithFields->ID
-                                   << " to " << NotMergedNode->ID);
+                      "There are " << NotMergedEdges.size() << " edges from "
+                                   << NodeWithFields->ID << " to "
+                                   << NotMergedNode->ID);
 
             bool AnalyzedNotMergedInvalidated = false;
             for (const Link &NotMergedLink : NotMergedEdges) {
@@ -546,8 +552,8 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
           }
 
           // If the children of the NodeWithFields have been changed by the
-          // merge, the CurChildEdges iterator ranges have been invalidated. So
-          // we have to break out of this loop as well.
+          // merge, the CurChildEdges are stale. So we have to break out of this
+          // loop as well.
           if (FieldsMerged) {
             break;
           }
@@ -569,10 +575,37 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
     }
   }
 
+  return TypeSystemChanged;
+}
+
+bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
-  return TypeSystemChanged;
+  bool Changed = deduplicateFields(TS, nullptr);
+
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  return Changed;
+}
+
+bool DeduplicateFields::runOnChangedNodes(LayoutTypeSystem &TS,
+                                          ArrayRef<LTSN *> Nodes) {
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  // The nodes are still visited in the same order of a full run, but the
+  // fields of a node are compared only if its subtree has changed since the
+  // previous run, or during this run. The previous run found no duplicate
+  // fields in the others, otherwise it would have changed their subtrees.
+  ChangedSubtrees Subtrees(TS, Nodes);
+  bool Changed = deduplicateFields(TS, &Subtrees);
+
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  return Changed;
 }
 
 } // end namespace dla
@@ -220,13 +220,13 @@ bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
           // Check if we merged more than one scalar that also was a pointer.
           // In that case we have to create a new union of their pointees,
           // enqueue it for further analysis
-          llvm::SmallVector<LTSN::NeighborIterator> PointerEdges;
+          llvm::SmallVector<LTSN::Link> PointerEdges;
           {
             LTSN::NeighborIterator ChildIt = MergedScalar->Successors.begin();
             LTSN::NeighborIterator ChildEnd = MergedScalar->Successors.end();
             for (; ChildIt != ChildEnd; ++ChildIt)
               if (isPointerEdge(*ChildIt))
-                PointerEdges.push_back(ChildIt);
+                PointerEdges.push_back(*ChildIt);
 
             revng_assert(PointerEdges.empty()
                          or MergedScalar->Size == PointerSize);
@@ -236,9 +236,13 @@ bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
             revng_log(Log,
                       "Merged scalar is a union of pointers: "
                         << MergedScalar->ID);
-            for (LTSN::NeighborIterator &PointerEdgeIt : PointerEdges) {
+            // Adding links to MergedScalar invalidates the iterators on its
+            // Successors, so we look up each pointer edge right before moving
+            // it.
+            for (const LTSN::Link &PointerEdge : PointerEdges) {
               LTSN *NewPointer = TS.createArtificialLayoutType();
               NewPointer->Size = PointerSize;
+              auto PointerEdgeIt = MergedScalar->Successors.find(PointerEdge);
               TS.moveEdgeSource(MergedScalar, NewPointer, PointerEdgeIt, 0);
               TS.addInstanceLink(MergedScalar,
                                  NewPointer,
@@ -325,6 +329,7 @@ bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
                                OffsetExpression{ 0 });
           } else if (not MergedAggregate->NonScalar) {
             MergedAggregate->Size = MergedScalar->Size;
+            TS.markChanged(MergedAggregate);
             TS.addInstanceLink(MergedAggregate,
                                MergedScalar,
                                OffsetExpression{ 0 });
@@ -2,6 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <set>
+#include <vector>
+
 #include "llvm/ADT/DepthFirstIterator.h"
 
 #include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
@@ -53,9 +57,9 @@ bool MergePointerNodes::runOnTypeSystem(LayoutTypeSystem &TS) {
       Changed = true;
 
       // This does note invalidate our iteration on llvm::nodes, since the
-      // underlying container for nodes is a std::set, and the iterator that is
-      // being held on it points to Node, not to any of the nodes in ToMerge,
-      // so erasing the nodes in ToMerge never invalidats the iterator to Node
+      // iterator that is being held on it points to Node, not to any of the
+      // nodes in ToMerge, and erasing nodes never invalidates the iterators to
+      // the other nodes
       TS.mergeNodes(ToMerge);
     }
   }
@@ -63,4 +67,49 @@ bool MergePointerNodes::runOnTypeSystem(LayoutTypeSystem &TS) {
   return Changed;
 }
 
+bool MergePointerNodes::runOnChangedNodes(LayoutTypeSystem &TS,
+                                          ArrayRef<LTSN *> Nodes) {
+  bool Changed = false;
+
+  // After the previous run no node had more than one pointer to it. A node
+  // can get new pointers only if it changes, and merging the pointers to a
+  // node changes the pointers to the merged one, so they are visited too.
+  // Pointers are always merged into the one with the lowest ID, so the result
+  // does not depend on the order in which the nodes are visited. Visiting a
+  // node can merge the others, so they are tracked by ID.
+  std::set<uint64_t> ToVisit;
+  for (const LTSN *Node : Nodes)
+    ToVisit.insert(Node->ID);
+
+  while (not ToVisit.empty()) {
+    uint64_t ID = *ToVisit.begin();
+    ToVisit.erase(ToVisit.begin());
+
+    LTSN *Node = TS.getNodeByID(ID);
+    if (Node == nullptr or isPointerRoot(Node))
+      continue;
+
+    std::vector<LTSN *> ToMerge;
+    for (LTSN *PointerToMerge :
+         llvm::children<InversePointerGraphNodeT>(Node)) {
+      revng_log(Log, "#### PointerToMerge: " << PointerToMerge->ID);
+      revng_assert(PointerToMerge->Successors.size() == 1);
+      revng_assert(ToMerge.empty()
+                   or ToMerge[0]->Size == PointerToMerge->Size);
+      ToMerge.push_back(PointerToMerge);
+    }
+
+    if (ToMerge.size() < 2)
+      continue;
+
+    Changed = true;
+    auto Checkpoint = TS.getChangeCheckpoint();
+    TS.mergeNodes(ToMerge);
+    for (const LTSN *ChangedNode : TS.getChangedSince(Checkpoint))
+      ToVisit.insert(ChangedNode->ID);
+  }
+
+  return Changed;
+}
+
 } // end namespace dla
@@ -321,6 +321,8 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
       Edge PredToChild = std::make_pair(Child, T);
       Erased = Pred->Successors.erase(PredToChild);
       revng_assert(Erased);
+      TS.markChanged(Pred);
+      TS.markChanged(Child);
       Changed = true;
     }
   }
@@ -34,6 +34,8 @@ bool dla::RemoveInvalidPointers::runOnTypeSystem(LayoutTypeSystem &TS) {
       revng_assert(PredIt != Pointee->Predecessors.end());
       Pointee->Predecessors.erase(PredIt);
       PtrNode->Successors.erase(It);
+      TS.markChanged(PtrNode);
+      TS.markChanged(Pointee);
       Changed = true;
     }
   }
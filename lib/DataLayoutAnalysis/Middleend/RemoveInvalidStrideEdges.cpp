@@ -93,6 +93,7 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
         revng_assert(PredIt != Succ->Predecessors.end());
         Succ->Predecessors.erase(PredIt);
         N->Successors.erase(It);
+        TS.markChanged(Succ);
         RemovedChild = true;
         Changed = true;
       }
@@ -121,6 +122,7 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
         }
 
         N->Size = NewSize;
+        TS.markChanged(N);
       }
     }
   }
@@ -2,7 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <optional>
+#include <utility>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
@@ -36,6 +39,8 @@ static Logger<> Log{ "dla-simplify-instance-off0" };
 
 namespace dla {
 
+using NeighborIterator = LayoutTypeSystemNode::NeighborIterator;
+using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
 using NodeSet = llvm::SmallPtrSet<const LayoutTypeSystemNode *, 8>;
 using ReachabilityMap = llvm::DenseMap<const LayoutTypeSystemNode *, NodeSet>;
 
@@ -221,16 +226,24 @@ bool SimplifyInstanceAtOffset0::runOnTypeSystem(LayoutTypeSystem &TS) {
 
     ReachabilityCache RC;
 
+    auto &Successors = Node->Successors;
+    const auto FindInstanceOff0 = [&Successors](NeighborIterator It) {
+      return std::find_if(It, Successors.end(), isInstanceOff0);
+    };
+
     // For each instance children of Node at offset 0, compute if it can be
     // collapsed into Node, and if it's possible collapse it.
-    for (LayoutTypeSystemNode *Child :
-         llvm::make_early_inc_range(llvm::children<InstanceZeroT>(Node))) {
+    auto It = FindInstanceOff0(Successors.begin());
+    while (It != Successors.end()) {
+      LayoutTypeSystemNode *Child = It->first;
+      auto Next = FindInstanceOff0(std::next(It));
 
       revng_log(Log, "Child: " << Child->ID);
       LoggerIndent ChildIndent(Log);
 
       if (not canBeCollapsed(RC, Node, Child)) {
         revng_log(Log, "NOT canBeCollapsed()");
+        It = Next;
         continue;
       }
 
@@ -244,9 +257,20 @@ bool SimplifyInstanceAtOffset0::runOnTypeSystem(LayoutTypeSystem &TS) {
                          true);
       }
 
+      // Merging adds the children of Child to the Successors of Node, which
+      // invalidates the iterators, so we have to look up Next again.
+      std::optional<IDBasedKey> NextKey;
+      if (Next != Successors.end())
+        NextKey = IDBasedKey{ Next->first->ID, Next->second };
+
       TS.mergeNodes({ Node, Child });
       Changed = true;
 
+      if (NextKey)
+        It = FindInstanceOff0(Successors.lower_bound(*NextKey));
+      else
+        It = Successors.end();
+
       if (Log.isEnabled()) {
         TS.dumpDotOnFile((llvm::Twine(I) + "-after-" + llvm::Twine(IDToCollapse)
                           + ".dot")
@@ -226,10 +226,10 @@ bool dumpModelToHeader(const model::Binary &Model,
       Header << B.getLineComment("===============");
       Header << '\n';
       QualifiedTypeNameMap AdditionalTypeNames;
-      TypeInlineHelper TheTypeInlineHelper(Model);
+      auto TheTypeInlineHelper = TypeInlineHelper::get(Model);
 
       printTypeDefinitions(Model,
-                           TheTypeInlineHelper,
+                           *TheTypeInlineHelper,
                            Header,
                            B,
                            AdditionalTypeNames,
@@ -76,6 +76,10 @@ void SwitchBreakNode::updateASTNodesPointers(ASTNodeMap &SubstitutionMap) {
   ParentSwitch = llvm::cast<SwitchNode>(SubstitutionMap.at(ParentSwitch));
 }
 
+void GotoNode::updateASTNodesPointers(ASTNodeMap &SubstitutionMap) {
+  Target = llvm::cast<LabelNode>(SubstitutionMap.at(Target));
+}
+
 // #### isEqual methods ####
 
 template<typename SwitchNodeType>
@@ -390,6 +394,26 @@ void SetNode::dump(llvm::raw_fd_ostream &ASTFile) {
 void SetNode::dumpEdge(llvm::raw_fd_ostream &ASTFile) {
 }
 
+void LabelNode::dump(llvm::raw_fd_ostream &ASTFile) {
+  ASTFile << "node_" << this->getID() << " [";
+  ASTFile << "label=\"label " << this->getName() << "\"";
+  ASTFile << ",shape=\"box\",color=\"red\"];\n";
+}
+
+void LabelNode::dumpEdge(llvm::raw_fd_ostream &ASTFile) {
+}
+
+void GotoNode::dump(llvm::raw_fd_ostream &ASTFile) {
+  ASTFile << "node_" << this->getID() << " [";
+  ASTFile << "label=\"" << this->getName() << "\"";
+  ASTFile << ",shape=\"box\",color=\"red\"];\n";
+}
+
+void GotoNode::dumpEdge(llvm::raw_fd_ostream &ASTFile) {
+  ASTFile << "node_" << this->getID() << " -> node_" << Target->getID()
+          << " [color=red,label=\"goto\"];\n";
+}
+
 void ASTNode::dump(llvm::raw_fd_ostream &ASTFile) {
   switch (getKind()) {
   case NK_Code:
@@ -410,6 +434,10 @@ void ASTNode::dump(llvm::raw_fd_ostream &ASTFile) {
     return llvm::cast<SwitchBreakNode>(this)->dump(ASTFile);
   case NK_Set:
     return llvm::cast<SetNode>(this)->dump(ASTFile);
+  case NK_Label:
+    return llvm::cast<LabelNode>(this)->dump(ASTFile);
+  case NK_Goto:
+    return llvm::cast<GotoNode>(this)->dump(ASTFile);
   }
 }
 
@@ -433,6 +461,10 @@ void ASTNode::dumpEdge(llvm::raw_fd_ostream &ASTFile) {
     return llvm::cast<SwitchBreakNode>(this)->dumpEdge(ASTFile);
   case NK_Set:
     return llvm::cast<SetNode>(this)->dumpEdge(ASTFile);
+  case NK_Label:
+    return llvm::cast<LabelNode>(this)->dumpEdge(ASTFile);
+  case NK_Goto:
+    return llvm::cast<GotoNode>(this)->dumpEdge(ASTFile);
   }
 }
 
@@ -444,34 +476,40 @@ void ASTNode::dumpSuccessor(llvm::raw_fd_ostream &ASTFile) {
   }
 }
 
-void ASTNode::deleteASTNode(ASTNode *A) {
+void ASTNode::destroyASTNode(ASTNode *A) {
   switch (A->getKind()) {
   case NodeKind::NK_Code:
-    delete static_cast<CodeNode *>(A);
+    static_cast<CodeNode *>(A)->~CodeNode();
     break;
   case NodeKind::NK_Break:
-    delete static_cast<BreakNode *>(A);
+    static_cast<BreakNode *>(A)->~BreakNode();
     break;
   case NodeKind::NK_Continue:
-    delete static_cast<ContinueNode *>(A);
+    static_cast<ContinueNode *>(A)->~ContinueNode();
     break;
   case NodeKind::NK_If:
-    delete static_cast<IfNode *>(A);
+    static_cast<IfNode *>(A)->~IfNode();
     break;
   case NodeKind::NK_Scs:
-    delete static_cast<ScsNode *>(A);
+    static_cast<ScsNode *>(A)->~ScsNode();
     break;
   case NodeKind::NK_List:
-    delete static_cast<SequenceNode *>(A);
+    static_cast<SequenceNode *>(A)->~SequenceNode();
     break;
   case NodeKind::NK_Switch:
-    delete static_cast<SwitchNode *>(A);
+    static_cast<SwitchNode *>(A)->~SwitchNode();
     break;
   case NodeKind::NK_SwitchBreak:
-    delete static_cast<SwitchBreakNode *>(A);
+    static_cast<SwitchBreakNode *>(A)->~SwitchBreakNode();
     break;
   case NodeKind::NK_Set:
-    delete static_cast<SetNode *>(A);
+    static_cast<SetNode *>(A)->~SetNode();
+    break;
+  case NodeKind::NK_Label:
+    static_cast<LabelNode *>(A)->~LabelNode();
+    break;
+  case NodeKind::NK_Goto:
+    static_cast<GotoNode *>(A)->~GotoNode();
     break;
   }
 }
@@ -25,6 +25,8 @@ static RecursiveCoroutine<bool> needsLoopVarImpl(const ASTNode *N) {
   case ASTNode::NodeKind::NK_SwitchBreak:
   case ASTNode::NodeKind::NK_Continue:
   case ASTNode::NodeKind::NK_Code:
+  case ASTNode::NodeKind::NK_Label:
+  case ASTNode::NodeKind::NK_Goto:
     rc_return false;
     break;
 
@@ -80,7 +82,19 @@ bool needsLoopVar(const ASTNode *N) {
   return needsLoopVarImpl(N);
 }
 
-using UniqueExpr = ASTTree::expr_unique_ptr;
+bool flipIfEmptyThen(ASTTree &AST, IfNode *If) {
+  if (If->hasThen())
+    return false;
+
+  If->setThen(If->getElse());
+  If->setElse(nullptr);
+
+  // Invert the conditional expression of the current `IfNode`.
+  revng_assert(If->getCondExpr());
+  ExprNode *Not = AST.addCondExpr<NotNode>(If->getCondExpr());
+  If->replaceCondExpr(Not);
+  return true;
+}
 
 static RecursiveCoroutine<void> flipEmptyThenImpl(ASTTree &AST, ASTNode *Node) {
   if (auto *Sequence = llvm::dyn_cast<SequenceNode>(Node)) {
@@ -88,17 +102,7 @@ static RecursiveCoroutine<void> flipEmptyThenImpl(ASTTree &AST, ASTNode *Node) {
       flipEmptyThenImpl(AST, Node);
     }
   } else if (auto *If = llvm::dyn_cast<IfNode>(Node)) {
-    if (!If->hasThen()) {
-      If->setThen(If->getElse());
-      If->setElse(nullptr);
-
-      // Invert the conditional expression of the current `IfNode`.
-      UniqueExpr Not;
-      revng_assert(If->getCondExpr());
-      Not.reset(new NotNode(If->getCondExpr()));
-      ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-      If->replaceCondExpr(NotNode);
-
+    if (flipIfEmptyThen(AST, If)) {
       rc_recur flipEmptyThenImpl(AST, If->getThen());
     } else {
 
@@ -230,6 +234,8 @@ static RecursiveCoroutine<ASTNode *> collapseSequencesImpl(ASTTree &AST,
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing.
     break;
   default:
@@ -328,6 +334,8 @@ static RecursiveCoroutine<ASTNode *> simplifyAtomicSequenceImpl(ASTTree &AST,
   case ASTNode::NK_Break:
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Set:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
 
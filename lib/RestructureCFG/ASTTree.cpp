@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <cstdlib>
 
 #include "llvm/Support/FileSystem.h"
@@ -18,54 +19,49 @@ using ASTNodeMap = std::map<ASTNode *, ASTNode *>;
 using ExprNodeMap = std::map<ExprNode *, ExprNode *>;
 
 // Helper to obtain a unique incremental counter (to give name to sequence
-// nodes).
-static int Counter = 1;
+// nodes). ASTs of independent regions may be built concurrently.
+static std::atomic<int> Counter = 1;
 static std::string getID() {
   return std::to_string(Counter++);
 }
 
 SwitchBreakNode *ASTTree::addSwitchBreak(SwitchNode *SN) {
-  ASTNodeList.emplace_back(new SwitchBreakNode(SN));
-  ASTNodeList.back()->setID(getNewID());
-  return llvm::cast<SwitchBreakNode>(ASTNodeList.back().get());
+  return addASTNode<SwitchBreakNode>(SN);
 }
 
 SequenceNode *ASTTree::addSequenceNode() {
-  ASTNodeList.emplace_back(SequenceNode::createEmpty("sequence " + getID()));
-
-  // Set the Node ID
-  ASTNodeList.back()->setID(getNewID());
-
-  return llvm::cast<SequenceNode>(ASTNodeList.back().get());
+  auto *Sequence = SequenceNode::createEmpty(Allocator, "sequence " + getID());
+  return llvm::cast<SequenceNode>(addASTNodeImpl(Sequence));
 }
 
 size_t ASTTree::size() const {
   return ASTNodeList.size();
 }
 
-ASTNode *ASTTree::addASTNodeImpl(ast_unique_ptr &&ASTObject) {
-  ASTNodeList.emplace_back(std::move(ASTObject));
-  ASTNode *ASTNode = ASTNodeList.back().get();
+ASTNode *ASTTree::addASTNodeImpl(ASTNode *ASTObject) {
+  ASTNodeList.emplace_back(ASTObject);
 
   // Set the Node ID
-  ASTNode->setID(getNewID());
+  ASTObject->setID(getNewID());
 
-  return ASTNode;
+  return ASTObject;
 }
 
-void ASTTree::addASTNode(BasicBlockNode<BasicBlock *> *Node,
-                         ast_unique_ptr &&ASTObject) {
-  ASTNode *ASTNode = addASTNodeImpl(std::move(ASTObject));
+void ASTTree::setCFGNode(ASTNode *ASTObject, BasicBlockNodeBB *Node) {
+  unsigned ID = ASTObject->getID();
+  if (ASTBBMap.size() <= ID)
+    ASTBBMap.resize(IDCounter, nullptr);
 
-  // Proceed with the new insertion
-  bool New = BBASTMap.insert({ Node, ASTNode }).second;
-  revng_assert(New);
-  New = ASTBBMap.insert({ ASTNode, Node }).second;
-  revng_assert(New);
+  revng_assert(ASTBBMap[ID] == nullptr);
+  ASTBBMap[ID] = Node;
 }
 
-ASTNode *ASTTree::addASTNode(ast_unique_ptr &&ASTObject) {
-  return addASTNodeImpl(std::move(ASTObject));
+void ASTTree::mapASTNode(BasicBlockNode<BasicBlock *> *Node,
+                         ASTNode *ASTObject) {
+  // Proceed with the new insertion
+  bool New = BBASTMap.insert({ Node, ASTObject }).second;
+  revng_assert(New);
+  setCFGNode(ASTObject, Node);
 }
 
 void ASTTree::removeASTNode(ASTNode *Node) {
@@ -87,12 +83,10 @@ ASTNode *ASTTree::findASTNode(BasicBlockNode<BasicBlock *> *BlockNode) {
 }
 
 BasicBlockNode<BasicBlock *> *ASTTree::findCFGNode(ASTNode *ASTNode) {
-  auto It = ASTBBMap.find(ASTNode);
-  if (It != ASTBBMap.end())
-    return It->second;
   // We may return nullptr, since for example continue and break nodes do not
   // have a corresponding CFGNode.
-  return nullptr;
+  unsigned ID = ASTNode->getID();
+  return ID < ASTBBMap.size() ? ASTBBMap[ID] : nullptr;
 }
 
 void ASTTree::setRoot(ASTNode *Root) {
@@ -110,14 +104,9 @@ ASTNode *ASTTree::copyASTNodesFrom(ASTTree &OldAST) {
   // Clone each ASTNode in the current AST.
   links_container::difference_type NewNodes = 0;
   for (ASTNode *Old : OldAST.nodes()) {
-    ASTNodeList.emplace_back(std::move(Old->Clone()));
+    ASTNode *NewASTNode = addASTNodeImpl(Old->Clone(Allocator));
     ++NewNodes;
 
-    ASTNode *NewASTNode = ASTNodeList.back().get();
-
-    // Set the Node ID
-    NewASTNode->setID(getNewID());
-
     BasicBlockNode<BasicBlock *> *OldCFGNode = OldAST.findCFGNode(Old);
     if (OldCFGNode != nullptr) {
 
@@ -132,18 +121,16 @@ ASTNode *ASTTree::copyASTNodesFrom(ASTTree &OldAST) {
       // `insert` to guarantee that the AST tiling for that portion uses the
       // correct newer nodes.
       BBASTMap.insert_or_assign(OldCFGNode, NewASTNode);
-      bool New = ASTBBMap.insert({ NewASTNode, OldCFGNode }).second;
-      revng_assert(New);
+      setCFGNode(NewASTNode, OldCFGNode);
     }
     ASTSubstitutionMap[Old] = NewASTNode;
   }
 
-  // Clone the conditional expression nodes.
-  for (const expr_unique_ptr &OldExpr : OldAST.expressions()) {
-    CondExprList.emplace_back(new AtomicNode(*cast<AtomicNode>(OldExpr.get())),
-                              expr_destructor());
-    ExprNode *NewExpr = CondExprList.back().get();
-    CondExprMap[OldExpr.get()] = NewExpr;
+  // Clone the conditional expression nodes, sharing the ones that are already
+  // present in the current AST.
+  for (ExprNode *OldExpr : OldAST.expressions()) {
+    BasicBlock *BB = cast<AtomicNode>(OldExpr)->getConditionalBasicBlock();
+    CondExprMap[OldExpr] = addCondExpr<AtomicNode>(BB);
   }
 
   // Update the AST and BBNode pointers inside the newly created AST nodes,
@@ -205,7 +192,45 @@ void ASTTree::dumpASTOnFile(const std::string &FunctionName,
   dumpASTOnFile(PathName + "/" + FileName);
 }
 
-ExprNode *ASTTree::addCondExpr(expr_unique_ptr &&Expr) {
-  CondExprList.emplace_back(std::move(Expr));
-  return CondExprList.back().get();
+static ASTTree::ExprKey getExprKey(const ExprNode *Expr) {
+  unsigned Kind = Expr->getKind();
+  switch (Expr->getKind()) {
+  case ExprNode::NodeKind::NK_ValueCompare: {
+    auto *Compare = cast<ValueCompareNode>(Expr);
+    return { Kind,
+             Compare->getComparison(),
+             Compare->getBasicBlock(),
+             nullptr,
+             Compare->getConstant() };
+  }
+  case ExprNode::NodeKind::NK_LoopStateCompare: {
+    auto *Compare = cast<LoopStateCompareNode>(Expr);
+    return {
+      Kind, Compare->getComparison(), nullptr, nullptr, Compare->getConstant()
+    };
+  }
+  case ExprNode::NodeKind::NK_Atomic: {
+    auto *Atomic = cast<AtomicNode>(Expr);
+    return { Kind, 0, Atomic->getConditionalBasicBlock(), nullptr, 0 };
+  }
+  case ExprNode::NodeKind::NK_Not: {
+    auto *Not = cast<NotNode>(Expr);
+    return { Kind, 0, Not->getNegatedNode(), nullptr, 0 };
+  }
+  case ExprNode::NodeKind::NK_And:
+  case ExprNode::NodeKind::NK_Or: {
+    const auto &[LHS, RHS] = cast<BinaryNode>(Expr)->getInternalNodes();
+    return { Kind, 0, LHS, RHS, 0 };
+  }
+  }
+  revng_abort();
+}
+
+ExprNode *ASTTree::internCondExpr(ExprNode *Expr) {
+  // `ExprNode`s are trivially destructible, so a duplicate is simply left
+  // unused in the arena
+  auto [It, New] = InternedCondExprs.try_emplace(getExprKey(Expr), Expr);
+  if (New)
+    CondExprList.push_back(Expr);
+  return It->second;
 }
@@ -6,6 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Path.h"
@@ -23,6 +26,7 @@
 #include "revng-c/RestructureCFG/ExprNode.h"
 #include "revng-c/RestructureCFG/GenerateAst.h"
 #include "revng-c/RestructureCFG/RegionCFGTree.h"
+#include "revng-c/RestructureCFG/RestructureCFG.h"
 #include "revng-c/Support/DecompilationHelpers.h"
 
 #include "FallThroughScopeAnalysis.h"
@@ -79,283 +83,337 @@ openFunctionFile(const StringRef DirectoryPath,
 static unsigned ShortCircuitCounter = 0;
 static unsigned TrivialShortCircuitCounter = 0;
 
-static RecursiveCoroutine<bool> hasSideEffects(ExprNode *Expr) {
+/// Memoized results of `hasSideEffects`: conditions are interned by the
+/// `ASTTree`, so the ones shared by many `IfNode`s are inspected only once
+using SideEffectsMap = llvm::DenseMap<const ExprNode *, bool>;
+
+static RecursiveCoroutine<bool> hasSideEffects(ExprNode *Expr,
+                                               SideEffectsMap &Cache) {
+  auto It = Cache.find(Expr);
+  if (It != Cache.end())
+    rc_return It->second;
+
+  bool Result = true;
   switch (Expr->getKind()) {
 
   case ExprNode::NodeKind::NK_Atomic: {
     auto *Atomic = llvm::cast<AtomicNode>(Expr);
     llvm::BasicBlock *BB = Atomic->getConditionalBasicBlock();
+    Result = false;
     for (llvm::Instruction &I : *BB) {
 
       if (I.getType()->isVoidTy() and hasSideEffects(I)) {
         // For Instructions with void type, AddLocalVariablesDueToSideEffects
         // cannot properly assign them to LocalVariables because they have
         // void type, so we need to explicitly ask if they have side effects.
-        rc_return true;
+        Result = true;
+        break;
       } else {
         revng_assert(not isCallToTagged(&I, FunctionTags::Assign),
                      "call to assign should have matched void+hasSideEffects");
       }
     }
-    rc_return false;
   } break;
 
   case ExprNode::NodeKind::NK_Not: {
     auto *Not = llvm::cast<NotNode>(Expr);
-    rc_return rc_recur hasSideEffects(Not->getNegatedNode());
+    Result = rc_recur hasSideEffects(Not->getNegatedNode(), Cache);
   } break;
 
   case ExprNode::NodeKind::NK_And: {
     auto *And = llvm::cast<AndNode>(Expr);
     const auto [LHS, RHS] = And->getInternalNodes();
-    rc_return rc_recur hasSideEffects(LHS) or rc_recur hasSideEffects(RHS);
+    Result = rc_recur hasSideEffects(LHS, Cache)
+             or rc_recur hasSideEffects(RHS, Cache);
   } break;
 
   case ExprNode::NodeKind::NK_Or: {
     auto *Or = llvm::cast<OrNode>(Expr);
     const auto [LHS, RHS] = Or->getInternalNodes();
-    rc_return rc_recur hasSideEffects(LHS) or rc_recur hasSideEffects(RHS);
+    Result = rc_recur hasSideEffects(LHS, Cache)
+             or rc_recur hasSideEffects(RHS, Cache);
   } break;
 
   default:
     revng_abort();
   }
-  rc_return true;
+
+  Cache[Expr] = Result;
+  rc_return Result;
 }
 
-static bool hasSideEffects(IfNode *If) {
+static bool hasSideEffects(IfNode *If, SideEffectsMap &Cache) {
   // Compute how many statement we need to serialize for the basicblock
   // associated with the internal `IfNode`.
-  return hasSideEffects(If->getCondExpr());
+  return hasSideEffects(If->getCondExpr(), Cache);
 }
 
-using UniqueExpr = ASTTree::expr_unique_ptr;
+/// Index of the `IfNode`s of a GHAST and of the parent of each node, used to
+/// drive the rewrites that only look at an `IfNode` and at its branches.
+///
+/// Instead of walking the subtree of an `IfNode` again after each rewrite,
+/// only the `IfNode` that has changed is visited again.
+///
+/// \note this relies on the GHAST being a tree, i.e., on each node having a
+///       single parent.
+class IfRewriteDriver {
+private:
+  /// Parent of each node in the GHAST, the root has a null parent. Nodes that
+  /// have been dropped from the GHAST by a rewrite are removed.
+  llvm::DenseMap<ASTNode *, ASTNode *> Parents;
 
-// Helper function to simplify short-circuit IFs
-static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
+  /// All the `IfNode`s ever indexed, in pre-order
+  std::vector<IfNode *> Ifs;
 
-  if (auto *Sequence = llvm::dyn_cast<SequenceNode>(RootNode)) {
-    for (ASTNode *Node : Sequence->nodes()) {
-      simplifyShortCircuit(Node, AST);
+public:
+  explicit IfRewriteDriver(ASTNode *RootNode) { index(RootNode, nullptr); }
+
+public:
+  /// Visits the `IfNode`s top-down, applying \a Rewrite to each of them until
+  /// it does not change it anymore, and only then visiting its branches.
+  ///
+  /// \a Rewrite returns whether it changed the `IfNode` it was given. It can
+  /// only change its condition and rearrange its branches, using nodes that
+  /// are already part of the GHAST.
+  ///
+  /// \note like the recursive visit this replaces, an `IfNode` is not visited
+  ///       again after its descendants have been rewritten, even if that would
+  ///       allow rewriting it again.
+  template<typename RewriteT>
+  void rewriteTopDown(RewriteT &&Rewrite) {
+    std::vector<IfNode *> Worklist(Ifs.rbegin(), Ifs.rend());
+
+    while (not Worklist.empty()) {
+      IfNode *If = Worklist.back();
+      Worklist.pop_back();
+
+      if (not Parents.count(If))
+        continue;
+
+      ASTNode *OldThen = If->getThen();
+      ASTNode *OldElse = If->getElse();
+      if (not Rewrite(If))
+        continue;
+
+      updateBranches(If, OldThen, OldElse);
+
+      // Rewrite `If` again before moving on to its branches. They come after
+      // it in the Worklist, since it is in pre-order.
+      Worklist.push_back(If);
     }
+  }
 
-  } else if (auto *Scs = llvm::dyn_cast<ScsNode>(RootNode)) {
-    simplifyShortCircuit(Scs->getBody(), AST);
-  } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(RootNode)) {
+  /// Applies \a Rewrite once to each `IfNode` in the GHAST. \a Rewrite can
+  /// change the `IfNode` it was given, but not the set of its branches.
+  template<typename RewriteT>
+  void forEachIf(RewriteT &&Rewrite) {
+    for (IfNode *If : Ifs)
+      if (Parents.count(If))
+        Rewrite(If);
+  }
 
-    for (auto &LabelCasePair : Switch->cases())
-      simplifyShortCircuit(LabelCasePair.second, AST);
+private:
+  template<typename CallableT>
+  static void forEachChild(ASTNode *Node, CallableT &&Callable) {
+    if (auto *Sequence = llvm::dyn_cast<SequenceNode>(Node)) {
+      for (ASTNode *Child : Sequence->nodes())
+        Callable(Child);
+    } else if (auto *Scs = llvm::dyn_cast<ScsNode>(Node)) {
+      if (Scs->hasBody())
+        Callable(Scs->getBody());
+    } else if (auto *If = llvm::dyn_cast<IfNode>(Node)) {
+      if (If->hasThen())
+        Callable(If->getThen());
+      if (If->hasElse())
+        Callable(If->getElse());
+    } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(Node)) {
+      for (auto &LabelCasePair : Switch->cases())
+        Callable(LabelCasePair.second);
+    }
+  }
 
-  } else if (auto *If = llvm::dyn_cast<IfNode>(RootNode)) {
-    if (If->hasBothBranches()) {
-      if (auto NestedIf = llvm::dyn_cast_or_null<IfNode>(If->getThen())) {
-
-        // TODO: Refactor this with some kind of iterator
-        if (NestedIf->getThen() != nullptr) {
-
-          if (If->getElse()->isEqual(NestedIf->getThen())
-              and not hasSideEffects(NestedIf)) {
-            if (BeautifyLogger.isEnabled()) {
-              BeautifyLogger << "Candidate for short-circuit reduction found:";
-              BeautifyLogger << "\n";
-              BeautifyLogger << "IF " << If->getName() << " and ";
-              BeautifyLogger << "IF " << NestedIf->getName() << "\n";
-              BeautifyLogger << "Nodes being simplified:\n";
-              BeautifyLogger << If->getElse()->getName() << " and ";
-              BeautifyLogger << NestedIf->getThen()->getName() << "\n";
-            }
-            If->setThen(NestedIf->getElse());
-            If->setElse(NestedIf->getThen());
-
-            // `if A and not B` situation.
-            UniqueExpr NotB;
-            NotB.reset(new NotNode(NestedIf->getCondExpr()));
-            ExprNode *NotBNode = AST.addCondExpr(std::move(NotB));
-
-            UniqueExpr AAndNotB;
-            AAndNotB.reset(new AndNode(If->getCondExpr(), NotBNode));
-
-            ExprNode *AAndNotBNode = AST.addCondExpr(std::move(AAndNotB));
-
-            If->replaceCondExpr(AAndNotBNode);
-
-            // Increment counter
-            ShortCircuitCounter += 1;
-
-            // Recursive call.
-            simplifyShortCircuit(If, AST);
-          }
-        }
+  void index(ASTNode *RootNode, ASTNode *RootParent) {
+    llvm::SmallVector<std::pair<ASTNode *, ASTNode *>, 16> Stack;
+    Stack.push_back({ RootNode, RootParent });
+    while (not Stack.empty()) {
+      auto [Node, Parent] = Stack.pop_back_val();
+      Parents[Node] = Parent;
+      if (auto *If = llvm::dyn_cast<IfNode>(Node))
+        Ifs.push_back(If);
+
+      // Push the children in reverse order, to visit them in pre-order
+      size_t FirstChild = Stack.size();
+      forEachChild(Node, [&](ASTNode *Child) {
+        Stack.push_back({ Child, Node });
+      });
+      std::reverse(std::next(Stack.begin(), FirstChild), Stack.end());
+    }
+  }
 
-        if (NestedIf->getElse() != nullptr) {
-          if (If->getElse()->isEqual(NestedIf->getElse())
-              and not hasSideEffects(NestedIf)) {
-            if (BeautifyLogger.isEnabled()) {
-              BeautifyLogger << "Candidate for short-circuit reduction found:";
-              BeautifyLogger << "\n";
-              BeautifyLogger << "IF " << If->getName() << " and ";
-              BeautifyLogger << "IF " << NestedIf->getName() << "\n";
-              BeautifyLogger << "Nodes being simplified:\n";
-              BeautifyLogger << If->getElse()->getName() << " and ";
-              BeautifyLogger << NestedIf->getElse()->getName() << "\n";
-            }
-            If->setThen(NestedIf->getThen());
-            If->setElse(NestedIf->getElse());
-
-            // `if A and B` situation.
-            UniqueExpr AAndB;
-            {
-              ExprNode *E = new AndNode(If->getCondExpr(),
-                                        NestedIf->getCondExpr());
-              AAndB.reset(E);
-            }
-
-            ExprNode *AAndBNode = AST.addCondExpr(std::move(AAndB));
-
-            If->replaceCondExpr(AAndBNode);
-
-            // Increment counter
-            ShortCircuitCounter += 1;
-
-            simplifyShortCircuit(If, AST);
-          }
-        }
-      }
+  /// Removes from the index the subtree rooted at \a Node, except for the
+  /// subtrees rooted in \a Kept
+  void drop(ASTNode *Node, const llvm::SmallPtrSetImpl<ASTNode *> &Kept) {
+    llvm::SmallVector<ASTNode *, 16> Stack = { Node };
+    while (not Stack.empty()) {
+      ASTNode *Current = Stack.pop_back_val();
+      if (Kept.contains(Current))
+        continue;
+      Parents.erase(Current);
+      forEachChild(Current, [&](ASTNode *Child) { Stack.push_back(Child); });
     }
-    if (If->hasBothBranches()) {
-      if (auto NestedIf = llvm::dyn_cast_or_null<IfNode>(If->getElse())) {
-        // TODO: Refactor this with some kind of iterator
-        if (NestedIf->getThen() != nullptr) {
-          if (If->getThen()->isEqual(NestedIf->getThen())
-              and not hasSideEffects(NestedIf)) {
-            if (BeautifyLogger.isEnabled()) {
-              BeautifyLogger << "Candidate for short-circuit reduction found:";
-              BeautifyLogger << "\n";
-              BeautifyLogger << "IF " << If->getName() << " and ";
-              BeautifyLogger << "IF " << NestedIf->getName() << "\n";
-              BeautifyLogger << "Nodes being simplified:\n";
-              BeautifyLogger << If->getThen()->getName() << " and ";
-              BeautifyLogger << NestedIf->getThen()->getName() << "\n";
-            }
-            If->setElse(NestedIf->getElse());
-            If->setThen(NestedIf->getThen());
-
-            // `if not A and not B` situation.
-            UniqueExpr NotA;
-            NotA.reset(new NotNode(If->getCondExpr()));
-            ExprNode *NotANode = AST.addCondExpr(std::move(NotA));
-
-            UniqueExpr NotB;
-            NotB.reset(new NotNode(NestedIf->getCondExpr()));
-            ExprNode *NotBNode = AST.addCondExpr(std::move(NotB));
-
-            UniqueExpr NotAAndNotB;
-            NotAAndNotB.reset(new AndNode(NotANode, NotBNode));
-            ExprNode *NotAAndNotBNode = AST.addCondExpr(std::move(NotAAndNotB));
-
-            If->replaceCondExpr(NotAAndNotBNode);
-
-            // Increment counter
-            ShortCircuitCounter += 1;
-
-            simplifyShortCircuit(If, AST);
-          }
-        }
+  }
 
-        if (NestedIf->getElse() != nullptr) {
-          if (If->getThen()->isEqual(NestedIf->getElse())
-              and not hasSideEffects(NestedIf)) {
-            if (BeautifyLogger.isEnabled()) {
-              BeautifyLogger << "Candidate for short-circuit reduction found:";
-              BeautifyLogger << "\n";
-              BeautifyLogger << "IF " << If->getName() << " and ";
-              BeautifyLogger << "IF " << NestedIf->getName() << "\n";
-              BeautifyLogger << "Nodes being simplified:\n";
-              BeautifyLogger << If->getThen()->getName() << " and ";
-              BeautifyLogger << NestedIf->getElse()->getName() << "\n";
-            }
-            If->setElse(NestedIf->getThen());
-            If->setThen(NestedIf->getElse());
-
-            // `if not A and B` situation.
-            UniqueExpr NotA;
-            NotA.reset(new NotNode(If->getCondExpr()));
-            ExprNode *NotANode = AST.addCondExpr(std::move(NotA));
-
-            UniqueExpr NotAAndB;
-            NotAAndB.reset(new AndNode(NotANode, NestedIf->getCondExpr()));
-            ExprNode *NotAAndBNode = AST.addCondExpr(std::move(NotAAndB));
-
-            If->replaceCondExpr(NotAAndBNode);
-
-            // Increment counter
-            ShortCircuitCounter += 1;
-
-            simplifyShortCircuit(If, AST);
-          }
-        }
-      }
+  void updateBranches(IfNode *If, ASTNode *OldThen, ASTNode *OldElse) {
+    llvm::SmallPtrSet<ASTNode *, 2> Branches;
+    for (ASTNode *Branch : { If->getThen(), If->getElse() })
+      if (Branch != nullptr)
+        Branches.insert(Branch);
+
+    for (ASTNode *OldBranch : { OldThen, OldElse })
+      if (OldBranch != nullptr)
+        drop(OldBranch, Branches);
+
+    for (ASTNode *Branch : Branches) {
+      revng_assert(Parents.count(Branch));
+      Parents[Branch] = If;
     }
+  }
+};
 
-    if (If->hasThen())
-      simplifyShortCircuit(If->getThen(), AST);
-    if (If->hasElse())
-      simplifyShortCircuit(If->getElse(), AST);
+static void logShortCircuit(IfNode *If,
+                            IfNode *NestedIf,
+                            ASTNode *First,
+                            ASTNode *Second) {
+  if (BeautifyLogger.isEnabled()) {
+    BeautifyLogger << "Candidate for short-circuit reduction found:";
+    BeautifyLogger << "\n";
+    BeautifyLogger << "IF " << If->getName() << " and ";
+    BeautifyLogger << "IF " << NestedIf->getName() << "\n";
+    BeautifyLogger << "Nodes being simplified:\n";
+    BeautifyLogger << First->getName() << " and ";
+    BeautifyLogger << Second->getName() << "\n";
   }
 }
 
-static void simplifyTrivialShortCircuit(ASTNode *RootNode, ASTTree &AST) {
-  if (auto *Sequence = llvm::dyn_cast<SequenceNode>(RootNode)) {
-    for (ASTNode *Node : Sequence->nodes()) {
-      simplifyTrivialShortCircuit(Node, AST);
+/// Merges \a If with an `IfNode` nested in one of its branches, if the other
+/// branch of \a If is equal to one of the branches of the nested `IfNode`.
+/// Returns whether it did.
+static bool
+simplifyShortCircuit(IfNode *If, ASTTree &AST, SideEffectsMap &SideEffects) {
+  if (not If->hasBothBranches())
+    return false;
+
+  if (auto *NestedIf = llvm::dyn_cast<IfNode>(If->getThen())) {
+    if (NestedIf->getThen() != nullptr
+        and If->getElse()->isEqual(NestedIf->getThen())
+        and not hasSideEffects(NestedIf, SideEffects)) {
+      logShortCircuit(If, NestedIf, If->getElse(), NestedIf->getThen());
+      If->setThen(NestedIf->getElse());
+      If->setElse(NestedIf->getThen());
+
+      // `if A and not B` situation.
+      ExprNode *NotB = AST.addCondExpr<NotNode>(NestedIf->getCondExpr());
+      ExprNode *AAndNotB = AST.addCondExpr<AndNode>(If->getCondExpr(), NotB);
+      If->replaceCondExpr(AAndNotB);
+
+      // Increment counter
+      ShortCircuitCounter += 1;
+      return true;
     }
-  } else if (auto *Scs = llvm::dyn_cast<ScsNode>(RootNode)) {
-    simplifyTrivialShortCircuit(Scs->getBody(), AST);
 
-  } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(RootNode)) {
+    if (NestedIf->getElse() != nullptr
+        and If->getElse()->isEqual(NestedIf->getElse())
+        and not hasSideEffects(NestedIf, SideEffects)) {
+      logShortCircuit(If, NestedIf, If->getElse(), NestedIf->getElse());
+      If->setThen(NestedIf->getThen());
+      If->setElse(NestedIf->getElse());
+
+      // `if A and B` situation.
+      ExprNode *AAndB = AST.addCondExpr<AndNode>(If->getCondExpr(),
+                                                 NestedIf->getCondExpr());
+      If->replaceCondExpr(AAndB);
+
+      // Increment counter
+      ShortCircuitCounter += 1;
+      return true;
+    }
+  }
 
-    for (auto &LabelCasePair : Switch->cases())
-      simplifyTrivialShortCircuit(LabelCasePair.second, AST);
+  if (auto *NestedIf = llvm::dyn_cast<IfNode>(If->getElse())) {
+    if (NestedIf->getThen() != nullptr
+        and If->getThen()->isEqual(NestedIf->getThen())
+        and not hasSideEffects(NestedIf, SideEffects)) {
+      logShortCircuit(If, NestedIf, If->getThen(), NestedIf->getThen());
+      If->setElse(NestedIf->getElse());
+      If->setThen(NestedIf->getThen());
+
+      // `if not A and not B` situation.
+      ExprNode *NotA = AST.addCondExpr<NotNode>(If->getCondExpr());
+      ExprNode *NotB = AST.addCondExpr<NotNode>(NestedIf->getCondExpr());
+      ExprNode *NotAAndNotB = AST.addCondExpr<AndNode>(NotA, NotB);
+      If->replaceCondExpr(NotAAndNotB);
+
+      // Increment counter
+      ShortCircuitCounter += 1;
+      return true;
+    }
 
-  } else if (auto *If = llvm::dyn_cast<IfNode>(RootNode)) {
-    if (!If->hasElse()) {
-      if (auto *InternalIf = llvm::dyn_cast<IfNode>(If->getThen())) {
-        if (!InternalIf->hasElse() and not hasSideEffects(InternalIf)) {
-          if (BeautifyLogger.isEnabled()) {
-            BeautifyLogger << "Candidate for trivial short-circuit reduction";
-            BeautifyLogger << "found:\n";
-            BeautifyLogger << "IF " << If->getName() << " and ";
-            BeautifyLogger << "If " << InternalIf->getName() << "\n";
-            BeautifyLogger << "Nodes being simplified:\n";
-            BeautifyLogger << If->getThen()->getName() << " and ";
-            BeautifyLogger << InternalIf->getThen()->getName() << "\n";
-          }
-          If->setThen(InternalIf->getThen());
-
-          // `if A and B` situation.
-          UniqueExpr AAndB;
-          {
-            ExprNode *E = new AndNode(If->getCondExpr(),
-                                      InternalIf->getCondExpr());
-            AAndB.reset(E);
-          }
-          ExprNode *AAndBNode = AST.addCondExpr(std::move(AAndB));
-
-          If->replaceCondExpr(AAndBNode);
-
-          // Increment counter
-          TrivialShortCircuitCounter += 1;
-
-          simplifyTrivialShortCircuit(RootNode, AST);
-        }
-      }
+    if (NestedIf->getElse() != nullptr
+        and If->getThen()->isEqual(NestedIf->getElse())
+        and not hasSideEffects(NestedIf, SideEffects)) {
+      logShortCircuit(If, NestedIf, If->getThen(), NestedIf->getElse());
+      If->setElse(NestedIf->getThen());
+      If->setThen(NestedIf->getElse());
+
+      // `if not A and B` situation.
+      ExprNode *NotA = AST.addCondExpr<NotNode>(If->getCondExpr());
+      ExprNode *NotAAndB = AST.addCondExpr<AndNode>(NotA,
+                                                    NestedIf->getCondExpr());
+      If->replaceCondExpr(NotAAndB);
+
+      // Increment counter
+      ShortCircuitCounter += 1;
+      return true;
     }
+  }
 
-    if (If->hasThen())
-      simplifyTrivialShortCircuit(If->getThen(), AST);
-    if (If->hasElse())
-      simplifyTrivialShortCircuit(If->getElse(), AST);
+  return false;
+}
+
+/// Merges \a If, which has no `else` branch, with an `IfNode` without `else`
+/// branch that is its `then` branch. Returns whether it did.
+static bool simplifyTrivialShortCircuit(IfNode *If,
+                                        ASTTree &AST,
+                                        SideEffectsMap &SideEffects) {
+  if (If->hasElse())
+    return false;
+
+  auto *InternalIf = llvm::dyn_cast_or_null<IfNode>(If->getThen());
+  if (not InternalIf or InternalIf->hasElse())
+    return false;
+
+  if (hasSideEffects(InternalIf, SideEffects))
+    return false;
+
+  if (BeautifyLogger.isEnabled()) {
+    BeautifyLogger << "Candidate for trivial short-circuit reduction";
+    BeautifyLogger << "found:\n";
+    BeautifyLogger << "IF " << If->getName() << " and ";
+    BeautifyLogger << "If " << InternalIf->getName() << "\n";
+    BeautifyLogger << "Nodes being simplified:\n";
+    BeautifyLogger << If->getThen()->getName() << " and ";
+    BeautifyLogger << InternalIf->getThen()->getName() << "\n";
   }
+  If->setThen(InternalIf->getThen());
+
+  // `if A and B` situation.
+  ExprNode *AAndB = AST.addCondExpr<AndNode>(If->getCondExpr(),
+                                             InternalIf->getCondExpr());
+  If->replaceCondExpr(AAndB);
+
+  // Increment counter
+  TrivialShortCircuitCounter += 1;
+  return true;
 }
 
 static ASTNode *matchSwitch(ASTTree &AST, ASTNode *RootNode) {
@@ -388,87 +446,57 @@ static ASTNode *matchSwitch(ASTTree &AST, ASTNode *RootNode) {
   return RootNode;
 }
 
-static void matchDoWhile(ASTNode *RootNode, ASTTree &AST) {
-
-  BeautifyLogger << "Matching do whiles"
-                 << "\n";
-  if (auto *Sequence = llvm::dyn_cast<SequenceNode>(RootNode)) {
-    for (ASTNode *Node : Sequence->nodes()) {
-      matchDoWhile(Node, AST);
-    }
-  } else if (auto *If = llvm::dyn_cast<IfNode>(RootNode)) {
-    if (If->hasThen()) {
-      matchDoWhile(If->getThen(), AST);
-    }
-    if (If->hasElse()) {
-      matchDoWhile(If->getElse(), AST);
-    }
-
-  } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(RootNode)) {
-
-    for (auto &LabelCasePair : Switch->cases())
-      matchDoWhile(LabelCasePair.second, AST);
-
-  } else if (auto *Scs = llvm::dyn_cast<ScsNode>(RootNode)) {
-    ASTNode *Body = Scs->getBody();
-
-    // Body could be nullptr (previous while/dowhile semplification)
-    if (Body == nullptr)
-      return;
-
-    // Recursive scs nesting handling
-    matchDoWhile(Body, AST);
+static void matchDoWhile(ScsNode *Scs, ASTTree &AST) {
+  ASTNode *Body = Scs->getBody();
 
-    // We don't want to transform a do-while in a while
-    if (Scs->isWhile())
-      return;
+  // Body could be nullptr (previous while/dowhile semplification)
+  if (Body == nullptr)
+    return;
 
-    ASTNode *LastNode = Body;
-    auto *SequenceBody = llvm::dyn_cast<SequenceNode>(Body);
-    if (SequenceBody) {
-      revng_assert(not SequenceBody->nodes().empty());
-      LastNode = *std::prev(SequenceBody->nodes().end());
-    }
-    revng_assert(LastNode);
+  // We don't want to transform a do-while in a while
+  if (Scs->isWhile())
+    return;
 
-    auto *NestedIf = llvm::dyn_cast<IfNode>(LastNode);
-    if (not NestedIf)
-      return;
+  ASTNode *LastNode = Body;
+  auto *SequenceBody = llvm::dyn_cast<SequenceNode>(Body);
+  if (SequenceBody) {
+    revng_assert(not SequenceBody->nodes().empty());
+    LastNode = *std::prev(SequenceBody->nodes().end());
+  }
+  revng_assert(LastNode);
 
-    ASTNode *Then = NestedIf->getThen();
-    ASTNode *Else = NestedIf->getElse();
-    auto *ThenBreak = llvm::dyn_cast_or_null<BreakNode>(Then);
-    auto *ElseBreak = llvm::dyn_cast_or_null<BreakNode>(Else);
-    auto *ThenContinue = llvm::dyn_cast_or_null<ContinueNode>(Then);
-    auto *ElseContinue = llvm::dyn_cast_or_null<ContinueNode>(Else);
+  auto *NestedIf = llvm::dyn_cast<IfNode>(LastNode);
+  if (not NestedIf)
+    return;
 
-    bool HandledCases = (ThenBreak and ElseContinue)
-                        or (ThenContinue and ElseBreak);
-    if (not HandledCases)
-      return;
+  ASTNode *Then = NestedIf->getThen();
+  ASTNode *Else = NestedIf->getElse();
+  auto *ThenBreak = llvm::dyn_cast_or_null<BreakNode>(Then);
+  auto *ElseBreak = llvm::dyn_cast_or_null<BreakNode>(Else);
+  auto *ThenContinue = llvm::dyn_cast_or_null<ContinueNode>(Then);
+  auto *ElseContinue = llvm::dyn_cast_or_null<ContinueNode>(Else);
 
-    Scs->setDoWhile(NestedIf);
+  bool HandledCases = (ThenBreak and ElseContinue)
+                      or (ThenContinue and ElseBreak);
+  if (not HandledCases)
+    return;
 
-    if (ThenBreak and ElseContinue) {
-      // Invert the conditional expression of the current `IfNode`.
-      UniqueExpr Not;
-      Not.reset(new NotNode(NestedIf->getCondExpr()));
-      ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-      NestedIf->replaceCondExpr(NotNode);
+  Scs->setDoWhile(NestedIf);
 
-    } else {
-      revng_assert(ElseBreak and ThenContinue);
-    }
+  if (ThenBreak and ElseContinue) {
+    // Invert the conditional expression of the current `IfNode`.
+    ExprNode *Not = AST.addCondExpr<NotNode>(NestedIf->getCondExpr());
+    NestedIf->replaceCondExpr(Not);
 
-    // Remove the if node
-    if (SequenceBody) {
-      SequenceBody->removeNode(NestedIf);
-    } else {
-      Scs->setBody(nullptr);
-    }
+  } else {
+    revng_assert(ElseBreak and ThenContinue);
+  }
 
+  // Remove the if node
+  if (SequenceBody) {
+    SequenceBody->removeNode(NestedIf);
   } else {
-    BeautifyLogger << "No matching done\n";
+    Scs->setBody(nullptr);
   }
 }
 
@@ -496,92 +524,99 @@ static void addComputationToContinue(ASTNode *RootNode, IfNode *ConditionIf) {
   }
 }
 
-static void matchWhile(ASTNode *RootNode, ASTTree &AST) {
+static void matchWhile(ScsNode *Scs, ASTTree &AST) {
+  ASTNode *Body = Scs->getBody();
+
+  // Body could be nullptr (previous while/dowhile semplification)
+  if (Body == nullptr)
+    return;
+
+  // We don't want to transform a while in a do-while
+  if (Scs->isDoWhile())
+    return;
+
+  ASTNode *FirstNode = Body;
+  auto *SequenceBody = llvm::dyn_cast<SequenceNode>(Body);
+  if (SequenceBody) {
+    revng_assert(not SequenceBody->nodes().empty());
+    FirstNode = *SequenceBody->nodes().begin();
+  }
+  revng_assert(FirstNode);
+
+  auto *NestedIf = llvm::dyn_cast<IfNode>(FirstNode);
+  if (not NestedIf)
+    return;
+
+  ASTNode *Then = NestedIf->getThen();
+  ASTNode *Else = NestedIf->getElse();
+  auto *ThenBreak = llvm::dyn_cast_or_null<BreakNode>(Then);
+  auto *ElseBreak = llvm::dyn_cast_or_null<BreakNode>(Else);
+
+  // Without a break, this if cannot become a while
+  if (not ThenBreak and not ElseBreak)
+    return;
+
+  // This is a while
+  Scs->setWhile(NestedIf);
+
+  ASTNode *BranchThatStaysInside = nullptr;
+  if (ElseBreak) {
+    BranchThatStaysInside = Then;
+
+  } else {
+    revng_assert(llvm::isa<BreakNode>(Then));
+    BranchThatStaysInside = Else;
+
+    // If the break node is the then branch, we should invert the
+    // conditional expression of the current `IfNode`.
+    ExprNode *Not = AST.addCondExpr<NotNode>(NestedIf->getCondExpr());
+    NestedIf->replaceCondExpr(Not);
+  }
+
+  // Remove the if node
+  if (SequenceBody) {
+    SequenceBody->removeNode(NestedIf);
+    if (BranchThatStaysInside) {
+      auto &Seq = SequenceBody->getChildVec();
+      Seq.insert(Seq.begin(), BranchThatStaysInside);
+    }
+  } else {
+    Scs->setBody(BranchThatStaysInside);
+  }
+  // Add computation before the continue nodes
+  addComputationToContinue(Scs->getBody(), NestedIf);
+}
+
+/// Matches `do-while` and `while` loops in a single visit. Matching a loop only
+/// looks at its own body and never affects the matching of the loops nesting
+/// it, so each loop can be handled as soon as its body has been visited.
+static void matchLoops(ASTNode *RootNode, ASTTree &AST) {
   if (auto *Sequence = llvm::dyn_cast<SequenceNode>(RootNode)) {
     for (ASTNode *Node : Sequence->nodes()) {
-      matchWhile(Node, AST);
+      matchLoops(Node, AST);
     }
   } else if (auto *If = llvm::dyn_cast<IfNode>(RootNode)) {
     if (If->hasThen()) {
-      matchWhile(If->getThen(), AST);
+      matchLoops(If->getThen(), AST);
     }
     if (If->hasElse()) {
-      matchWhile(If->getElse(), AST);
+      matchLoops(If->getElse(), AST);
     }
 
   } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(RootNode)) {
 
     for (auto &LabelCasePair : Switch->cases())
-      matchWhile(LabelCasePair.second, AST);
+      matchLoops(LabelCasePair.second, AST);
 
   } else if (auto *Scs = llvm::dyn_cast<ScsNode>(RootNode)) {
-    ASTNode *Body = Scs->getBody();
-
-    // Body could be nullptr (previous while/dowhile semplification)
-    if (Body == nullptr)
-      return;
 
     // Recursive scs nesting handling
-    matchWhile(Body, AST);
-
-    // We don't want to transform a while in a do-while
-    if (Scs->isDoWhile())
-      return;
-
-    ASTNode *FirstNode = Body;
-    auto *SequenceBody = llvm::dyn_cast<SequenceNode>(Body);
-    if (SequenceBody) {
-      revng_assert(not SequenceBody->nodes().empty());
-      FirstNode = *SequenceBody->nodes().begin();
-    }
-    revng_assert(FirstNode);
-
-    auto *NestedIf = llvm::dyn_cast<IfNode>(FirstNode);
-    if (not NestedIf)
-      return;
-
-    ASTNode *Then = NestedIf->getThen();
-    ASTNode *Else = NestedIf->getElse();
-    auto *ThenBreak = llvm::dyn_cast_or_null<BreakNode>(Then);
-    auto *ElseBreak = llvm::dyn_cast_or_null<BreakNode>(Else);
-
-    // Without a break, this if cannot become a while
-    if (not ThenBreak and not ElseBreak)
-      return;
-
-    // This is a while
-    Scs->setWhile(NestedIf);
-
-    ASTNode *BranchThatStaysInside = nullptr;
-    if (ElseBreak) {
-      BranchThatStaysInside = Then;
+    if (Scs->hasBody())
+      matchLoops(Scs->getBody(), AST);
 
-    } else {
-      revng_assert(llvm::isa<BreakNode>(Then));
-      BranchThatStaysInside = Else;
-
-      // If the break node is the then branch, we should invert the
-      // conditional expression of the current `IfNode`.
-      UniqueExpr Not;
-      Not.reset(new NotNode(NestedIf->getCondExpr()));
-      ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-      NestedIf->replaceCondExpr(NotNode);
-    }
-
-    // Remove the if node
-    if (SequenceBody) {
-      SequenceBody->removeNode(NestedIf);
-      if (BranchThatStaysInside) {
-        auto &Seq = SequenceBody->getChildVec();
-        Seq.insert(Seq.begin(), BranchThatStaysInside);
-      }
-    } else {
-      Scs->setBody(BranchThatStaysInside);
-    }
-    // Add computation before the continue nodes
-    addComputationToContinue(Scs->getBody(), NestedIf);
-  } else {
-    BeautifyLogger << "No matching done\n";
+    BeautifyLogger << "Matching do-while and while\n";
+    matchDoWhile(Scs, AST);
+    matchWhile(Scs, AST);
   }
 }
 
@@ -658,6 +693,8 @@ protected:
     case ASTNode::NK_Set:
     case ASTNode::NK_Code:
     case ASTNode::NK_Continue:
+    case ASTNode::NK_Label:
+    case ASTNode::NK_Goto:
       break; // do nothing
     }
   }
@@ -763,12 +800,17 @@ computeCumulativeNodeWeight(ASTNode *Node,
   } break;
   case ASTNode::NK_Set:
   case ASTNode::NK_SwitchBreak:
-  case ASTNode::NK_Break: {
+  case ASTNode::NK_Break:
+  case ASTNode::NK_Goto: {
 
     // If we assign weight 1 to all these cases, no distinction is needed for
     // them.
     rc_return 1;
   } break;
+  case ASTNode::NK_Label: {
+    // Labels do not emit any statement on their own
+    rc_return 0;
+  } break;
   default:
     revng_abort();
   }
@@ -923,6 +965,8 @@ promoteNoFallthrough(ASTTree &AST,
   case ASTNode::NK_Set:
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing.
     break;
   default:
@@ -962,7 +1006,10 @@ static ASTNode *promoteNoFallthroughIf(const model::Binary &Model,
   return RootNode;
 }
 
-void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
+void beautifyAST(const model::Binary &Model,
+                 Function &F,
+                 ASTTree &CombedAST,
+                 RestructureMetrics *Metrics) {
 
   // If the --short-circuit-metrics-output-dir=dir argument was passed from
   // command line, we need to print the statistics for the short circuit metrics
@@ -981,9 +1028,20 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
 
   Dumper.log("before-beautify");
 
+  // The following simplifications only look at an `IfNode` and at its
+  // branches: they share an index of the `IfNode`s, and each rewrite only
+  // causes the nodes it affects to be visited again.
+  IfRewriteDriver IfRewrites(RootNode);
+  auto FlipEmptyThen = [&CombedAST](IfNode *If) {
+    flipIfEmptyThen(CombedAST, If);
+  };
+
   // Simplify short-circuit nodes.
   revng_log(BeautifyLogger, "Performing short-circuit simplification\n");
-  simplifyShortCircuit(RootNode, CombedAST);
+  SideEffectsMap SideEffects;
+  IfRewrites.rewriteTopDown([&CombedAST, &SideEffects](IfNode *If) {
+    return simplifyShortCircuit(If, CombedAST, SideEffects);
+  });
   Dumper.log("after-short-circuit");
 
   // Flip IFs with empty then branches.
@@ -992,13 +1050,15 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
   // simplify. In this way we can keep it simple.
   revng_log(BeautifyLogger,
             "Performing IFs with empty then branches flipping\n");
-  flipEmptyThen(CombedAST, RootNode);
+  IfRewrites.forEachIf(FlipEmptyThen);
   Dumper.log("after-if-flip");
 
   // Simplify trivial short-circuit nodes.
   revng_log(BeautifyLogger,
             "Performing trivial short-circuit simplification\n");
-  simplifyTrivialShortCircuit(RootNode, CombedAST);
+  IfRewrites.rewriteTopDown([&CombedAST, &SideEffects](IfNode *If) {
+    return simplifyTrivialShortCircuit(If, CombedAST, SideEffects);
+  });
   Dumper.log("after-trivial-short-circuit");
 
   // Flip IFs with empty then branches.
@@ -1007,7 +1067,7 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
   // want to flip them as well.
   revng_log(BeautifyLogger,
             "Performing IFs with empty then branches flipping\n");
-  flipEmptyThen(CombedAST, RootNode);
+  IfRewrites.forEachIf(FlipEmptyThen);
   Dumper.log("after-if-flip");
 
   // Match switch node.
@@ -1040,15 +1100,10 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
   RootNode = simplifyAtomicSequence(CombedAST, RootNode);
   Dumper.log("after-empty-sequences-removal");
 
-  // Match dowhile.
-  revng_log(BeautifyLogger, "Matching do-while\n");
-  matchDoWhile(RootNode, CombedAST);
-  Dumper.log("after-match-do-while");
-
-  // Match while.
-  revng_log(BeautifyLogger, "Matching while\n");
-  matchWhile(RootNode, CombedAST);
-  Dumper.log("after-match-while");
+  // Match do-while and while.
+  revng_log(BeautifyLogger, "Matching do-while and while\n");
+  matchLoops(RootNode, CombedAST);
+  Dumper.log("after-match-loops");
 
   // Remove unnecessary scopes under the fallthrough analysis.
   revng_log(BeautifyLogger, "Analyzing fallthrough scopes\n");
@@ -1098,4 +1153,9 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
                      << F.getName().data() << "," << ShortCircuitCounter << ","
                      << TrivialShortCircuitCounter << "\n";
   }
+
+  if (Metrics) {
+    Metrics->ShortCircuits = ShortCircuitCounter;
+    Metrics->TrivialShortCircuits = TrivialShortCircuitCounter;
+  }
 }
@@ -229,6 +229,12 @@ fallThroughScopeImpl(const model::Binary &Model,
   case ASTNode::NK_Break: {
     rc_return FallThroughScopeType::LoopBreak;
   } break;
+  case ASTNode::NK_Label: {
+    rc_return FallThroughScopeType::FallThrough;
+  } break;
+  case ASTNode::NK_Goto: {
+    rc_return FallThroughScopeType::Goto;
+  } break;
   default:
     revng_abort();
   }
@@ -22,6 +22,7 @@ enum class FallThroughScopeType {
   Continue,
   LoopBreak,
   SwitchBreak,
+  Goto,
 };
 
 using FallThroughScopeTypeMap = std::map<const ASTNode *, FallThroughScopeType>;
@@ -89,6 +89,8 @@ countSetNodeInLoop(ASTNode *Node, SetNodeCounterMap &CounterMap) {
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -212,6 +214,8 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -434,7 +438,9 @@ static RecursiveCoroutine<bool> containsSet(ASTNode *Node) {
   case ASTNode::NK_Code:
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
-  case ASTNode::NK_Break: {
+  case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto: {
     rc_return false;
   } break;
   default:
@@ -672,6 +678,8 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -804,6 +812,8 @@ static RecursiveCoroutine<ASTNode *> simplifySwitchBreakImpl(ASTNode *Node) {
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -31,7 +31,8 @@ static bool isPreferredAsFallThrough(FallThroughScopeType Element) {
   case FallThroughScopeType::Return:
   case FallThroughScopeType::Continue:
   case FallThroughScopeType::LoopBreak:
-  case FallThroughScopeType::SwitchBreak: {
+  case FallThroughScopeType::SwitchBreak:
+  case FallThroughScopeType::Goto: {
     return true;
   } break;
   case FallThroughScopeType::FallThrough:
@@ -168,6 +169,8 @@ promoteCallNoReturnImpl(ASTTree &AST,
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -5,12 +5,28 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/Support/CommandLine.h"
+
+#include "revng/Support/CommandLine.h"
+
 #include "revng-c/RestructureCFG/RegionCFGTreeImpl.h"
 
+using namespace llvm::cl;
+
 // Explicit instantiation for the `RegionCFG` template class.
 template class RegionCFG<llvm::BasicBlock *>;
 
-unsigned DuplicationCounter = 0;
+std::atomic<unsigned> DuplicationCounter = 0;
+std::atomic<unsigned> DuplicatedWeightCounter = 0;
+
+opt<unsigned> DuplicationBudget("restructure-duplication-budget",
+                                desc("Maximum weight duplicated by the comb, "
+                                     "as a percentage of the region weight. "
+                                     "Regions exceeding it are emitted with "
+                                     "gotos. 0 means no limit."),
+                                value_desc("percentage"),
+                                init(0),
+                                cat(MainCategory));
 
-unsigned UntangleTentativeCounter = 0;
-unsigned UntanglePerformedCounter = 0;
+std::atomic<unsigned> UntangleTentativeCounter = 0;
+std::atomic<unsigned> UntanglePerformedCounter = 0;
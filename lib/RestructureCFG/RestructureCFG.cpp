@@ -2,12 +2,22 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iterator>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
 #include <sstream>
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/BreadthFirstIterator.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -17,6 +27,8 @@
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_os_ostream.h"
 
 #include "revng/Support/Debug.h"
@@ -55,111 +67,6 @@ template class RegionCFG<BasicBlock *>;
 using MetaRegionBB = MetaRegion<BasicBlock *>;
 using MetaRegionBBVect = std::vector<MetaRegionBB>;
 using MetaRegionBBPtrVect = std::vector<MetaRegionBB *>;
-using BackedgeMetaRegionMap = std::map<EdgeDescriptor, MetaRegionBB *>;
-
-static bool mergeSCSStep(MetaRegionBBVect &MetaRegions) {
-  for (auto RegionIt1 = MetaRegions.begin(); RegionIt1 != MetaRegions.end();
-       RegionIt1++) {
-    for (auto RegionIt2 = std::next(RegionIt1); RegionIt2 != MetaRegions.end();
-         RegionIt2++) {
-      bool Intersects = (*RegionIt1).intersectsWith(*RegionIt2);
-      bool IsIncluded = (*RegionIt1).isSubSet(*RegionIt2);
-      bool IsIncludedReverse = (*RegionIt2).isSubSet(*RegionIt1);
-      bool AreEquivalent = (*RegionIt1).nodesEquality(*RegionIt2);
-      if (Intersects
-          and (((!IsIncluded) and (!IsIncludedReverse)) or AreEquivalent)) {
-        (*RegionIt1).mergeWith(*RegionIt2);
-        MetaRegions.erase(RegionIt2);
-        return true;
-      }
-    }
-  }
-
-  return false;
-}
-
-static void simplifySCS(MetaRegionBBVect &MetaRegions) {
-  bool Changes = true;
-  while (Changes) {
-    Changes = mergeSCSStep(MetaRegions);
-  }
-}
-
-static bool
-mergeSCSAbnormalRetreating(MetaRegionBBVect &MetaRegions,
-                           const llvm::SmallDenseSet<EdgeDescriptor> &Backedges,
-                           BackedgeMetaRegionMap &BackedgeMetaRegionMap,
-                           std::set<MetaRegionBB *> &BlacklistedMetaregions) {
-  for (auto RegionIt = MetaRegions.begin(); RegionIt != MetaRegions.end();
-       RegionIt++) {
-    MetaRegionBB &Region = *RegionIt;
-
-    // Do not re-analyze blacklisted metaregions.
-    if (!BlacklistedMetaregions.contains(&Region)) {
-
-      // Iterate over all the backedges present in the graph, if the current
-      // region contains the source of a backedge, it should contain also the
-      // the target of that backedge. If not, merge the two SCSs.
-      for (EdgeDescriptor Backedge : Backedges) {
-        bool FirstIn = Region.containsNode(Backedge.first);
-        bool SecondIn = Region.containsNode(Backedge.second);
-        bool AbnormalIncoming = FirstIn and not SecondIn;
-        bool AbnormalOutgoing = not FirstIn and SecondIn;
-        if (AbnormalIncoming or AbnormalOutgoing) {
-
-          // Retrieve the Metaregion identified by the backedge with goes
-          // goes outside the scope of the current Metaregion.
-          MetaRegionBB *OtherRegion = BackedgeMetaRegionMap.at(Backedge);
-          Region.mergeWith(*OtherRegion);
-
-          // Blacklist the region which we have merged.
-          BackedgeMetaRegionMap[Backedge] = &Region;
-          BlacklistedMetaregions.insert(OtherRegion);
-          return true;
-
-          // Abort if we didn't find the metaregion to remove.
-          revng_abort("Not found the region to merge with.");
-        }
-      }
-    }
-  }
-
-  return false;
-}
-
-static void
-simplifySCSAbnormalRetreating(MetaRegionBBVect &MetaRegions,
-                              const llvm::SmallDenseSet<EdgeDescriptor>
-                                &Backedges) {
-
-  // Temporary map where to store the correspondence between the backedge and
-  // the SCS it gives origin to.
-  // HACK: this should be done at the same time of the metaregion creation.
-  unsigned MetaRegionIndex = 0;
-  std::map<EdgeDescriptor, MetaRegionBB *> BackedgeMetaRegionMap;
-  for (EdgeDescriptor Backedge : Backedges) {
-    BackedgeMetaRegionMap[Backedge] = &MetaRegions.at(MetaRegionIndex);
-    MetaRegionIndex++;
-  }
-
-  std::set<MetaRegionBB *> BlacklistedMetaregions;
-  bool Changes = true;
-  while (Changes) {
-    Changes = mergeSCSAbnormalRetreating(MetaRegions,
-                                         Backedges,
-                                         BackedgeMetaRegionMap,
-                                         BlacklistedMetaregions);
-  }
-
-  // Remove all the metaregion that have been merged with others, using the
-  // erase/remove idiom.
-  MetaRegions.erase(remove_if(MetaRegions.begin(),
-                              MetaRegions.end(),
-                              [&BlacklistedMetaregions](MetaRegionBB &M) {
-                                return BlacklistedMetaregions.count(&M) == 1;
-                              }),
-                    MetaRegions.end());
-}
 
 static void sortMetaRegions(MetaRegionBBVect &MetaRegions) {
   std::sort(MetaRegions.begin(),
@@ -189,12 +96,67 @@ static bool checkMetaregionConsistency(const MetaRegionBBVect &MetaRegions,
   return ComparisonState;
 }
 
+/// Assigns a dense index to a set of nodes, so that subsets of them can be
+/// represented as bitsets
+class DenseNodeNumbering {
+private:
+  std::vector<BasicBlockNodeBB *> Nodes;
+  llvm::DenseMap<BasicBlockNodeBB *, unsigned> Indices;
+
+public:
+  void add(BasicBlockNodeBB *Node) {
+    if (Indices.try_emplace(Node, Nodes.size()).second)
+      Nodes.push_back(Node);
+  }
+
+  unsigned size() const { return Nodes.size(); }
+
+  BasicBlockNodeBB *nodeAt(unsigned Index) const { return Nodes[Index]; }
+
+  unsigned indexOf(BasicBlockNodeBB *Node) const {
+    auto It = Indices.find(Node);
+    revng_assert(It != Indices.end());
+    return It->second;
+  }
+
+  template<typename RangeT>
+  llvm::BitVector toBitVector(RangeT &&Range) const {
+    llvm::BitVector Result(size());
+    for (BasicBlockNodeBB *Node : Range)
+      Result.set(indexOf(Node));
+    return Result;
+  }
+
+  std::set<BasicBlockNodeBB *> toSet(const llvm::BitVector &Bits) const {
+    std::set<BasicBlockNodeBB *> Result;
+    for (unsigned Index : Bits.set_bits())
+      Result.insert(nodeAt(Index));
+    return Result;
+  }
+};
+
 static void computeParents(MetaRegionBBVect &MetaRegions) {
-  for (MetaRegionBB &MetaRegion1 : MetaRegions) {
+  // Represent the metaregions as bitsets, to make the inclusion checks cheap
+  DenseNodeNumbering Numbering;
+  for (MetaRegionBB &MetaRegion : MetaRegions)
+    for (BasicBlockNodeBB *Node : MetaRegion.nodes())
+      Numbering.add(Node);
+
+  std::vector<llvm::BitVector> Bits;
+  Bits.reserve(MetaRegions.size());
+  for (MetaRegionBB &MetaRegion : MetaRegions)
+    Bits.push_back(Numbering.toBitVector(MetaRegion.nodes()));
+
+  for (auto &Group1 : llvm::enumerate(MetaRegions)) {
+    MetaRegionBB &MetaRegion1 = Group1.value();
+    const llvm::BitVector &Bits1 = Bits[Group1.index()];
     bool ParentFound = false;
-    for (MetaRegionBB &MetaRegion2 : MetaRegions) {
+    for (auto &Group2 : llvm::enumerate(MetaRegions)) {
+      MetaRegionBB &MetaRegion2 = Group2.value();
       if (&MetaRegion1 != &MetaRegion2) {
-        if (MetaRegion1.isSubSet(MetaRegion2)) {
+
+        // `test` checks whether `Bits1` has any node that is not in the other
+        if (not Bits1.test(Bits[Group2.index()])) {
 
           if (CombLogger.isEnabled()) {
             CombLogger << "For metaregion: " << &MetaRegion1 << "\n";
@@ -222,30 +184,27 @@ static void computeParents(MetaRegionBBVect &MetaRegions) {
 }
 
 static MetaRegionBBPtrVect applyPartialOrder(MetaRegionBBVect &V) {
-  MetaRegionBBPtrVect OrderedVector;
-  std::set<MetaRegionBB *> Processed;
-
-  while (V.size() != Processed.size()) {
-    for (auto RegionIt1 = V.begin(); RegionIt1 != V.end(); RegionIt1++) {
-      if (!Processed.contains(&*RegionIt1)) {
-        bool FoundParent = false;
-        for (auto RegionIt2 = V.begin(); RegionIt2 != V.end(); RegionIt2++) {
-          if ((RegionIt1 != RegionIt2) and !Processed.contains(&*RegionIt2)) {
-            if ((*RegionIt1).getParent() == &*RegionIt2) {
-              FoundParent = true;
-              break;
-            }
-          }
-        }
+  // Repeatedly pick the first metaregion in `V` whose parent has already been
+  // picked. A metaregion becomes ready as soon as its parent is picked, so
+  // keeping the ready ones in a min-heap of their positions is enough.
+  std::map<MetaRegionBB *, llvm::SmallVector<size_t, 4>> Children;
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> Ready;
+  for (auto &Group : llvm::enumerate(V)) {
+    if (MetaRegionBB *Parent = Group.value().getParent())
+      Children[Parent].push_back(Group.index());
+    else
+      Ready.push(Group.index());
+  }
 
-        if (FoundParent == false) {
-          OrderedVector.push_back(&*RegionIt1);
-          Processed.insert(&*RegionIt1);
-          break;
-        }
-      }
-    }
+  MetaRegionBBPtrVect OrderedVector;
+  while (not Ready.empty()) {
+    MetaRegionBB *MetaRegion = &V[Ready.top()];
+    Ready.pop();
+    OrderedVector.push_back(MetaRegion);
+    for (size_t Child : Children[MetaRegion])
+      Ready.push(Child);
   }
+  revng_assert(OrderedVector.size() == V.size());
 
   std::reverse(OrderedVector.begin(), OrderedVector.end());
   return OrderedVector;
@@ -258,66 +217,202 @@ static bool alreadyInMetaregion(MetaRegionBBVect &V, BasicBlockNodeBB *N) {
   return false;
 }
 
-static MetaRegionBBVect
-createMetaRegions(const llvm::SmallDenseSet<EdgeDescriptor> &Backedges) {
-  std::map<BasicBlockNodeBB *, std::set<BasicBlockNodeBB *>> AdditionalSCSNodes;
-  std::vector<std::pair<BasicBlockNodeBB *, std::set<BasicBlockNodeBB *>>>
-    Regions;
+/// A SCS under construction, with its nodes represented as a bitset
+struct DenseSCS {
+  int Index;
+  llvm::BitVector Nodes;
+};
+
+/// Two SCSs need to be merged if they are equal, or if they intersect without
+/// one including the other
+static bool mustMerge(const DenseSCS &First, const DenseSCS &Second) {
+  if (not First.Nodes.anyCommon(Second.Nodes))
+    return false;
+
+  bool FirstIncluded = not First.Nodes.test(Second.Nodes);
+  bool SecondIncluded = not Second.Nodes.test(First.Nodes);
+  return FirstIncluded == SecondIncluded;
+}
+
+/// Merges SCSs until they are either nested or disjoint. At each step, the
+/// first pair (in lexicographic order of positions) that needs merging is
+/// merged, keeping the first of the two. Only the SCS that has just grown can
+/// form new pairs to merge, so instead of restarting the search from scratch
+/// after each merge, we check it against the SCSs preceding it, and then
+/// resume from it.
+static void simplifySCS(std::vector<DenseSCS> &SCSs) {
+  size_t I = 0;
+  while (I < SCSs.size()) {
+    auto Begin = std::next(SCSs.begin(), I + 1);
+    auto It = std::find_if(Begin, SCSs.end(), [&](const DenseSCS &Other) {
+      return mustMerge(SCSs[I], Other);
+    });
+    if (It == SCSs.end()) {
+      ++I;
+      continue;
+    }
+
+    SCSs[I].Nodes |= It->Nodes;
+    SCSs.erase(It);
+
+    for (size_t K = 0; K < I;) {
+      if (mustMerge(SCSs[K], SCSs[I])) {
+        SCSs[K].Nodes |= SCSs[I].Nodes;
+        SCSs.erase(std::next(SCSs.begin(), I));
+        I = K;
+        K = 0;
+      } else {
+        ++K;
+      }
+    }
+  }
+}
 
+/// Merges each SCS containing only one of the endpoints of a backedge with the
+/// SCS of that backedge
+static void
+simplifySCSAbnormalRetreating(std::vector<DenseSCS> &SCSs,
+                              const DenseNodeNumbering &Numbering,
+                              const llvm::SmallDenseSet<EdgeDescriptor>
+                                &Backedges) {
+  // The i-th SCS has been created from the i-th backedge
+  std::vector<std::pair<unsigned, unsigned>> Endpoints;
+  std::vector<size_t> BackedgeSCS;
+  for (EdgeDescriptor Backedge : Backedges) {
+    Endpoints.push_back({ Numbering.indexOf(Backedge.first),
+                          Numbering.indexOf(Backedge.second) });
+    BackedgeSCS.push_back(BackedgeSCS.size());
+  }
+  revng_assert(BackedgeSCS.size() == SCSs.size());
+
+  // A SCS only changes when it absorbs another one, and SCSs preceding it had
+  // no abnormal backedges, so after a merge we resume from the merging SCS.
+  llvm::BitVector Blacklisted(SCSs.size());
+  size_t Current = 0;
+  while (Current < SCSs.size()) {
+    if (Blacklisted.test(Current)) {
+      ++Current;
+      continue;
+    }
+
+    bool Merged = false;
+    const llvm::BitVector &Nodes = SCSs[Current].Nodes;
+    for (auto &Group : llvm::enumerate(Endpoints)) {
+      const auto &[Source, Target] = Group.value();
+      if (Nodes.test(Source) != Nodes.test(Target)) {
+        size_t &Other = BackedgeSCS[Group.index()];
+        SCSs[Current].Nodes |= SCSs[Other].Nodes;
+        Blacklisted.set(Other);
+        Other = Current;
+        Merged = true;
+        break;
+      }
+    }
+
+    if (not Merged)
+      ++Current;
+  }
+
+  // Remove all the SCSs that have been merged into others
+  std::vector<DenseSCS> Result;
+  for (auto &Group : llvm::enumerate(SCSs))
+    if (not Blacklisted.test(Group.index()))
+      Result.push_back(std::move(Group.value()));
+  SCSs = std::move(Result);
+}
+
+/// Checks that each SCS contains either both or none of the endpoints of each
+/// backedge
+static bool
+checkSCSConsistency(const std::vector<DenseSCS> &SCSs,
+                    const DenseNodeNumbering &Numbering,
+                    const llvm::SmallDenseSet<EdgeDescriptor> &Backedges) {
+  for (const DenseSCS &SCS : SCSs) {
+    for (EdgeDescriptor Backedge : Backedges) {
+      bool HasSource = SCS.Nodes.test(Numbering.indexOf(Backedge.first));
+      bool HasTarget = SCS.Nodes.test(Numbering.indexOf(Backedge.second));
+      if (HasSource != HasTarget)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static MetaRegionBBVect
+createMetaRegions(RegionCFG<BasicBlock *> &RootCFG,
+                  const llvm::SmallDenseSet<EdgeDescriptor> &Backedges) {
+  DenseNodeNumbering Numbering;
+  for (BasicBlockNodeBB *Node : RootCFG.nodes())
+    Numbering.add(Node);
+
+  std::vector<DenseSCS> SCSs;
+  std::vector<unsigned> Heads;
+  std::map<unsigned, llvm::BitVector> AdditionalSCSNodes;
+  llvm::BitVector IsHead(Numbering.size());
+  int SCSIndex = 1;
   for (auto &Backedge : Backedges) {
+    auto SCSNodes = nodesBetween(Backedge.second, Backedge.first);
+    llvm::BitVector SCS = Numbering.toBitVector(SCSNodes);
 
-    // Convert the `llvm::SmallSetVector` generated by the `nodesBetween` to a
-    // `std::set`, whose ordering properties are necessary for the following of
-    // the restructuring algorithm
-    auto SCSNodesSmall = nodesBetween(Backedge.second, Backedge.first);
-    std::set<BasicBlockNodeBB *> SCSNodes;
-    SCSNodes.insert(SCSNodesSmall.begin(), SCSNodesSmall.end());
-    AdditionalSCSNodes[Backedge.second].insert(SCSNodes.begin(),
-                                               SCSNodes.end());
+    unsigned Head = Numbering.indexOf(Backedge.second);
+    IsHead.set(Head);
+    AdditionalSCSNodes.try_emplace(Head, Numbering.size()).first->second |= SCS;
 
     if (CombLogger.isEnabled()) {
       CombLogger << "SCS identified by: ";
       CombLogger << Backedge.first->getNameStr() << " -> "
                  << Backedge.second->getNameStr() << "\n";
       CombLogger << "Is composed of nodes:\n";
-      for (auto Node : SCSNodes) {
+      for (auto Node : Numbering.toSet(SCS)) {
         CombLogger << Node->getNameStr() << "\n";
       }
     }
 
-    Regions.push_back(std::make_pair(Backedge.second, SCSNodes));
+    Heads.push_back(Head);
+    SCSs.push_back({ SCSIndex, std::move(SCS) });
+    SCSIndex++;
   }
 
   // Include in the regions found before other possible sub-regions, if an edge
   // which is the target of a backedge is included in an outer region.
-  for (auto &Region : Regions) {
-    BasicBlockNodeBB *Head = Region.first;
-    std::set<BasicBlockNodeBB *> &Nodes = Region.second;
-    std::set<BasicBlockNodeBB *> AdditionalNodes;
-    std::set<BasicBlockNodeBB *> OldNodes;
-    do {
-      OldNodes = Nodes;
-      for (BasicBlockNodeBB *Node : Nodes) {
-        if ((Node != Head) and (AdditionalSCSNodes.contains(Node))) {
-          CombLogger << "Adding additional nodes for region with head: ";
-          CombLogger << Head->getNameStr();
-          CombLogger << " and relative to node: ";
-          CombLogger << Node->getNameStr() << "\n";
-          AdditionalNodes.insert(AdditionalSCSNodes[Node].begin(),
-                                 AdditionalSCSNodes[Node].end());
+  for (auto &Group : llvm::enumerate(SCSs)) {
+    unsigned Head = Heads[Group.index()];
+    llvm::BitVector &Nodes = Group.value().Nodes;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      llvm::BitVector NestedHeads = Nodes;
+      NestedHeads &= IsHead;
+      NestedHeads.reset(Head);
+      for (unsigned NestedHead : NestedHeads.set_bits()) {
+        const llvm::BitVector &Additional = AdditionalSCSNodes.at(NestedHead);
+        if (Additional.test(Nodes)) {
+          if (CombLogger.isEnabled()) {
+            CombLogger << "Adding additional nodes for region with head: ";
+            CombLogger << Numbering.nodeAt(Head)->getNameStr();
+            CombLogger << " and relative to node: ";
+            CombLogger << Numbering.nodeAt(NestedHead)->getNameStr() << "\n";
+          }
+          Nodes |= Additional;
+          Changed = true;
         }
       }
-      Nodes.insert(AdditionalNodes.begin(), AdditionalNodes.end());
-      AdditionalNodes.clear();
-    } while (Nodes != OldNodes);
+    }
   }
 
+  // Simplify SCS if they contain an edge which goes outside the scope of the
+  // current region.
+  simplifySCSAbnormalRetreating(SCSs, Numbering, Backedges);
+  revng_assert(checkSCSConsistency(SCSs, Numbering, Backedges));
+
+  // Simplify SCS in a fixed-point fashion.
+  simplifySCS(SCSs);
+
   MetaRegionBBVect MetaRegions;
-  int SCSIndex = 1;
-  for (size_t I = 0; I < Regions.size(); ++I) {
-    auto &SCS = Regions[I].second;
-    MetaRegions.push_back(MetaRegionBB(SCSIndex, SCS, true));
-    SCSIndex++;
+  for (const DenseSCS &SCS : SCSs) {
+    std::set<BasicBlockNodeBB *> Nodes = Numbering.toSet(SCS.Nodes);
+    MetaRegions.push_back(MetaRegionBB(SCS.Index, Nodes, true));
   }
   return MetaRegions;
 }
@@ -327,6 +422,15 @@ static cl::opt<std::string> MetricsOutputPath("restructure-metrics-output-dir",
                                               value_desc("restructure-dir"),
                                               cat(MainCategory));
 
+static cl::opt<unsigned> RestructureThreads("restructure-threads",
+                                           desc("Number of threads used to "
+                                                "restructure independent "
+                                                "regions of a function (0 "
+                                                "means one per hardware "
+                                                "thread)"),
+                                           cat(MainCategory),
+                                           init(1));
+
 static void LogMetaRegions(const MetaRegionBBPtrVect &MetaRegions,
                            const std::string &HeaderMsg) {
   if (CombLogger.isEnabled()) {
@@ -458,32 +562,173 @@ static MetaRegionBB *computePredecessorsParent(MetaRegionBBPtrVect &MetaRegions,
   return mostNestedRegion(PredecessorMetaRegions);
 }
 
-bool restructureCFG(Function &F, ASTTree &AST) {
-  revng_log(CombLogger, "restructuring Function: " << F.getName());
-  revng_log(CombLogger, "Num basic blocks: " << F.size());
+using RegionCFGBB = RegionCFG<BasicBlock *>;
+using CollapsedASTMap = std::map<RegionCFGBB *, ASTTree>;
+
+/// Generates the ASTs of all the regions collapsed in \p RootCFG, using
+/// \p NumThreads threads. Regions that do not contain each other are
+/// independent, so each region is scheduled as soon as all the regions
+/// collapsed inside it have their AST. The result is the same as the one of
+/// the serial restructuring.
+static void generateCollapsedASTs(RegionCFGBB &RootCFG,
+                                  CollapsedASTMap &CollapsedMap,
+                                  unsigned NumThreads) {
+  // For each region, the regions directly containing it, and the number of
+  // regions directly collapsed inside it whose AST is not ready yet
+  std::map<RegionCFGBB *, llvm::SmallVector<RegionCFGBB *, 2>> Parents;
+  std::map<RegionCFGBB *, unsigned> PendingChildren;
+
+  llvm::SmallVector<RegionCFGBB *, 8> Worklist = { &RootCFG };
+  while (not Worklist.empty()) {
+    RegionCFGBB *Region = Worklist.pop_back_val();
+
+    // Clones of a collapsed node share the same region
+    std::set<RegionCFGBB *> Children;
+    for (BasicBlockNodeBB *Node : Region->nodes())
+      if (Node->isCollapsed())
+        Children.insert(Node->getCollapsedCFG());
+
+    if (Region != &RootCFG)
+      PendingChildren[Region] = Children.size();
+
+    for (RegionCFGBB *Child : Children) {
+      auto &ChildParents = Parents[Child];
+      if (ChildParents.empty())
+        Worklist.push_back(Child);
+      ChildParents.push_back(Region);
+    }
+  }
 
-  DuplicationCounter = 0;
-  UntangleTentativeCounter = 0;
-  UntanglePerformedCounter = 0;
+  // With a single collapsed region there's nothing to run in parallel: the
+  // root region restructures it on demand
+  if (PendingChildren.size() < 2)
+    return;
 
-  // Clear graph object from the previous pass.
-  RegionCFG<BasicBlock *> RootCFG;
+  // The untangle of a region uses the weights of the regions collapsed in it.
+  // When restructuring serially, they're computed by the untangle of the root
+  // region, before any collapsed region is combed. Compute them here, in the
+  // same state, so that the output doesn't depend on the scheduling.
+  {
+    std::map<RegionCFGBB *, unsigned> Pending = PendingChildren;
+    llvm::SmallVector<RegionCFGBB *, 8> Ready;
+    for (const auto &[Region, NumPending] : Pending)
+      if (NumPending == 0)
+        Ready.push_back(Region);
+
+    while (not Ready.empty()) {
+      RegionCFGBB *Region = Ready.pop_back_val();
+      Region->computeUntangleWeight();
+      for (RegionCFGBB *Parent : Parents.at(Region)) {
+        auto It = Pending.find(Parent);
+        if (It != Pending.end() and --It->second == 0)
+          Ready.push_back(Parent);
+      }
+    }
+  }
 
-  // Set names of the CFG region
-  RootCFG.setFunctionName(F.getName().str());
-  RootCFG.setRegionName("root");
+  // Create all the entries upfront: from now on, `CollapsedMap` is only read,
+  // and each worker writes exclusively the AST of the region it restructures.
+  for (const auto &[Region, Pending] : PendingChildren)
+    CollapsedMap.insert({ Region, ASTTree() });
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(NumThreads));
+  std::mutex PendingMutex;
+
+  std::function<void(RegionCFGBB *)> Schedule;
+  Schedule = [&](RegionCFGBB *Region) {
+    Pool.async([&, Region]() {
+      generateAst(*Region, CollapsedMap.at(Region), CollapsedMap);
+
+      // The parents that no longer wait for any child can be scheduled. The
+      // root region is restructured by the caller.
+      std::lock_guard<std::mutex> Lock(PendingMutex);
+      for (RegionCFGBB *Parent : Parents.at(Region)) {
+        auto It = PendingChildren.find(Parent);
+        if (It != PendingChildren.end() and --It->second == 0)
+          Schedule(Parent);
+      }
+    });
+  };
 
-  // Initialize the RegionCFG object
-  RootCFG.initialize(&F);
+  // Start from the innermost regions
+  {
+    std::lock_guard<std::mutex> Lock(PendingMutex);
+    for (const auto &[Region, Pending] : PendingChildren)
+      if (Pending == 0)
+        Schedule(Region);
+  }
 
-  if (CombLogger.isEnabled()) {
-    CombLogger << "Analyzing function: " << F.getName() << "\n";
-    RootCFG.dumpCFGOnFile(F.getName().str(), "restructure", "initial-state");
+  Pool.wait();
+}
+
+/// Computes the weight of \a AST, comparable to the weight of the CFG it has
+/// been generated from
+static unsigned computeASTWeight(ASTTree &AST) {
+  unsigned Weight = 0;
+  for (ASTNode *N : AST.nodes()) {
+    switch (N->getKind()) {
+    case ASTNode::NK_Scs:
+    case ASTNode::NK_If:
+    case ASTNode::NK_Switch: {
+      // Control-flow nodes emit single constructs, so we just increase the
+      // weight by one.
+      // Control-flow nodes would also have nested scopes (then-else for if,
+      // cases for switch, loop body for scs). However, those nodes are
+      // visited separately, and will be accounted for later.
+      ++Weight;
+    } break;
+    case ASTNode::NK_Set:
+    case ASTNode::NK_Break:
+    case ASTNode::NK_SwitchBreak:
+    case ASTNode::NK_Continue:
+    case ASTNode::NK_Goto: {
+      // These AST Nodes are emitted as single instructions.
+      // Just increase the weight by one.
+      ++Weight;
+    } break;
+    case ASTNode::NK_List: {
+      // Sequence nodes are just scopes, they don't have a real weight.
+      // Their weight is just sum of the weights of the nodes they contain,
+      // that will be visited nevertheless.
+    } break;
+    case ASTNode::NK_Label: {
+      // Labels are not instructions, they only mark a goto target.
+    } break;
+    case ASTNode::NK_Code: {
+      auto *BB = cast<CodeNode>(N)->getOriginalBB();
+      revng_assert(BB);
+      Weight += WeightTraits<llvm::BasicBlock *>::getWeight(BB);
+    } break;
+    default:
+      revng_abort("unexpected AST node");
+    }
   }
+  return Weight;
+}
+
+std::string describeRestructureOptions() {
+  unsigned Budget = DuplicationBudget;
+  return "restructure-duplication-budget=" + to_string(Budget);
+}
+
+using Clock = std::chrono::steady_clock;
 
+/// Returns the seconds elapsed since \a Start, and restarts it
+static double lap(Clock::time_point &Start) {
+  Clock::time_point Now = Clock::now();
+  std::chrono::duration<double> Elapsed = Now - Start;
+  Start = Now;
+  return Elapsed.count();
+}
+
+/// Identifies the metaregions of \a RootCFG, and computes their parents, which
+/// point into the returned vector. A dummy node is inserted on each backedge,
+/// and \a Backedges is set to the backedges going out of the dummy nodes.
+static MetaRegionBBVect
+identifyMetaRegions(RegionCFG<BasicBlock *> &RootCFG,
+                    llvm::SmallDenseSet<EdgeDescriptor> &Backedges) {
   // Identify SCS regions.
-  llvm::SmallDenseSet<EdgeDescriptor>
-    Backedges = getBackedges(&RootCFG.getEntryNode()).takeSet();
+  Backedges = getBackedges(&RootCFG.getEntryNode()).takeSet();
   revng_log(CombLogger, "Initial Backedges in the graph:");
   for (auto &Backedge : Backedges) {
     LoggerIndent Indent(CombLogger);
@@ -512,19 +757,9 @@ bool restructureCFG(Function &F, ASTTree &AST) {
     revng_assert(Backedge.first->isEmpty());
   }
 
-  // Create meta regions
-  MetaRegionBBVect MetaRegions = createMetaRegions(Backedges);
-  LogMetaRegions(MetaRegions, "Metaregions after nothing:");
-
-  // Simplify SCS if they contain an edge which goes outside the scope of the
-  // current region.
-  simplifySCSAbnormalRetreating(MetaRegions, Backedges);
-  LogMetaRegions(MetaRegions, "Metaregions after first simplification:");
-  revng_assert(checkMetaregionConsistency(MetaRegions, Backedges));
-
-  // Simplify SCS in a fixed-point fashion.
-  simplifySCS(MetaRegions);
-  LogMetaRegions(MetaRegions, "Metaregions after second simplification:");
+  // Create meta regions, merging them until they are well nested
+  MetaRegionBBVect MetaRegions = createMetaRegions(RootCFG, Backedges);
+  LogMetaRegions(MetaRegions, "Metaregions after simplification:");
   revng_assert(checkMetaregionConsistency(MetaRegions, Backedges));
 
   // Sort the Metaregions in increasing number of composing nodes order.
@@ -537,6 +772,97 @@ bool restructureCFG(Function &F, ASTTree &AST) {
   // Print metaregions after ordering.
   LogMetaRegions(MetaRegions, "Metaregions parent relationship:");
 
+  return MetaRegions;
+}
+
+/// Prints \a Meta as the sorted names of the basic blocks it contains, but
+/// that are not in its children, followed by its children
+static std::string
+describeMetaRegion(const MetaRegionBB &Meta,
+                   const std::multimap<const MetaRegionBB *,
+                                       const MetaRegionBB *> &Children) {
+  std::vector<std::string> Elements;
+  for (BasicBlockNodeBB *Node : Meta.nodes()) {
+    if (not Node->isCode())
+      continue;
+
+    auto [Begin, End] = Children.equal_range(&Meta);
+    auto ContainsNode = [Node](const auto &Child) {
+      return Child.second->containsNode(Node);
+    };
+    if (std::none_of(Begin, End, ContainsNode))
+      Elements.push_back(Node->getOriginalNode()->getName().str());
+  }
+  std::sort(Elements.begin(), Elements.end());
+
+  std::vector<std::string> Nested;
+  for (const auto &[_, Child] : llvm::make_range(Children.equal_range(&Meta)))
+    Nested.push_back(describeMetaRegion(*Child, Children));
+  std::sort(Nested.begin(), Nested.end());
+  llvm::append_range(Elements, Nested);
+
+  std::string Result = "{";
+  for (const auto &Group : llvm::enumerate(Elements))
+    Result += (Group.index() == 0 ? "" : " ") + Group.value();
+  return Result + "}";
+}
+
+std::string describeMetaRegionTree(Function &F) {
+  RegionCFG<BasicBlock *> RootCFG;
+  RootCFG.setFunctionName(F.getName().str());
+  RootCFG.setRegionName("root");
+  RootCFG.initialize(&F);
+
+  llvm::SmallDenseSet<EdgeDescriptor> Backedges;
+  MetaRegionBBVect MetaRegions = identifyMetaRegions(RootCFG, Backedges);
+
+  std::multimap<const MetaRegionBB *, const MetaRegionBB *> Children;
+  for (const MetaRegionBB &Meta : MetaRegions)
+    Children.insert({ Meta.getParent(), &Meta });
+
+  std::vector<std::string> Outermost;
+  for (const auto &[_, Meta] : llvm::make_range(Children.equal_range(nullptr)))
+    Outermost.push_back(describeMetaRegion(*Meta, Children));
+  std::sort(Outermost.begin(), Outermost.end());
+
+  std::string Result;
+  for (const auto &Group : llvm::enumerate(Outermost))
+    Result += (Group.index() == 0 ? "" : " ") + Group.value();
+  return Result;
+}
+
+bool restructureCFG(Function &F, ASTTree &AST, RestructureMetrics *Metrics) {
+  revng_log(CombLogger, "restructuring Function: " << F.getName());
+  revng_log(CombLogger, "Num basic blocks: " << F.size());
+
+  Clock::time_point PhaseStart = Clock::now();
+
+  DuplicationCounter = 0;
+  DuplicatedWeightCounter = 0;
+  UntangleTentativeCounter = 0;
+  UntanglePerformedCounter = 0;
+
+  // Clear graph object from the previous pass.
+  RegionCFG<BasicBlock *> RootCFG;
+
+  // Set names of the CFG region
+  RootCFG.setFunctionName(F.getName().str());
+  RootCFG.setRegionName("root");
+
+  // Initialize the RegionCFG object
+  RootCFG.initialize(&F);
+  if (Metrics)
+    Metrics->InitialNodes = RootCFG.size();
+
+  if (CombLogger.isEnabled()) {
+    CombLogger << "Analyzing function: " << F.getName() << "\n";
+    RootCFG.dumpCFGOnFile(F.getName().str(), "restructure", "initial-state");
+  }
+
+  // Identify the metaregions, and the backedges that they contain
+  llvm::SmallDenseSet<EdgeDescriptor> Backedges;
+  MetaRegionBBVect MetaRegions = identifyMetaRegions(RootCFG, Backedges);
+
   // Find an ordering for the metaregions that satisfies the inclusion
   // relationship. We create a new "shadow" vector containing only pointers to
   // the "real" metaregions.
@@ -545,6 +871,11 @@ bool restructureCFG(Function &F, ASTTree &AST) {
   // Print metaregions after ordering.
   LogMetaRegions(OrderedMetaRegions, "Metaregions after partial ordering:");
 
+  if (Metrics) {
+    Metrics->MetaRegions = OrderedMetaRegions.size();
+    Metrics->MetaRegionsSeconds = lap(PhaseStart);
+  }
+
   // Create a std::vector from the reverse post order. We cannot just use the
   // regular ReversePostOrderTraversal because later we'll need the removal
   // operation.
@@ -703,6 +1034,8 @@ bool restructureCFG(Function &F, ASTTree &AST) {
       // Create the dispatcher.
       Head = RootCFG.addEntryDispatcher();
       Meta->insertNode(Head);
+      if (Metrics)
+        ++Metrics->EntryDispatchers;
 
       // For each target of the dispatcher add the edge and add it in the map.
       std::map<std::pair<BasicBlockNodeBB *, std::optional<unsigned>>, unsigned>
@@ -734,14 +1067,12 @@ bool restructureCFG(Function &F, ASTTree &AST) {
 
         // Do different stuff depending if the insertion took place
         unsigned NewIndex = MapInsertionIt.first->second;
-        if (bool NewlyInserted = MapInsertionIt.second; NewlyInserted) {
+        bool NewlyInserted = MapInsertionIt.second;
+        if (NewlyInserted) {
           edge_label_t Labels;
           Labels.insert(NewIndex);
           EdgeInfo EI = { Labels, false };
           addEdge(EdgeDescriptor(Head, EdgeToRedirect.second), EI);
-        } else if (OriginalSource->isSet()) {
-          // We need to remove the "additional" setnode which will not be used
-          RootCFG.removeNode(OriginalSource);
         }
         std::string Name = EdgeToRedirect.second->getName().str();
         auto *SetNode = RootCFG.addEntrySetStateNode(NewIndex, Name);
@@ -750,6 +1081,11 @@ bool restructureCFG(Function &F, ASTTree &AST) {
         addPlainEdge(EdgeDescriptor(SetNode, Head));
         ContinueBackedges.push_back(EdgeDescriptor(SetNode, Head));
         ++IncrementalIdx;
+
+        // We need to remove the "additional" setnode which will not be used.
+        // This must be done after its incoming edge has been redirected.
+        if (not NewlyInserted and OriginalSource->isSet())
+          RootCFG.removeNode(OriginalSource);
       }
 
       // Move the remaining (the retreatings have been handled in the above
@@ -1194,6 +1530,8 @@ bool restructureCFG(Function &F, ASTTree &AST) {
 
       // Create the dispatcher.
       ExitDispatcher = RootCFG.addExitDispatcher();
+      if (Metrics)
+        ++Metrics->ExitDispatchers;
 
       // For each target of the dispatcher add the edge and add it in the map.
       std::map<BasicBlockNodeBB *, unsigned> SuccessorsIdxMap;
@@ -1333,7 +1671,7 @@ bool restructureCFG(Function &F, ASTTree &AST) {
     }
 
     // Replace the pointers inside SCS.
-    Meta->replaceNodes(CollapsedGraph.getNodes());
+    Meta->replaceNodes(CollapsedGraph.nodes());
 
     // Remove useless nodes inside the SCS (like dandling break/continue)
     CollapsedGraph.removeNotReachables(OrderedMetaRegions);
@@ -1389,65 +1727,58 @@ bool restructureCFG(Function &F, ASTTree &AST) {
   // Check that the root region is acyclic at this point.
   revng_assert(RootCFG.isDAG());
 
+  if (Metrics)
+    Metrics->CollapseSeconds = lap(PhaseStart);
+
   // Collect statistics
   unsigned InitialWeight = 0;
-  if (MetricsOutputPath.getNumOccurrences()) {
-    revng_assert(MetricsOutputPath.getNumOccurrences() == 1);
+  if (MetricsOutputPath.getNumOccurrences() or Metrics) {
+    revng_assert(MetricsOutputPath.getNumOccurrences() <= 1);
     // Compute the initial weight of the CFG.
     for (BasicBlockNodeBB *BBNode : RootCFG.nodes()) {
       InitialWeight += BBNode->getWeight();
     }
   }
 
-  // Invoke the AST generation for the root region.
-  std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> CollapsedMap;
+  // Invoke the AST generation for the root region. Loggers are not
+  // thread-safe: if the restructuring is being logged, the collapsed regions
+  // are restructured on demand by the root region, one at a time.
+  CollapsedASTMap CollapsedMap;
+  unsigned NumThreads = llvm::hardware_concurrency(RestructureThreads)
+                          .compute_thread_count();
+  if (NumThreads > 1 and not CombLogger.isEnabled())
+    generateCollapsedASTs(RootCFG, CollapsedMap, NumThreads);
   generateAst(RootCFG, AST, CollapsedMap);
 
+  if (Metrics)
+    Metrics->GenerateASTSeconds = lap(PhaseStart);
+
   // Scorporated this part which was previously inside the `generateAst` to
   // avoid having it run twice or more (it was run inside the recursive step
   // of the `generateAst`, and then another time for the final root AST, which
   // now is directly the entire AST, since there's no flattening anymore).
   normalize(AST, F);
 
-  // Serialize the collected metrics in the outputfile.
-  if (MetricsOutputPath.getNumOccurrences()) {
-    // Compute the increase in weight, on the AST
-    unsigned FinalWeight = 0;
-    for (ASTNode *N : AST.nodes()) {
-      switch (N->getKind()) {
-      case ASTNode::NK_Scs:
-      case ASTNode::NK_If:
-      case ASTNode::NK_Switch: {
-        // Control-flow nodes emit single constructs, so we just increase the
-        // weight by one.
-        // Control-flow nodes would also have nested scopes (then-else for if,
-        // cases for switch, loop body for scs). However, those nodes are
-        // visited separately, and will be accounted for later.
-        ++FinalWeight;
-      } break;
-      case ASTNode::NK_Set:
-      case ASTNode::NK_Break:
-      case ASTNode::NK_SwitchBreak:
-      case ASTNode::NK_Continue: {
-        // These AST Nodes are emitted as single instructions.
-        // Just increase the weight by one.
-        ++FinalWeight;
-      } break;
-      case ASTNode::NK_List: {
-        // Sequence nodes are just scopes, they don't have a real weight.
-        // Their weight is just sum of the weights of the nodes they contain,
-        // that will be visited nevertheless.
-      } break;
-      case ASTNode::NK_Code: {
-        auto *BB = cast<CodeNode>(N)->getOriginalBB();
-        revng_assert(BB);
-        FinalWeight += WeightTraits<llvm::BasicBlock *>::getWeight(BB);
-      } break;
-      default:
-        revng_abort("unexpected AST node");
-      }
+  if (Metrics) {
+    Metrics->NormalizeSeconds = lap(PhaseStart);
+    Metrics->DuplicatedNodes = DuplicationCounter;
+    Metrics->DuplicatedWeight = DuplicatedWeightCounter;
+    Metrics->UntangleTentative = UntangleTentativeCounter;
+    Metrics->UntanglePerformed = UntanglePerformedCounter;
+    Metrics->GotoRegions = RootCFG.needsGotos() ? 1 : 0;
+    Metrics->FinalNodes = RootCFG.size();
+    for (RegionCFG<BasicBlock *> &Region : Regions) {
+      if (Region.needsGotos())
+        ++Metrics->GotoRegions;
+      Metrics->FinalNodes += Region.size();
     }
+    Metrics->InitialWeight = InitialWeight;
+    Metrics->FinalWeight = computeASTWeight(AST);
+  }
 
+  // Serialize the collected metrics in the outputfile.
+  if (MetricsOutputPath.getNumOccurrences()) {
+    unsigned FinalWeight = computeASTWeight(AST);
     float Increase = float(FinalWeight) / float(InitialWeight);
 
     std::ofstream Output;
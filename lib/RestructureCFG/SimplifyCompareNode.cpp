@@ -23,6 +23,40 @@
 
 using namespace llvm;
 
+using ComparisonKind = CompareNode::ComparisonKind;
+
+/// Return the interned `CompareNode` with the same LHS of \a Compare, and with
+/// the given comparison and constant
+static ExprNode *getCompare(ASTTree &AST,
+                            const CompareNode *Compare,
+                            ComparisonKind Comparison,
+                            size_t Constant) {
+  if (auto *ValueCompare = llvm::dyn_cast<ValueCompareNode>(Compare)) {
+    BasicBlock *BB = ValueCompare->getBasicBlock();
+    return AST.addCondExpr<ValueCompareNode>(Comparison, BB, Constant);
+  }
+  return AST.addCondExpr<LoopStateCompareNode>(Comparison, Constant);
+}
+
+/// Return the negation of \a Compare, as a `CompareNode`
+static ExprNode *getFlippedCompare(ASTTree &AST, const CompareNode *Compare) {
+  switch (Compare->getComparison()) {
+  case ComparisonKind::Comparison_Equal:
+    return getCompare(AST,
+                      Compare,
+                      ComparisonKind::Comparison_NotEqual,
+                      Compare->getConstant());
+  case ComparisonKind::Comparison_NotEqual:
+    return getCompare(AST,
+                      Compare,
+                      ComparisonKind::Comparison_Equal,
+                      Compare->getConstant());
+  case ComparisonKind::Comparison_NotPresent:
+    return getCompare(AST, Compare, ComparisonKind::Comparison_Equal, 0);
+  }
+  revng_abort();
+}
+
 RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
@@ -67,10 +101,8 @@ RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
     if (auto *Not = llvm::dyn_cast<NotNode>(IfCondExpr)) {
       ExprNode *NegatedExpr = Not->getNegatedNode();
       revng_assert(NegatedExpr);
-      if (auto *Compare = llvm::dyn_cast<CompareNode>(NegatedExpr)) {
-        Compare->flipComparison();
-        If->replaceCondExpr(Compare);
-      }
+      if (auto *Compare = llvm::dyn_cast<CompareNode>(NegatedExpr))
+        If->replaceCondExpr(getFlippedCompare(AST, Compare));
     }
 
     // Further simplification for special `CompareNode`s comparing with constant
@@ -83,17 +115,15 @@ RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
     IfCondExpr = If->getCondExpr();
     if (auto *Compare = llvm::dyn_cast<CompareNode>(IfCondExpr)) {
       if (Compare->getConstant() == 0) {
-        using ComparisonKind = CompareNode::ComparisonKind;
         auto Comparison = Compare->getComparison();
+        auto NotPresentKind = ComparisonKind::Comparison_NotPresent;
         if (Comparison == ComparisonKind::Comparison_Equal) {
-          Compare->setNotPresentKind();
-          using UniqueExpr = ASTTree::expr_unique_ptr;
-          UniqueExpr Not;
-          Not.reset(new NotNode(Compare));
-          ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-          If->replaceCondExpr(NotNode);
+          ExprNode *NotPresent = getCompare(AST, Compare, NotPresentKind, 0);
+          ExprNode *Not = AST.addCondExpr<NotNode>(NotPresent);
+          If->replaceCondExpr(Not);
         } else if (Comparison == ComparisonKind::Comparison_NotEqual) {
-          Compare->setNotPresentKind();
+          ExprNode *NotPresent = getCompare(AST, Compare, NotPresentKind, 0);
+          If->replaceCondExpr(NotPresent);
         }
       }
     }
@@ -114,6 +144,8 @@ RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
@@ -166,10 +166,8 @@ simplifyDualSwitch(ASTTree &AST, ASTNode *Node) {
       rc_return Switch;
     }
 
-    using UniqueExpr = ASTTree::expr_unique_ptr;
-    using ExprDestruct = ASTTree::expr_destructor;
     using ComparisonKind = CompareNode::ComparisonKind;
-    ASTTree::ast_unique_ptr ASTObject;
+    IfNode *If = nullptr;
 
     if (Switch->getCondition() == nullptr) {
       // A) Dispatcher `switch`.
@@ -179,12 +177,10 @@ simplifyDualSwitch(ASTTree &AST, ASTNode *Node) {
       revng_assert(Switch->getOriginalBB() == nullptr);
 
       // Build the `ExprNode` containing the newly crafted `CompareNode`.
-      UniqueExpr
-        CondExpr(new LoopStateCompareNode(ComparisonKind::Comparison_Equal,
-                                          Fields->CaseIndex),
-                 ExprDestruct());
-      ExprNode *Cond = AST.addCondExpr(std::move(CondExpr));
-      ASTObject.reset(new IfNode(Cond, Fields->Then, Fields->Else));
+      auto Equal = ComparisonKind::Comparison_Equal;
+      ExprNode *Cond = AST.addCondExpr<LoopStateCompareNode>(Equal,
+                                                             Fields->CaseIndex);
+      If = AST.addASTNode<IfNode>(Cond, Fields->Then, Fields->Else);
     } else {
       // B) Standard `switch`.
       // Retrieve the original `BasicBlock pointed by the `switch`.
@@ -195,21 +191,19 @@ simplifyDualSwitch(ASTTree &AST, ASTNode *Node) {
 
       // Build the `CompareNode` equivalent to the condition of the simplified
       // switch.
-      UniqueExpr CondExpr(new ValueCompareNode(ComparisonKind::Comparison_Equal,
-                                               BB,
-                                               Fields->CaseIndex),
-                          ExprDestruct());
-      ExprNode *Cond = AST.addCondExpr(std::move(CondExpr));
-      ASTObject.reset(new IfNode(Cond,
-                                 Fields->Then,
-                                 Fields->Else,
-                                 SwitchName,
-                                 IsWeaved,
-                                 BB));
+      auto Equal = ComparisonKind::Comparison_Equal;
+      ExprNode *Cond = AST.addCondExpr<ValueCompareNode>(Equal,
+                                                         BB,
+                                                         Fields->CaseIndex);
+      If = AST.addASTNode<IfNode>(Cond,
+                                  Fields->Then,
+                                  Fields->Else,
+                                  SwitchName,
+                                  IsWeaved,
+                                  BB);
     }
 
     // Assign the `if` which substitutes the `switch`
-    IfNode *If = llvm::cast<IfNode>(AST.addASTNode(std::move(ASTObject)));
     revng_assert(If);
 
     // Remove possible `SwitchBreak` nodes that are left around in the `then` or
@@ -243,6 +237,8 @@ simplifyDualSwitch(ASTTree &AST, ASTNode *Node) {
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
     // Do nothing
     break;
   default:
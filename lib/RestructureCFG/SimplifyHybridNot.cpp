@@ -6,6 +6,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/Casting.h"
@@ -23,48 +25,24 @@
 
 using namespace llvm;
 
+// Number of occurrences of the `AtomicNode` of a BasicBlock in the conditions
+// of the GHAST, either directly or contained in a `NotNode`
 struct AssociatedExprs {
-  llvm::SmallSet<ExprNode **, 1> DirectExprs;
-  llvm::SmallSet<ExprNode **, 1> NegatedExprs;
+  unsigned DirectExprs = 0;
+  unsigned NegatedExprs = 0;
 };
 
 using BBExprsMap = llvm::SmallDenseMap<BasicBlock *, AssociatedExprs>;
 
-enum Direction {
-  Direct,
-  Negated
-};
-
-static void insertInAssociatedExprs(BBExprsMap &BBExprs,
-                                    BasicBlock *BB,
-                                    ExprNode **Node,
-                                    Direction Direction) {
-
-  // Check if the entry in the map is already present
-  BBExprsMap::iterator It = BBExprs.find(BB);
-  if (It == BBExprs.end()) {
-
-    // Insert in the map the corresponding entry if not already present, and
-    // reassign the iterator so we can use it
-    It = BBExprs.insert(std::make_pair(BB, AssociatedExprs())).first;
-  }
-
-  // Insert the pointer to the `ExprNode` in the correct vector
-  if (Direction == Direct) {
-    auto InsertIt = It->second.DirectExprs.insert(Node);
-    revng_assert(InsertIt.second == true);
-  } else if (Direction == Negated) {
-    auto InsertIt = It->second.NegatedExprs.insert(Node);
-    revng_assert(InsertIt.second == true);
-  } else {
-    revng_abort();
-  }
-}
+using IfNodeSet = llvm::SmallSetVector<IfNode *, 8>;
 
-static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
+static RecursiveCoroutine<void> collectExprBB(ExprNode *Expr,
                                               BBExprsMap &BBExprs) {
 
-  switch ((*Expr)->getKind()) {
+  // Conditions are shared among `IfNode`s and among other conditions, so we
+  // count each occurrence of an `AtomicNode` along the visit, instead of each
+  // distinct `ExprNode`
+  switch (Expr->getKind()) {
   case ExprNode::NodeKind::NK_ValueCompare:
   case ExprNode::NodeKind::NK_LoopStateCompare: {
     // In the `CompareNode` the associated `BasicBlock` does not contain a full
@@ -72,35 +50,32 @@ static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
     // IR component for the hybrid simplification, and we do nothing.
   } break;
   case ExprNode::NodeKind::NK_Atomic: {
-    auto *Atomic = llvm::cast<AtomicNode>(*Expr);
+    auto *Atomic = llvm::cast<AtomicNode>(Expr);
     BasicBlock *BB = Atomic->getConditionalBasicBlock();
-
-    // Insert the `ExprNode`
-    insertInAssociatedExprs(BBExprs, BB, Expr, Direct);
+    BBExprs[BB].DirectExprs += 1;
   } break;
 
   case ExprNode::NodeKind::NK_Not: {
-    auto *Not = llvm::cast<NotNode>(*Expr);
+    auto *Not = llvm::cast<NotNode>(Expr);
 
     if (auto *Contained = llvm::dyn_cast<AtomicNode>(Not->getNegatedNode())) {
       BasicBlock *BB = Contained->getConditionalBasicBlock();
 
-      // The `NotNode` directly contains an `AtomicNode`, we therefore insert
-      // the address to the `NotNode` in the `NegatedExprs` vector
-      insertInAssociatedExprs(BBExprs, BB, Expr, Negated);
+      // The `NotNode` directly contains an `AtomicNode`, we therefore count it
+      // as a negated occurrence
+      BBExprs[BB].NegatedExprs += 1;
     } else {
 
       // If the `NotNode` does not directly contain an `AtomicNode`, we need to
       // continue with the inspection
-      ExprNode **NegatedNode = Not->getNegatedNodeAddress();
-      rc_recur collectExprBB(NegatedNode, BBExprs);
+      rc_recur collectExprBB(Not->getNegatedNode(), BBExprs);
     }
   } break;
 
   case ExprNode::NodeKind::NK_And:
   case ExprNode::NodeKind::NK_Or: {
-    auto *Binary = llvm::cast<BinaryNode>(*Expr);
-    const auto &[LHS, RHS] = Binary->getInternalNodesAddress();
+    auto *Binary = llvm::cast<BinaryNode>(Expr);
+    const auto &[LHS, RHS] = Binary->getInternalNodes();
     rc_recur collectExprBB(LHS, BBExprs);
     rc_recur collectExprBB(RHS, BBExprs);
   } break;
@@ -111,15 +86,22 @@ static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
   rc_return;
 }
 
-static RecursiveCoroutine<void>
-populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
+static void collectIfExprBB(IfNode *If, BBExprsMap &BBExprs, IfNodeSet &Ifs) {
+  if (Ifs.insert(If))
+    collectExprBB(If->getCondExpr(), BBExprs);
+}
+
+static RecursiveCoroutine<void> populateAssociatedExprMap(ASTTree &AST,
+                                                          ASTNode *Node,
+                                                          BBExprsMap &BBExprs,
+                                                          IfNodeSet &Ifs) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
     SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
 
     // Recursively call the visit on each element of the `SequenceNode`
     for (ASTNode *&N : Seq->nodes()) {
-      rc_recur populateAssociatedExprMap(AST, N, BBExprs);
+      rc_recur populateAssociatedExprMap(AST, N, BBExprs, Ifs);
     }
   } break;
   case ASTNode::NK_Scs: {
@@ -129,32 +111,29 @@ populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
     // `dowhile`, we should inspect the related condition containing the
     // `IfNode` associated to the execution of the loop
     if (not Scs->isWhileTrue()) {
-      IfNode *If = Scs->getRelatedCondition();
-      ExprNode **IfExpr = If->getCondExprAddress();
-      collectExprBB(IfExpr, BBExprs);
+      collectIfExprBB(Scs->getRelatedCondition(), BBExprs, Ifs);
     }
 
     if (Scs->hasBody()) {
-      rc_recur populateAssociatedExprMap(AST, Scs->getBody(), BBExprs);
+      rc_recur populateAssociatedExprMap(AST, Scs->getBody(), BBExprs, Ifs);
     }
   } break;
   case ASTNode::NK_If: {
     IfNode *If = llvm::cast<IfNode>(Node);
-    ExprNode **IfExpr = If->getCondExprAddress();
-    collectExprBB(IfExpr, BBExprs);
+    collectIfExprBB(If, BBExprs, Ifs);
 
     if (If->hasThen()) {
-      rc_recur populateAssociatedExprMap(AST, If->getThen(), BBExprs);
+      rc_recur populateAssociatedExprMap(AST, If->getThen(), BBExprs, Ifs);
     }
     if (If->hasElse()) {
-      rc_recur populateAssociatedExprMap(AST, If->getElse(), BBExprs);
+      rc_recur populateAssociatedExprMap(AST, If->getElse(), BBExprs, Ifs);
     }
   } break;
   case ASTNode::NK_Switch: {
     auto *Switch = llvm::cast<SwitchNode>(Node);
     for (auto &LabelCasePair : Switch->cases()) {
       ASTNode *Case = LabelCasePair.second;
-      rc_recur populateAssociatedExprMap(AST, Case, BBExprs);
+      rc_recur populateAssociatedExprMap(AST, Case, BBExprs, Ifs);
     }
   } break;
   case ASTNode::NK_Code:
@@ -162,6 +141,8 @@ populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
   case ASTNode::NK_SwitchBreak:
   case ASTNode::NK_Continue:
   case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto:
 
     // These nodes do not have an `ExprNode` embedded, nor do embed other
     // nested nodes
@@ -203,8 +184,8 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
     // transformation
     llvm::Value *Condition = Branch->getCondition();
 
-    auto &DirectExprs = AssociatedExprs.DirectExprs;
-    auto &NegatedExprs = AssociatedExprs.NegatedExprs;
+    unsigned DirectExprs = AssociatedExprs.DirectExprs;
+    unsigned NegatedExprs = AssociatedExprs.NegatedExprs;
 
     // TODO: we currently handle `ICmpInst`s and `BooleanNot`s as conditions for
     //       the branch, explore alternative situations that we may want to
@@ -230,12 +211,12 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
       auto Predicate = Compare->getPredicate();
 
       if (Predicate == llvm::ICmpInst::Predicate::ICMP_NE) {
-        if (NegatedExprs.size() >= DirectExprs.size()) {
+        if (NegatedExprs >= DirectExprs) {
           ConsensusBB.insert(std::make_pair(BB, NotKind::SimpleIR));
         }
       }
       if (Predicate == llvm::ICmpInst::Predicate::ICMP_EQ) {
-        if (NegatedExprs.size() > DirectExprs.size()) {
+        if (NegatedExprs > DirectExprs) {
           ConsensusBB.insert(std::make_pair(BB, NotKind::SimpleIR));
         }
       }
@@ -243,7 +224,7 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
 
       // Handle the hybrid simplify starting the analysis from the `BooleanNot`
       // call in the LLVM IR
-      if (NegatedExprs.size() >= DirectExprs.size()) {
+      if (NegatedExprs >= DirectExprs) {
         ConsensusBB.insert(std::make_pair(BB, NotKind::BooleanNot));
       }
     }
@@ -308,46 +289,90 @@ static void flipIRNot(BasicBlock *BB, const NotKind &NotKind) {
   return;
 }
 
-static void
-flipAssociatedExprs(ASTTree &AST, BBExprsMap &BBExprs, BasicBlock *BB) {
-  // Flip the condition on the expressions associated to the BasicBlock under
-  // analysis
-  auto It = BBExprs.find(BB);
-  revng_assert(It != BBExprs.end());
-
-  auto &AssociatedExprs = It->second;
-  auto &DirectExprs = AssociatedExprs.DirectExprs;
-  auto &NegatedExprs = AssociatedExprs.NegatedExprs;
-
-  // Iterate over the sets of the direct and negated associated expressions
-  for (ExprNode **DirectExpr : DirectExprs) {
-    using UniqueExpr = ASTTree::expr_unique_ptr;
-    UniqueExpr Not;
-    Not.reset(new NotNode(*DirectExpr));
-    ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-    *DirectExpr = NotNode;
-  }
+using ExprNodeMap = llvm::DenseMap<ExprNode *, ExprNode *>;
+
+static RecursiveCoroutine<ExprNode *>
+flipAssociatedExprs(ASTTree &AST,
+                    ExprNode *Expr,
+                    ConsensusMap &BBs,
+                    ExprNodeMap &Flipped) {
+  // Conditions are immutable and shared, so we build the flipped version of
+  // each of them only once, reusing the original when nothing changes
+  auto It = Flipped.find(Expr);
+  if (It != Flipped.end())
+    rc_return It->second;
+
+  ExprNode *Result = Expr;
+  switch (Expr->getKind()) {
+  case ExprNode::NodeKind::NK_ValueCompare:
+  case ExprNode::NodeKind::NK_LoopStateCompare:
+    break;
 
-  for (ExprNode **NegatedExpr : NegatedExprs) {
-    NotNode *ContainedNot = llvm::cast<NotNode>(*NegatedExpr);
-    ExprNode *AtomicNode = ContainedNot->getNegatedNode();
-    *NegatedExpr = AtomicNode;
+  case ExprNode::NodeKind::NK_Atomic: {
+    // Negate the direct expressions associated to a flipped BasicBlock
+    auto *Atomic = llvm::cast<AtomicNode>(Expr);
+    if (BBs.count(Atomic->getConditionalBasicBlock())) {
+      Result = AST.addCondExpr<NotNode>(Expr);
+    }
+  } break;
+
+  case ExprNode::NodeKind::NK_Not: {
+    auto *Not = llvm::cast<NotNode>(Expr);
+    ExprNode *Negated = Not->getNegatedNode();
+    if (auto *Contained = llvm::dyn_cast<AtomicNode>(Negated)) {
+
+      // Remove the negation from the negated expressions associated to a
+      // flipped BasicBlock
+      if (BBs.count(Contained->getConditionalBasicBlock()))
+        Result = Contained;
+    } else {
+      ExprNode *NewNegated = rc_recur flipAssociatedExprs(AST,
+                                                          Negated,
+                                                          BBs,
+                                                          Flipped);
+      if (NewNegated != Negated)
+        Result = AST.addCondExpr<NotNode>(NewNegated);
+    }
+  } break;
+
+  case ExprNode::NodeKind::NK_And:
+  case ExprNode::NodeKind::NK_Or: {
+    auto *Binary = llvm::cast<BinaryNode>(Expr);
+    const auto &[LHS, RHS] = Binary->getInternalNodes();
+    ExprNode *NewLHS = rc_recur flipAssociatedExprs(AST, LHS, BBs, Flipped);
+    ExprNode *NewRHS = rc_recur flipAssociatedExprs(AST, RHS, BBs, Flipped);
+    if (NewLHS != LHS or NewRHS != RHS) {
+      if (llvm::isa<AndNode>(Binary))
+        Result = AST.addCondExpr<AndNode>(NewLHS, NewRHS);
+      else
+        Result = AST.addCondExpr<OrNode>(NewLHS, NewRHS);
+    }
+  } break;
+
+  default:
+    revng_abort();
   }
+
+  Flipped[Expr] = Result;
+  rc_return Result;
 }
 
 static void simplifyHybridNotImpl(ASTTree &AST,
-                                  BBExprsMap &BBExprs,
+                                  IfNodeSet &Ifs,
                                   ConsensusMap &ConsensusBB) {
-  for (const auto &[BB, NotKind] : ConsensusBB) {
+  if (ConsensusBB.empty())
+    return;
 
-    // Flip the condition on the LLVMIR
+  // Flip the condition on the LLVMIR
+  for (const auto &[BB, NotKind] : ConsensusBB)
     flipIRNot(BB, NotKind);
 
-    // Flip the condition on the `ExprNode`s
-    flipAssociatedExprs(AST, BBExprs, BB);
+  // Flip the condition on the `ExprNode`s, for all the BasicBlocks at once
+  ExprNodeMap Flipped;
+  for (IfNode *If : Ifs) {
+    ExprNode *Expr = If->getCondExpr();
+    If->replaceCondExpr(flipAssociatedExprs(AST, Expr, ConsensusBB, Flipped));
   }
-
-  return;
 }
 
 ASTNode *simplifyHybridNot(ASTTree &AST, ASTNode *RootNode) {
@@ -357,10 +382,11 @@ ASTNode *simplifyHybridNot(ASTTree &AST, ASTNode *RootNode) {
   // and the negation that is represented on the IR level with a comparison
   // which implies a negation.
   BBExprsMap BBExprs;
+  IfNodeSet Ifs;
 
-  // Map that contains the correspondence of the `ExprNode`s affected by a
-  // BasicBlock
-  populateAssociatedExprMap(AST, RootNode, BBExprs);
+  // Map that contains the number of occurrences of the `ExprNode`s affected by
+  // a BasicBlock
+  populateAssociatedExprMap(AST, RootNode, BBExprs, Ifs);
 
   // Run the analysis which checks if all the references to a single instance of
   // block that is a candidate for flipping, do agree for the flip operation
@@ -368,7 +394,7 @@ ASTNode *simplifyHybridNot(ASTTree &AST, ASTNode *RootNode) {
 
   // Perform the simplification for the BBs for which the consensus computation
   // agrees on the outcome of the transformation
-  simplifyHybridNotImpl(AST, BBExprs, ConsensusBB);
+  simplifyHybridNotImpl(AST, Ifs, ConsensusBB);
 
   return RootNode;
 }
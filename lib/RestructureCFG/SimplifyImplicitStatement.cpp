@@ -165,7 +165,9 @@ simplifyImplicitStatementImpl(ASTTree &AST,
   } break;
   case ASTNode::NK_Set:
   case ASTNode::NK_SwitchBreak:
-  case ASTNode::NK_Break: {
+  case ASTNode::NK_Break:
+  case ASTNode::NK_Label:
+  case ASTNode::NK_Goto: {
     // All these emit a statement
     rc_return false;
   } break;
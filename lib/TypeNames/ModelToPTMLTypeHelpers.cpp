@@ -2,10 +2,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
 #include <unordered_map>
 
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
@@ -46,6 +48,51 @@ TypeInlineHelper::TypeInlineHelper(const model::Binary &Model) {
   TypesToInline = findTypesToInline(Model, TypeGraph);
 }
 
+/// Hash everything the results of TypeInlineHelper depend upon: the identity
+/// and the kind of each type, the edges among them and the stack frame types.
+/// Since the analysis results are pointers to model::Types, their addresses are
+/// part of the hash too.
+static llvm::hash_code hashInliningInputs(const model::Binary &Model) {
+  llvm::hash_code Result = llvm::hash_combine(&Model, Model.Types().size());
+
+  for (const UpcastablePointer<model::Type> &T : Model.Types()) {
+    Result = llvm::hash_combine(Result, T.get(), T->Kind());
+    for (const model::QualifiedType &QT : T->edges())
+      Result = llvm::hash_combine(Result,
+                                  QT.UnqualifiedType().get(),
+                                  QT.isPointer());
+  }
+
+  for (const model::Function &Function : Model.Functions()) {
+    const model::Type *StackT = nullptr;
+    if (not Function.StackFrameType().empty())
+      StackT = Function.StackFrameType().getConst();
+    Result = llvm::hash_combine(Result, StackT);
+  }
+
+  return Result;
+}
+
+std::shared_ptr<const TypeInlineHelper>
+TypeInlineHelper::get(const model::Binary &Model) {
+  // Only the helper for the latest version of the model is kept around: as soon
+  // as the model changes the old one is dropped. Users still holding it keep it
+  // alive through their shared_ptr.
+  static std::mutex Mutex;
+  static llvm::hash_code CachedHash;
+  static std::shared_ptr<const TypeInlineHelper> Cached;
+
+  llvm::hash_code Hash = hashInliningInputs(Model);
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  if (Cached == nullptr or CachedHash != Hash) {
+    Cached = std::make_shared<const TypeInlineHelper>(Model);
+    CachedHash = Hash;
+  }
+
+  return Cached;
+}
+
 const GraphInfo &TypeInlineHelper::getTypeGraph() const {
   return TypeGraph;
 }
@@ -145,24 +192,53 @@ TypeInlineHelper::calculateNumOfOccurences(const model::Binary &Model) {
   return Result;
 }
 
+TypeSet
+TypeInlineHelper::getStackTypesToInline(const model::Binary &Model,
+                                        const model::Function &Function) const {
+  TypeSet Result;
+  if (Function.StackFrameType().empty())
+    return Result;
+
+  const model::Type *StackT = Function.StackFrameType().getConst();
+  // Do not inline stack types that are being used somewhere else.
+  auto TheTypeToNumOfRefs = TypeToNumOfRefs.find(StackT);
+  if (TheTypeToNumOfRefs != TypeToNumOfRefs.end()
+      and TheTypeToNumOfRefs->second != 0)
+    return Result;
+
+  revng_assert(StackT->Kind() == model::TypeKind::StructType);
+  Result.insert(StackT);
+  auto AllNestedTypes = getTypesToInlineInTypeTy(Model, StackT);
+  Result.merge(AllNestedTypes);
+  return Result;
+}
+
 StackTypesMap
 TypeInlineHelper::findStackTypesPerFunction(const model::Binary &Model) const {
   StackTypesMap Result;
 
   for (auto &Function : Model.Functions()) {
-    if (not Function.StackFrameType().empty()) {
-      const model::Type *StackT = Function.StackFrameType().getConst();
-      // Do not inline stack types that are being used somewhere else.
-      auto TheTypeToNumOfRefs = TypeToNumOfRefs.find(StackT);
-      if (TheTypeToNumOfRefs != TypeToNumOfRefs.end()
-          and TheTypeToNumOfRefs->second != 0)
-        continue;
+    auto StackTypes = getStackTypesToInline(Model, Function);
+    if (not StackTypes.empty())
+      Result[&Function] = std::move(StackTypes);
+  }
 
-      revng_assert(StackT->Kind() == model::TypeKind::StructType);
-      Result[&Function].insert(StackT);
-      auto AllNestedTypes = getTypesToInlineInTypeTy(Model, StackT);
-      Result[&Function].merge(AllNestedTypes);
-    }
+  return Result;
+}
+
+StackTypesMap TypeInlineHelper::findStackTypesPerFunction(
+  const model::Binary &Model,
+  const std::set<MetaAddress> &Functions) const {
+  StackTypesMap Result;
+
+  for (const MetaAddress &Entry : Functions) {
+    auto It = Model.Functions().find(Entry);
+    if (It == Model.Functions().end())
+      continue;
+
+    auto StackTypes = getStackTypesToInline(Model, *It);
+    if (not StackTypes.empty())
+      Result[&*It] = std::move(StackTypes);
   }
 
   return Result;
@@ -677,7 +753,7 @@ bool isCandidateForInline(const model::Type *T) {
 bool TypeInlineHelper::isReachableFromRootType(const model::Type *Type,
                                                const model::Type *RootType,
                                                const GraphInfo &TypeGraph) {
-  auto TheTypeToNode = TypeGraph.TypeToNode;
+  const auto &TheTypeToNode = TypeGraph.TypeToNode;
 
   // Visit all the nodes reachable from RootType.
   llvm::df_iterator_default_set<Node *> Visited;
@@ -0,0 +1,255 @@
+/// \file CombingBenchmark.cpp
+/// Scaling benchmark for the combing of RegionCFGs built from synthetic graphs
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+
+#define BOOST_TEST_MODULE CombingBenchmark
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Debug.h"
+#include "revng/Support/GraphAlgorithms.h"
+#include "revng/UnitTestHelpers/DotGraphObject.h"
+
+#include "revng-c/RestructureCFG/BasicBlockNode.h"
+#include "revng-c/RestructureCFG/BasicBlockNodeImpl.h"
+#include "revng-c/RestructureCFG/RegionCFGTree.h"
+#include "revng-c/RestructureCFG/RegionCFGTreeImpl.h"
+#include "revng-c/RestructureCFG/Utils.h"
+
+using namespace llvm;
+
+// Specialization of the `WeightTraits` for the `DotNode` class. In this
+// situation we simply use 1 as default weight.
+template<>
+struct WeightTraits<DotNode *> {
+  static inline size_t getWeight(DotNode *) { return 1; }
+};
+
+using BBNodeDot = BasicBlockNode<DotNode *>;
+using DotEdge = std::pair<BBNodeDot *, BBNodeDot *>;
+
+/// Emits the edges of a synthetic graph in dot format. The node called
+/// "entry" is the entry of the graph.
+using GraphGenerator = std::function<void(raw_ostream &, unsigned)>;
+
+static std::string node(unsigned Index) {
+  return Index == 0 ? "entry" : "n" + std::to_string(Index);
+}
+
+static void edge(raw_ostream &Out, const Twine &From, const Twine &To) {
+  Out << From << " -> " << To << ";\n";
+}
+
+/// A loop nest as deep as half of \a Size: each loop can either enter the
+/// inner loop or skip it, and then reaches its latch
+static void emitNestedLoops(raw_ostream &Out, unsigned Size) {
+  unsigned Depth = std::max(Size / 2, 1U);
+  edge(Out, "entry", "h1");
+  for (unsigned I = 1; I <= Depth; ++I) {
+    std::string Header = "h" + std::to_string(I);
+    std::string Latch = "l" + std::to_string(I);
+    if (I != Depth) {
+      edge(Out, Header, "h" + std::to_string(I + 1));
+      edge(Out, "l" + std::to_string(I + 1), Latch);
+    }
+    edge(Out, Header, Latch);
+    edge(Out, Latch, Header);
+  }
+  edge(Out, "l1", "exit");
+}
+
+/// A chain of irreducible regions, each one with two entries
+static void emitIrreducibleChain(raw_ostream &Out, unsigned Size) {
+  unsigned Regions = std::max(Size / 3, 1U);
+  for (unsigned I = 0; I < Regions; ++I) {
+    std::string Dispatch = node(3 * I);
+    std::string A = "a" + std::to_string(I);
+    std::string B = "b" + std::to_string(I);
+    std::string Next = node(3 * (I + 1));
+    edge(Out, Dispatch, A);
+    edge(Out, Dispatch, B);
+    edge(Out, A, B);
+    edge(Out, B, A);
+    edge(Out, A, Next);
+    edge(Out, B, Next);
+  }
+}
+
+/// A single switch with \a Size cases, every other case falling through into
+/// the next one
+static void emitHugeSwitch(raw_ostream &Out, unsigned Size) {
+  for (unsigned I = 1; I <= Size; ++I) {
+    edge(Out, "entry", node(I));
+    if (I % 2 == 1 and I != Size)
+      edge(Out, node(I), node(I + 1));
+    else
+      edge(Out, node(I), "exit");
+  }
+}
+
+/// A sequence of `if`s without `else`, each one leaving the chain early
+static void emitIfChain(raw_ostream &Out, unsigned Size) {
+  unsigned Ifs = std::max(Size / 2, 1U);
+  for (unsigned I = 0; I < Ifs; ++I) {
+    std::string Condition = node(I);
+    std::string Then = "t" + std::to_string(I);
+    std::string Next = node(I + 1);
+    edge(Out, Condition, Then);
+    edge(Out, Condition, Next);
+    edge(Out, Then, Next);
+    if (I % 4 == 3)
+      edge(Out, Then, "exit");
+  }
+  edge(Out, node(Ifs), "exit");
+}
+
+/// A random DAG, where each node has one or two successors among the
+/// following ones. The edges are local, to keep the duplication bounded.
+static void emitRandomDAG(raw_ostream &Out, unsigned Size) {
+  constexpr unsigned Window = 8;
+  std::mt19937 Generator(Size);
+  for (unsigned I = 0; I + 1 < Size; ++I) {
+    unsigned Last = std::min(I + Window, Size - 1);
+    std::uniform_int_distribution<unsigned> Successor(I + 1, Last);
+    unsigned First = Successor(Generator);
+    edge(Out, node(I), node(First));
+    if (Generator() % 2 == 0) {
+      unsigned Second = Successor(Generator);
+      if (Second != First)
+        edge(Out, node(I), node(Second));
+    }
+  }
+}
+
+/// Wall time and heap usage of each step of the combing of a graph
+struct CombingMeasurement {
+  size_t InitialNodes = 0;
+  size_t FinalNodes = 0;
+  size_t Backedges = 0;
+  double InitializeSeconds = 0;
+  double SCSSeconds = 0;
+  double InflateSeconds = 0;
+  int64_t HeapDelta = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point Start) {
+  std::chrono::duration<double> Elapsed = Clock::now() - Start;
+  return Elapsed.count();
+}
+
+static CombingMeasurement
+measureCombing(const GraphGenerator &Generator, unsigned Size) {
+  CombingMeasurement Result;
+
+  // Serialize the synthetic graph, so that it goes through the same path of
+  // the other tests
+  SmallString<128> Path;
+  int FD;
+  std::error_code Error = sys::fs::createTemporaryFile("combing-benchmark",
+                                                       "dot",
+                                                       FD,
+                                                       Path);
+  revng_assert(not Error);
+  {
+    raw_fd_ostream Out(FD, /* shouldClose */ true);
+    Out << "digraph Benchmark {\n";
+    Generator(Out, Size);
+    Out << "}\n";
+  }
+
+  uint64_t HeapBefore = sys::Process::GetMallocUsage();
+  auto Start = Clock::now();
+
+  DotGraph Dot;
+  Dot.parseDotFromFile(Path.str().str(), "entry");
+  RegionCFG<DotNode *> Region;
+  Region.initialize(&Dot);
+  Result.InitialNodes = Region.size();
+  Result.InitializeSeconds = secondsSince(Start);
+
+  // Identify the SCSs, as the restructuring does, and then turn the retreating
+  // edges into `continue` nodes, to obtain the acyclic body that is combed
+  Start = Clock::now();
+  auto Backedges = getBackedges(&Region.getEntryNode()).takeSet();
+  size_t SCSNodes = 0;
+  for (const DotEdge &Backedge : Backedges)
+    SCSNodes += nodesBetween(Backedge.second, Backedge.first).size();
+  revng_assert(Backedges.empty() or SCSNodes != 0);
+  for (const DotEdge &Backedge : Backedges)
+    moveEdgeTarget(Backedge, Region.addContinue());
+  revng_assert(Region.isDAG());
+  Result.Backedges = Backedges.size();
+  Result.SCSSeconds = secondsSince(Start);
+
+  Start = Clock::now();
+  Region.inflate();
+  Result.InflateSeconds = secondsSince(Start);
+  Result.FinalNodes = Region.size();
+
+  Result.HeapDelta = static_cast<int64_t>(sys::Process::GetMallocUsage())
+                     - static_cast<int64_t>(HeapBefore);
+
+  sys::fs::remove(Path);
+  return Result;
+}
+
+/// Graph sizes go from 1000 nodes up to the value of the first argument of the
+/// test, growing by a factor of 10
+static unsigned getMaximumSize() {
+  auto &Suite = boost::unit_test::framework::master_test_suite();
+  if (Suite.argc > 1)
+    return std::strtoul(Suite.argv[1], nullptr, 10);
+  return 1000;
+}
+
+static void runBenchmark(const char *Name, const GraphGenerator &Generator) {
+  unsigned MaximumSize = getMaximumSize();
+  for (unsigned Size = 1000; Size <= MaximumSize; Size *= 10) {
+    CombingMeasurement M = measureCombing(Generator, Size);
+    BOOST_TEST(M.FinalNodes >= M.InitialNodes);
+    BOOST_TEST_MESSAGE(Name << ": " << M.InitialNodes << " nodes, "
+                            << M.Backedges << " backedges, "
+                            << "initialize " << M.InitializeSeconds << "s, "
+                            << "SCS " << M.SCSSeconds << "s, "
+                            << "inflate " << M.InflateSeconds << "s, "
+                            << M.FinalNodes << " nodes after combing, "
+                            << "heap delta " << M.HeapDelta << " bytes");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(NestedLoops) {
+  runBenchmark("nested loops", emitNestedLoops);
+}
+
+BOOST_AUTO_TEST_CASE(IrreducibleChain) {
+  runBenchmark("irreducible chain", emitIrreducibleChain);
+}
+
+BOOST_AUTO_TEST_CASE(HugeSwitch) {
+  runBenchmark("huge switch", emitHugeSwitch);
+}
+
+BOOST_AUTO_TEST_CASE(IfChain) {
+  runBenchmark("if chain", emitIfChain);
+}
+
+BOOST_AUTO_TEST_CASE(RandomDAG) {
+  runBenchmark("random DAG", emitRandomDAG);
+}
@@ -0,0 +1,310 @@
+/// \file DLAMiddleEndBenchmark.cpp
+/// Scaling benchmark for the DLA middle-end on synthetic type systems, and
+/// checks of the changes that its Steps report for incremental runs
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BOOST_TEST_MODULE DLAMiddleEndBenchmark
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+#include "lib/DataLayoutAnalysis/Middleend/DLAStep.h"
+
+using LTSN = dla::LayoutTypeSystemNode;
+
+using namespace llvm;
+using namespace dla;
+
+static constexpr uint64_t PointerSize = 8;
+
+/// Adds to \a TS the nodes and links that the DLA frontend would create for a
+/// function with \a Accesses memory accesses.
+///
+/// Each access reads or writes a field of one of the base pointers of the
+/// function, possibly inside an array. Accesses as large as a pointer load or
+/// store pointers to other base pointers, to fresh values, or to the pointees
+/// of the previous functions, so that the type systems of different functions
+/// are connected.
+static void addSyntheticFunction(LayoutTypeSystem &TS,
+                                 std::mt19937 &Generator,
+                                 SmallVectorImpl<LTSN *> &Pointees,
+                                 unsigned Accesses) {
+  const auto Chance = [&Generator](unsigned Percent) {
+    return Generator() % 100 < Percent;
+  };
+  const auto Pick = [&Generator](const auto &Range) {
+    return Range[Generator() % std::size(Range)];
+  };
+  // Functions only share the pointees of the functions processed just before
+  // them, to keep the types of the whole program from collapsing together
+  const auto PickPointee = [&Generator, &Pointees]() {
+    size_t Window = std::min<size_t>(Pointees.size(), 32);
+    return Pointees[Pointees.size() - 1 - Generator() % Window];
+  };
+
+  SmallVector<LTSN *, 8> Bases;
+  unsigned NumBases = 1 + Accesses / 8;
+  for (unsigned I = 0; I < NumBases; ++I) {
+    if (not Pointees.empty() and Chance(30))
+      Bases.push_back(PickPointee());
+    else
+      Bases.push_back(TS.createArtificialLayoutType());
+  }
+
+  // Copies and casts of the base pointers
+  for (unsigned I = 0; I < NumBases; ++I) {
+    if (Chance(20))
+      TS.addEqualityLink(Bases[I], TS.createArtificialLayoutType());
+    if (Chance(10))
+      TS.addInstanceLink(Pick(Bases), Bases[I], OffsetExpression{});
+  }
+
+  static constexpr uint64_t AccessSizes[] = { 1, 2, 4, 8, 8, 8 };
+  for (unsigned I = 0; I < Accesses; ++I) {
+    uint64_t Size = Pick(AccessSizes);
+
+    // The address of the access
+    OffsetExpression OE{};
+    OE.Offset = Size * (Generator() % 16);
+    if (Chance(15)) {
+      uint64_t Stride = Size * (1 + Generator() % 4);
+      OE.Offset %= Stride;
+      OE.Strides.push_back(Stride);
+      if (Chance(50))
+        OE.TripCounts.push_back(2 + Generator() % 30);
+      else
+        OE.TripCounts.push_back(std::nullopt);
+    }
+    LTSN *Address = TS.createArtificialLayoutType();
+    TS.addInstanceLink(Pick(Bases), Address, std::move(OE));
+
+    LTSN *Access = TS.createArtificialLayoutType();
+    Access->Size = Size;
+    Access->InterferingInfo = AllChildrenAreNonInterfering;
+    TS.addInstanceLink(Address, Access, OffsetExpression{});
+
+    if (Size != PointerSize)
+      continue;
+
+    // The loaded or stored value is a pointer
+    LTSN *Pointee = nullptr;
+    if (Chance(40))
+      Pointee = Pick(Bases);
+    else if (not Pointees.empty() and Chance(30))
+      Pointee = PickPointee();
+    else
+      Pointee = TS.createArtificialLayoutType();
+    Pointees.push_back(Pointee);
+
+    Pointee->InterferingInfo = Unknown;
+    TS.addPointerLink(Access, Pointee);
+
+    using PointerGraph = EdgeFilteredGraph<LTSN *, isPointerEdge>;
+    for (LTSN *PointerToPointee :
+         llvm::children<llvm::Inverse<PointerGraph>>(Pointee))
+      if (PointerToPointee != Access)
+        TS.addEqualityLink(PointerToPointee, Access);
+  }
+}
+
+/// Adds to \a TS \a Functions synthetic functions, generated from \a Seed
+static void addSyntheticFunctions(LayoutTypeSystem &TS,
+                                  unsigned Functions,
+                                  unsigned Seed) {
+  std::mt19937 Generator(Seed);
+  SmallVector<LTSN *, 0> Pointees;
+  for (unsigned I = 0; I < Functions; ++I)
+    addSyntheticFunction(TS, Generator, Pointees, 4 + Generator() % 60);
+}
+
+struct MiddleEndMeasurement {
+  size_t InitialNodes = 0;
+  size_t InitialEdges = 0;
+  size_t FinalNodes = 0;
+  size_t FinalEdges = 0;
+  double Seconds = 0;
+};
+
+static size_t countEdges(const LayoutTypeSystem &TS) {
+  size_t Result = 0;
+  for (const LTSN *N : TS.getLayoutsRange())
+    Result += N->Successors.size();
+  return Result;
+}
+
+static MiddleEndMeasurement measureMiddleEnd(unsigned Functions) {
+  MiddleEndMeasurement Result;
+
+  LayoutTypeSystem TS;
+  addSyntheticFunctions(TS, Functions, Functions);
+  Result.InitialNodes = TS.getNumLayouts();
+  Result.InitialEdges = countEdges(TS);
+
+  StepManager SM;
+  scheduleMiddleEndSteps(SM, PointerSize);
+
+  auto Start = std::chrono::steady_clock::now();
+  SM.run(TS);
+  std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now()
+                                          - Start;
+  Result.Seconds = Elapsed.count();
+
+  Result.FinalNodes = TS.getNumLayouts();
+  Result.FinalEdges = countEdges(TS);
+  revng_check(TS.verifyConsistency());
+  return Result;
+}
+
+/// The number of synthetic functions goes from 100 up to the value of the first
+/// argument of the test, growing by a factor of 10
+static unsigned getMaximumFunctions() {
+  auto &Suite = boost::unit_test::framework::master_test_suite();
+  if (Suite.argc > 1)
+    return std::strtoul(Suite.argv[1], nullptr, 10);
+  return 100;
+}
+
+BOOST_AUTO_TEST_CASE(MiddleEndPipeline) {
+  unsigned MaximumFunctions = getMaximumFunctions();
+  for (unsigned Functions = 100; Functions <= MaximumFunctions;
+       Functions *= 10) {
+    MiddleEndMeasurement M = measureMiddleEnd(Functions);
+    BOOST_TEST(M.FinalNodes != 0U);
+    BOOST_TEST_MESSAGE(Functions << " functions: " << M.InitialNodes
+                                 << " nodes and " << M.InitialEdges
+                                 << " edges, middle-end " << M.Seconds
+                                 << "s, " << M.FinalNodes << " nodes and "
+                                 << M.FinalEdges << " edges after it");
+  }
+}
+
+/// Prints the nodes of \a TS and their edges, in order of ID
+static std::string printTypeSystem(const LayoutTypeSystem &TS) {
+  std::string Result;
+  raw_string_ostream OS(Result);
+  for (const LTSN *N : TS.getLayoutsRange()) {
+    OS << N->ID << ": size " << N->Size << ", interfering "
+       << static_cast<int>(N->InterferingInfo)
+       << (N->NonScalar ? ", non-scalar" : "") << "\n";
+    for (const auto &[Child, Tag] : N->Successors) {
+      OS << "  -> " << Child->ID << ", kind "
+         << static_cast<int>(Tag->getKind());
+      if (Tag->getKind() == TypeLinkTag::LK_Instance) {
+        OS << ", ";
+        Tag->getOffsetExpr().print(OS);
+      }
+      OS << "\n";
+    }
+  }
+  return OS.str();
+}
+
+/// Runs the middle-end on a synthetic type system, and prints the result
+static std::string
+runMiddleEnd(unsigned Functions, unsigned Seed, bool Incremental) {
+  LayoutTypeSystem TS;
+  addSyntheticFunctions(TS, Functions, Seed);
+
+  StepManager SM;
+  scheduleMiddleEndSteps(SM, PointerSize);
+  SM.enableStatistics();
+  if (not Incremental)
+    SM.disableIncrementalRuns();
+  SM.run(TS);
+  revng_check(TS.verifyConsistency());
+
+  const auto IsIncremental = [](const StepStatistics &Stats) {
+    return Stats.Incremental;
+  };
+  BOOST_TEST(llvm::any_of(SM.getStatistics(), IsIncremental) == Incremental);
+
+  return printTypeSystem(TS);
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalRunsMatchFullRuns) {
+  // A Step that changes a node without marking it as changed makes the
+  // incremental runs of the other Steps miss it. Most nodes change between two
+  // runs of a Step on large type systems, so many small ones are used.
+  for (unsigned Seed = 1; Seed <= 64; ++Seed) {
+    unsigned Functions = 1 + Seed % 16;
+    std::string Full = runMiddleEnd(Functions, Seed, /*Incremental=*/false);
+    std::string Incremental = runMiddleEnd(Functions,
+                                           Seed,
+                                           /*Incremental=*/true);
+    BOOST_TEST((Full == Incremental), "Different results with seed " << Seed);
+  }
+}
+
+/// What a Step has to report with markChanged when it changes a node
+struct NodeState {
+  uint64_t Size = 0;
+  std::vector<std::pair<uint64_t, const TypeLinkTag *>> Successors;
+  std::vector<std::pair<uint64_t, const TypeLinkTag *>> Predecessors;
+
+  explicit NodeState(const LTSN *N) : Size(N->Size) {
+    for (const auto &[Child, Tag] : N->Successors)
+      Successors.emplace_back(Child->ID, Tag);
+    for (const auto &[Parent, Tag] : N->Predecessors)
+      Predecessors.emplace_back(Parent->ID, Tag);
+  }
+
+  bool operator==(const NodeState &) const = default;
+};
+
+static std::map<uint64_t, NodeState> getNodeStates(const LayoutTypeSystem &TS) {
+  std::map<uint64_t, NodeState> Result;
+  for (const LTSN *N : TS.getLayoutsRange())
+    Result.emplace(N->ID, NodeState(N));
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(StepsMarkTheNodesTheyChange) {
+  for (unsigned Seed = 1; Seed <= 16; ++Seed) {
+    LayoutTypeSystem TS;
+    addSyntheticFunctions(TS, Seed, Seed);
+
+    StepManager SM;
+    scheduleMiddleEndSteps(SM, PointerSize);
+    unsigned Index = 0;
+    for (const std::unique_ptr<Step> &S : SM.sched()) {
+      std::map<uint64_t, NodeState> Before = getNodeStates(TS);
+      auto Checkpoint = TS.getChangeCheckpoint();
+      S->runOnTypeSystem(TS);
+
+      std::set<uint64_t> Changed;
+      for (const LTSN *N : TS.getChangedSince(Checkpoint))
+        Changed.insert(N->ID);
+
+      for (const LTSN *N : TS.getLayoutsRange()) {
+        auto It = Before.find(N->ID);
+        if (It != Before.end() and It->second == NodeState(N))
+          continue;
+
+        BOOST_TEST(Changed.contains(N->ID),
+                   "Step " << Index << " has changed node " << N->ID
+                           << " without marking it, with seed " << Seed);
+      }
+      ++Index;
+    }
+  }
+}
@@ -0,0 +1,184 @@
+/// \file DLANeighborsSet.cpp
+/// Tests for the set of the neighbors of the nodes of the DLA type system
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <iterator>
+#include <vector>
+
+#define BOOST_TEST_MODULE DLANeighborsSet
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+using namespace dla;
+
+using LTSN = LayoutTypeSystemNode;
+using NeighborsSet = LTSN::NeighborsSet;
+using Link = LTSN::Link;
+using LinkVector = std::vector<Link>;
+
+static const TypeLinkTag InstanceAt0 = TypeLinkTag::instanceTag(
+  OffsetExpression(0));
+static const TypeLinkTag InstanceAt8 = TypeLinkTag::instanceTag(
+  OffsetExpression(8));
+static const TypeLinkTag Pointer = TypeLinkTag::pointerTag();
+
+/// Returns the Links in \a Set, visited from the first to the last
+static LinkVector forward(const NeighborsSet &Set) {
+  return LinkVector(Set.begin(), Set.end());
+}
+
+/// Returns the Links in \a Set, visited from the last to the first
+static LinkVector backward(const NeighborsSet &Set) {
+  LinkVector Result;
+  for (auto It = Set.end(); It != Set.begin();)
+    Result.push_back(*--It);
+  return Result;
+}
+
+/// Checks that \a Set contains exactly \a Expected, in this order, visiting it
+/// in both directions
+static void checkContent(const NeighborsSet &Set, const LinkVector &Expected) {
+  BOOST_TEST(Set.size() == Expected.size());
+  BOOST_TEST(Set.empty() == Expected.empty());
+  BOOST_TEST((forward(Set) == Expected));
+  BOOST_TEST((backward(Set) == LinkVector(Expected.rbegin(), Expected.rend())));
+  for (const Link &L : Expected)
+    BOOST_TEST(Set.contains(L));
+}
+
+/// Neighbors are sorted by ID, and then by tag
+struct Fixture {
+  LayoutTypeSystem TS;
+  LTSN *A = TS.createArtificialLayoutType();
+  LTSN *B = TS.createArtificialLayoutType();
+  LTSN *C = TS.createArtificialLayoutType();
+  LinkVector Sorted = { { A, &InstanceAt0 },
+                        { A, &InstanceAt8 },
+                        { B, &Pointer },
+                        { C, &InstanceAt0 } };
+
+  NeighborsSet makeSet() const {
+    NeighborsSet Result;
+    // Insert in reverse order, to check that the set sorts the Links
+    for (const Link &L : llvm::reverse(Sorted))
+      BOOST_TEST(Result.insert(L).second);
+    return Result;
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(InsertSortsAndDeduplicates, Fixture) {
+  NeighborsSet Set = makeSet();
+  checkContent(Set, Sorted);
+
+  auto [It, Inserted] = Set.insert(Sorted[2]);
+  BOOST_TEST(not Inserted);
+  BOOST_TEST((*It == Sorted[2]));
+  checkContent(Set, Sorted);
+}
+
+BOOST_FIXTURE_TEST_CASE(EraseLeavesTombstones, Fixture) {
+  NeighborsSet Set = makeSet();
+
+  // Erasing does not invalidate the iterators to the other Links
+  auto Last = std::prev(Set.end());
+  auto Next = Set.erase(Set.find(Sorted[1]));
+  BOOST_TEST((*Next == Sorted[2]));
+  BOOST_TEST((*Last == Sorted[3]));
+
+  BOOST_TEST(not Set.contains(Sorted[1]));
+  BOOST_TEST((Set.find(Sorted[1]) == Set.end()));
+  BOOST_TEST(Set.erase(Sorted[1]) == 0U);
+  checkContent(Set, { Sorted[0], Sorted[2], Sorted[3] });
+
+  BOOST_TEST(Set.erase(Sorted[3]) == 1U);
+  checkContent(Set, { Sorted[0], Sorted[2] });
+
+  Set.erase(Set.begin(), Set.end());
+  checkContent(Set, {});
+}
+
+BOOST_FIXTURE_TEST_CASE(IteratorsSkipTombstones, Fixture) {
+  NeighborsSet Set = makeSet();
+
+  // Erase the first, the last and one of the Links in the middle, so that the
+  // remaining ones are surrounded by tombstones in both directions
+  Set.erase(Sorted[0]);
+  Set.erase(Sorted[2]);
+  Set.erase(Sorted[3]);
+  checkContent(Set, { Sorted[1] });
+  BOOST_TEST((*Set.begin() == Sorted[1]));
+  BOOST_TEST((*std::prev(Set.end()) == Sorted[1]));
+  BOOST_TEST((std::next(Set.begin()) == Set.end()));
+
+  // Searching for an erased Link reaches the next one that is not erased
+  BOOST_TEST((*Set.lower_bound(Sorted[0]) == Sorted[1]));
+  BOOST_TEST((Set.lower_bound(Sorted[2]) == Set.end()));
+  BOOST_TEST((Set.upper_bound(Sorted[1]) == Set.end()));
+}
+
+BOOST_FIXTURE_TEST_CASE(InsertRevivesErasedLinks, Fixture) {
+  NeighborsSet Set = makeSet();
+  Set.erase(Sorted[1]);
+  Set.erase(Sorted[3]);
+
+  // A Link equal to the erased one, but with a different tag object
+  const TypeLinkTag OtherInstanceAt8 = TypeLinkTag::instanceTag(
+    OffsetExpression(8));
+  Link Revived = { A, &OtherInstanceAt8 };
+  auto [It, Inserted] = Set.insert(Revived);
+  BOOST_TEST(Inserted);
+  BOOST_TEST(It->second == &OtherInstanceAt8);
+  checkContent(Set, { Sorted[0], Revived, Sorted[2] });
+
+  // The other tombstone is still skipped
+  BOOST_TEST(not Set.contains(Sorted[3]));
+  BOOST_TEST((std::next(It, 2) == Set.end()));
+}
+
+BOOST_FIXTURE_TEST_CASE(InsertCompactsTombstones, Fixture) {
+  NeighborsSet Set = makeSet();
+  Set.erase(Sorted[0]);
+  Set.erase(Sorted[2]);
+
+  // Inserting a new Link removes the tombstones, and keeps the set sorted
+  LTSN *D = TS.createArtificialLayoutType();
+  Link New = { D, &Pointer };
+  auto [It, Inserted] = Set.insert(New);
+  BOOST_TEST(Inserted);
+  BOOST_TEST((*It == New));
+  checkContent(Set, { Sorted[1], Sorted[3], New });
+
+  // The erased Links can be inserted again
+  BOOST_TEST(Set.insert(Sorted[2]).second);
+  BOOST_TEST(Set.insert(Sorted[0]).second);
+  checkContent(Set, { Sorted[0], Sorted[1], Sorted[2], Sorted[3], New });
+}
+
+BOOST_FIXTURE_TEST_CASE(RangeInsertKeepsExistingLinks, Fixture) {
+  NeighborsSet Set;
+  Set.insert(Sorted[0]);
+  Set.insert(Sorted[1]);
+  Set.insert(Sorted[3]);
+  Set.erase(Sorted[1]);
+
+  // The range is not sorted, contains duplicates, a Link equal to one in the
+  // set and a Link equal to an erased one
+  const TypeLinkTag OtherInstanceAt0 = TypeLinkTag::instanceTag(
+    OffsetExpression(0));
+  Link Duplicate = { C, &OtherInstanceAt0 };
+  LinkVector Range = { Sorted[2], Duplicate, Sorted[1], Sorted[2] };
+  Set.insert(Range.begin(), Range.end());
+  checkContent(Set, Sorted);
+
+  // The Link that was already in the set is kept
+  BOOST_TEST(Set.find(Duplicate)->second == &InstanceAt0);
+
+  // Inserting an empty range changes nothing
+  Set.insert(Range.end(), Range.end());
+  checkContent(Set, Sorted);
+}
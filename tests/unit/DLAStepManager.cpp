@@ -232,3 +232,38 @@ BOOST_AUTO_TEST_CASE(SimpleInvalidate) {
   BOOST_TEST(SM.getNumSteps() == 5);
   BOOST_TEST(SM.hasValidSchedule());
 }
+
+BOOST_AUTO_TEST_CASE(CollectStatistics) {
+  LayoutTypeSystem TS;
+  LayoutTypeSystemNode *Root = TS.createArtificialLayoutType();
+  LayoutTypeSystemNode *Copy = TS.createArtificialLayoutType();
+  LayoutTypeSystemNode *Field = TS.createArtificialLayoutType();
+  Field->Size = 8;
+  TS.addEqualityLink(Root, Copy);
+  TS.addInstanceLink(Copy, Field, OffsetExpression{});
+
+  StepManager SM;
+  SM.enableStatistics();
+  BOOST_TEST(SM.addStep<CollapseEqualitySCC>());
+  BOOST_TEST(SM.addStep<CollapseEqualitySCC>());
+  SM.run(TS);
+
+  auto Statistics = SM.getStatistics();
+  BOOST_TEST(Statistics.size() == 2U);
+
+  // The first run collapses Root and Copy
+  BOOST_TEST(Statistics[0].Name == "CollapseEqualitySCC");
+  BOOST_TEST(Statistics[0].Changed);
+  BOOST_TEST(Statistics[0].NodesBefore == 3U);
+  BOOST_TEST(Statistics[0].NodesAfter == 2U);
+  BOOST_TEST(Statistics[0].EdgesBefore == 3U);
+  BOOST_TEST(Statistics[0].EdgesAfter == 1U);
+  BOOST_TEST(Statistics[0].MergedNodes == 1U);
+  BOOST_TEST(Statistics[0].RemovedNodes == 0U);
+
+  // The second one has nothing left to do
+  BOOST_TEST(not Statistics[1].Changed);
+  BOOST_TEST(Statistics[1].NodesBefore == Statistics[1].NodesAfter);
+  BOOST_TEST(Statistics[1].EdgesBefore == Statistics[1].EdgesAfter);
+  BOOST_TEST(Statistics[1].MergedNodes == 0U);
+}
@@ -250,6 +250,41 @@ BOOST_AUTO_TEST_CASE(PruneLayoutNodesWithoutLayout_basic) {
     revng_check(Eq.isRemoved(ID));
 }
 
+/// Test that re-running on the changed nodes prunes the nodes left without
+/// sized leaves
+BOOST_AUTO_TEST_CASE(PruneLayoutNodesWithoutLayout_incremental) {
+  dla::LayoutTypeSystem TS;
+  VerifyLog.enable();
+
+  // Build TS
+  LTSN *Root = createRoot(TS);
+  LTSN *Mid = addInstanceAtOffset(TS, Root, /*offset=*/0, /*size=*/0);
+  LTSN *Leaf = addInstanceAtOffset(TS, Mid, /*offset=*/0, /*size=*/8);
+  LTSN *Other = addInstanceAtOffset(TS, Root, /*offset=*/8, /*size=*/8);
+
+  // Nothing to prune
+  dla::PruneLayoutNodesWithoutLayout Step;
+  revng_check(not Step.runOnTypeSystem(TS));
+  auto Checkpoint = TS.getChangeCheckpoint();
+
+  // Leave Mid without sized leaves
+  TS.removeNode(Leaf);
+  auto Changed = TS.getChangedSince(Checkpoint);
+  revng_check(Changed.size() == 1 and Changed[0] == Mid);
+
+  // Mid is pruned, Root still has a sized child
+  revng_check(Step.runOnChangedNodes(TS, Changed));
+  revng_check(TS.getNumLayouts() == 2);
+  revng_check(Root->Successors.size() == 1);
+  revng_check(llvm::is_contained(llvm::children<LTSN *>(Root), Other));
+
+  // Leave Root without sized leaves, so that it's pruned too
+  Checkpoint = TS.getChangeCheckpoint();
+  TS.removeNode(Other);
+  revng_check(Step.runOnChangedNodes(TS, TS.getChangedSince(Checkpoint)));
+  revng_check(TS.getNumLayouts() == 0);
+}
+
 // ----------------- CollapseSingleChild ----------------
 
 /// Test nominal case with one parent and one instance child at offset 0
@@ -498,6 +533,43 @@ BOOST_AUTO_TEST_CASE(ComputeUpperMemberAccesses_basic) {
   revng_check(not Eq.isRemoved(PtrNode->ID));
 }
 
+/// Test that re-running on the changed nodes propagates the new sizes up to
+/// the roots
+BOOST_AUTO_TEST_CASE(ComputeUpperMemberAccesses_incremental) {
+  dla::LayoutTypeSystem TS;
+  VerifyLog.enable();
+
+  // Build TS
+  LTSN *Root = createRoot(TS);
+  LTSN *Mid = addInstanceAtOffset(TS, Root, /*offset=*/4, /*size=*/0);
+  LTSN *Leaf = addInstanceAtOffset(TS, Mid, /*offset=*/0, /*size=*/8);
+
+  dla::ComputeUpperMemberAccesses Step;
+  revng_check(Step.runOnTypeSystem(TS));
+  revng_check(Mid->Size == 8);
+  revng_check(Root->Size == 12);
+  auto Checkpoint = TS.getChangeCheckpoint();
+
+  // Grow Leaf, and add a new child to Root
+  Leaf->Size = 16;
+  TS.markChanged(Leaf);
+  LTSN *Other = addInstanceAtOffset(TS, Root, /*offset=*/32, /*size=*/4);
+  auto Changed = TS.getChangedSince(Checkpoint);
+  revng_check(Changed.size() == 3);
+  revng_check(llvm::is_contained(Changed, Root));
+  revng_check(llvm::is_contained(Changed, Leaf));
+  revng_check(llvm::is_contained(Changed, Other));
+
+  revng_check(Step.runOnChangedNodes(TS, Changed));
+  revng_check(Mid->Size == 16);
+  revng_check(Root->Size == 36);
+
+  // Nothing changed since the previous run
+  Checkpoint = TS.getChangeCheckpoint();
+  revng_check(TS.getChangedSince(Checkpoint).empty());
+  revng_check(not Step.runOnChangedNodes(TS, {}));
+}
+
 // ----------------- ComputeNonInterferingComponents ----
 
 /// Test union nested inside a struct
@@ -0,0 +1,142 @@
+/// \file DecompileCache.cpp
+/// Tests for the persistent cache of the C code of decompiled functions
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <optional>
+#include <string>
+
+#define BOOST_TEST_MODULE DecompileCache
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/TupleTree/TupleTree.h"
+
+#include "lib/Backend/DecompileCache.h"
+
+using namespace llvm;
+
+static const MetaAddress Entry = MetaAddress::fromPC(Triple::x86_64, 0x400000);
+
+/// A model with a single function, taking a pointer to a struct, and the LLVM
+/// function isolated from it
+struct Fixture {
+  TupleTree<model::Binary> Model;
+  model::TypePath Struct;
+  LLVMContext Context;
+  Module M{ "decompile-cache", Context };
+  Function *F = nullptr;
+  FunctionMetadataCache Cache;
+  InlineableTypesMap StackTypes;
+  SmallString<128> Directory;
+
+  Fixture() {
+    Model->Architecture() = model::Architecture::x86_64;
+    Model->DefaultABI() = model::ABI::SystemV_x86_64;
+
+    auto NewStruct = model::makeType<model::StructType>();
+    auto *StructType = cast<model::StructType>(NewStruct.get());
+    StructType->Size() = 8;
+    StructType->Fields()[0].Type() = {
+      get64BitType(model::PrimitiveTypeKind::Signed), {}
+    };
+    Struct = Model->recordNewType(std::move(NewStruct));
+
+    auto NewPrototype = model::makeType<model::CABIFunctionType>();
+    auto *Prototype = cast<model::CABIFunctionType>(NewPrototype.get());
+    Prototype->ABI() = model::ABI::SystemV_x86_64;
+    Prototype->ReturnType() = {
+      Model->getPrimitiveType(model::PrimitiveTypeKind::Void, 0), {}
+    };
+    Prototype->Arguments()[0].Type() = {
+      Struct, { model::Qualifier::createPointer(8) }
+    };
+    Model->Functions()[Entry].Prototype() = Model->recordNewType(
+      std::move(NewPrototype));
+
+    auto *Int64 = Type::getInt64Ty(Context);
+    auto *FTy = FunctionType::get(Type::getVoidTy(Context), { Int64 }, false);
+    F = Function::Create(FTy, GlobalValue::ExternalLinkage, "function", &M);
+    setMetaAddressMetadata(F, FunctionEntryMDNName, Entry);
+    FunctionTags::Isolated.addTo(F);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", F));
+    Builder.CreateRetVoid();
+
+    auto Error = sys::fs::createUniqueDirectory("decompile-cache", Directory);
+    revng_assert(not Error);
+  }
+
+  ~Fixture() { sys::fs::remove_directories(Directory); }
+
+  model::TypePath get64BitType(model::PrimitiveTypeKind::Values Kind) {
+    return Model->getPrimitiveType(Kind, 8);
+  }
+
+  std::string computeKey(StringRef Options) {
+    DecompileCache DiskCache(Directory, *Model, Options);
+    return DiskCache.computeKey(Cache, *F, StackTypes);
+  }
+
+  std::optional<std::string> lookup(StringRef Options) {
+    DecompileCache DiskCache(Directory, *Model, Options);
+    return DiskCache.lookup(DiskCache.computeKey(Cache, *F, StackTypes));
+  }
+
+  void store(StringRef Options, StringRef CCode) {
+    DecompileCache DiskCache(Directory, *Model, Options);
+    DiskCache.store(DiskCache.computeKey(Cache, *F, StackTypes), CCode);
+  }
+};
+
+static constexpr const char *Options = "ptml-tags=yes";
+static constexpr const char *CCode = "void function(struct_0 *arg) {}\n";
+
+BOOST_FIXTURE_TEST_CASE(SameInputsHit, Fixture) {
+  BOOST_TEST(not lookup(Options).has_value());
+  store(Options, CCode);
+
+  // A new cache on the same directory, model and options finds the entry
+  std::optional<std::string> Cached = lookup(Options);
+  BOOST_REQUIRE(Cached.has_value());
+  BOOST_TEST(*Cached == CCode);
+}
+
+BOOST_FIXTURE_TEST_CASE(ChangedModelTypeMisses, Fixture) {
+  store(Options, CCode);
+  std::string OldKey = computeKey(Options);
+
+  // The struct is reachable from the type of the argument of the function
+  auto *StructType = cast<model::StructType>(Struct.get());
+  StructType->Fields()[0].Type() = {
+    get64BitType(model::PrimitiveTypeKind::Unsigned), {}
+  };
+
+  BOOST_TEST(computeKey(Options) != OldKey);
+  BOOST_TEST(not lookup(Options).has_value());
+}
+
+BOOST_FIXTURE_TEST_CASE(ChangedOptionsMiss, Fixture) {
+  store(Options, CCode);
+
+  BOOST_TEST(computeKey("ptml-tags=no") != computeKey(Options));
+  BOOST_TEST(not lookup("ptml-tags=no").has_value());
+  BOOST_TEST(lookup(Options).has_value());
+}
@@ -0,0 +1,103 @@
+/// \file DecompileTargets.cpp
+/// Tests for the selection of the functions to decompile
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE DecompileTargets
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompileFunction.h"
+
+using namespace llvm;
+
+static MetaAddress entryOf(unsigned Index) {
+  return MetaAddress::fromPC(Triple::x86_64, 0x400000 + 0x10 * Index);
+}
+
+/// Adds to \a M a function with entry number \a Index, tagged as isolated if
+/// \a Isolated, and with a body if \a Defined
+static Function *
+addFunction(Module &M, unsigned Index, bool Isolated, bool Defined) {
+  LLVMContext &Context = M.getContext();
+  auto *FTy = FunctionType::get(Type::getVoidTy(Context), false);
+  auto *F = Function::Create(FTy,
+                             GlobalValue::ExternalLinkage,
+                             "function_" + std::to_string(Index),
+                             &M);
+  setMetaAddressMetadata(F, FunctionEntryMDNName, entryOf(Index));
+  if (Isolated)
+    FunctionTags::Isolated.addTo(F);
+
+  if (Defined) {
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", F));
+    Builder.CreateRetVoid();
+  }
+
+  return F;
+}
+
+BOOST_AUTO_TEST_CASE(OnlyRequestedFunctionsAreSelected) {
+  LLVMContext Context;
+  Module M("decompile-targets", Context);
+  Function *First = addFunction(M, 0, true, true);
+  Function *Second = addFunction(M, 1, true, true);
+  Function *Third = addFunction(M, 2, true, true);
+  addFunction(M, 3, /* Isolated */ true, /* Defined */ false);
+  addFunction(M, 4, /* Isolated */ false, /* Defined */ true);
+
+  // No targets means all the isolated functions with a body
+  std::vector<Function *> All = { First, Second, Third };
+  BOOST_TEST(selectFunctionsToDecompile(M, {}) == All);
+
+  // Only the requested functions are restructured and emitted
+  std::vector<Function *> Selected = selectFunctionsToDecompile(M,
+                                                                { entryOf(1) });
+  BOOST_TEST(Selected == std::vector<Function *>{ Second });
+
+  Selected = selectFunctionsToDecompile(M, { entryOf(2), entryOf(0) });
+  BOOST_TEST(Selected == (std::vector<Function *>{ First, Third }));
+
+  // Declarations and functions that are not isolated are never selected
+  BOOST_TEST(selectFunctionsToDecompile(M, { entryOf(3) }).empty());
+  BOOST_TEST(selectFunctionsToDecompile(M, { entryOf(4) }).empty());
+
+  // Requesting a function that doesn't exist selects nothing
+  BOOST_TEST(selectFunctionsToDecompile(M, { entryOf(5) }).empty());
+}
+
+/// Requesting a single function of a large module selects exactly that one,
+/// wherever it is in the module
+BOOST_AUTO_TEST_CASE(SingleFunctionRequest) {
+  LLVMContext Context;
+  Module M("decompile-targets", Context);
+  constexpr unsigned Functions = 1000;
+  std::vector<Function *> All;
+  for (unsigned I = 0; I < Functions; ++I)
+    All.push_back(addFunction(M, I, true, true));
+
+  for (unsigned Index : { 0U, Functions / 2, Functions - 1 }) {
+    std::set<MetaAddress> Targets = { entryOf(Index) };
+    std::vector<Function *> Selected = selectFunctionsToDecompile(M, Targets);
+    BOOST_TEST(Selected == std::vector<Function *>{ All[Index] });
+  }
+}
@@ -0,0 +1,203 @@
+/// \file DecompiledFunctionArchive.cpp
+/// Tests for the indexed archive of decompiled functions
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+
+#define BOOST_TEST_MODULE DecompiledFunctionArchive
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Backend/DecompiledFunctionArchive.h"
+
+using namespace llvm;
+using namespace decompiled_archive;
+
+using revng::pipes::DecompileStringMap;
+
+static MetaAddress entryOf(unsigned Index) {
+  return MetaAddress::fromPC(Triple::x86_64, 0x400000 + 0x10 * Index);
+}
+
+static std::string bodyOf(unsigned Index) {
+  std::string Body = "void function_" + std::to_string(Index) + "(void) {\n";
+  for (unsigned I = 0; I <= Index; ++I)
+    Body += "  do_something(" + std::to_string(I) + ");\n";
+  return Body + "}\n";
+}
+
+/// Serializes an archive with the functions 0, 2 and 4, inserted out of order
+static std::string writeArchive(bool Compress) {
+  DecompileStringMap Functions("decompile");
+  for (unsigned Index : { 4, 0, 2 })
+    Functions.insert_or_assign(entryOf(Index), bodyOf(Index));
+
+  std::string Result;
+  raw_string_ostream OS(Result);
+  writeDecompiledFunctionArchive(OS, Functions, Compress);
+  OS.flush();
+  return Result;
+}
+
+static Expected<DecompiledFunctionArchive> readArchive(StringRef Data) {
+  auto Buffer = MemoryBuffer::getMemBufferCopy(Data);
+  return DecompiledFunctionArchive::create(std::move(Buffer));
+}
+
+static Header *getHeader(std::string &Data) {
+  return reinterpret_cast<Header *>(Data.data());
+}
+
+static IndexEntry *getIndex(std::string &Data) {
+  return reinterpret_cast<IndexEntry *>(Data.data() + sizeof(Header));
+}
+
+/// Returns the message of the error, or an empty string if there's none
+static std::string errorMessage(Error Err) {
+  if (not Err)
+    return "";
+  return toString(std::move(Err));
+}
+
+static void checkRoundTrip(bool Compress) {
+  std::string Data = writeArchive(Compress);
+  bool IsCompressed = getHeader(Data)->Flags & Flags::Compressed;
+  BOOST_TEST(IsCompressed == (Compress and compression::zlib::isAvailable()));
+
+  auto MaybeArchive = readArchive(Data);
+  BOOST_REQUIRE(errorMessage(MaybeArchive.takeError()) == "");
+  const DecompiledFunctionArchive &Archive = *MaybeArchive;
+
+  // The index is sorted by MetaAddress
+  BOOST_TEST(Archive.size() == 3U);
+  BOOST_TEST(Archive.getKey(0).toString() == entryOf(0).toString());
+  BOOST_TEST(Archive.getKey(1).toString() == entryOf(2).toString());
+  BOOST_TEST(Archive.getKey(2).toString() == entryOf(4).toString());
+
+  for (unsigned Index : { 0, 2, 4 }) {
+    auto MaybeBody = Archive.lookup(entryOf(Index));
+    BOOST_REQUIRE(errorMessage(MaybeBody.takeError()) == "");
+    BOOST_REQUIRE(MaybeBody->has_value());
+    BOOST_TEST(**MaybeBody == bodyOf(Index));
+  }
+
+  // Missing keys, before, between and after the existing ones
+  for (unsigned Index : { 1, 3, 5 }) {
+    auto MaybeBody = Archive.lookup(entryOf(Index));
+    BOOST_REQUIRE(errorMessage(MaybeBody.takeError()) == "");
+    BOOST_TEST(not MaybeBody->has_value());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RoundTripUncompressed) {
+  checkRoundTrip(false);
+}
+
+BOOST_AUTO_TEST_CASE(RoundTripCompressed) {
+  checkRoundTrip(true);
+}
+
+BOOST_AUTO_TEST_CASE(EmptyArchive) {
+  std::string Result;
+  raw_string_ostream OS(Result);
+  writeDecompiledFunctionArchive(OS, DecompileStringMap("decompile"), true);
+  OS.flush();
+
+  auto MaybeArchive = readArchive(Result);
+  BOOST_REQUIRE(errorMessage(MaybeArchive.takeError()) == "");
+  BOOST_TEST(MaybeArchive->size() == 0U);
+  auto MaybeBody = MaybeArchive->lookup(entryOf(0));
+  BOOST_REQUIRE(errorMessage(MaybeBody.takeError()) == "");
+  BOOST_TEST(not MaybeBody->has_value());
+}
+
+BOOST_AUTO_TEST_CASE(CorruptHeader) {
+  std::string Data = writeArchive(true);
+
+  // Truncated header
+  BOOST_TEST(errorMessage(readArchive(Data.substr(0, sizeof(Header) - 1))
+                            .takeError())
+               .find("truncated header")
+             != std::string::npos);
+
+  // Bad magic
+  std::string BadMagic = Data;
+  BadMagic[0] = 'X';
+  BOOST_TEST(errorMessage(readArchive(BadMagic).takeError()).find("bad magic")
+             != std::string::npos);
+
+  // Unsupported version
+  std::string BadVersion = Data;
+  getHeader(BadVersion)->Version = Version + 1;
+  BOOST_TEST(errorMessage(readArchive(BadVersion).takeError())
+               .find("unsupported version")
+             != std::string::npos);
+
+  // More entries than the file can hold
+  std::string BadCount = Data;
+  getHeader(BadCount)->EntryCount = uint64_t(1) << 40;
+  BOOST_TEST(errorMessage(readArchive(BadCount).takeError())
+               .find("truncated index")
+             != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TruncatedBody) {
+  for (bool Compress : { false, true }) {
+    std::string Data = writeArchive(Compress);
+    Data.pop_back();
+    BOOST_TEST(errorMessage(readArchive(Data).takeError())
+                 .find("out of bounds")
+               != std::string::npos);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidUncompressedSize) {
+  std::string Data = writeArchive(false);
+  IndexEntry &Entry = getIndex(Data)[1];
+  Entry.RawSize = Entry.RawSize + 1;
+  BOOST_TEST(errorMessage(readArchive(Data).takeError())
+               .find("invalid uncompressed size")
+             != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(CorruptCompressedBody) {
+  if (not compression::zlib::isAvailable())
+    return;
+
+  std::string Data = writeArchive(true);
+  const IndexEntry &Corrupt = getIndex(Data)[1];
+  uint64_t BodyOffset = Corrupt.BodyOffset;
+  uint64_t BodySize = Corrupt.BodySize;
+  std::memset(Data.data() + BodyOffset, 0xFF, BodySize);
+
+  // The index is still valid, so the archive can be opened
+  auto MaybeArchive = readArchive(Data);
+  BOOST_REQUIRE(errorMessage(MaybeArchive.takeError()) == "");
+
+  // Looking up the corrupt body reports an error...
+  auto MaybeBody = MaybeArchive->lookup(entryOf(2));
+  BOOST_TEST(errorMessage(MaybeBody.takeError()).find("cannot decompress")
+             != std::string::npos);
+
+  // ...while the other bodies can still be read
+  MaybeBody = MaybeArchive->lookup(entryOf(4));
+  BOOST_REQUIRE(errorMessage(MaybeBody.takeError()) == "");
+  BOOST_REQUIRE(MaybeBody->has_value());
+  BOOST_TEST(**MaybeBody == bodyOf(4));
+}
@@ -0,0 +1,134 @@
+/// \file PTMLCBuilder.cpp
+/// Tests and micro-benchmark for the plain C emission of ptml::PTMLCBuilder
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <iterator>
+#include <string>
+
+#define BOOST_TEST_MODULE PTMLCBuilder
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/APInt.h"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+#include "revng-c/Support/PTMLC.h"
+
+using Operator = ptml::PTMLCBuilder::Operator;
+
+static constexpr Operator AllOperators[] = {
+  Operator::PointerDereference,
+  Operator::AddressOf,
+  Operator::Arrow,
+  Operator::Dot,
+  Operator::Add,
+  Operator::Sub,
+  Operator::Mul,
+  Operator::Div,
+  Operator::Modulo,
+  Operator::RShift,
+  Operator::LShift,
+  Operator::And,
+  Operator::Or,
+  Operator::Xor,
+  Operator::CmpEq,
+  Operator::CmpNeq,
+  Operator::CmpGt,
+  Operator::CmpGte,
+  Operator::CmpLt,
+  Operator::CmpLte,
+  Operator::BoolAnd,
+  Operator::BoolOr,
+  Operator::BoolNot,
+  Operator::Assign,
+  Operator::BinaryNot,
+  Operator::UnaryMinus,
+};
+
+/// Number of statements of the synthetic function used for the benchmark
+static constexpr unsigned BenchmarkStatements = 200000;
+
+/// Emit a large function body made of statements in the shape of
+/// `a = (b OP 42) OP 0x2a;` using either the Tag-returning getters or their
+/// string-returning variants.
+template<bool UseStrings>
+static std::string emitFunctionBody(const ptml::PTMLCBuilder &B) {
+  constexpr size_t NumOperators = std::size(AllOperators);
+  llvm::APInt Value(64, 42);
+
+  std::string Result;
+  for (unsigned I = 0; I < BenchmarkStatements; ++I) {
+    Operator Op = AllOperators[I % NumOperators];
+    Operator Other = AllOperators[(I * 7) % NumOperators];
+    if constexpr (UseStrings) {
+      Result += "a " + B.getOperatorString(Operator::Assign) + " (b "
+                + B.getOperatorString(Op) + " " + B.getNumberString(Value)
+                + ") " + B.getOperatorString(Other) + " "
+                + B.getConstantString("0x2a") + ";\n";
+    } else {
+      Result += "a " + B.getOperator(Operator::Assign) + " (b "
+                + B.getOperator(Op) + " " + B.getNumber(Value) + ") "
+                + B.getOperator(Other) + " " + B.getConstantTag("0x2a")
+                + ";\n";
+    }
+  }
+
+  return Result;
+}
+
+template<bool UseStrings>
+static double timeFunctionBody(const ptml::PTMLCBuilder &B,
+                               std::string &Output) {
+  auto Start = std::chrono::steady_clock::now();
+  Output = emitFunctionBody<UseStrings>(B);
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+BOOST_AUTO_TEST_CASE(StringVariantsMatchTags) {
+  for (bool PlainC : { false, true }) {
+    ptml::PTMLCBuilder B(PlainC);
+
+    for (Operator Op : AllOperators)
+      BOOST_TEST(B.getOperatorString(Op) == B.getOperator(Op).serialize());
+
+    BOOST_TEST(B.getConstantString("0x2a")
+               == B.getConstantTag("0x2a").serialize());
+    BOOST_TEST(B.getNullString() == B.getNullTag().serialize());
+    BOOST_TEST(B.getNumberString(42) == B.getNumber(42).serialize());
+
+    llvm::APInt Negative(64, -1, /* isSigned */ true);
+    BOOST_TEST(B.getNumberString(Negative)
+               == B.getNumber(Negative).serialize());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlainCOperatorsAreNotEscaped) {
+  ptml::PTMLCBuilder B(/* GeneratePlainC */ true);
+  BOOST_TEST(B.getOperatorString(Operator::BoolAnd) == "&&");
+  BOOST_TEST(B.getOperatorString(Operator::Arrow) == "->");
+  BOOST_TEST(B.getOperatorString(Operator::CmpLte) == "<=");
+}
+
+BOOST_AUTO_TEST_CASE(EmissionThroughput) {
+  for (bool PlainC : { false, true }) {
+    ptml::PTMLCBuilder B(PlainC);
+
+    std::string TagOutput;
+    std::string StringOutput;
+    double TagSeconds = timeFunctionBody<false>(B, TagOutput);
+    double StringSeconds = timeFunctionBody<true>(B, StringOutput);
+
+    BOOST_TEST(TagOutput == StringOutput);
+
+    const char *Mode = PlainC ? "plain C" : "PTML";
+    BOOST_TEST_MESSAGE(Mode << ": " << BenchmarkStatements << " statements, "
+                            << "Tag getters " << TagSeconds << "s, "
+                            << "string getters " << StringSeconds << "s");
+  }
+}
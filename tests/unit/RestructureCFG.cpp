@@ -0,0 +1,463 @@
+/// \file RestructureCFG.cpp
+/// Tests for the restructuring of the CFG of LLVM functions
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#define BOOST_TEST_MODULE RestructureCFG
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/Support/Debug.h"
+
+#include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/BasicBlockNodeImpl.h"
+#include "revng-c/RestructureCFG/RegionCFGTree.h"
+#include "revng-c/RestructureCFG/RegionCFGTreeImpl.h"
+#include "revng-c/RestructureCFG/RestructureCFG.h"
+
+using namespace llvm;
+
+static std::unique_ptr<Module> parseModule(LLVMContext &Context,
+                                           const char *IR) {
+  SMDiagnostic Diagnostic;
+  std::unique_ptr<Module> M = parseAssemblyString(IR, Diagnostic, Context);
+  if (not M) {
+    Diagnostic.print("RestructureCFG", dbgs());
+    revng_abort("cannot parse the test module");
+  }
+  return M;
+}
+
+/// The switch in `entry` is weaved, since `common` postdominates two of its
+/// cases. Then `cond` is untangled, duplicating the subgraph starting from
+/// `then`, which has three exits.
+static const char *UntangleAndWeaveIR = R"LLVM(
+define void @untangle_and_weave(i32 %x, i1 %c, i32* %p) {
+entry:
+  switch i32 %x, label %default [
+    i32 0, label %case0
+    i32 1, label %case1
+    i32 2, label %case2
+  ]
+
+case0:
+  store i32 0, i32* %p
+  br label %common
+
+case1:
+  store i32 1, i32* %p
+  br label %common
+
+case2:
+  store i32 2, i32* %p
+  br label %cond
+
+default:
+  store i32 3, i32* %p
+  br label %cond
+
+common:
+  store i32 4, i32* %p
+  store i32 5, i32* %p
+  br label %cond
+
+cond:
+  br i1 %c, label %then, label %else
+
+then:
+  store i32 6, i32* %p
+  switch i32 %x, label %join [
+    i32 3, label %early_exit
+    i32 4, label %other_exit
+  ]
+
+else:
+  store i32 7, i32* %p
+  br label %join
+
+join:
+  store i32 8, i32* %p
+  store i32 9, i32* %p
+  store i32 10, i32* %p
+  br label %exit
+
+early_exit:
+  ret void
+
+other_exit:
+  ret void
+
+exit:
+  ret void
+}
+)LLVM";
+
+BOOST_AUTO_TEST_CASE(UntangleAndWeaveKeepDominatorTreesInSync) {
+  // Cross-check the incrementally updated trees against trees computed from
+  // scratch after every update
+  VerifyLog.enable();
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parseModule(Context, UntangleAndWeaveIR);
+  Function &F = *M->getFunction("untangle_and_weave");
+
+  RegionCFG<BasicBlock *> Region;
+  Region.setFunctionName(F.getName().str());
+  Region.setRegionName("root");
+  Region.initialize(&F);
+
+  unsigned UntangledBefore = UntanglePerformedCounter;
+  Region.markUnreachableAsInlined();
+  Region.weave();
+  Region.inflate();
+
+  bool Weaved = false;
+  for (BasicBlockNode<BasicBlock *> *Node : Region.nodes())
+    Weaved = Weaved or Node->isWeaved();
+  BOOST_TEST(Weaved);
+  BOOST_TEST(UntanglePerformedCounter > UntangledBefore);
+  BOOST_TEST(Region.isDAG());
+
+  // The nodes dropped by the untangle and by the combing have been reclaimed
+  BOOST_TEST(Region.getRemovedNodesCount() == 0U);
+}
+
+/// Sets the value of `-restructure-threads`
+static void setRestructureThreads(unsigned Threads) {
+  cl::Option *Option = cl::getRegisteredOptions().lookup("restructure-threads");
+  revng_assert(Option != nullptr);
+  *static_cast<cl::opt<unsigned> *>(Option) = Threads;
+}
+
+/// `outer` contains the loop `inner`, and `other` is a sibling of `outer`.
+/// The bodies of the loops need to be combed, and the collapsed loops are
+/// on the two sides of the conditional in `entry`, which can be untangled.
+static const char *NestedLoopsIR = R"LLVM(
+define void @nested_loops(i1 %c0, i1 %c1, i1 %c2, i1 %c3, i32* %p) {
+entry:
+  br i1 %c0, label %outer, label %other
+
+outer:
+  store i32 0, i32* %p
+  br label %inner
+
+inner:
+  br i1 %c1, label %inner_a, label %inner_b
+
+inner_a:
+  store i32 1, i32* %p
+  br i1 %c2, label %inner_b, label %inner_c
+
+inner_b:
+  store i32 2, i32* %p
+  store i32 3, i32* %p
+  br label %inner_latch
+
+inner_c:
+  store i32 4, i32* %p
+  br label %inner_latch
+
+inner_latch:
+  br i1 %c3, label %inner, label %outer_latch
+
+outer_latch:
+  store i32 5, i32* %p
+  br i1 %c1, label %outer, label %join
+
+other:
+  store i32 6, i32* %p
+  br i1 %c2, label %other_a, label %other_b
+
+other_a:
+  store i32 7, i32* %p
+  br i1 %c3, label %other_b, label %other_latch
+
+other_b:
+  store i32 8, i32* %p
+  store i32 9, i32* %p
+  br label %other_latch
+
+other_latch:
+  br i1 %c1, label %other, label %other_exit
+
+other_exit:
+  br i1 %c2, label %join, label %early_exit
+
+join:
+  store i32 10, i32* %p
+  store i32 11, i32* %p
+  store i32 12, i32* %p
+  br label %exit
+
+early_exit:
+  ret void
+
+exit:
+  ret void
+}
+
+define void @irreducible(i1 %c0, i1 %c1, i1 %c2, i32* %p) {
+entry:
+  br i1 %c0, label %a, label %b
+
+a:
+  store i32 0, i32* %p
+  br i1 %c1, label %b, label %a_exit
+
+b:
+  store i32 1, i32* %p
+  br i1 %c2, label %a, label %loop
+
+loop:
+  store i32 2, i32* %p
+  br i1 %c1, label %loop, label %b_exit
+
+a_exit:
+  store i32 3, i32* %p
+  br label %exit
+
+b_exit:
+  store i32 4, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
+)LLVM";
+
+BOOST_AUTO_TEST_CASE(ParallelRestructuringMatchesSerial) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parseModule(Context, NestedLoopsIR);
+
+  for (Function &F : *M) {
+    BOOST_TEST_MESSAGE("Restructuring " << F.getName().str());
+
+    setRestructureThreads(1);
+    ASTTree SerialAST;
+    RestructureMetrics Serial;
+    restructureCFG(F, SerialAST, &Serial);
+
+    setRestructureThreads(4);
+    ASTTree ParallelAST;
+    RestructureMetrics Parallel;
+    restructureCFG(F, ParallelAST, &Parallel);
+
+    // There must be at least two collapsed regions to run in parallel
+    BOOST_TEST(Serial.MetaRegions >= 2U);
+
+    BOOST_TEST(SerialAST.getRoot()->isEqual(ParallelAST.getRoot()));
+    BOOST_TEST(SerialAST.size() == ParallelAST.size());
+    BOOST_TEST(Serial.DuplicatedNodes == Parallel.DuplicatedNodes);
+    BOOST_TEST(Serial.DuplicatedWeight == Parallel.DuplicatedWeight);
+    BOOST_TEST(Serial.UntanglePerformed == Parallel.UntanglePerformed);
+    BOOST_TEST(Serial.GotoRegions == Parallel.GotoRegions);
+    BOOST_TEST(Serial.FinalWeight == Parallel.FinalWeight);
+  }
+
+  setRestructureThreads(1);
+}
+
+/// `b` is reachable both from `entry` and from the conditional in `a`, so the
+/// comb needs to duplicate it. `d` is heavy enough to make untangling `a` and
+/// `entry` not convenient.
+static const char *DuplicationIR = R"LLVM(
+define void @duplication(i1 %c0, i1 %c1, i32* %p) {
+entry:
+  br i1 %c0, label %a, label %b
+
+a:
+  store i32 0, i32* %p
+  br i1 %c1, label %b, label %c
+
+b:
+  store i32 1, i32* %p
+  store i32 2, i32* %p
+  store i32 3, i32* %p
+  store i32 4, i32* %p
+  store i32 5, i32* %p
+  br label %d
+
+c:
+  store i32 6, i32* %p
+  br label %d
+
+d:
+  store i32 7, i32* %p
+  store i32 8, i32* %p
+  store i32 9, i32* %p
+  store i32 10, i32* %p
+  store i32 11, i32* %p
+  ret void
+}
+)LLVM";
+
+BOOST_AUTO_TEST_CASE(DuplicationBudgetFallsBackToGotos) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parseModule(Context, DuplicationIR);
+  Function &F = *M->getFunction("duplication");
+
+  // Without a budget, the comb duplicates `b`
+  {
+    ASTTree AST;
+    RestructureMetrics Metrics;
+    restructureCFG(F, AST, &Metrics);
+    BOOST_TEST(Metrics.DuplicatedNodes > 0U);
+    BOOST_TEST(Metrics.GotoRegions == 0U);
+  }
+
+  // With a budget smaller than the weight of `b`, the region is emitted with
+  // `goto`s
+  constexpr unsigned Budget = 10;
+  DuplicationBudget = Budget;
+  ASTTree AST;
+  RestructureMetrics Metrics;
+  restructureCFG(F, AST, &Metrics);
+  DuplicationBudget = 0;
+
+  BOOST_TEST(Metrics.GotoRegions == 1U);
+  BOOST_TEST(Metrics.DuplicatedWeight * 100
+             <= Metrics.InitialWeight * uint64_t(Budget));
+
+  // Every `goto` targets a label emitted in the AST
+  llvm::SmallPtrSet<const LabelNode *, 4> Labels;
+  llvm::SmallVector<const GotoNode *, 4> Gotos;
+  for (ASTNode *Node : AST.nodes()) {
+    if (auto *Label = dyn_cast<LabelNode>(Node))
+      Labels.insert(Label);
+    else if (auto *Goto = dyn_cast<GotoNode>(Node))
+      Gotos.push_back(Goto);
+  }
+
+  BOOST_TEST(not Gotos.empty());
+  for (const GotoNode *Goto : Gotos)
+    BOOST_TEST(Labels.contains(Goto->getTarget()));
+}
+
+/// The loops `a`-`c` and `b`-`d` overlap, so they end up in a single
+/// metaregion
+static const char *OverlappingLoopsIR = R"LLVM(
+define void @overlapping(i1 %c0, i1 %c1, i32* %p) {
+entry:
+  br label %a
+
+a:
+  store i32 0, i32* %p
+  br label %b
+
+b:
+  store i32 1, i32* %p
+  br label %c
+
+c:
+  store i32 2, i32* %p
+  br i1 %c0, label %a, label %d
+
+d:
+  store i32 3, i32* %p
+  br i1 %c1, label %b, label %exit
+
+exit:
+  ret void
+}
+)LLVM";
+
+BOOST_AUTO_TEST_CASE(MetaRegionTrees) {
+  LLVMContext Context;
+  std::unique_ptr<Module> Nested = parseModule(Context, NestedLoopsIR);
+  std::unique_ptr<Module> Overlapping = parseModule(Context,
+                                                    OverlappingLoopsIR);
+
+  auto Check = [](Function *F, const char *Expected) {
+    BOOST_TEST_MESSAGE("Metaregions of " << F->getName().str());
+    BOOST_TEST(describeMetaRegionTree(*F) == Expected);
+  };
+
+  // `inner` is nested in `outer`, which is a sibling of `other`
+  Check(Nested->getFunction("nested_loops"),
+        "{other other_a other_b other_latch} "
+        "{outer outer_latch {inner inner_a inner_b inner_c inner_latch}}");
+
+  // The irreducible loop `a`-`b` and the self loop `loop` are siblings
+  Check(Nested->getFunction("irreducible"), "{a b} {loop}");
+
+  Check(Overlapping->getFunction("overlapping"), "{a b c d}");
+}
+
+BOOST_AUTO_TEST_CASE(NodeStorageReclaimsRemovedNodes) {
+  using BBNode = BasicBlockNode<BasicBlock *>;
+
+  RegionCFG<BasicBlock *> Region;
+  SmallVector<BBNode *, 8> Nodes;
+  for (unsigned I = 0; I < 8; ++I)
+    Nodes.push_back(Region.addArtificialNode());
+  for (unsigned I = 0; I + 1 < Nodes.size(); ++I)
+    addPlainEdge(std::make_pair(Nodes[I], Nodes[I + 1]));
+
+  // Remove some nodes, including the first and the last one
+  SmallPtrSet<BBNode *, 4> Removed;
+  for (unsigned I : { 0, 3, 4, 7 }) {
+    Region.removeNode(Nodes[I]);
+    Removed.insert(Nodes[I]);
+  }
+  BOOST_TEST(Region.size() == 4U);
+  BOOST_TEST(Region.getRemovedNodesCount() == 4U);
+  BOOST_TEST(Nodes[2]->successor_size() == 0U);
+  BOOST_TEST(Nodes[5]->predecessor_size() == 0U);
+
+  // The nodes that are left are visited in ID order, and can be looked up
+  SmallVector<BBNode *, 8> Expected = {
+    Nodes[1], Nodes[2], Nodes[5], Nodes[6]
+  };
+  SmallVector<BBNode *, 8> Visited(Region.begin(), Region.end());
+  BOOST_TEST((Visited == Expected));
+  for (BBNode *Node : Nodes) {
+    BBNode *Lookup = Region.getNodeByID(Node->getID());
+    BOOST_TEST((Lookup == (Removed.contains(Node) ? nullptr : Node)));
+  }
+
+  // Until they're reclaimed, the memory of the removed nodes is not reused
+  BBNode *BeforeReclaim = Region.addArtificialNode();
+  BOOST_TEST(not Removed.contains(BeforeReclaim));
+
+  // Afterwards, new nodes take the memory of the removed ones, but not their
+  // ID
+  Region.reclaimRemovedNodes();
+  BOOST_TEST(Region.getRemovedNodesCount() == 0U);
+  BBNodeIDMap<BasicBlock *, unsigned> Indices;
+  for (unsigned I = 0; I < Nodes.size(); ++I)
+    if (not Removed.contains(Nodes[I]))
+      Indices[Nodes[I]] = I + 1;
+
+  unsigned IDBound = Region.getIDBound();
+  SmallPtrSet<BBNode *, 4> Reused;
+  for (unsigned I = 0; I < Removed.size(); ++I) {
+    BBNode *New = Region.addArtificialNode();
+    BOOST_TEST(New->getID() >= IDBound);
+    BOOST_TEST(Indices.lookup(New) == 0U);
+    BOOST_TEST(Region.getNodeByID(New->getID()) == New);
+    Reused.insert(New);
+  }
+  BOOST_TEST((Reused == Removed));
+  BOOST_TEST(Region.size() == 9U);
+
+  // Once the memory of the removed nodes is used up, the storage grows again
+  BBNode *Grown = Region.addArtificialNode();
+  BOOST_TEST(not Removed.contains(Grown));
+  BOOST_TEST(Region.size() == 10U);
+}